@@ -84,6 +84,7 @@ static const pa_daemon_conf default_conf = {
     .disable_remixing = false,
     .disable_lfe_remixing = true,
     .lfe_crossover_freq = 0,
+    .render_threads = 0,
     .config_file = NULL,
     .use_pid_file = true,
     .system_instance = false,
@@ -102,7 +103,9 @@ static const pa_daemon_conf default_conf = {
     .default_sample_spec = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 },
     .alternate_sample_rate = 48000,
     .default_channel_map = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
-    .shm_size = 0
+    .shm_size = 0,
+    .shm_hugepages = PA_MEM_HUGEPAGES_NO,
+    .shm_numa_node = -1
 #ifdef HAVE_SYS_RESOURCE_H
    ,.rlimit_fsize = { .value = 0, .is_set = false },
     .rlimit_data = { .value = 0, .is_set = false },
@@ -445,6 +448,45 @@ static int parse_fragment_size_msec(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_shm_hugepages(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int b;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (pa_streq(state->rvalue, "transparent"))
+        c->shm_hugepages = PA_MEM_HUGEPAGES_TRANSPARENT;
+    else if ((b = pa_parse_boolean(state->rvalue)) >= 0)
+        c->shm_hugepages = b ? PA_MEM_HUGEPAGES_YES : PA_MEM_HUGEPAGES_NO;
+    else {
+        pa_log(_("[%s:%u] Invalid huge pages setting '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parse_shm_numa_node(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int32_t node;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (pa_streq(state->rvalue, "none"))
+        node = -1;
+    else if (pa_atoi(state->rvalue, &node) < 0 || node < -1) {
+        pa_log(_("[%s:%u] Invalid NUMA node '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->shm_numa_node = (int) node;
+    return 0;
+}
+
 static int parse_nice_level(pa_config_parser_state *state) {
     pa_daemon_conf *c;
     int32_t level;
@@ -557,8 +599,11 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-lfe-remixing",       pa_config_parse_bool,     &c->disable_lfe_remixing, NULL },
         { "enable-lfe-remixing",        pa_config_parse_not_bool, &c->disable_lfe_remixing, NULL },
         { "lfe-crossover-freq",         pa_config_parse_unsigned, &c->lfe_crossover_freq, NULL },
+        { "render-threads",             pa_config_parse_unsigned, &c->render_threads, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
+        { "shm-hugepages",              parse_shm_hugepages,      c, NULL },
+        { "shm-numa-node",              parse_shm_numa_node,      c, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
         { "log-time",                   pa_config_parse_bool,     &c->log_time, NULL },
         { "log-backtrace",              pa_config_parse_unsigned, &c->log_backtrace, NULL },
@@ -750,6 +795,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "enable-remixing = %s\n", pa_yes_no(!c->disable_remixing));
     pa_strbuf_printf(s, "enable-lfe-remixing = %s\n", pa_yes_no(!c->disable_lfe_remixing));
     pa_strbuf_printf(s, "lfe-crossover-freq = %u\n", c->lfe_crossover_freq);
+    pa_strbuf_printf(s, "render-threads = %u\n", c->render_threads);
     pa_strbuf_printf(s, "default-sample-format = %s\n", pa_sample_format_to_string(c->default_sample_spec.format));
     pa_strbuf_printf(s, "default-sample-rate = %u\n", c->default_sample_spec.rate);
     pa_strbuf_printf(s, "alternate-sample-rate = %u\n", c->alternate_sample_rate);
@@ -761,6 +807,11 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
+    pa_strbuf_printf(s, "shm-hugepages = %s\n", pa_mem_hugepages_to_string(c->shm_hugepages));
+    if (c->shm_numa_node >= 0)
+        pa_strbuf_printf(s, "shm-numa-node = %i\n", c->shm_numa_node);
+    else
+        pa_strbuf_printf(s, "shm-numa-node = none\n");
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
     pa_strbuf_printf(s, "log-backtrace = %u\n", c->log_backtrace);
@@ -129,10 +129,13 @@ typedef struct pa_daemon_conf {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_threads;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    pa_mem_hugepages_t shm_hugepages;
+    int shm_numa_node;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
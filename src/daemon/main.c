@@ -1018,7 +1018,7 @@ int main(int argc, char *argv[]) {
 
     if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm,
                           !conf->disable_shm && !conf->disable_memfd && pa_memfd_is_locally_supported(),
-                          conf->shm_size))) {
+                          conf->shm_size, conf->shm_hugepages, conf->shm_numa_node))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
@@ -1031,6 +1031,7 @@ int main(int argc, char *argv[]) {
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
     c->lfe_crossover_freq = conf->lfe_crossover_freq;
+    c->render_threads = conf->render_threads;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
@@ -0,0 +1,428 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "convolver.h"
+
+/* Limits of the FFT partition size. Larger partitions mean fewer of
+ * them for long filters, smaller ones cheaper transforms for the partial
+ * blocks we get from small requests. */
+#define MIN_BLOCK_SIZE 64
+#define MAX_BLOCK_SIZE 512
+
+struct pa_convolver {
+    pa_convolver_engine_t engine;
+    unsigned n_inputs, n_outputs, n_taps;
+
+    /* Direct engine */
+    float *taps;                /* [input][output][tap] */
+    float *history;             /* n_taps frames, newest at history_offset */
+    unsigned history_offset;
+    float *sums;
+
+#ifdef HAVE_FFTW
+    /* FFT engine. Spectra are stored split into real and imaginary
+     * parts, each padded to spectrum_stride, so that the complex
+     * multiply-accumulate is a plain loop over aligned arrays the
+     * compiler can vectorize. */
+    unsigned block_size, n_partitions, spectrum_stride;
+    unsigned fill, current;
+
+    float *windows;             /* [input][2 * block_size] */
+    float *input_re, *input_im; /* [input][partition], a ring indexed by current */
+    float *filter_re, *filter_im; /* [input][output][partition] */
+    float *past_re, *past_im;   /* [output], all but the current partition summed up */
+    float *sum_re, *sum_im;
+    float *out;
+
+    fftwf_plan forward, backward;
+#endif
+};
+
+static pa_convolver *direct_new(pa_convolver *c) {
+    c->taps = pa_xnew0(float, c->n_inputs * c->n_outputs * c->n_taps);
+    c->history = pa_xnew0(float, c->n_inputs * c->n_taps);
+    c->sums = pa_xnew0(float, c->n_outputs);
+
+    return c;
+}
+
+static void direct_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *taps, unsigned stride) {
+    float *d = c->taps + (input * c->n_outputs + output) * c->n_taps;
+    unsigned j;
+
+    for (j = 0; j < c->n_taps; j++)
+        d[j] = taps[j * stride];
+}
+
+/* Adds history frames [from, to) convolved with taps [first_tap, ...) */
+static void direct_fold(pa_convolver *c, unsigned from, unsigned to, unsigned first_tap) {
+    unsigned i, o, j;
+
+    for (o = 0; o < c->n_outputs; o++) {
+        for (i = 0; i < c->n_inputs; i++) {
+            const float *h = c->taps + (i * c->n_outputs + o) * c->n_taps + first_tap;
+            const float *x = c->history + i;
+            float sum = 0;
+
+            for (j = from; j < to; j++)
+                sum += x[j * c->n_inputs] * h[j - from];
+
+            c->sums[o] += sum;
+        }
+    }
+}
+
+static void direct_run(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    unsigned l, o;
+
+    for (l = 0; l < n_frames; l++) {
+        memcpy(c->history + c->history_offset * c->n_inputs, src, c->n_inputs * sizeof(float));
+        src += c->n_inputs;
+
+        memset(c->sums, 0, c->n_outputs * sizeof(float));
+
+        /* The history is a ring with the newest frame at
+         * history_offset and older ones following it, so tap j
+         * applies to frame (history_offset + j) % n_taps. Fold it in
+         * two runs instead of wrapping the index for every tap. */
+        direct_fold(c, c->history_offset, c->n_taps, 0);
+        direct_fold(c, 0, c->history_offset, c->n_taps - c->history_offset);
+
+        for (o = 0; o < c->n_outputs; o++)
+            *(dst++) = c->sums[o];
+
+        c->history_offset = (c->history_offset > 0 ? c->history_offset : c->n_taps) - 1;
+    }
+}
+
+#ifdef HAVE_FFTW
+
+static float *fft_alloc(size_t n) {
+    float *p;
+
+    p = fftwf_malloc(n * sizeof(float));
+    pa_assert_se(p);
+    memset(p, 0, n * sizeof(float));
+
+    return p;
+}
+
+static void complex_mac(float *acc_re, float *acc_im, const float *x_re, const float *x_im,
+                        const float *h_re, const float *h_im, unsigned n) {
+    unsigned k;
+
+    for (k = 0; k < n; k++) {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+static size_t input_offset(pa_convolver *c, unsigned input, unsigned partition) {
+    return (input * c->n_partitions + partition) * c->spectrum_stride;
+}
+
+static size_t filter_offset(pa_convolver *c, unsigned input, unsigned output, unsigned partition) {
+    return ((input * c->n_outputs + output) * c->n_partitions + partition) * c->spectrum_stride;
+}
+
+static pa_convolver *fft_new(pa_convolver *c) {
+    fftwf_iodim dim;
+
+    c->block_size = PA_CLAMP(pa_make_power_of_two(c->n_taps), MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+    c->n_partitions = PA_ROUND_UP(c->n_taps, c->block_size) / c->block_size;
+    /* Keeps every spectrum as aligned as the first one, which FFTW
+     * needs for executing plans on other arrays */
+    c->spectrum_stride = PA_ROUND_UP(c->block_size + 1, 16);
+
+    c->windows = fft_alloc(c->n_inputs * 2 * c->block_size);
+    c->input_re = fft_alloc(c->n_inputs * c->n_partitions * c->spectrum_stride);
+    c->input_im = fft_alloc(c->n_inputs * c->n_partitions * c->spectrum_stride);
+    c->filter_re = fft_alloc(c->n_inputs * c->n_outputs * c->n_partitions * c->spectrum_stride);
+    c->filter_im = fft_alloc(c->n_inputs * c->n_outputs * c->n_partitions * c->spectrum_stride);
+    c->past_re = fft_alloc(c->n_outputs * c->spectrum_stride);
+    c->past_im = fft_alloc(c->n_outputs * c->spectrum_stride);
+    c->sum_re = fft_alloc(c->spectrum_stride);
+    c->sum_im = fft_alloc(c->spectrum_stride);
+    c->out = fft_alloc(2 * c->block_size);
+
+    dim.n = (int) (2 * c->block_size);
+    dim.is = 1;
+    dim.os = 1;
+
+    c->forward = fftwf_plan_guru_split_dft_r2c(1, &dim, 0, NULL, c->windows, c->input_re, c->input_im, FFTW_ESTIMATE);
+    c->backward = fftwf_plan_guru_split_dft_c2r(1, &dim, 0, NULL, c->sum_re, c->sum_im, c->out, FFTW_ESTIMATE);
+
+    if (!c->forward || !c->backward) {
+        pa_log("Failed to create FFT plans.");
+        pa_convolver_free(c);
+        return NULL;
+    }
+
+    pa_log_debug("FFT convolution of %u taps in %u partitions of %u frames.", c->n_taps, c->n_partitions, c->block_size);
+
+    return c;
+}
+
+static void fft_free(pa_convolver *c) {
+    if (c->forward)
+        fftwf_destroy_plan(c->forward);
+    if (c->backward)
+        fftwf_destroy_plan(c->backward);
+
+    fftwf_free(c->windows);
+    fftwf_free(c->input_re);
+    fftwf_free(c->input_im);
+    fftwf_free(c->filter_re);
+    fftwf_free(c->filter_im);
+    fftwf_free(c->past_re);
+    fftwf_free(c->past_im);
+    fftwf_free(c->sum_re);
+    fftwf_free(c->sum_im);
+    fftwf_free(c->out);
+}
+
+static void fft_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *taps, unsigned stride) {
+    /* Folds the normalization of the inverse transform into the filter */
+    float scale = 1.0f / (2 * c->block_size);
+    unsigned p, j;
+
+    for (p = 0; p < c->n_partitions; p++) {
+        size_t offset = filter_offset(c, input, output, p);
+
+        memset(c->out, 0, 2 * c->block_size * sizeof(float));
+
+        for (j = 0; j < c->block_size && p * c->block_size + j < c->n_taps; j++)
+            c->out[j] = taps[(p * c->block_size + j) * stride] * scale;
+
+        fftwf_execute_split_dft_r2c(c->forward, c->out, c->filter_re + offset, c->filter_im + offset);
+    }
+}
+
+/* Sums up the contributions of all complete blocks for the block that
+ * starts now, they do not change until it is complete */
+static void fft_update_past(pa_convolver *c) {
+    unsigned i, o, p;
+
+    memset(c->past_re, 0, c->n_outputs * c->spectrum_stride * sizeof(float));
+    memset(c->past_im, 0, c->n_outputs * c->spectrum_stride * sizeof(float));
+
+    for (o = 0; o < c->n_outputs; o++) {
+        for (i = 0; i < c->n_inputs; i++) {
+            for (p = 1; p < c->n_partitions; p++) {
+                size_t x = input_offset(c, i, (c->current + c->n_partitions - p) % c->n_partitions);
+                size_t h = filter_offset(c, i, o, p);
+
+                complex_mac(c->past_re + o * c->spectrum_stride, c->past_im + o * c->spectrum_stride,
+                            c->input_re + x, c->input_im + x, c->filter_re + h, c->filter_im + h,
+                            c->spectrum_stride);
+            }
+        }
+    }
+}
+
+static void fft_run(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    unsigned i, o, k, n;
+
+    while (n_frames > 0) {
+        n = PA_MIN(n_frames, c->block_size - c->fill);
+
+        /* The second half of each window is the current block, the
+         * first half the previous one. What follows the part filled
+         * so far does not matter for the outputs we take. */
+        for (i = 0; i < c->n_inputs; i++) {
+            float *w = c->windows + i * 2 * c->block_size + c->block_size + c->fill;
+            size_t x = input_offset(c, i, c->current);
+
+            for (k = 0; k < n; k++)
+                w[k] = src[k * c->n_inputs + i];
+
+            fftwf_execute_split_dft_r2c(c->forward, c->windows + i * 2 * c->block_size, c->input_re + x, c->input_im + x);
+        }
+
+        for (o = 0; o < c->n_outputs; o++) {
+            memcpy(c->sum_re, c->past_re + o * c->spectrum_stride, c->spectrum_stride * sizeof(float));
+            memcpy(c->sum_im, c->past_im + o * c->spectrum_stride, c->spectrum_stride * sizeof(float));
+
+            for (i = 0; i < c->n_inputs; i++) {
+                size_t x = input_offset(c, i, c->current);
+                size_t h = filter_offset(c, i, o, 0);
+
+                complex_mac(c->sum_re, c->sum_im, c->input_re + x, c->input_im + x,
+                            c->filter_re + h, c->filter_im + h, c->spectrum_stride);
+            }
+
+            fftwf_execute_split_dft_c2r(c->backward, c->sum_re, c->sum_im, c->out);
+
+            for (k = 0; k < n; k++)
+                dst[k * c->n_outputs + o] = c->out[c->block_size + c->fill + k];
+        }
+
+        src += n * c->n_inputs;
+        dst += n * c->n_outputs;
+        n_frames -= n;
+        c->fill += n;
+
+        if (c->fill >= c->block_size) {
+            for (i = 0; i < c->n_inputs; i++) {
+                float *w = c->windows + i * 2 * c->block_size;
+
+                memcpy(w, w + c->block_size, c->block_size * sizeof(float));
+            }
+
+            c->fill = 0;
+            c->current = (c->current + 1) % c->n_partitions;
+
+            fft_update_past(c);
+        }
+    }
+}
+
+static void fft_reset(pa_convolver *c) {
+    memset(c->windows, 0, c->n_inputs * 2 * c->block_size * sizeof(float));
+    memset(c->input_re, 0, c->n_inputs * c->n_partitions * c->spectrum_stride * sizeof(float));
+    memset(c->input_im, 0, c->n_inputs * c->n_partitions * c->spectrum_stride * sizeof(float));
+    memset(c->past_re, 0, c->n_outputs * c->spectrum_stride * sizeof(float));
+    memset(c->past_im, 0, c->n_outputs * c->spectrum_stride * sizeof(float));
+    c->fill = 0;
+    c->current = 0;
+}
+
+#endif /* HAVE_FFTW */
+
+pa_convolver *pa_convolver_new(pa_convolver_engine_t engine, unsigned n_inputs, unsigned n_outputs, unsigned n_taps) {
+    pa_convolver *c;
+
+    pa_assert(n_inputs > 0);
+    pa_assert(n_outputs > 0);
+    pa_assert(n_taps > 0);
+
+#ifndef HAVE_FFTW
+    if (engine == PA_CONVOLVER_FFT) {
+        pa_log("FFT convolution is not supported, PulseAudio was built without FFTW.");
+        return NULL;
+    }
+#endif
+
+    c = pa_xnew0(pa_convolver, 1);
+    c->engine = engine;
+    c->n_inputs = n_inputs;
+    c->n_outputs = n_outputs;
+    c->n_taps = n_taps;
+
+    switch (engine) {
+        case PA_CONVOLVER_DIRECT:
+            return direct_new(c);
+
+#ifdef HAVE_FFTW
+        case PA_CONVOLVER_FFT:
+            return fft_new(c);
+#endif
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+void pa_convolver_free(pa_convolver *c) {
+    pa_assert(c);
+
+#ifdef HAVE_FFTW
+    if (c->engine == PA_CONVOLVER_FFT)
+        fft_free(c);
+#endif
+
+    pa_xfree(c->taps);
+    pa_xfree(c->history);
+    pa_xfree(c->sums);
+    pa_xfree(c);
+}
+
+void pa_convolver_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *taps, unsigned stride) {
+    pa_assert(c);
+    pa_assert(input < c->n_inputs);
+    pa_assert(output < c->n_outputs);
+    pa_assert(taps);
+
+#ifdef HAVE_FFTW
+    if (c->engine == PA_CONVOLVER_FFT) {
+        fft_set_filter(c, input, output, taps, stride);
+        fft_update_past(c);
+        return;
+    }
+#endif
+
+    direct_set_filter(c, input, output, taps, stride);
+}
+
+void pa_convolver_reset(pa_convolver *c) {
+    pa_assert(c);
+
+#ifdef HAVE_FFTW
+    if (c->engine == PA_CONVOLVER_FFT) {
+        fft_reset(c);
+        return;
+    }
+#endif
+
+    memset(c->history, 0, c->n_inputs * c->n_taps * sizeof(float));
+    c->history_offset = 0;
+}
+
+void pa_convolver_run(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    pa_assert(c);
+    pa_assert(src);
+    pa_assert(dst);
+
+#ifdef HAVE_FFTW
+    if (c->engine == PA_CONVOLVER_FFT) {
+        fft_run(c, src, dst, n_frames);
+        return;
+    }
+#endif
+
+    direct_run(c, src, dst, n_frames);
+}
+
+int pa_convolver_engine_from_string(const char *s, pa_convolver_engine_t *engine) {
+    pa_assert(s);
+    pa_assert(engine);
+
+    if (pa_streq(s, "direct"))
+        *engine = PA_CONVOLVER_DIRECT;
+    else if (pa_streq(s, "fft"))
+        *engine = PA_CONVOLVER_FFT;
+    else
+        return -1;
+
+    return 0;
+}
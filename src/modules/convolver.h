@@ -0,0 +1,52 @@
+#ifndef fooconvolverhfoo
+#define fooconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Convolves n_inputs interleaved float channels with one FIR filter per
+ * input/output pair and sums the results per output.
+ *
+ * The direct engine computes every output sample in the time domain,
+ * which is cheap for very short filters only. The FFT engine uses
+ * uniformly partitioned overlap-save convolution. It adds no latency:
+ * a block that is not complete yet is transformed zero padded and
+ * only the partitions older than the current block are cached. */
+
+typedef enum pa_convolver_engine {
+    PA_CONVOLVER_DIRECT,
+    PA_CONVOLVER_FFT,
+} pa_convolver_engine_t;
+
+typedef struct pa_convolver pa_convolver;
+
+/* Returns NULL if the engine is not available */
+pa_convolver *pa_convolver_new(pa_convolver_engine_t engine, unsigned n_inputs, unsigned n_outputs, unsigned n_taps);
+void pa_convolver_free(pa_convolver *c);
+
+/* Sets the filter from input to output, taps[j * stride] is tap j.
+ * Filters default to silence. */
+void pa_convolver_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *taps, unsigned stride);
+
+/* Forgets about all past input */
+void pa_convolver_reset(pa_convolver *c);
+
+void pa_convolver_run(pa_convolver *c, const float *src, float *dst, unsigned n_frames);
+
+int pa_convolver_engine_from_string(const char *s, pa_convolver_engine_t *engine);
+
+#endif
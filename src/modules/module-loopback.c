@@ -32,6 +32,7 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/memchunk-ring.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
@@ -61,6 +62,8 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*32)
 
+#define RING_SIZE 256
+
 #define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
 
 struct userdata {
@@ -71,6 +74,7 @@ struct userdata {
     pa_source_output *source_output;
 
     pa_asyncmsgq *asyncmsgq;
+    pa_memchunk_ring *ring;
     pa_memblockq *memblockq;
 
     pa_rtpoll_item *rtpoll_item_read, *rtpoll_item_write;
@@ -116,8 +120,7 @@ static const char* const valid_modargs[] = {
 };
 
 enum {
-    SINK_INPUT_MESSAGE_POST = PA_SINK_INPUT_MESSAGE_MAX,
-    SINK_INPUT_MESSAGE_REWIND,
+    SINK_INPUT_MESSAGE_WAKEUP = PA_SINK_INPUT_MESSAGE_MAX,
     SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT
 };
 
@@ -302,7 +305,10 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
         chunk = &copy;
     }
 
-    pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_POST, NULL, 0, chunk, NULL);
+    /* The audio goes through the ring, the message queue is only
+     * needed if the sink input is waiting for it */
+    if (pa_memchunk_ring_push(u->ring, chunk))
+        pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_WAKEUP, NULL, 0, NULL, NULL);
     u->send_counter += (int64_t) chunk->length;
 }
 
@@ -314,7 +320,8 @@ static void source_output_process_rewind_cb(pa_source_output *o, size_t nbytes)
     pa_source_output_assert_io_context(o);
     pa_assert_se(u = o->userdata);
 
-    pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_REWIND, NULL, (int64_t) nbytes, NULL, NULL);
+    if (pa_memchunk_ring_seek(u->ring, -(int64_t) nbytes, PA_SEEK_RELATIVE))
+        pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_WAKEUP, NULL, 0, NULL, NULL);
     u->send_counter -= (int64_t) nbytes;
 }
 
@@ -368,6 +375,12 @@ static void source_output_detach_cb(pa_source_output *o) {
         pa_rtpoll_item_free(u->rtpoll_item_write);
         u->rtpoll_item_write = NULL;
     }
+
+    /* Hand over what did not fit into the ring so far. Otherwise it
+     * would sit here until the next push, which may come from another
+     * source long after a move, or never. */
+    if (!pa_memchunk_ring_flush(u->ring))
+        pa_log_debug("Ring still full on detach, keeping the rest for the next push.");
 }
 
 /* Called from output thread context */
@@ -456,6 +469,18 @@ static void source_output_suspend_cb(pa_source_output *o, bool suspended) {
     update_adjust_timer(u);
 }
 
+/* Called from output thread context */
+static void drain_ring(struct userdata *u) {
+    int64_t n;
+
+    n = pa_memchunk_ring_drain(u->ring, u->memblockq);
+
+    if (!PA_SINK_IS_OPENED(u->sink_input->sink->thread_info.state))
+        pa_memblockq_flush_write(u->memblockq, true);
+
+    u->recv_counter += n;
+}
+
 /* Called from output thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
@@ -470,8 +495,13 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
         ;
     u->in_pop = false;
 
+    drain_ring(u);
+
     if (pa_memblockq_peek(u->memblockq, chunk) < 0) {
         pa_log_info("Could not peek into queue");
+
+        /* Have the source output tell us when there is data again */
+        pa_memchunk_ring_request_wakeup(u->ring);
         return -1;
     }
 
@@ -510,14 +540,11 @@ static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, in
             break;
         }
 
-        case SINK_INPUT_MESSAGE_POST:
+        case SINK_INPUT_MESSAGE_WAKEUP:
 
             pa_sink_input_assert_io_context(u->sink_input);
 
-            if (PA_SINK_IS_OPENED(u->sink_input->sink->thread_info.state))
-                pa_memblockq_push_align(u->memblockq, chunk);
-            else
-                pa_memblockq_flush_write(u->memblockq, true);
+            drain_ring(u);
 
             /* Is this the end of an underrun? Then let's start things
              * right-away */
@@ -531,21 +558,6 @@ static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, in
                                              false, true, false);
             }
 
-            u->recv_counter += (int64_t) chunk->length;
-
-            return 0;
-
-        case SINK_INPUT_MESSAGE_REWIND:
-
-            pa_sink_input_assert_io_context(u->sink_input);
-
-            if (PA_SINK_IS_OPENED(u->sink_input->sink->thread_info.state))
-                pa_memblockq_seek(u->memblockq, -offset, PA_SEEK_RELATIVE, true);
-            else
-                pa_memblockq_flush_write(u->memblockq, true);
-
-            u->recv_counter -= offset;
-
             return 0;
 
         case SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT: {
@@ -943,6 +955,7 @@ int pa__init(pa_module *m) {
     pa_memblock_unref(silence.memblock);
 
     u->asyncmsgq = pa_asyncmsgq_new(0);
+    u->ring = pa_memchunk_ring_new(RING_SIZE);
 
     if (!pa_proplist_contains(u->source_output->proplist, PA_PROP_MEDIA_NAME))
         pa_proplist_setf(u->source_output->proplist, PA_PROP_MEDIA_NAME, "Loopback to %s",
@@ -999,5 +1012,8 @@ void pa__done(pa_module*m) {
     if (u->asyncmsgq)
         pa_asyncmsgq_unref(u->asyncmsgq);
 
+    if (u->ring)
+        pa_memchunk_ring_free(u->ring);
+
     pa_xfree(u);
 }
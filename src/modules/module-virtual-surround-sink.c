@@ -41,6 +41,7 @@
 
 #include <math.h>
 
+#include "convolver.h"
 #include "module-virtual-surround-sink-symdef.h"
 
 PA_MODULE_AUTHOR("Niels Ole Salscheider");
@@ -58,10 +59,21 @@ PA_MODULE_USAGE(
           "use_volume_sharing=<yes or no> "
           "force_flat_volume=<yes or no> "
           "hrir=/path/to/left_hrir.wav "
+          "convolution=<direct or fft> "
         ));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+/* Only used for the direct convolution, which is too expensive for
+ * longer filters */
+#define MAX_DIRECT_HRIR_SAMPLES 64
+
+#ifdef HAVE_FFTW
+#define DEFAULT_CONVOLUTION PA_CONVOLVER_FFT
+#else
+#define DEFAULT_CONVOLUTION PA_CONVOLVER_DIRECT
+#endif
+
 struct userdata {
     pa_module *module;
 
@@ -85,8 +97,7 @@ struct userdata {
     unsigned hrir_samples;
     float *hrir_data;
 
-    float *input_buffer;
-    int input_buffer_offset;
+    pa_convolver *convolver;
 };
 
 static const char* const valid_modargs[] = {
@@ -100,6 +111,7 @@ static const char* const valid_modargs[] = {
     "use_volume_sharing",
     "force_flat_volume",
     "hrir",
+    "convolution",
     NULL
 };
 
@@ -215,13 +227,9 @@ static void sink_set_mute_cb(pa_sink *s) {
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
     float *src, *dst;
-    unsigned n;
+    unsigned n, l;
     pa_memchunk tchunk;
 
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
-
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
     pa_assert_se(u = i->userdata);
@@ -253,29 +261,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (l = 0; l < n; l++) {
-        memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
-
-        sum_right = 0;
-        sum_left = 0;
-
-        /* fold the input buffer with the impulse response */
-        for (j = 0; j < u->hrir_samples; j++) {
-            for (k = 0; k < u->channels; k++) {
-                current_sample = u->input_buffer[((u->input_buffer_offset + j) % u->hrir_samples) * u->channels + k];
-
-                sum_left += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_left[k]];
-                sum_right += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_right[k]];
-            }
-        }
-
-        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
-        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
+    /* fold the input with the impulse response */
+    pa_convolver_run(u->convolver, src, dst, n);
 
-        u->input_buffer_offset--;
-        if (u->input_buffer_offset < 0)
-            u->input_buffer_offset += u->hrir_samples;
-    }
+    for (l = 0; l < 2 * n; l++)
+        dst[l] = PA_CLAMP_UNLIKELY(dst[l], -1.0f, 1.0f);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -304,8 +294,7 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
 
             /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
+            pa_convolver_reset(u->convolver);
         }
     }
 
@@ -579,6 +568,9 @@ int pa__init(pa_module*m) {
     pa_memchunk hrir_temp_chunk, hrir_temp_chunk_resampled;
     pa_resampler *resampler;
 
+    pa_convolver_engine_t convolution = DEFAULT_CONVOLUTION;
+    const char *convolution_str;
+
     size_t hrir_copied_length, hrir_total_length;
 
     hrir_temp_chunk.memblock = NULL;
@@ -645,6 +637,12 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if ((convolution_str = pa_modargs_get_value(ma, "convolution", NULL)) &&
+        pa_convolver_engine_from_string(convolution_str, &convolution) < 0) {
+        pa_log("Invalid convolution '%s', expected 'direct' or 'fft'.", convolution_str);
+        goto fail;
+    }
+
     /* sample spec / map of sink input */
     pa_channel_map_init_stereo(&sink_input_map);
     sink_input_ss.channels = 2;
@@ -747,9 +745,10 @@ int pa__init(pa_module*m) {
                                  PA_RESAMPLER_SRC_SINC_BEST_QUALITY, PA_RESAMPLER_NO_REMAP);
 
     u->hrir_samples = hrir_temp_chunk.length / pa_frame_size(&hrir_temp_ss) * hrir_ss.rate / hrir_temp_ss.rate;
-    if (u->hrir_samples > 64) {
-        u->hrir_samples = 64;
-        pa_log("The (resampled) hrir contains more than 64 samples. Only the first 64 samples will be used to limit processor usage.");
+    if (convolution == PA_CONVOLVER_DIRECT && u->hrir_samples > MAX_DIRECT_HRIR_SAMPLES) {
+        u->hrir_samples = MAX_DIRECT_HRIR_SAMPLES;
+        pa_log("The (resampled) hrir contains more than %u samples. Only the first %u samples will be used to limit processor usage. "
+               "Use convolution=fft to use all of them.", MAX_DIRECT_HRIR_SAMPLES, MAX_DIRECT_HRIR_SAMPLES);
     }
 
     hrir_total_length = u->hrir_samples * pa_frame_size(&hrir_ss);
@@ -771,10 +770,10 @@ int pa__init(pa_module*m) {
             hrir_data = (float *) pa_memblock_acquire(hrir_temp_chunk_resampled.memblock);
 
             if (hrir_total_length - hrir_copied_length >= hrir_temp_chunk_resampled.length) {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
+                memcpy((char *) u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
                 hrir_copied_length += hrir_temp_chunk_resampled.length;
             } else {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
+                memcpy((char *) u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
                 hrir_copied_length = hrir_total_length;
             }
 
@@ -825,8 +824,13 @@ int pa__init(pa_module*m) {
         }
     }
 
-    u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
-    u->input_buffer_offset = 0;
+    if (!(u->convolver = pa_convolver_new(convolution, u->channels, 2, u->hrir_samples)))
+        goto fail;
+
+    for (i = 0; i < u->channels; i++) {
+        pa_convolver_set_filter(u->convolver, i, 0, u->hrir_data + u->mapping_left[i], u->hrir_channels);
+        pa_convolver_set_filter(u->convolver, i, 1, u->hrir_data + u->mapping_right[i], u->hrir_channels);
+    }
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
@@ -887,8 +891,8 @@ void pa__done(pa_module*m) {
     if (u->hrir_data)
         pa_xfree(u->hrir_data);
 
-    if (u->input_buffer)
-        pa_xfree(u->input_buffer);
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
 
     if (u->mapping_left)
         pa_xfree(u->mapping_left);
@@ -195,6 +195,23 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
     return c;
 }
 
+static void srb_template_clear(pa_context *c) {
+    unsigned i;
+
+    c->srb_template.readfd = -1;
+    c->srb_template.writefd = -1;
+
+    if (c->srb_template.memblock) {
+        pa_memblock_unref(c->srb_template.memblock);
+        c->srb_template.memblock = NULL;
+    }
+
+    for (i = 0; i < c->srb_template.n_lanes; i++)
+        pa_memblock_unref(c->srb_template.lanes[i]);
+    c->srb_template.n_lanes = 0;
+    c->srb_n_lanes = 0;
+}
+
 static void context_unlink(pa_context *c) {
     pa_stream *s;
 
@@ -222,10 +239,7 @@ static void context_unlink(pa_context *c) {
         c->pstream = NULL;
     }
 
-    if (c->srb_template.memblock) {
-        pa_memblock_unref(c->srb_template.memblock);
-        c->srb_template.memblock = NULL;
-    }
+    srb_template_clear(c);
 
     if (c->client) {
         pa_socket_client_unref(c->client);
@@ -370,16 +384,20 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
         return;
     }
 
+    /* The srbchannel's own block comes first, then those of its lanes */
+    if (!c->srb_template.memblock)
+        c->srb_template.memblock = pa_memblock_ref(memblock);
+    else
+        c->srb_template.lanes[c->srb_template.n_lanes++] = pa_memblock_ref(memblock);
+
+    if (c->srb_template.n_lanes < c->srb_n_lanes)
+        return;
+
     /* Create the srbchannel */
-    c->srb_template.memblock = memblock;
-    pa_memblock_ref(memblock);
     sr = pa_srbchannel_new_from_template(c->mainloop, &c->srb_template);
     if (!sr) {
         pa_log_warn("Failed to create srbchannel from template");
-        c->srb_template.readfd = -1;
-        c->srb_template.writefd = -1;
-        pa_memblock_unref(c->srb_template.memblock);
-        c->srb_template.memblock = NULL;
+        srb_template_clear(c);
         return;
     }
 
@@ -393,6 +411,19 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
     pa_pstream_set_srbchannel(c->pstream, sr);
 }
 
+static void pstream_memfd_segment_callback(pa_pstream *p, pa_mempool *pool, void *userdata) {
+    pa_context *c = userdata;
+
+    pa_assert(p);
+    pa_assert(pool);
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    /* Our pool has grown, register the new segments like the pool
+     * itself */
+    pa_pstream_register_memfd_segments(p, pool, c->version >= 35 ? c->pdispatch : NULL, &c->ctag);
+}
+
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     pa_context *c = userdata;
     pa_stream *s;
@@ -405,13 +436,21 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
 
     pa_context_ref(c);
 
-    if (c->srb_template.readfd != -1 && c->srb_template.memblock == NULL) {
+    if (c->srb_template.readfd != -1 &&
+        (c->srb_template.memblock == NULL || c->srb_template.n_lanes < c->srb_n_lanes)) {
         handle_srbchannel_memblock(c, chunk->memblock);
         pa_context_unref(c);
         return;
     }
 
-    if ((s = pa_hashmap_get(c->record_streams, PA_UINT32_TO_PTR(channel)))) {
+    if ((s = pa_hashmap_get(c->playback_streams, PA_UINT32_TO_PTR(channel)))) {
+
+        /* The only block sent on a playback channel is the ring the
+         * server wants the stream's data written into */
+        if (!s->write_ring && chunk->memblock && !pa_memblock_is_ours(chunk->memblock))
+            s->write_ring = pa_write_ring_attach(chunk->memblock, pa_frame_size(&s->sample_spec));
+
+    } else if ((s = pa_hashmap_get(c->record_streams, PA_UINT32_TO_PTR(channel)))) {
 
         if (chunk->memblock) {
             pa_memblockq_seek(s->record_memblockq, offset, seek, true);
@@ -540,6 +579,12 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+            if (c->do_shm && c->version >= 33)
+                pa_pstream_enable_block_id_batching(c->pstream);
+
+            if (c->do_shm && c->version >= 35)
+                pa_pstream_enable_max_export_slots(c->pstream);
+
             c->shm_type = PA_MEM_TYPE_PRIVATE;
             if (c->do_shm) {
                 if (c->version >= 31 && memfd_on_remote && c->memfd_on_local) {
@@ -611,6 +656,7 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
     pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
     pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
+    pa_pstream_set_memfd_segment_callback(c->pstream, pstream_memfd_segment_callback, c);
 
     pa_assert(!c->pdispatch);
     c->pdispatch = pa_pdispatch_new(c->mainloop, c->use_rtclock, command_table, PA_COMMAND_MAX);
@@ -1471,6 +1517,7 @@ static void pa_command_enable_srbchannel(pa_pdispatch *pd, uint32_t command, uin
 
 #ifdef HAVE_CREDS
     pa_cmsg_ancil_data *ancil = NULL;
+    uint32_t n_lanes = 0;
 
     pa_assert(pd);
     pa_assert(command == PA_COMMAND_ENABLE_SRBCHANNEL);
@@ -1489,11 +1536,19 @@ static void pa_command_enable_srbchannel(pa_pdispatch *pd, uint32_t command, uin
     if (ancil->nfd != 2 || ancil->fds[0] == -1 || ancil->fds[1] == -1)
         goto fail;
 
+    if (c->version >= 34 &&
+        (pa_tagstruct_getu32(t, &n_lanes) < 0 || n_lanes > PA_SRBCHANNEL_LANES_MAX))
+        goto fail;
+
+    if (!pa_tagstruct_eof(t))
+        goto fail;
+
     pa_context_ref(c);
 
     c->srb_template.readfd = ancil->fds[0];
     c->srb_template.writefd = ancil->fds[1];
     c->srb_setup_tag = tag;
+    c->srb_n_lanes = n_lanes;
 
     pa_context_unref(c);
 
@@ -1524,12 +1579,7 @@ static void pa_command_disable_srbchannel(pa_pdispatch *pd, uint32_t command, ui
 
     pa_pstream_set_srbchannel(c->pstream, NULL);
 
-    c->srb_template.readfd = -1;
-    c->srb_template.writefd = -1;
-    if (c->srb_template.memblock) {
-        pa_memblock_unref(c->srb_template.memblock);
-        c->srb_template.memblock = NULL;
-    }
+    srb_template_clear(c);
 
     /* Send disable command back again */
     t2 = pa_tagstruct_new();
@@ -1547,7 +1597,7 @@ static void pa_command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command,
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
-    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, t))
+    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, tag, t))
         pa_context_fail(c, PA_ERR_PROTOCOL);
 }
 
@@ -41,6 +41,7 @@
 #include <pulsecore/hashmap.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/write-ring.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-util.h>
 #endif
@@ -72,6 +73,7 @@ struct pa_context {
 
     pa_srbchannel_template srb_template;
     uint32_t srb_setup_tag;
+    unsigned srb_n_lanes;
 
     pa_hashmap *record_streams, *playback_streams;
     PA_LLIST_HEAD(pa_stream, streams);
@@ -179,6 +181,9 @@ struct pa_stream {
     /* playback */
     pa_memblock *write_memblock;
     void *write_data;
+    pa_write_ring *write_ring;
+    void *write_ring_data;
+    size_t write_ring_length;
     int64_t latest_underrun_at_index;
 
     /* recording */
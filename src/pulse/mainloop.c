@@ -32,6 +32,10 @@
 #include <pulsecore/pipe.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -39,7 +43,9 @@
 #include <pulsecore/poll.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/i18n.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-error.h>
@@ -57,6 +63,14 @@ struct pa_io_event {
     pa_io_event_flags_t events;
     struct pollfd *pollfd;
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* The fd registered with epoll, a dup() of fd if there is another
+     * io event for the same fd already. -1 if not registered. */
+    int epoll_fd;
+    /* What epoll hands back for it, see epoll_io_events */
+    uint32_t epoll_key;
+#endif
+
     pa_io_event_cb_t callback;
     void *userdata;
     pa_io_event_destroy_cb_t destroy_callback;
@@ -72,6 +86,12 @@ struct pa_time_event {
     bool use_rtclock:1;
     pa_usec_t time;
 
+    /* Where in the time event heap this event is, TIME_HEAP_NONE if it
+     * is not enabled or about to be dispatched. In the latter case
+     * next_due links it to the next one to dispatch. */
+    unsigned heap_index;
+    pa_time_event *next_due;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -104,8 +124,31 @@ struct pa_mainloop {
     struct pollfd *pollfds;
     unsigned max_pollfds, n_pollfds;
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* If this is not -1 the io events are registered with epoll, and
+     * pollfds only contains the epoll fd */
+    int epoll_fd;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events;
+    bool epoll_polled:1;
+
+    /* epoll keeps a registration as long as the file description is
+     * open, even if the fd was closed before the io event was freed,
+     * e.g. when it was dup()ed or inherited by a child. So epoll does
+     * not get pointers to io events, but keys that are looked up here,
+     * and registrations that could not be removed are dropped by
+     * starting over with a new epoll fd (epoll_reset). Key 0 is the
+     * wakeup pipe. */
+    pa_hashmap *epoll_io_events;
+    uint32_t epoll_next_key;
+    bool epoll_reset:1;
+#endif
+
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
+
+    /* The enabled time events, ordered as a binary min-heap by time */
+    pa_time_event **time_heap;
+    unsigned n_time_heap, max_time_heap;
 
     pa_mainloop_api api;
 
@@ -144,6 +187,155 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static uint32_t map_flags_to_epoll(pa_io_event_flags_t flags) {
+    return
+        (flags & PA_IO_EVENT_INPUT ? EPOLLIN : 0) |
+        (flags & PA_IO_EVENT_OUTPUT ? EPOLLOUT : 0) |
+        (flags & PA_IO_EVENT_ERROR ? EPOLLERR : 0) |
+        (flags & PA_IO_EVENT_HANGUP ? EPOLLHUP : 0);
+}
+
+static pa_io_event_flags_t map_flags_from_epoll(uint32_t flags) {
+    return
+        (flags & EPOLLIN ? PA_IO_EVENT_INPUT : 0) |
+        (flags & EPOLLOUT ? PA_IO_EVENT_OUTPUT : 0) |
+        (flags & EPOLLERR ? PA_IO_EVENT_ERROR : 0) |
+        (flags & EPOLLHUP ? PA_IO_EVENT_HANGUP : 0);
+}
+
+static void epoll_unregister(pa_io_event *e) {
+    pa_mainloop *m = e->mainloop;
+
+    if (e->epoll_fd < 0)
+        return;
+
+    /* If the fd has been closed already, the registration may still be
+     * there, if the file description is open elsewhere */
+    if (m->epoll_fd >= 0 && epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, e->epoll_fd, NULL) < 0)
+        m->epoll_reset = true;
+
+    if (e->epoll_fd != e->fd)
+        pa_close(e->epoll_fd);
+
+    pa_assert_se(pa_hashmap_remove(m->epoll_io_events, PA_UINT32_TO_PTR(e->epoll_key)) == e);
+    e->epoll_fd = -1;
+}
+
+/* Goes back to poll() for good, for fds that epoll does not support,
+ * like regular files */
+static void epoll_disable(pa_mainloop *m) {
+    pa_io_event *e;
+
+    pa_log_debug("Falling back to poll() in the main loop.");
+
+    PA_LLIST_FOREACH(e, m->io_events)
+        if (!e->dead)
+            epoll_unregister(e);
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+    m->epoll_reset = false;
+
+    /* The epoll events array might be in use by dispatch_pollfds() right
+     * now, it is freed with the main loop */
+    m->rebuild_pollfds = true;
+}
+
+static void epoll_register(pa_io_event *e) {
+    pa_mainloop *m = e->mainloop;
+    struct epoll_event ev;
+    pa_io_event *i;
+    int fd = e->fd;
+
+    pa_assert(m->epoll_fd >= 0);
+
+    /* epoll refuses the same fd twice, so the second io event for an fd
+     * registers a dup() of it */
+    PA_LLIST_FOREACH(i, m->io_events)
+        if (i != e && !i->dead && i->fd == e->fd) {
+            fd = -1;
+            break;
+        }
+
+    /* Unique among the registered io events, even after wrapping
+     * around */
+    do
+        e->epoll_key = ++m->epoll_next_key;
+    while (e->epoll_key == 0 || pa_hashmap_get(m->epoll_io_events, PA_UINT32_TO_PTR(e->epoll_key)));
+
+    pa_zero(ev);
+    ev.events = map_flags_to_epoll(e->events);
+    ev.data.u32 = e->epoll_key;
+
+    if (fd < 0 || epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+
+        if (fd >= 0 && errno != EEXIST)
+            goto fail;
+
+        if ((fd = fcntl(e->fd, F_DUPFD_CLOEXEC, 0)) < 0)
+            goto fail;
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            pa_close(fd);
+            goto fail;
+        }
+    }
+
+    e->epoll_fd = fd;
+    pa_assert_se(pa_hashmap_put(m->epoll_io_events, PA_UINT32_TO_PTR(e->epoll_key), e) == 0);
+    return;
+
+fail:
+    epoll_disable(m);
+}
+
+/* Registers all io events with a new epoll fd, which drops whatever
+ * epoll_unregister() could not remove from the old one */
+static void epoll_reset(pa_mainloop *m) {
+    struct epoll_event ev;
+    pa_io_event *e;
+    int fd;
+
+    pa_assert(m->epoll_fd >= 0);
+
+    m->epoll_reset = false;
+
+    if ((fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        goto fail;
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+
+    if (epoll_ctl(fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_close(fd);
+        goto fail;
+    }
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = fd;
+    m->rebuild_pollfds = true;
+
+    PA_LLIST_FOREACH(e, m->io_events) {
+        if (e->dead || e->epoll_fd < 0)
+            continue;
+
+        pa_zero(ev);
+        ev.events = map_flags_to_epoll(e->events);
+        ev.data.u32 = e->epoll_key;
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, e->epoll_fd, &ev) < 0)
+            goto fail;
+    }
+
+    return;
+
+fail:
+    epoll_disable(m);
+}
+#endif
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -176,6 +368,13 @@ static pa_io_event* mainloop_io_new(
     m->rebuild_pollfds = true;
     m->n_io_events ++;
 
+#ifdef HAVE_SYS_EPOLL_H
+    e->epoll_fd = -1;
+
+    if (m->epoll_fd >= 0)
+        epoll_register(e);
+#endif
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -190,6 +389,18 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
 
     e->events = events;
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (e->epoll_fd >= 0) {
+        struct epoll_event ev;
+
+        pa_zero(ev);
+        ev.events = map_flags_to_epoll(events);
+        ev.data.u32 = e->epoll_key;
+
+        epoll_ctl(e->mainloop->epoll_fd, EPOLL_CTL_MOD, e->epoll_fd, &ev);
+    } else
+#endif
+
     if (e->pollfd)
         e->pollfd->events = map_flags_to_libc(events);
     else
@@ -208,6 +419,11 @@ static void mainloop_io_free(pa_io_event *e) {
     e->mainloop->n_io_events --;
     e->mainloop->rebuild_pollfds = true;
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* Right away, the fd is usually closed right after this */
+    epoll_unregister(e);
+#endif
+
     pa_mainloop_wakeup(e->mainloop);
 }
 
@@ -286,6 +502,87 @@ static void mainloop_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy
 }
 
 /* Time events */
+#define TIME_HEAP_NONE ((unsigned) -1)
+
+static void time_heap_set(pa_mainloop *m, unsigned idx, pa_time_event *e) {
+    m->time_heap[idx] = e;
+    e->heap_index = idx;
+}
+
+static void time_heap_sift_up(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+
+    while (idx > 0) {
+        unsigned parent = (idx - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[parent]);
+        idx = parent;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+static void time_heap_sift_down(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+
+    for (;;) {
+        unsigned child = idx * 2 + 1;
+
+        if (child >= m->n_time_heap)
+            break;
+
+        if (child + 1 < m->n_time_heap && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[child]);
+        idx = child;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+static void time_heap_insert(pa_mainloop *m, pa_time_event *e) {
+    pa_assert(e->heap_index == TIME_HEAP_NONE);
+
+    if (m->n_time_heap >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(m->max_time_heap * 2, 16U);
+        m->time_heap = pa_xrealloc(m->time_heap, sizeof(pa_time_event*) * m->max_time_heap);
+    }
+
+    time_heap_set(m, m->n_time_heap++, e);
+    time_heap_sift_up(m, e->heap_index);
+}
+
+static void time_heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned idx = e->heap_index;
+
+    if (idx == TIME_HEAP_NONE)
+        return;
+
+    pa_assert(idx < m->n_time_heap);
+    pa_assert(m->time_heap[idx] == e);
+
+    e->heap_index = TIME_HEAP_NONE;
+
+    if (idx == --m->n_time_heap)
+        return;
+
+    /* Fill the hole with the last one, and move that to where it
+     * belongs */
+    time_heap_set(m, idx, m->time_heap[m->n_time_heap]);
+
+    if (idx > 0 && m->time_heap[(idx - 1) / 2]->time > m->time_heap[idx]->time)
+        time_heap_sift_up(m, idx);
+    else
+        time_heap_sift_down(m, idx);
+}
+
 static pa_usec_t make_rt(const struct timeval *tv, bool *use_rtclock) {
     struct timeval ttv;
 
@@ -327,19 +624,14 @@ static pa_time_event* mainloop_time_new(
 
     e = pa_xnew0(pa_time_event, 1);
     e->mainloop = m;
+    e->heap_index = TIME_HEAP_NONE;
 
     if ((e->enabled = (t != PA_USEC_INVALID))) {
         e->time = t;
         e->use_rtclock = use_rtclock;
 
         m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        time_heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -370,21 +662,14 @@ static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
     } else if (!e->enabled && valid)
         e->mainloop->n_enabled_time_events++;
 
+    time_heap_remove(e->mainloop, e);
+
     if ((e->enabled = valid)) {
         e->time = t;
         e->use_rtclock = use_rtclock;
+        time_heap_insert(e->mainloop, e);
         pa_mainloop_wakeup(e->mainloop);
     }
-
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
-
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
-
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
-    }
 }
 
 static void mainloop_time_free(pa_time_event *e) {
@@ -400,8 +685,7 @@ static void mainloop_time_free(pa_time_event *e) {
         e->enabled = false;
     }
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    time_heap_remove(e->mainloop, e);
 
     /* no wakeup needed here. Think about it! */
 }
@@ -447,6 +731,38 @@ static const pa_mainloop_api vtable = {
     .quit = mainloop_quit,
 };
 
+#ifdef HAVE_SYS_EPOLL_H
+static void epoll_init(pa_mainloop *m) {
+    struct epoll_event ev;
+    const char *e;
+
+    m->epoll_fd = -1;
+    m->epoll_io_events = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    if ((e = getenv("PULSE_MAINLOOP_BACKEND")) && !pa_streq(e, "epoll")) {
+        if (!pa_streq(e, "poll"))
+            pa_log_warn("Unknown main loop backend '%s', using poll().", e);
+
+        return;
+    }
+
+    if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed, using poll(): %s", pa_cstrerror(errno));
+        return;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_log_debug("Failed to add the wakeup pipe to epoll, using poll(): %s", pa_cstrerror(errno));
+        pa_close(m->epoll_fd);
+        m->epoll_fd = -1;
+    }
+}
+#endif
+
 pa_mainloop *pa_mainloop_new(void) {
     pa_mainloop *m;
 
@@ -463,6 +779,10 @@ pa_mainloop *pa_mainloop_new(void) {
     pa_make_fd_nonblock(m->wakeup_pipe[0]);
     pa_make_fd_nonblock(m->wakeup_pipe[1]);
 
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_init(m);
+#endif
+
     m->rebuild_pollfds = true;
 
     m->api = vtable;
@@ -491,6 +811,10 @@ static void cleanup_io_events(pa_mainloop *m, bool force) {
                 m->io_events_please_scan--;
             }
 
+#ifdef HAVE_SYS_EPOLL_H
+            epoll_unregister(e);
+#endif
+
             if (e->destroy_callback)
                 e->destroy_callback(&m->api, e, e->userdata);
 
@@ -525,6 +849,8 @@ static void cleanup_time_events(pa_mainloop *m, bool force) {
                 e->enabled = false;
             }
 
+            time_heap_remove(m, e);
+
             if (e->destroy_callback)
                 e->destroy_callback(&m->api, e, e->userdata);
 
@@ -575,6 +901,14 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_time_events(m, true);
 
     pa_xfree(m->pollfds);
+    pa_xfree(m->time_heap);
+
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_fd >= 0)
+        pa_close(m->epoll_fd);
+    pa_xfree(m->epoll_events);
+    pa_hashmap_free(m->epoll_io_events);
+#endif
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -599,6 +933,32 @@ static void rebuild_pollfds(pa_mainloop *m) {
     struct pollfd *p;
     unsigned l;
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_fd >= 0) {
+        l = m->n_io_events + 1;
+        if (m->max_epoll_events < l) {
+            l *= 2;
+            m->epoll_events = pa_xrealloc(m->epoll_events, sizeof(struct epoll_event)*l);
+            m->max_epoll_events = l;
+        }
+
+        if (m->max_pollfds < 1) {
+            m->pollfds = pa_xnew(struct pollfd, 1);
+            m->max_pollfds = 1;
+        }
+
+        /* We only poll() on the epoll fd itself, that way a poll_func
+         * still works */
+        m->pollfds[0].fd = m->epoll_fd;
+        m->pollfds[0].events = POLLIN;
+        m->pollfds[0].revents = 0;
+        m->n_pollfds = 1;
+
+        m->rebuild_pollfds = false;
+        return;
+    }
+#endif
+
     l = m->n_io_events + 1;
     if (m->max_pollfds < l) {
         l *= 2;
@@ -633,12 +993,43 @@ static void rebuild_pollfds(pa_mainloop *m) {
     m->rebuild_pollfds = false;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static unsigned dispatch_epoll_events(pa_mainloop *m) {
+    unsigned r = 0, k;
+
+    for (k = 0; k < (unsigned) m->poll_func_ret; k++) {
+        uint32_t key = m->epoll_events[k].data.u32;
+        pa_io_event *e;
+
+        if (m->quit)
+            break;
+
+        /* The wakeup pipe, freed during this dispatch, or left behind
+         * by an fd closed before its io event was freed */
+        if (key == 0 || !(e = pa_hashmap_get(m->epoll_io_events, PA_UINT32_TO_PTR(key))) || e->dead)
+            continue;
+
+        pa_assert(e->callback);
+
+        e->callback(&m->api, e, e->fd, map_flags_from_epoll(m->epoll_events[k].events), e->userdata);
+        r++;
+    }
+
+    return r;
+}
+#endif
+
 static unsigned dispatch_pollfds(pa_mainloop *m) {
     pa_io_event *e;
     unsigned r = 0, k;
 
     pa_assert(m->poll_func_ret > 0);
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_polled)
+        return dispatch_epoll_events(m);
+#endif
+
     k = m->poll_func_ret;
 
     PA_LLIST_FOREACH(e, m->io_events) {
@@ -684,31 +1075,6 @@ static unsigned dispatch_defer(pa_mainloop *m) {
     return r;
 }
 
-static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
-    pa_assert(m);
-
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
-
-    PA_LLIST_FOREACH(t, m->time_events) {
-
-        if (t->dead || !t->enabled)
-            continue;
-
-        if (!n || t->time < n->time) {
-            n = t;
-
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
-    }
-
-    m->cached_next_time_event = n;
-    return n;
-}
-
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     pa_time_event *t;
     pa_usec_t clock_now;
@@ -716,7 +1082,8 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     if (m->n_enabled_time_events <= 0)
         return PA_USEC_INVALID;
 
-    pa_assert_se(t = find_next_time_event(m));
+    pa_assert(m->n_time_heap > 0);
+    t = m->time_heap[0];
 
     if (t->time <= 0)
         return 0;
@@ -730,7 +1097,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
 }
 
 static unsigned dispatch_timeout(pa_mainloop *m) {
-    pa_time_event *e;
+    pa_time_event *e, *due = NULL, **tail = &due;
     pa_usec_t now;
     unsigned r = 0;
     pa_assert(m);
@@ -740,25 +1107,43 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
 
     now = pa_rtclock_now();
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    /* Take everything that is due off the heap first, in order. That
+     * way an event that is restarted for the past from a callback only
+     * fires again in the next iteration. */
+    while (m->n_time_heap > 0 && m->time_heap[0]->time <= now) {
+        e = m->time_heap[0];
+        time_heap_remove(m, e);
 
-        if (m->quit)
-            break;
+        e->next_due = NULL;
+        *tail = e;
+        tail = &e->next_due;
+    }
+
+    while ((e = due)) {
+        struct timeval tv;
+
+        due = e->next_due;
+
+        if (m->quit) {
+            /* Whatever is left stays due */
+            if (e->enabled && e->heap_index == TIME_HEAP_NONE)
+                time_heap_insert(m, e);
 
-        if (e->dead || !e->enabled)
             continue;
+        }
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        /* An earlier callback might have freed, disabled or moved it */
+        if (e->dead || !e->enabled || e->time > now)
+            continue;
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+        pa_assert(e->callback);
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        /* Disable time event */
+        mainloop_time_restart(e, NULL);
 
-            r++;
-        }
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+
+        r++;
     }
 
     return r;
@@ -789,6 +1174,11 @@ int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
     clear_wakeup(m);
     scan_dead(m);
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_reset)
+        epoll_reset(m);
+#endif
+
     if (m->quit)
         goto quit;
 
@@ -860,6 +1250,12 @@ int pa_mainloop_poll(pa_mainloop *m) {
 #endif
         }
 
+#ifdef HAVE_SYS_EPOLL_H
+        /* Now see what made the epoll fd readable */
+        if ((m->epoll_polled = m->epoll_fd >= 0) && m->poll_func_ret > 0)
+            m->poll_func_ret = epoll_wait(m->epoll_fd, m->epoll_events, (int) m->max_epoll_events, 0);
+#endif
+
         if (m->poll_func_ret < 0) {
             if (errno == EINTR)
                 m->poll_func_ret = 0;
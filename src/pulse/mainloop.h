@@ -36,6 +36,15 @@ struct pollfd;
  * It supports the functions defined in the main loop abstraction and very
  * little else.
  *
+ * Where available, the file descriptors are kept registered with epoll
+ * and poll() is only called on the epoll file descriptor, so the cost of
+ * an iteration does not grow with the number of file descriptors. A
+ * function set with pa_mainloop_set_poll_func() then gets passed that
+ * single file descriptor. Set the environment variable
+ * $PULSE_MAINLOOP_BACKEND to "poll" to have all file descriptors passed
+ * to poll() directly instead. The main loop also falls back to that for
+ * file descriptors that epoll cannot handle.
+ *
  * The main loop is created using pa_mainloop_new() and destroyed using
  * pa_mainloop_free(). To get access to the main loop abstraction,
  * pa_mainloop_get_api() is used.
@@ -27,20 +27,127 @@
 #include <pulse/xmalloc.h>
 #include <pulse/utf8.h>
 
-#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/refcnt.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
 #include "proplist.h"
 
+/* A key and its value in a single allocation. Properties are never
+ * modified once they are set up, so proplists share them: copying and
+ * updating a proplist only takes references, and setting a key puts a
+ * new property in place of the old one. Pointers returned by
+ * pa_proplist_gets() hence stay valid until that key is set or unset
+ * in that very proplist, just like before. */
 struct property {
-    char *key;
-    void *value;
+    PA_REFCNT_DECLARE;
+    bool is_string;
+    const char *key;
     size_t nbytes;
 };
 
-#define MAKE_HASHMAP(p) ((pa_hashmap*) (p))
-#define MAKE_PROPLIST(p) ((pa_proplist*) (p))
+/* The value follows the struct and is always NUL terminated. The key
+ * comes after it, unless it is one of the well known keys. */
+#define PROPERTY_VALUE(prop) ((uint8_t*) (prop) + PA_ALIGN(sizeof(struct property)))
+
+/* Proplists hold a few dozen properties at most, so they are a plain
+ * array in insertion order, and lookups compare the key hashes kept in
+ * the array before looking at any key. Unsetting a key leaves a hole,
+ * so that it is fine to unset the current key while iterating. Holes
+ * are squeezed out when the array is full. */
+struct slot {
+    unsigned hash;
+    struct property *prop;
+};
+
+struct pa_proplist {
+    struct slot *slots;
+    unsigned n_slots, n_allocated, n_props;
+};
+
+#define MIN_SLOTS 8
+
+/* Sorted, for bsearch(). Properties with one of these keys point here
+ * instead of carrying a copy of the key. */
+static const char * const well_known_keys[] = {
+    PA_PROP_APPLICATION_ICON,
+    PA_PROP_APPLICATION_ICON_NAME,
+    PA_PROP_APPLICATION_ID,
+    PA_PROP_APPLICATION_LANGUAGE,
+    PA_PROP_APPLICATION_NAME,
+    PA_PROP_APPLICATION_PROCESS_BINARY,
+    PA_PROP_APPLICATION_PROCESS_HOST,
+    PA_PROP_APPLICATION_PROCESS_ID,
+    PA_PROP_APPLICATION_PROCESS_MACHINE_ID,
+    PA_PROP_APPLICATION_PROCESS_SESSION_ID,
+    PA_PROP_APPLICATION_PROCESS_USER,
+    PA_PROP_APPLICATION_VERSION,
+    PA_PROP_DEVICE_ACCESS_MODE,
+    PA_PROP_DEVICE_API,
+    PA_PROP_DEVICE_BUFFERING_BUFFER_SIZE,
+    PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE,
+    PA_PROP_DEVICE_BUS,
+    PA_PROP_DEVICE_BUS_PATH,
+    PA_PROP_DEVICE_CLASS,
+    PA_PROP_DEVICE_DESCRIPTION,
+    PA_PROP_DEVICE_FORM_FACTOR,
+    PA_PROP_DEVICE_ICON,
+    PA_PROP_DEVICE_ICON_NAME,
+    PA_PROP_DEVICE_INTENDED_ROLES,
+    PA_PROP_DEVICE_MASTER_DEVICE,
+    PA_PROP_DEVICE_PRODUCT_ID,
+    PA_PROP_DEVICE_PRODUCT_NAME,
+    PA_PROP_DEVICE_PROFILE_DESCRIPTION,
+    PA_PROP_DEVICE_PROFILE_NAME,
+    PA_PROP_DEVICE_SERIAL,
+    PA_PROP_DEVICE_STRING,
+    PA_PROP_DEVICE_VENDOR_ID,
+    PA_PROP_DEVICE_VENDOR_NAME,
+    PA_PROP_EVENT_DESCRIPTION,
+    PA_PROP_EVENT_ID,
+    PA_PROP_EVENT_MOUSE_BUTTON,
+    PA_PROP_EVENT_MOUSE_HPOS,
+    PA_PROP_EVENT_MOUSE_VPOS,
+    PA_PROP_EVENT_MOUSE_X,
+    PA_PROP_EVENT_MOUSE_Y,
+    PA_PROP_FILTER_APPLY,
+    PA_PROP_FILTER_SUPPRESS,
+    PA_PROP_FILTER_WANT,
+    PA_PROP_FORMAT_CHANNEL_MAP,
+    PA_PROP_FORMAT_CHANNELS,
+    PA_PROP_FORMAT_RATE,
+    PA_PROP_FORMAT_SAMPLE_FORMAT,
+    PA_PROP_MEDIA_ARTIST,
+    PA_PROP_MEDIA_COPYRIGHT,
+    PA_PROP_MEDIA_FILENAME,
+    PA_PROP_MEDIA_ICON,
+    PA_PROP_MEDIA_ICON_NAME,
+    PA_PROP_MEDIA_LANGUAGE,
+    PA_PROP_MEDIA_NAME,
+    PA_PROP_MEDIA_ROLE,
+    PA_PROP_MEDIA_SOFTWARE,
+    PA_PROP_MEDIA_TITLE,
+    PA_PROP_MODULE_AUTHOR,
+    PA_PROP_MODULE_DESCRIPTION,
+    PA_PROP_MODULE_USAGE,
+    PA_PROP_MODULE_VERSION,
+    PA_PROP_WINDOW_DESKTOP,
+    PA_PROP_WINDOW_HEIGHT,
+    PA_PROP_WINDOW_HPOS,
+    PA_PROP_WINDOW_ICON,
+    PA_PROP_WINDOW_ICON_NAME,
+    PA_PROP_WINDOW_ID,
+    PA_PROP_WINDOW_NAME,
+    PA_PROP_WINDOW_VPOS,
+    PA_PROP_WINDOW_WIDTH,
+    PA_PROP_WINDOW_X,
+    PA_PROP_WINDOW_X11_DISPLAY,
+    PA_PROP_WINDOW_X11_MONITOR,
+    PA_PROP_WINDOW_X11_SCREEN,
+    PA_PROP_WINDOW_X11_XID,
+    PA_PROP_WINDOW_Y
+};
 
 int pa_proplist_key_valid(const char *key) {
 
@@ -53,29 +160,141 @@ int pa_proplist_key_valid(const char *key) {
     return 1;
 }
 
-static void property_free(struct property *prop) {
+static int key_compare(const void *key, const void *member) {
+    return strcmp(key, *(const char * const *) member);
+}
+
+static struct property *property_new(const char *key, const void *data, size_t nbytes, bool is_string) {
+    struct property *prop;
+    const char * const *interned;
+    size_t l = 0;
+
+    if (!(interned = bsearch(key, well_known_keys, PA_ELEMENTSOF(well_known_keys), sizeof(well_known_keys[0]), key_compare)))
+        l = strlen(key) + 1;
+
+    prop = pa_xmalloc(PA_ALIGN(sizeof(struct property)) + nbytes + 1 + l);
+    PA_REFCNT_INIT(prop);
+    prop->is_string = is_string;
+    prop->nbytes = nbytes;
+
+    if (nbytes > 0)
+        memcpy(PROPERTY_VALUE(prop), data, nbytes);
+    PROPERTY_VALUE(prop)[nbytes] = 0;
+
+    if (interned)
+        prop->key = *interned;
+    else
+        prop->key = memcpy(PROPERTY_VALUE(prop) + nbytes + 1, key, l);
+
+    return prop;
+}
+
+static void property_unref(struct property *prop) {
     pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    if (PA_REFCNT_DEC(prop) > 0)
+        return;
 
-    pa_xfree(prop->key);
-    pa_xfree(prop->value);
     pa_xfree(prop);
 }
 
+static bool value_is_string(const void *data, size_t nbytes) {
+    const char *v = data;
+
+    if (nbytes <= 0)
+        return false;
+
+    if (v[nbytes-1] != 0)
+        return false;
+
+    if (strlen(v) != nbytes-1)
+        return false;
+
+    return pa_utf8_valid(v);
+}
+
+static struct slot *find_slot(pa_proplist *p, const char *key, unsigned hash) {
+    unsigned i;
+
+    for (i = 0; i < p->n_slots; i++) {
+        struct slot *s = p->slots + i;
+
+        if (s->prop && s->hash == hash && pa_streq(s->prop->key, key))
+            return s;
+    }
+
+    return NULL;
+}
+
+static struct property *get_property(pa_proplist *p, const char *key) {
+    struct slot *s;
+
+    if (!(s = find_slot(p, key, pa_idxset_string_hash_func(key))))
+        return NULL;
+
+    return s->prop;
+}
+
+static void reserve_slots(pa_proplist *p, unsigned n) {
+    if (p->n_allocated >= n)
+        return;
+
+    p->slots = pa_xrenew(struct slot, p->slots, n);
+    p->n_allocated = n;
+}
+
+/* Takes over the reference to prop */
+static void append_property(pa_proplist *p, unsigned hash, struct property *prop) {
+
+    if (p->n_slots >= p->n_allocated) {
+        if (p->n_props < p->n_slots) {
+            unsigned i, j;
+
+            for (i = j = 0; i < p->n_slots; i++)
+                if (p->slots[i].prop)
+                    p->slots[j++] = p->slots[i];
+
+            p->n_slots = j;
+        } else
+            reserve_slots(p, PA_MAX(MIN_SLOTS, p->n_allocated * 2));
+    }
+
+    p->slots[p->n_slots].hash = hash;
+    p->slots[p->n_slots].prop = prop;
+    p->n_slots++;
+    p->n_props++;
+}
+
+/* Takes over the reference to prop */
+static void put_property(pa_proplist *p, unsigned hash, struct property *prop) {
+    struct slot *s;
+
+    if ((s = find_slot(p, prop->key, hash))) {
+        property_unref(s->prop);
+        s->prop = prop;
+    } else
+        append_property(p, hash, prop);
+}
+
+static void set_property(pa_proplist *p, const char *key, const void *data, size_t nbytes, bool is_string) {
+    put_property(p, pa_idxset_string_hash_func(key), property_new(key, data, nbytes, is_string));
+}
+
 pa_proplist* pa_proplist_new(void) {
-    return MAKE_PROPLIST(pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, NULL, (pa_free_cb_t) property_free));
+    return pa_xnew0(pa_proplist, 1);
 }
 
 void pa_proplist_free(pa_proplist* p) {
     pa_assert(p);
 
-    pa_hashmap_free(MAKE_HASHMAP(p));
+    pa_proplist_clear(p);
+    pa_xfree(p->slots);
+    pa_xfree(p);
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
-    struct property *prop;
-    bool add = false;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(value);
@@ -83,26 +302,13 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     if (!pa_proplist_key_valid(key) || !pa_utf8_valid(value))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xstrdup(value);
-    prop->nbytes = strlen(value)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    set_property(p, key, value, strlen(value)+1, true);
 
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    bool add = false;
     char *k, *v;
 
     pa_assert(p);
@@ -118,20 +324,10 @@ static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, con
         return -1;
     }
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = true;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
+    set_property(p, k, v, strlen(v)+1, true);
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(v);
 
     return 0;
 }
@@ -152,8 +348,6 @@ int pa_proplist_setp(pa_proplist *p, const char *pair) {
 }
 
 static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    bool add = false;
     char *k, *v;
     uint8_t *d;
     size_t dn;
@@ -181,29 +375,16 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
 
     pa_xfree(v);
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = true;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    d[dn] = 0;
-    prop->value = d;
-    prop->nbytes = dn;
+    set_property(p, k, d, dn, value_is_string(d, dn));
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(d);
 
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
-    struct property *prop;
-    bool add = false;
     va_list ap;
     char *v;
 
@@ -221,18 +402,8 @@ int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     if (!pa_utf8_valid(v))
         goto fail;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    set_property(p, key, v, strlen(v)+1, true);
+    pa_xfree(v);
 
     return 0;
 
@@ -242,9 +413,6 @@ fail:
 }
 
 int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
-    struct property *prop;
-    bool add = false;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(data || nbytes == 0);
@@ -252,21 +420,7 @@ int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nb
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xmalloc(nbytes+1);
-    if (nbytes > 0)
-        memcpy(prop->value, data, nbytes);
-    ((char*) prop->value)[nbytes] = 0;
-    prop->nbytes = nbytes;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    set_property(p, key, data, nbytes, value_is_string(data, nbytes));
 
     return 0;
 }
@@ -280,22 +434,13 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     if (!pa_proplist_key_valid(key))
         return NULL;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
-        return NULL;
-
-    if (prop->nbytes <= 0)
-        return NULL;
-
-    if (((char*) prop->value)[prop->nbytes-1] != 0)
+    if (!(prop = get_property(p, key)))
         return NULL;
 
-    if (strlen((char*) prop->value) != prop->nbytes-1)
+    if (!prop->is_string)
         return NULL;
 
-    if (!pa_utf8_valid((char*) prop->value))
-        return NULL;
-
-    return (char*) prop->value;
+    return (char*) PROPERTY_VALUE(prop);
 }
 
 int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *nbytes) {
@@ -309,18 +454,18 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = get_property(p, key)))
         return -1;
 
-    *data = prop->value;
+    *data = PROPERTY_VALUE(prop);
     *nbytes = prop->nbytes;
 
     return 0;
 }
 
 void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, const pa_proplist *other) {
-    struct property *prop;
-    void *state = NULL;
+    bool was_empty;
+    unsigned i;
 
     pa_assert(p);
     pa_assert(mode == PA_UPDATE_SET || mode == PA_UPDATE_MERGE || mode == PA_UPDATE_REPLACE);
@@ -329,27 +474,49 @@ void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, const pa_proplist
     if (mode == PA_UPDATE_SET)
         pa_proplist_clear(p);
 
-    /* MAKE_HASHMAP turns the const pointer into a non-const pointer, but
-     * that's ok, because we don't modify the hashmap contents. */
-    while ((prop = pa_hashmap_iterate(MAKE_HASHMAP(other), &state, NULL))) {
+    /* Keys are unique in other, so there is nothing to look up if p
+     * starts out empty */
+    if ((was_empty = pa_proplist_isempty(p)))
+        reserve_slots(p, other->n_props);
 
-        if (mode == PA_UPDATE_MERGE && pa_proplist_contains(p, prop->key))
+    for (i = 0; i < other->n_slots; i++) {
+        const struct slot *s = other->slots + i;
+
+        if (!s->prop)
+            continue;
+
+        if (mode == PA_UPDATE_MERGE && !was_empty && find_slot(p, s->prop->key, s->hash))
             continue;
 
-        pa_assert_se(pa_proplist_set(p, prop->key, prop->value, prop->nbytes) == 0);
+        PA_REFCNT_INC(s->prop);
+
+        if (was_empty)
+            append_property(p, s->hash, s->prop);
+        else
+            put_property(p, s->hash, s->prop);
     }
 }
 
 int pa_proplist_unset(pa_proplist *p, const char *key) {
+    struct slot *s;
+
     pa_assert(p);
     pa_assert(key);
 
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (pa_hashmap_remove_and_free(MAKE_HASHMAP(p), key) < 0)
+    if (!(s = find_slot(p, key, pa_idxset_string_hash_func(key))))
         return -2;
 
+    property_unref(s->prop);
+    s->prop = NULL;
+    p->n_props--;
+
+    /* Holes at the end can go right away */
+    while (p->n_slots > 0 && !p->slots[p->n_slots-1].prop)
+        p->n_slots--;
+
     return 0;
 }
 
@@ -372,12 +539,21 @@ int pa_proplist_unset_many(pa_proplist *p, const char * const keys[]) {
 }
 
 const char *pa_proplist_iterate(pa_proplist *p, void **state) {
-    struct property *prop;
+    unsigned i;
 
-    if (!(prop = pa_hashmap_iterate(MAKE_HASHMAP(p), state, NULL)))
-        return NULL;
+    pa_assert(p);
+    pa_assert(state);
+
+    /* The state is the position to continue at */
+    if (*state != (void*) -1)
+        for (i = PA_PTR_TO_UINT(*state); i < p->n_slots; i++)
+            if (p->slots[i].prop) {
+                *state = PA_UINT_TO_PTR(i + 1);
+                return p->slots[i].prop->key;
+            }
 
-    return prop->key;
+    *state = (void*) -1;
+    return NULL;
 }
 
 char *pa_proplist_to_string_sep(pa_proplist *p, const char *sep) {
@@ -626,7 +802,7 @@ pa_proplist *pa_proplist_from_string(const char *s) {
     }
 
 success:
-    return MAKE_PROPLIST(pl);
+    return pl;
 
 fail:
     pa_proplist_free(pl);
@@ -640,16 +816,22 @@ int pa_proplist_contains(pa_proplist *p, const char *key) {
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!get_property(p, key))
         return 0;
 
     return 1;
 }
 
 void pa_proplist_clear(pa_proplist *p) {
+    unsigned i;
+
     pa_assert(p);
 
-    pa_hashmap_remove_all(MAKE_HASHMAP(p));
+    for (i = 0; i < p->n_slots; i++)
+        if (p->slots[i].prop)
+            property_unref(p->slots[i].prop);
+
+    p->n_slots = p->n_props = 0;
 }
 
 pa_proplist* pa_proplist_copy(const pa_proplist *p) {
@@ -666,20 +848,17 @@ pa_proplist* pa_proplist_copy(const pa_proplist *p) {
 unsigned pa_proplist_size(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_size(MAKE_HASHMAP(p));
+    return p->n_props;
 }
 
 int pa_proplist_isempty(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_isempty(MAKE_HASHMAP(p));
+    return p->n_props == 0;
 }
 
 int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
-    const void *key = NULL;
-    struct property *a_prop = NULL;
-    struct property *b_prop = NULL;
-    void *state = NULL;
+    unsigned i;
 
     pa_assert(a);
     pa_assert(b);
@@ -690,14 +869,24 @@ int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
     if (pa_proplist_size(a) != pa_proplist_size(b))
         return 0;
 
-    while ((a_prop = pa_hashmap_iterate(MAKE_HASHMAP(a), &state, &key))) {
-        if (!(b_prop = pa_hashmap_get(MAKE_HASHMAP(b), key)))
+    for (i = 0; i < a->n_slots; i++) {
+        struct property *a_prop = a->slots[i].prop;
+        struct slot *b_slot;
+
+        if (!a_prop)
+            continue;
+
+        if (!(b_slot = find_slot(b, a_prop->key, a->slots[i].hash)))
             return 0;
 
-        if (a_prop->nbytes != b_prop->nbytes)
+        /* Shared properties are equal by definition */
+        if (b_slot->prop == a_prop)
+            continue;
+
+        if (a_prop->nbytes != b_slot->prop->nbytes)
             return 0;
 
-        if (memcmp(a_prop->value, b_prop->value, a_prop->nbytes) != 0)
+        if (memcmp(PROPERTY_VALUE(a_prop), PROPERTY_VALUE(b_slot->prop), a_prop->nbytes) != 0)
             return 0;
     }
 
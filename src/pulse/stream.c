@@ -171,6 +171,9 @@ static pa_stream *pa_stream_new_with_proplist_internal(
 
     s->write_memblock = NULL;
     s->write_data = NULL;
+    s->write_ring = NULL;
+    s->write_ring_data = NULL;
+    s->write_ring_length = 0;
 
     pa_memchunk_reset(&s->peek_memchunk);
     s->peek_data = NULL;
@@ -289,6 +292,9 @@ static void stream_free(pa_stream *s) {
         pa_memblock_unref(s->write_memblock);
     }
 
+    if (s->write_ring)
+        pa_write_ring_free(s->write_ring);
+
     if (s->peek_memchunk.memblock) {
         if (s->peek_data)
             pa_memblock_release(s->peek_memchunk.memblock);
@@ -1418,6 +1424,8 @@ int pa_stream_begin_write(
         void **data,
         size_t *nbytes) {
 
+    size_t m, fs;
+
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
 
@@ -1427,15 +1435,30 @@ int pa_stream_begin_write(
     PA_CHECK_VALIDITY(s->context, data, PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, nbytes && *nbytes != 0, PA_ERR_INVALID);
 
-    if (*nbytes != (size_t) -1) {
-        size_t m, fs;
+    m = pa_mempool_block_size_max(s->context->mempool);
+    fs = pa_frame_size(&s->sample_spec);
+
+    m = (m / fs) * fs;
+    if (*nbytes != (size_t) -1 && *nbytes > m)
+        *nbytes = m;
 
-        m = pa_mempool_block_size_max(s->context->mempool);
-        fs = pa_frame_size(&s->sample_spec);
+    if (!s->write_memblock && !s->write_ring_data && s->write_ring) {
+        size_t n = *nbytes;
 
-        m = (m / fs) * fs;
-        if (*nbytes > m)
-            *nbytes = m;
+        /* Write straight into the server's ring if it has room. When we
+         * get to choose, ask for no more than a quarter of it, so that
+         * a single write does not hold it up. */
+        if (n == (size_t) -1)
+            n = PA_MAX(((pa_write_ring_get_capacity(s->write_ring) / 4) / fs) * fs, fs);
+
+        if ((s->write_ring_data = pa_write_ring_begin_write(s->write_ring, &n)))
+            s->write_ring_length = *nbytes == (size_t) -1 ? PA_MIN(n, m) : *nbytes;
+    }
+
+    if (s->write_ring_data) {
+        *data = s->write_ring_data;
+        *nbytes = s->write_ring_length;
+        return 0;
     }
 
     if (!s->write_memblock) {
@@ -1458,7 +1481,13 @@ int pa_stream_cancel_write(
     PA_CHECK_VALIDITY(s->context, !pa_detect_fork(), PA_ERR_FORKED);
     PA_CHECK_VALIDITY(s->context, s->state == PA_STREAM_READY, PA_ERR_BADSTATE);
     PA_CHECK_VALIDITY(s->context, s->direction == PA_STREAM_PLAYBACK || s->direction == PA_STREAM_UPLOAD, PA_ERR_BADSTATE);
-    PA_CHECK_VALIDITY(s->context, s->write_memblock, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, s->write_memblock || s->write_ring_data, PA_ERR_BADSTATE);
+
+    if (s->write_ring_data) {
+        pa_write_ring_end_write(s->write_ring, 0);
+        s->write_ring_data = NULL;
+        return 0;
+    }
 
     pa_assert(s->write_data);
 
@@ -1493,11 +1522,28 @@ int pa_stream_write_ext_free(
                       ((data >= s->write_data) &&
                        ((const char*) data + length <= (const char*) s->write_data + pa_memblock_get_length(s->write_memblock))),
                       PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context,
+                      !s->write_ring_data ||
+                      ((data >= s->write_ring_data) &&
+                       ((const char*) data + length <= (const char*) s->write_ring_data + s->write_ring_length)),
+                      PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, offset % pa_frame_size(&s->sample_spec) == 0, PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, length % pa_frame_size(&s->sample_spec) == 0, PA_ERR_INVALID);
-    PA_CHECK_VALIDITY(s->context, !free_cb || !s->write_memblock, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, !free_cb || (!s->write_memblock && !s->write_ring_data), PA_ERR_INVALID);
 
-    if (s->write_memblock) {
+    if (s->write_ring_data && data == s->write_ring_data) {
+        size_t index;
+
+        /* pa_stream_write_begin() handed out space in the ring, only
+         * tell the server where the data is */
+
+        index = pa_write_ring_end_write(s->write_ring, length);
+        s->write_ring_data = NULL;
+
+        if (length > 0)
+            pa_pstream_send_ring_data(s->context->pstream, s->channel, offset, seek, index, length);
+
+    } else if (s->write_memblock) {
         pa_memchunk chunk;
 
         /* pa_stream_write_begin() was called before */
@@ -1520,7 +1566,14 @@ int pa_stream_write_ext_free(
         size_t t_length = length;
         const void *t_data = data;
 
-        /* pa_stream_write_begin() was not called before */
+        /* pa_stream_write_begin() was not called before, or the data
+         * does not start at the beginning of the space in the ring it
+         * handed out. Copy it then, the ring only takes whole writes. */
+
+        if (s->write_ring_data) {
+            pa_write_ring_end_write(s->write_ring, 0);
+            s->write_ring_data = NULL;
+        }
 
         while (t_length > 0) {
             pa_memchunk chunk;
@@ -56,6 +56,7 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/modinfo.h>
 #include <pulsecore/dynarray.h>
+#include <pulsecore/packet.h>
 
 #include "cli-command.h"
 
@@ -343,6 +344,7 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     char bytes[PA_BYTES_SNPRINT_MAX];
     const pa_mempool_stat *mstat;
+    const pa_packet_stat *pstat;
     unsigned k;
     pa_sink *def_sink;
     pa_source *def_source;
@@ -379,6 +381,18 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Memory pool segments: %u, huge pages: %s, NUMA node: %i.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_segments),
+                     pa_mem_hugepages_to_string((pa_mem_hugepages_t) pa_atomic_load(&mstat->hugepages)),
+                     pa_atomic_load(&mstat->numa_node));
+
+    pstat = pa_packet_get_stat();
+
+    pa_strbuf_printf(buf, "Packets currently allocated: %u, during the whole lifetime: %u, malloc() calls for them: %u.\n",
+                     (unsigned) pa_atomic_load(&pstat->n_allocated),
+                     (unsigned) pa_atomic_load(&pstat->n_accumulated),
+                     (unsigned) pa_atomic_load(&pstat->n_malloced));
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
@@ -402,6 +416,14 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                          (unsigned) pa_atomic_load(&mstat->n_allocated_by_type[k]),
                          (unsigned) pa_atomic_load(&mstat->n_accumulated_by_type[k]));
 
+    for (k = 0; k < PA_MEMPOOL_SLOT_CLASSES; k++)
+        pa_strbuf_printf(buf,
+                         "Memory pool slots of size %s: %u allocated/%u accumulated, in %u pool blocks.\n",
+                         pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_mempool_slot_size(c->mempool, k)),
+                         (unsigned) pa_atomic_load(&mstat->n_slots_allocated_by_class[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_slots_accumulated_by_class[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_blocks_by_class[k]));
+
     return 0;
 }
 
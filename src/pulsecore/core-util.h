@@ -249,6 +249,15 @@ void pa_reduce(unsigned *num, unsigned *den);
 
 unsigned pa_ncpus(void);
 
+/* Tells the CPU that we are in a busy loop, for spinning */
+static inline void pa_cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
 /* Replaces all occurrences of `a' in `s' with `b'. The caller has to free the
  * returned string. All parameters must be non-NULL and additionally `a' must
  * not be a zero-length string.
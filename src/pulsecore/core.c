@@ -38,6 +38,7 @@
 #include <pulsecore/random.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/thread-mq.h>
 
 #include "core.h"
 
@@ -54,6 +55,10 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
             pa_module_unload(userdata, true);
             return 0;
 
+        case PA_CORE_MESSAGE_GROW_MEMPOOL:
+            pa_mempool_grow(c->mempool);
+            return 0;
+
         default:
             return -1;
     }
@@ -61,7 +66,19 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
 
 static void core_free(pa_object *o);
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size) {
+/* Called from any thread. Creating the shared memory for a new segment
+ * does not belong into IO threads, so they leave it to us. */
+static void mempool_grow_cb(pa_mempool *pool, void *userdata) {
+    pa_core *c = userdata;
+    pa_thread_mq *q;
+
+    if ((q = pa_thread_mq_get()))
+        pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(c), PA_CORE_MESSAGE_GROW_MEMPOOL, NULL, 0, NULL, NULL);
+    else
+        pa_mempool_grow(pool);
+}
+
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size, pa_mem_hugepages_t shm_hugepages, int shm_numa_node) {
     pa_core* c;
     pa_mempool *pool;
     pa_mem_type_t type;
@@ -71,7 +88,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     if (shared) {
         type = (enable_memfd) ? PA_MEM_TYPE_SHARED_MEMFD : PA_MEM_TYPE_SHARED_POSIX;
-        if (!(pool = pa_mempool_new(type, shm_size, false))) {
+        if (!(pool = pa_mempool_new_full(type, shm_size, false, shm_hugepages, shm_numa_node))) {
             pa_log_warn("Failed to allocate %s memory pool. Falling back to a normal memory pool.",
                         pa_mem_type_to_string(type));
             shared = false;
@@ -79,7 +96,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     }
 
     if (!shared) {
-        if (!(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, shm_size, false))) {
+        if (!(pool = pa_mempool_new_full(PA_MEM_TYPE_PRIVATE, shm_size, false, shm_hugepages, shm_numa_node))) {
             pa_log("pa_mempool_new() failed.");
             return NULL;
         }
@@ -126,7 +143,10 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->subscription_event_last = NULL;
 
     c->mempool = pool;
+    pa_mempool_set_grow_callback(c->mempool, mempool_grow_cb, c);
     c->shm_size = shm_size;
+    c->shm_hugepages = shm_hugepages;
+    c->shm_numa_node = shm_numa_node;
     pa_silence_cache_init(&c->silence_cache);
 
     c->exit_event = NULL;
@@ -144,6 +164,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->disable_remixing = false;
     c->disable_lfe_remixing = true;
     c->lfe_crossover_freq = 0;
+    c->render_threads = 0;
     c->deferred_volume = true;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
@@ -171,6 +171,7 @@ struct pa_core {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_threads;
 
     pa_defer_event *module_defer_unload_event;
     pa_hashmap *modules_pending_unload; /* pa_module -> pa_module (hashmap-as-a-set) */
@@ -187,6 +188,10 @@ struct pa_core {
      * or PA daemon defaults (~ 64 MiB). */
     size_t shm_size;
 
+    /* How to back memory pools, for the per-client ones as well */
+    pa_mem_hugepages_t shm_hugepages;
+    int shm_numa_node;
+
     pa_silence_cache silence_cache;
 
     pa_time_event *exit_event;
@@ -218,10 +223,11 @@ PA_DECLARE_PUBLIC_CLASS(pa_core);
 
 enum {
     PA_CORE_MESSAGE_UNLOAD_MODULE,
+    PA_CORE_MESSAGE_GROW_MEMPOOL,
     PA_CORE_MESSAGE_MAX
 };
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size);
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size, pa_mem_hugepages_t shm_hugepages, int shm_numa_node);
 
 /* Check whether no one is connected to this core */
 void pa_core_check_idle(pa_core *c);
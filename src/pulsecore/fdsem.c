@@ -43,8 +43,17 @@
 #include <sys/eventfd.h>
 #endif
 
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+#include <linux/futex.h>
+#define USE_FUTEX
+#endif
+
 #include "fdsem.h"
 
+/* Upper bound for the number of times pa_fdsem_wait() checks for a post
+ * before going to sleep */
+#define SPIN_MAX 1000
+
 struct pa_fdsem {
     int fds[2];
 #ifdef HAVE_SYS_EVENTFD_H
@@ -52,8 +61,29 @@ struct pa_fdsem {
 #endif
     int write_type;
     pa_fdsem_data *data;
+
+#ifdef USE_FUTEX
+    /* Only for semaphores that do not live in shared memory: waiters in
+     * pa_fdsem_wait() sleep on a futex instead of reading from the fd,
+     * which is only needed if they want to poll() */
+    bool use_futex;
+    pa_atomic_t sleeping;
+    int spin;
+#endif
 };
 
+#ifdef USE_FUTEX
+static void futex_wait(pa_atomic_t *a, int value) {
+    /* Returns right away with EAGAIN if *a is not value anymore, and
+     * may wake up spuriously, the callers check again anyway */
+    syscall(SYS_futex, &a->value, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(pa_atomic_t *a) {
+    syscall(SYS_futex, &a->value, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#endif
+
 pa_fdsem *pa_fdsem_new(void) {
     pa_fdsem *f;
 
@@ -77,6 +107,12 @@ pa_fdsem *pa_fdsem_new(void) {
     pa_atomic_store(&f->data->signalled, 0);
     pa_atomic_store(&f->data->in_pipe, 0);
 
+#ifdef USE_FUTEX
+    /* Spinning only helps if the poster can run at the same time */
+    f->use_futex = true;
+    f->spin = pa_ncpus() > 1 ? SPIN_MAX / 10 : -1;
+#endif
+
     return f;
 }
 
@@ -181,6 +217,11 @@ void pa_fdsem_post(pa_fdsem *f) {
 
     if (pa_atomic_cmpxchg(&f->data->signalled, 0, 1)) {
 
+#ifdef USE_FUTEX
+        if (f->use_futex && pa_atomic_load(&f->sleeping))
+            futex_wake(&f->data->signalled);
+#endif
+
         if (pa_atomic_load(&f->data->waiting)) {
             ssize_t r;
             char x = 'x';
@@ -219,6 +260,37 @@ void pa_fdsem_post(pa_fdsem *f) {
     }
 }
 
+#ifdef USE_FUTEX
+/* Spins for a while in the hope that the post is about to come, and
+ * sleeps on the futex if it does not. How long to spin is adapted to how
+ * long it took for the post to come the last few times. */
+static void futex_wait_for_post(pa_fdsem *f) {
+    int n, max;
+
+    if (f->spin >= 0) {
+        max = PA_MIN(f->spin * 2 + 10, SPIN_MAX);
+
+        for (n = 0; n < max; n++) {
+            pa_cpu_relax();
+
+            if (pa_atomic_load(&f->data->signalled) && pa_atomic_cmpxchg(&f->data->signalled, 1, 0)) {
+                f->spin += (n - f->spin) / 8;
+                return;
+            }
+        }
+
+        f->spin -= f->spin / 8;
+    }
+
+    pa_atomic_inc(&f->sleeping);
+
+    while (!pa_atomic_cmpxchg(&f->data->signalled, 1, 0))
+        futex_wait(&f->data->signalled, 0);
+
+    pa_assert_se(pa_atomic_dec(&f->sleeping) >= 1);
+}
+#endif
+
 void pa_fdsem_wait(pa_fdsem *f) {
     pa_assert(f);
 
@@ -227,6 +299,13 @@ void pa_fdsem_wait(pa_fdsem *f) {
     if (pa_atomic_cmpxchg(&f->data->signalled, 1, 0))
         return;
 
+#ifdef USE_FUTEX
+    if (f->use_futex) {
+        futex_wait_for_post(f);
+        return;
+    }
+#endif
+
     pa_atomic_inc(&f->data->waiting);
 
     while (!pa_atomic_cmpxchg(&f->data->signalled, 1, 0)) {
@@ -24,7 +24,12 @@
 
 /* A simple, asynchronous semaphore which uses fds for sleeping. In
  * the best case all functions are lock-free unless sleeping is
- * required.  */
+ * required. Where futexes are available, pa_fdsem_wait() on a
+ * semaphore from pa_fdsem_new() spins for a short while and then sleeps
+ * on a futex instead, the fd is then only used for the
+ * pa_fdsem_before_poll()/pa_fdsem_after_poll() pair. Semaphores in
+ * shared memory always use the fd, the other side might not know
+ * about the futex.  */
 
 #include <pulsecore/atomic.h>
 
@@ -0,0 +1,137 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include "hash-index.h"
+
+/* Most hashmaps and idxsets hold only a handful of entries */
+#define MIN_SIZE 8
+
+/* Tables are not shrunk below this, so that small ones that fill up
+ * and empty again all the time do not keep reallocating */
+#define MIN_SHRINK_SIZE 64
+
+/* Grow when more than 4/5 of the slots are in use, shrink when less
+ * than 1/8 are */
+#define TOO_FULL(n, size) ((n) * 5 > (size) * 4)
+#define TOO_EMPTY(n, size) ((size) > MIN_SHRINK_SIZE && (n) * 8 < (size))
+
+void pa_hash_index_init(pa_hash_index *t) {
+    pa_assert(t);
+
+    t->slots = NULL;
+    t->size = t->shift = t->n_entries = 0;
+}
+
+void pa_hash_index_done(pa_hash_index *t) {
+    pa_assert(t);
+
+    pa_xfree(t->slots);
+    pa_hash_index_init(t);
+}
+
+static void insert(pa_hash_index *t, uint32_t hash, void *entry) {
+    pa_hash_index_slot s, *p;
+    unsigned i, mask = t->size - 1;
+
+    s.entry = entry;
+    s.hash = hash;
+    s.dist = 0;
+
+    for (i = pa_hash_index_home(t, hash);; i = (i + 1) & mask, s.dist++) {
+        p = t->slots + i;
+
+        if (!p->entry) {
+            *p = s;
+            return;
+        }
+
+        /* Take the slot from entries that are closer to their home, and
+         * carry on with them instead */
+        if (p->dist < s.dist) {
+            pa_hash_index_slot tmp = *p;
+
+            *p = s;
+            s = tmp;
+        }
+    }
+}
+
+static void resize(pa_hash_index *t, unsigned size) {
+    pa_hash_index_slot *old = t->slots;
+    unsigned old_size = t->size, i, bits = 0;
+
+    pa_assert(size >= MIN_SIZE);
+    pa_assert(size > t->n_entries);
+
+    while ((1U << bits) < size)
+        bits++;
+
+    t->slots = pa_xnew0(pa_hash_index_slot, size);
+    t->size = size;
+    t->shift = 32 - bits;
+
+    for (i = 0; i < old_size; i++)
+        if (old[i].entry)
+            insert(t, old[i].hash, old[i].entry);
+
+    pa_xfree(old);
+}
+
+void pa_hash_index_put(pa_hash_index *t, uint32_t hash, void *entry) {
+    pa_assert(t);
+    pa_assert(entry);
+
+    if (!t->slots)
+        resize(t, MIN_SIZE);
+    else if (TOO_FULL(t->n_entries + 1, t->size))
+        resize(t, t->size * 2);
+
+    insert(t, hash, entry);
+    t->n_entries++;
+}
+
+void pa_hash_index_remove(pa_hash_index *t, uint32_t hash, void *entry) {
+    unsigned i, j, mask;
+
+    pa_assert(t);
+    pa_assert(entry);
+    pa_assert(t->n_entries > 0);
+
+    mask = t->size - 1;
+
+    for (i = pa_hash_index_home(t, hash); t->slots[i].entry != entry; i = (i + 1) & mask)
+        pa_assert(t->slots[i].entry);
+
+    /* Move the entries after it that are not at their home one slot
+     * back, so that no lookup has to step over a hole */
+    for (j = (i + 1) & mask; t->slots[j].entry && t->slots[j].dist > 0; i = j, j = (j + 1) & mask) {
+        t->slots[i] = t->slots[j];
+        t->slots[i].dist--;
+    }
+
+    t->slots[i].entry = NULL;
+    t->n_entries--;
+
+    if (TOO_EMPTY(t->n_entries, t->size))
+        resize(t, t->size / 2);
+}
@@ -0,0 +1,87 @@
+#ifndef foopulsecorehashindexhfoo
+#define foopulsecorehashindexhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+
+/* An open addressing hash table of entry pointers, used by pa_hashmap
+ * and pa_idxset to look up their entries. It knows nothing about keys:
+ * it only stores the hash value of each entry next to the pointer, and
+ * lookups return every entry with a matching hash in turn, leaving the
+ * comparison of the keys to the caller. Collisions are resolved with
+ * Robin Hood hashing and backward shift deletion, so probe sequences
+ * stay short, and the table grows and shrinks with the number of
+ * entries. */
+
+typedef struct pa_hash_index_slot {
+    void *entry;
+    uint32_t hash;
+    uint32_t dist; /* Distance from the slot the hash maps to */
+} pa_hash_index_slot;
+
+typedef struct pa_hash_index {
+    pa_hash_index_slot *slots;
+    unsigned size, shift, n_entries;
+} pa_hash_index;
+
+void pa_hash_index_init(pa_hash_index *t);
+void pa_hash_index_done(pa_hash_index *t);
+
+/* Adds an entry. The caller must have checked that there is no entry
+ * with an equal key yet. */
+void pa_hash_index_put(pa_hash_index *t, uint32_t hash, void *entry);
+
+/* Removes an entry that was added with the same hash before */
+void pa_hash_index_remove(pa_hash_index *t, uint32_t hash, void *entry);
+
+static inline unsigned pa_hash_index_home(const pa_hash_index *t, uint32_t hash) {
+    /* Fibonacci hashing, so that hash functions that only vary the low
+     * bits, like the trivial one, still spread over the whole table */
+    return (unsigned) ((hash * UINT32_C(2654435769)) >> t->shift);
+}
+
+/* Returns the next entry with the given hash, or NULL if there are no
+ * more. *state must be 0 on the first call. */
+static inline void *pa_hash_index_find(const pa_hash_index *t, uint32_t hash, unsigned *state) {
+    unsigned i, mask;
+
+    if (PA_UNLIKELY(!t->slots))
+        return NULL;
+
+    mask = t->size - 1;
+    i = (pa_hash_index_home(t, hash) + *state) & mask;
+
+    for (;; i = (i + 1) & mask, (*state)++) {
+        const pa_hash_index_slot *s = t->slots + i;
+
+        /* An entry with this hash would have displaced anything closer
+         * to its home than it would be here */
+        if (!s->entry || s->dist < *state)
+            return NULL;
+
+        if (s->hash == hash) {
+            (*state)++;
+            return s->entry;
+        }
+    }
+}
+
+#endif
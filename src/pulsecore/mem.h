@@ -45,6 +45,26 @@ static inline const char *pa_mem_type_to_string(pa_mem_type_t type) {
     pa_assert_not_reached();
 }
 
+typedef enum pa_mem_hugepages {
+    PA_MEM_HUGEPAGES_NO,              /* Normal pages only */
+    PA_MEM_HUGEPAGES_TRANSPARENT,     /* Ask for transparent huge pages with madvise() */
+    PA_MEM_HUGEPAGES_YES,             /* Preallocated huge pages (MAP_HUGETLB, MFD_HUGETLB),
+                                         falling back to transparent ones */
+} pa_mem_hugepages_t;
+
+static inline const char *pa_mem_hugepages_to_string(pa_mem_hugepages_t hugepages) {
+    switch (hugepages) {
+    case PA_MEM_HUGEPAGES_NO:
+        return "no";
+    case PA_MEM_HUGEPAGES_TRANSPARENT:
+        return "transparent";
+    case PA_MEM_HUGEPAGES_YES:
+        return "yes";
+    }
+
+    pa_assert_not_reached();
+}
+
 static inline bool pa_mem_type_is_shared(pa_mem_type_t t) {
     return (t == PA_MEM_TYPE_SHARED_POSIX) || (t == PA_MEM_TYPE_SHARED_MEMFD);
 }
@@ -50,17 +50,31 @@
 
 #include "memblock.h"
 
-/* We can allocate 64*1024*1024 bytes at maximum. That's 64MB. Please
+/* We can allocate 64*1024*1024 bytes at first. That's 64MB. Please
  * note that the footprint is usually much smaller, since the data is
  * stored in SHM and our OS does not commit the memory before we use
  * it for the first time. */
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
-#define PA_MEMEXPORT_SLOTS_MAX 128
+/* When all of that is in use, the pool grows by further segments of
+ * the same size as the first one, up to this many in total */
+#define PA_MEMPOOL_SEGMENTS_MAX 8
 
-#define PA_MEMIMPORT_SLOTS_MAX 160
-#define PA_MEMIMPORT_SEGMENTS_MAX 16
+/* Each of the slots above can be split into smaller ones, so that small
+ * blocks don't take up a whole slot. A size class has slots of
+ * PA_MEMPOOL_SLOT_SIZE >> shift bytes, smallest first. */
+static const unsigned slot_class_shift[PA_MEMPOOL_SLOT_CLASSES] = { 4, 2, 0 };
+
+/* Export slots are allocated in chunks as needed, the block IDs for
+ * all of them are reserved when the memexport is created. Older peers
+ * import no more than 160 blocks at a time, so only the first chunk is
+ * used unless pa_memexport_enable_max_slots() is called. */
+#define PA_MEMEXPORT_SLOTS_MAX 2048
+#define PA_MEMEXPORT_SLOTS_CHUNK 128
+
+#define PA_MEMIMPORT_SLOTS_MAX (PA_MEMEXPORT_SLOTS_MAX + 32)
+#define PA_MEMIMPORT_SEGMENTS_MAX (16 + PA_MEMPOOL_SEGMENTS_MAX)
 
 struct pa_memblock {
     PA_REFCNT_DECLARE; /* the reference counter */
@@ -141,17 +155,18 @@ struct pa_memimport {
 struct memexport_slot {
     PA_LLIST_FIELDS(struct memexport_slot);
     pa_memblock *block;
+    uint32_t id;
 };
 
 struct pa_memexport {
     pa_mutex *mutex;
     pa_mempool *pool;
 
-    struct memexport_slot slots[PA_MEMEXPORT_SLOTS_MAX];
+    struct memexport_slot *slots[PA_MEMEXPORT_SLOTS_MAX / PA_MEMEXPORT_SLOTS_CHUNK];
 
     PA_LLIST_HEAD(struct memexport_slot, free_slots);
     PA_LLIST_HEAD(struct memexport_slot, used_slots);
-    unsigned n_init;
+    unsigned n_init, n_max;
     unsigned baseidx;
 
     /* Called whenever a client from which we imported a memory block
@@ -163,6 +178,19 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
+/* A piece of shared memory the pool's blocks live in */
+struct mempool_segment {
+    pa_shm memory;
+
+    pa_atomic_t n_init;
+
+    /* The size class each initialized block has been split into */
+    uint8_t *block_class;
+
+    /* A list of free slots that may be reused, per size class */
+    pa_flist *free_slots[PA_MEMPOOL_SLOT_CLASSES];
+};
+
 struct pa_mempool {
     /* Reference count the mempool
      *
@@ -184,21 +212,33 @@ struct pa_mempool {
     pa_semaphore *semaphore;
     pa_mutex *mutex;
 
-    pa_shm memory;
+    /* Only the first n_segments are set up. Segments are added by
+     * whoever sets growing first, and never removed before the pool is
+     * freed. */
+    struct mempool_segment segments[PA_MEMPOOL_SEGMENTS_MAX];
+    pa_atomic_t n_segments;
+    pa_atomic_t growing;
+
+    /* If set, growing is left to whoever is called back, see
+     * pa_mempool_set_grow_callback() */
+    pa_mempool_grow_cb_t grow_cb;
+    void *grow_userdata;
+    pa_atomic_t grow_requested;
+
+    pa_mem_type_t type;
+    pa_mem_hugepages_t hugepages;
 
     bool global;
 
+    /* The size of and the number of blocks in each segment */
     size_t block_size;
     unsigned n_blocks;
     bool is_remote_writable;
 
-    pa_atomic_t n_init;
-
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
+    size_t slot_size[PA_MEMPOOL_SLOT_CLASSES];
 
     pa_mempool_stat stat;
 };
@@ -292,34 +332,193 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
-    struct mempool_slot *slot;
+static struct mempool_slot* segment_split_block(pa_mempool *p, struct mempool_segment *seg, unsigned c) {
+    uint8_t *block;
+    size_t o;
+    int idx;
+
+    /* We keep the first slot of the new block and make the others
+     * available to everyone. */
+
+    if ((unsigned) pa_atomic_load(&seg->n_init) >= p->n_blocks)
+        return NULL;
+
+    if ((unsigned) (idx = pa_atomic_inc(&seg->n_init)) >= p->n_blocks) {
+        pa_atomic_dec(&seg->n_init);
+        return NULL;
+    }
+
+    block = (uint8_t*) seg->memory.ptr + (p->block_size * (size_t) idx);
+    seg->block_class[idx] = (uint8_t) c;
+
+    for (o = p->slot_size[c]; o + p->slot_size[c] <= p->block_size; o += p->slot_size[c])
+        while (pa_flist_push(seg->free_slots[c], block + o) < 0)
+            ;
+
+    pa_atomic_inc(&p->stat.n_blocks_by_class[c]);
+
+    return (struct mempool_slot*) block;
+}
+
+/* Should be called locked */
+static int segment_init(pa_mempool *p, struct mempool_segment *seg) {
+    unsigned c;
+
+    if (pa_shm_create_rw(&seg->memory, p->type, p->n_blocks * p->block_size, 0700, p->hugepages) < 0)
+        return -1;
+
+    pa_atomic_store(&seg->n_init, 0);
+    seg->block_class = pa_xnew0(uint8_t, p->n_blocks);
+
+    for (c = 0; c < PA_MEMPOOL_SLOT_CLASSES; c++)
+        seg->free_slots[c] = pa_flist_new((unsigned) (p->n_blocks * (p->block_size / p->slot_size[c])));
+
+    return 0;
+}
+
+static void segment_done(struct mempool_segment *seg) {
+    unsigned c;
+
+    for (c = 0; c < PA_MEMPOOL_SLOT_CLASSES; c++)
+        pa_flist_free(seg->free_slots[c], NULL);
+
+    pa_xfree(seg->block_class);
+    pa_shm_free(&seg->memory);
+}
+
+/* No lock necessary. Adds a segment to the pool, unless somebody else
+ * did so since n segments were seen. Returns false if the pool did not
+ * grow and there is no point in retrying, i.e. it cannot grow any
+ * further or another thread is adding a segment right now. Nobody
+ * ever waits for that, so the shm creation does not block others. */
+static bool mempool_grow(pa_mempool *p, unsigned n) {
+    char t[PA_BYTES_SNPRINT_MAX];
+    struct mempool_segment *seg;
+    int node;
+
+    if ((unsigned) pa_atomic_load(&p->n_segments) != n)
+        return true;
+
+    if (n >= PA_MEMPOOL_SEGMENTS_MAX)
+        return false;
+
+    if (!pa_atomic_cmpxchg(&p->growing, 0, 1))
+        return false;
+
+    if ((unsigned) pa_atomic_load(&p->n_segments) != n) {
+        pa_atomic_store(&p->growing, 0);
+        return true;
+    }
+
+    /* Nobody looks at the segment before n_segments covers it */
+    seg = &p->segments[n];
+
+    if (segment_init(p, seg) < 0) {
+        pa_atomic_store(&p->growing, 0);
+        return false;
+    }
+
+    /* Publishes the segment, the atomic store is a full memory
+     * barrier */
+    pa_atomic_store(&p->n_segments, (int) n + 1);
+    pa_atomic_inc(&p->stat.n_segments);
+    pa_atomic_store(&p->growing, 0);
+
+    /* After publishing, so that pa_mempool_bind_numa_node() either
+     * sees the segment or has set the node by now */
+    if ((node = pa_atomic_load(&p->stat.numa_node)) >= 0)
+        pa_shm_bind_numa_node(&seg->memory, node);
+
+    pa_log_debug("Memory pool full, added segment %u of size %s", n,
+                 pa_bytes_snprint(t, sizeof(t), (unsigned) seg->memory.size));
+
+    return true;
+}
+
+/* No lock necessary. Asks the grow callback for another segment, once
+ * until pa_mempool_grow() is called. */
+static void mempool_request_grow(pa_mempool *p) {
+    if ((unsigned) pa_atomic_load(&p->n_segments) >= PA_MEMPOOL_SEGMENTS_MAX)
+        return;
+
+    if (pa_atomic_cmpxchg(&p->grow_requested, 0, 1))
+        p->grow_cb(p, p->grow_userdata);
+}
+
+/* No lock necessary */
+static unsigned mempool_slot_class(pa_mempool *p, size_t length) {
+    unsigned c;
+
     pa_assert(p);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
-        int idx;
+    for (c = 0; c < PA_MEMPOOL_SLOT_CLASSES - 1; c++)
+        if (length <= p->slot_size[c])
+            break;
 
-        /* The free list was empty, we have to allocate a new entry */
+    return c;
+}
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
-        else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, unsigned c) {
+    struct mempool_slot *slot = NULL;
+    unsigned s, n;
 
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
-            return NULL;
+    pa_assert(p);
+    pa_assert(c < PA_MEMPOOL_SLOT_CLASSES);
+
+    for (;;) {
+        n = (unsigned) pa_atomic_load(&p->n_segments);
+
+        for (s = 0; s < n && !slot; s++)
+            slot = pa_flist_pop(p->segments[s].free_slots[c]);
+
+        /* The free lists were empty, we have to split up a new
+         * block */
+        for (s = 0; s < n && !slot; s++)
+            slot = segment_split_block(p, &p->segments[s], c);
+
+        if (slot) {
+            /* Ask for the next segment while a quarter of the last
+             * one is still unused, so that it is usually there before
+             * it is needed */
+            if (p->grow_cb && s == n &&
+                (unsigned) pa_atomic_load(&p->segments[n - 1].n_init) >= p->n_blocks - p->n_blocks / 4)
+                mempool_request_grow(p);
+
+            break;
         }
+
+        /* Unless the callback could grow the pool right away, this
+         * allocation fails */
+        if (p->grow_cb) {
+            mempool_request_grow(p);
+
+            if ((unsigned) pa_atomic_load(&p->n_segments) == n)
+                break;
+
+            continue;
+        }
+
+        if (!mempool_grow(p, n))
+            break;
+    }
+
+    if (!slot) {
+        if (pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Pool full");
+        pa_atomic_inc(&p->stat.n_pool_full);
+        return NULL;
     }
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
+/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->slot_size[c], 0, 0); */
 /*     } */
 /* #endif */
 
+    pa_atomic_inc(&p->stat.n_slots_allocated_by_class[c]);
+    pa_atomic_inc(&p->stat.n_slots_accumulated_by_class[c]);
+
     return slot;
 }
 
@@ -329,23 +528,57 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static struct mempool_segment* mempool_segment_by_ptr(pa_mempool *p, void *ptr) {
+    unsigned s, n;
+
     pa_assert(p);
 
-    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
-    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+    n = (unsigned) pa_atomic_load(&p->n_segments);
+
+    for (s = 0; s < n; s++) {
+        pa_shm *m = &p->segments[s].memory;
+
+        if ((uint8_t*) ptr >= (uint8_t*) m->ptr && (uint8_t*) ptr < (uint8_t*) m->ptr + m->size)
+            return &p->segments[s];
+    }
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    pa_assert_not_reached();
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr, struct mempool_segment **seg, unsigned *c) {
     unsigned idx;
+    size_t o;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+    *seg = mempool_segment_by_ptr(p, ptr);
+
+    o = (size_t) ((uint8_t*) ptr - (uint8_t*) (*seg)->memory.ptr);
+    idx = (unsigned) (o / p->block_size);
+    *c = (*seg)->block_class[idx];
+    o -= idx * p->block_size;
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    return (struct mempool_slot*) ((uint8_t*) (*seg)->memory.ptr + (idx * p->block_size) + (o / p->slot_size[*c]) * p->slot_size[*c]);
+}
+
+/* No lock necessary */
+static void mempool_free_slot(pa_mempool *p, struct mempool_segment *seg, struct mempool_slot *slot, unsigned c) {
+    pa_assert(p);
+    pa_assert(seg);
+    pa_assert(slot);
+
+/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
+/*     if (PA_UNLIKELY(pa_in_valgrind())) { */
+/*         VALGRIND_FREELIKE_BLOCK(slot, p->slot_size[c]); */
+/*     } */
+/* #endif */
+
+    pa_atomic_dec(&p->stat.n_slots_allocated_by_class[c]);
+
+    /* The free list dimensions should easily allow all slots
+     * to fit in, hence try harder if pushing this slot into
+     * the free list fails */
+    while (pa_flist_push(seg->free_slots[c], slot) < 0)
+        ;
 }
 
 /* No lock necessary */
@@ -365,6 +598,7 @@ void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable) {
 pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
+    unsigned c;
     static int mempool_disable = 0;
 
     pa_assert(p);
@@ -382,18 +616,23 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    /* Use the smallest slots the data fits in. The header goes into
+     * the slot too if there is room left for it, otherwise it is
+     * allocated separately. */
+    c = mempool_slot_class(p, length);
+
+    if (p->slot_size[c] >= PA_ALIGN(sizeof(pa_memblock)) + length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, c)))
             return NULL;
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
+    } else if (p->slot_size[c] >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, c)))
             return NULL;
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
@@ -642,24 +881,16 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
+            struct mempool_segment *seg;
             struct mempool_slot *slot;
+            unsigned c;
             bool call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data), &seg, &c));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
-/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
-/*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
-/*             } */
-/* #endif */
-
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            mempool_free_slot(b->pool, seg, slot, c);
 
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
@@ -714,7 +945,7 @@ static void memblock_make_local(pa_memblock *b) {
     if (b->length <= b->pool->block_size) {
         struct mempool_slot *slot;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, mempool_slot_class(b->pool, b->length)))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -826,9 +1057,14 @@ static void memblock_replace_import(pa_memblock *b) {
  * TODO-1: Transform the global core mempool to a per-client one
  * TODO-2: Remove global mempools support */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
+    return pa_mempool_new_full(type, size, per_client, PA_MEM_HUGEPAGES_NO, -1);
+}
+
+pa_mempool *pa_mempool_new_full(pa_mem_type_t type, size_t size, bool per_client, pa_mem_hugepages_t hugepages, int numa_node) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
     const size_t page_size = pa_page_size();
+    unsigned c;
 
     p = pa_xnew0(pa_mempool, 1);
     PA_REFCNT_INIT(p);
@@ -846,21 +1082,44 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
             p->n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, type, p->n_blocks * p->block_size, 0700) < 0) {
+    for (c = 0; c < PA_MEMPOOL_SLOT_CLASSES; c++) {
+        p->slot_size[c] = p->block_size >> slot_class_shift[c];
+
+        /* Don't split blocks into slots smaller than a page, so that
+         * they can still be punched one by one */
+        if (p->slot_size[c] < page_size)
+            p->slot_size[c] = page_size;
+    }
+
+    p->type = type;
+    p->hugepages = hugepages;
+
+    if (segment_init(p, &p->segments[0]) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
-    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
+    pa_atomic_store(&p->n_segments, 1);
+    pa_atomic_store(&p->stat.n_segments, 1);
+
+    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu, huge pages: %s",
                  pa_mem_type_to_string(type),
                  p->n_blocks,
                  pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
                  pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
-                 (unsigned long) pa_mempool_block_size_max(p));
+                 (unsigned long) pa_mempool_block_size_max(p),
+                 pa_mem_hugepages_to_string(p->segments[0].memory.hugepages));
 
-    p->global = !per_client;
+    pa_atomic_store(&p->stat.hugepages, (int) p->segments[0].memory.hugepages);
+    pa_atomic_store(&p->stat.numa_node, -1);
+
+    /* Not being able to bind the pool is not fatal */
+    if (numa_node >= 0 && pa_shm_bind_numa_node(&p->segments[0].memory, numa_node) >= 0) {
+        pa_log_debug("Bound memory pool to NUMA node %i", numa_node);
+        pa_atomic_store(&p->stat.numa_node, numa_node);
+    }
 
-    pa_atomic_store(&p->n_init, 0);
+    p->global = !per_client;
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -868,12 +1127,12 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     p->mutex = pa_mutex_new(true, true);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
-
     return p;
 }
 
 static void mempool_free(pa_mempool *p) {
+    unsigned s;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -886,41 +1145,48 @@ static void mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
-
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
 
 #ifdef DEBUG_REF
-        unsigned i;
+        unsigned i, c;
+        size_t o;
         pa_flist *list;
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        list = pa_flist_new((unsigned) (p->n_blocks * (p->block_size / p->slot_size[0])));
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+        for (s = 0; s < (unsigned) pa_atomic_load(&p->n_segments); s++) {
+            struct mempool_segment *seg = &p->segments[s];
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+            for (i = 0; i < (unsigned) pa_atomic_load(&seg->n_init); i++) {
+                c = seg->block_class[i];
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                for (o = 0; o + p->slot_size[c] <= p->block_size; o += p->slot_size[c]) {
+                    struct mempool_slot *slot;
+                    pa_memblock *b, *k;
 
-                if (b == k)
-                    break;
-            }
+                    slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + (p->block_size * (size_t) i) + o);
+                    b = mempool_slot_data(slot);
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                    while ((k = pa_flist_pop(seg->free_slots[c]))) {
+                        while (pa_flist_push(list, k) < 0)
+                            ;
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
+                        if (b == k)
+                            break;
+                    }
+
+                    if (!k)
+                        pa_log("REF: Leaked memory block %p", b);
+
+                    while ((k = pa_flist_pop(list)))
+                        while (pa_flist_push(seg->free_slots[c], k) < 0)
+                            ;
+                }
+            }
         }
 
         pa_flist_free(list, NULL);
@@ -932,7 +1198,8 @@ static void mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
-    pa_shm_free(&p->memory);
+    for (s = 0; s < (unsigned) pa_atomic_load(&p->n_segments); s++)
+        segment_done(&p->segments[s]);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
@@ -947,6 +1214,40 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
     return &p->stat;
 }
 
+/* Self-locked */
+int pa_mempool_bind_numa_node(pa_mempool *p, int node) {
+    unsigned s;
+    int ret = 0;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    for (s = 0; s < (unsigned) pa_atomic_load(&p->n_segments); s++)
+        if (pa_shm_bind_numa_node(&p->segments[s].memory, node) < 0) {
+            ret = -1;
+            goto finish;
+        }
+
+    pa_log_debug("Bound memory pool to NUMA node %i", node);
+
+    /* Segments added later on are bound to it, too */
+    pa_atomic_store(&p->stat.numa_node, node);
+
+finish:
+    pa_mutex_unlock(p->mutex);
+
+    return ret;
+}
+
+/* No lock necessary */
+size_t pa_mempool_slot_size(pa_mempool *p, unsigned c) {
+    pa_assert(p);
+    pa_assert(c < PA_MEMPOOL_SLOT_CLASSES);
+
+    return p->slot_size[c];
+}
+
 /* No lock necessary */
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
@@ -958,37 +1259,44 @@ size_t pa_mempool_block_size_max(pa_mempool *p) {
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned s, c;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    for (s = 0; s < (unsigned) pa_atomic_load(&p->n_segments); s++) {
+        struct mempool_segment *seg = &p->segments[s];
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+        for (c = 0; c < PA_MEMPOOL_SLOT_CLASSES; c++) {
+            list = pa_flist_new((unsigned) (p->n_blocks * (p->block_size / p->slot_size[c])));
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+            while ((slot = pa_flist_pop(seg->free_slots[c])))
+                while (pa_flist_push(list, slot) < 0)
+                    ;
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
-    }
+            while ((slot = pa_flist_pop(list))) {
+                pa_shm_punch(&seg->memory, (size_t) ((uint8_t*) slot - (uint8_t*) seg->memory.ptr), p->slot_size[c]);
 
-    pa_flist_free(list, NULL);
+                while (pa_flist_push(seg->free_slots[c], slot))
+                    ;
+            }
+
+            pa_flist_free(list, NULL);
+        }
+    }
 }
 
 /* No lock necessary */
 bool pa_mempool_is_shared(pa_mempool *p) {
     pa_assert(p);
 
-    return pa_mem_type_is_shared(p->memory.type);
+    return pa_mem_type_is_shared(p->type);
 }
 
 /* No lock necessary */
 bool pa_mempool_is_memfd_backed(const pa_mempool *p) {
     pa_assert(p);
 
-    return (p->memory.type == PA_MEM_TYPE_SHARED_MEMFD);
+    return (p->type == PA_MEM_TYPE_SHARED_MEMFD);
 }
 
 /* No lock necessary */
@@ -998,11 +1306,55 @@ int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
     if (!pa_mempool_is_shared(p))
         return -1;
 
-    *id = p->memory.id;
+    *id = p->segments[0].memory.id;
 
     return 0;
 }
 
+/* Not thread safe, to be called before the pool is shared with other
+ * threads */
+void pa_mempool_set_grow_callback(pa_mempool *p, pa_mempool_grow_cb_t cb, void *userdata) {
+    pa_assert(p);
+
+    p->grow_cb = cb;
+    p->grow_userdata = userdata;
+}
+
+/* No lock necessary */
+void pa_mempool_grow(pa_mempool *p) {
+    pa_assert(p);
+
+    mempool_grow(p, (unsigned) pa_atomic_load(&p->n_segments));
+
+    /* The next segment may be asked for again from now on */
+    pa_atomic_store(&p->grow_requested, 0);
+}
+
+/* No lock necessary */
+unsigned pa_mempool_get_n_segments(pa_mempool *p) {
+    pa_assert(p);
+
+    return (unsigned) pa_atomic_load(&p->n_segments);
+}
+
+/* No lock necessary
+ *
+ * For the segments added when the pool grows. Their memfd descriptor
+ * is kept open until the pool is freed, since they are registered with
+ * each connection separately once in use. DO NOT close the returned
+ * descriptor by your own. */
+int pa_mempool_get_segment_memfd(pa_mempool *p, unsigned s, uint32_t *id) {
+    pa_assert(p);
+    pa_assert(s > 0);
+    pa_assert(s < (unsigned) pa_atomic_load(&p->n_segments));
+    pa_assert(pa_mempool_is_memfd_backed(p));
+    pa_assert(p->segments[s].memory.fd != -1);
+
+    *id = p->segments[s].memory.id;
+
+    return p->segments[s].memory.fd;
+}
+
 pa_mempool* pa_mempool_ref(pa_mempool *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -1052,8 +1404,8 @@ int pa_mempool_take_memfd_fd(pa_mempool *p) {
 
     pa_mutex_lock(p->mutex);
 
-    memfd_fd = p->memory.fd;
-    p->memory.fd = -1;
+    memfd_fd = p->segments[0].memory.fd;
+    p->segments[0].memory.fd = -1;
 
     pa_mutex_unlock(p->mutex);
 
@@ -1077,7 +1429,7 @@ int pa_mempool_get_memfd_fd(pa_mempool *p) {
     pa_assert(pa_mempool_is_memfd_backed(p));
     pa_assert(pa_mempool_is_global(p));
 
-    memfd_fd = p->memory.fd;
+    memfd_fd = p->segments[0].memory.fd;
     pa_assert(memfd_fd != -1);
 
     return memfd_fd;
@@ -1325,13 +1677,14 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     if (!pa_mempool_is_shared(p))
         return NULL;
 
-    e = pa_xnew(pa_memexport, 1);
+    e = pa_xnew0(pa_memexport, 1);
     e->mutex = pa_mutex_new(true, true);
     e->pool = p;
     pa_mempool_ref(e->pool);
     PA_LLIST_HEAD_INIT(struct memexport_slot, e->free_slots);
     PA_LLIST_HEAD_INIT(struct memexport_slot, e->used_slots);
     e->n_init = 0;
+    e->n_max = PA_MEMEXPORT_SLOTS_CHUNK;
     e->revoke_cb = cb;
     e->userdata = userdata;
 
@@ -1344,18 +1697,32 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     return e;
 }
 
+/* Self-locked */
+void pa_memexport_enable_max_slots(pa_memexport *e) {
+    pa_assert(e);
+
+    pa_mutex_lock(e->mutex);
+    e->n_max = PA_MEMEXPORT_SLOTS_MAX;
+    pa_mutex_unlock(e->mutex);
+}
+
 void pa_memexport_free(pa_memexport *e) {
+    unsigned i;
+
     pa_assert(e);
 
     pa_mutex_lock(e->mutex);
     while (e->used_slots)
-        pa_memexport_process_release(e, (uint32_t) (e->used_slots - e->slots + e->baseidx));
+        pa_memexport_process_release(e, e->used_slots->id + e->baseidx);
     pa_mutex_unlock(e->mutex);
 
     pa_mutex_lock(e->pool->mutex);
     PA_LLIST_REMOVE(pa_memexport, e->pool->exports, e);
     pa_mutex_unlock(e->pool->mutex);
 
+    for (i = 0; i < PA_ELEMENTSOF(e->slots); i++)
+        pa_xfree(e->slots[i]);
+
     pa_mempool_unref(e->pool);
     pa_mutex_free(e->mutex);
     pa_xfree(e);
@@ -1363,6 +1730,7 @@ void pa_memexport_free(pa_memexport *e) {
 
 /* Self-locked */
 int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
+    struct memexport_slot *slot;
     pa_memblock *b;
 
     pa_assert(e);
@@ -1376,14 +1744,16 @@ int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
     if (id >= e->n_init)
         goto fail;
 
-    if (!e->slots[id].block)
+    slot = &e->slots[id / PA_MEMEXPORT_SLOTS_CHUNK][id % PA_MEMEXPORT_SLOTS_CHUNK];
+
+    if (!slot->block)
         goto fail;
 
-    b = e->slots[id].block;
-    e->slots[id].block = NULL;
+    b = slot->block;
+    slot->block = NULL;
 
-    PA_LLIST_REMOVE(struct memexport_slot, e->used_slots, &e->slots[id]);
-    PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, &e->slots[id]);
+    PA_LLIST_REMOVE(struct memexport_slot, e->used_slots, slot);
+    PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, slot);
 
     pa_mutex_unlock(e->mutex);
 
@@ -1421,7 +1791,7 @@ static void memexport_revoke_blocks(pa_memexport *e, pa_memimport *i) {
             slot->block->per_type.imported.segment->import != i)
             continue;
 
-        idx = (uint32_t) (slot - e->slots + e->baseidx);
+        idx = slot->id + e->baseidx;
         e->revoke_cb(e, idx, e->userdata);
         pa_memexport_process_release(e, idx);
     }
@@ -1474,9 +1844,15 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
     if (e->free_slots) {
         slot = e->free_slots;
         PA_LLIST_REMOVE(struct memexport_slot, e->free_slots, slot);
-    } else if (e->n_init < PA_MEMEXPORT_SLOTS_MAX)
-        slot = &e->slots[e->n_init++];
-    else {
+    } else if (e->n_init < e->n_max) {
+        struct memexport_slot **chunk = &e->slots[e->n_init / PA_MEMEXPORT_SLOTS_CHUNK];
+
+        if (!*chunk)
+            *chunk = pa_xnew(struct memexport_slot, PA_MEMEXPORT_SLOTS_CHUNK);
+
+        slot = &(*chunk)[e->n_init % PA_MEMEXPORT_SLOTS_CHUNK];
+        slot->id = e->n_init++;
+    } else {
         pa_mutex_unlock(e->mutex);
         pa_memblock_unref(b);
         return -1;
@@ -1484,7 +1860,7 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
 
     PA_LLIST_PREPEND(struct memexport_slot, e->used_slots, slot);
     slot->block = b;
-    *block_id = (uint32_t) (slot - e->slots + e->baseidx);
+    *block_id = slot->id + e->baseidx;
 
     pa_mutex_unlock(e->mutex);
 /*     pa_log("Got block id %u", *block_id); */
@@ -1498,7 +1874,7 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
         pa_assert(b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL);
         pa_assert(b->pool);
         pa_assert(pa_mempool_is_shared(b->pool));
-        memory = &b->pool->memory;
+        memory = &mempool_segment_by_ptr(b->pool, data)->memory;
     }
 
     pa_assert(data >= memory->ptr);
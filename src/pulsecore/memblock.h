@@ -54,8 +54,12 @@ typedef struct pa_memimport_segment pa_memimport_segment;
 typedef struct pa_memimport pa_memimport;
 typedef struct pa_memexport pa_memexport;
 
+/* The number of slot sizes pool blocks are allocated from */
+#define PA_MEMPOOL_SLOT_CLASSES 3
+
 typedef void (*pa_memimport_release_cb_t)(pa_memimport *i, uint32_t block_id, void *userdata);
 typedef void (*pa_memexport_revoke_cb_t)(pa_memexport *e, uint32_t block_id, void *userdata);
+typedef void (*pa_mempool_grow_cb_t)(pa_mempool *p, void *userdata);
 
 /* Please note that updates to this structure are not locked,
  * i.e. n_allocated might be updated at a point in time where
@@ -76,6 +80,20 @@ struct pa_mempool_stat {
 
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
+
+    /* Pool slots in use and ever handed out per size class, and the
+     * number of pool blocks split into slots of that class */
+    pa_atomic_t n_slots_allocated_by_class[PA_MEMPOOL_SLOT_CLASSES];
+    pa_atomic_t n_slots_accumulated_by_class[PA_MEMPOOL_SLOT_CLASSES];
+    pa_atomic_t n_blocks_by_class[PA_MEMPOOL_SLOT_CLASSES];
+
+    /* The number of shared memory segments the pool consists of */
+    pa_atomic_t n_segments;
+
+    /* What the pool memory is backed with (a pa_mem_hugepages_t),
+     * and the NUMA node it is bound to, or -1 */
+    pa_atomic_t hugepages;
+    pa_atomic_t numa_node;
 };
 
 /* Allocate a new memory block of type PA_MEMBLOCK_MEMPOOL or PA_MEMBLOCK_APPENDED, depending on the size */
@@ -125,11 +143,28 @@ pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client);
+/* Like pa_mempool_new(), but the pool memory may be backed by huge
+ * pages, and bound to a NUMA node if numa_node is not negative */
+pa_mempool *pa_mempool_new_full(pa_mem_type_t type, size_t size, bool per_client, pa_mem_hugepages_t hugepages, int numa_node);
 void pa_mempool_unref(pa_mempool *p);
 pa_mempool* pa_mempool_ref(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
+/* Moves the pool memory to the NUMA node, e.g. the one of the thread
+ * that will mostly work with it */
+int pa_mempool_bind_numa_node(pa_mempool *p, int node);
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
+/* Pools grow by further segments when full. By default the thread
+ * that finds the pool full adds the segment right away. With a grow
+ * callback, it is called instead, from whatever thread allocates, once
+ * the pool is about to run full. It should arrange for pa_mempool_grow()
+ * to be called from a thread that may block, e.g. the main thread.
+ * Until then, allocations that find the pool full fail. */
+void pa_mempool_set_grow_callback(pa_mempool *p, pa_mempool_grow_cb_t cb, void *userdata);
+void pa_mempool_grow(pa_mempool *p);
+unsigned pa_mempool_get_n_segments(pa_mempool *p);
+/* Returns the memfd of the segment s > 0 and sets its SHM ID */
+int pa_mempool_get_segment_memfd(pa_mempool *p, unsigned s, uint32_t *id);
 bool pa_mempool_is_shared(pa_mempool *p);
 bool pa_mempool_is_memfd_backed(const pa_mempool *p);
 bool pa_mempool_is_global(pa_mempool *p);
@@ -137,6 +172,8 @@ bool pa_mempool_is_per_client(pa_mempool *p);
 bool pa_mempool_is_remote_writable(pa_mempool *p);
 void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable);
 size_t pa_mempool_block_size_max(pa_mempool *p);
+/* The slot size of a size class, smallest first */
+size_t pa_mempool_slot_size(pa_mempool *p, unsigned c);
 
 int pa_mempool_take_memfd_fd(pa_mempool *p);
 int pa_mempool_get_memfd_fd(pa_mempool *p);
@@ -151,6 +188,8 @@ int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata);
+/* Lets more blocks be exported at a time than older peers can import */
+void pa_memexport_enable_max_slots(pa_memexport *e);
 void pa_memexport_free(pa_memexport *e);
 int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint32_t *block_id,
                      uint32_t *shm_id, size_t *offset, size_t * size);
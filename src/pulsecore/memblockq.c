@@ -30,24 +30,25 @@
 #include <pulsecore/log.h>
 #include <pulsecore/mcalign.h>
 #include <pulsecore/macro.h>
-#include <pulsecore/flist.h>
 
 #include "memblockq.h"
 
 /* #define MEMBLOCKQ_DEBUG */
 
-struct list_item {
-    struct list_item *next, *prev;
+/* The blocks are kept in a circular array sorted by index. Pushing
+ * and dropping mostly happens at the two ends, so this rarely needs
+ * to move anything, and blocks in the middle can be found by binary
+ * search instead of walking a list. */
+struct entry {
     int64_t index;
     pa_memchunk chunk;
 };
 
-PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
-
 struct pa_memblockq {
-    struct list_item *blocks, *blocks_tail;
-    struct list_item *current_read, *current_write;
-    unsigned n_blocks;
+    struct entry *entries;
+    unsigned n_allocated; /* always a power of two */
+    unsigned head, n_blocks;
+    unsigned current_read;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
     bool in_prebuf;
@@ -116,98 +117,120 @@ void pa_memblockq_free(pa_memblockq* bq) {
     if (bq->mcalign)
         pa_mcalign_free(bq->mcalign);
 
+    pa_xfree(bq->entries);
     pa_xfree(bq->name);
     pa_xfree(bq);
 }
 
-static void fix_current_read(pa_memblockq *bq) {
-    pa_assert(bq);
+/* i counts from the oldest block */
+static inline struct entry *entry(pa_memblockq *bq, unsigned i) {
+    return &bq->entries[(bq->head + i) & (bq->n_allocated - 1)];
+}
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_read = NULL;
-        return;
-    }
+static inline int64_t entry_end(const struct entry *e) {
+    return e->index + (int64_t) e->chunk.length;
+}
 
-    if (PA_UNLIKELY(!bq->current_read))
-        bq->current_read = bq->blocks;
+/* Returns the first block that ends after idx, or n_blocks */
+static unsigned find_block(pa_memblockq *bq, unsigned lo, int64_t idx) {
+    unsigned hi = bq->n_blocks;
 
-    /* Scan left */
-    while (PA_UNLIKELY(bq->current_read->index > bq->read_index))
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
 
-        if (bq->current_read->prev)
-            bq->current_read = bq->current_read->prev;
+        if (entry_end(entry(bq, mid)) <= idx)
+            lo = mid + 1;
         else
-            break;
-
-    /* Scan right */
-    while (PA_LIKELY(bq->current_read != NULL) && PA_UNLIKELY(bq->current_read->index + (int64_t) bq->current_read->chunk.length <= bq->read_index))
-        bq->current_read = bq->current_read->next;
+            hi = mid;
+    }
 
-    /* At this point current_read will either point at or left of the
-       next block to play. It may be NULL in case everything in
-       the queue was already played */
+    return lo;
 }
 
-static void fix_current_write(pa_memblockq *bq) {
+static void fix_current_read(pa_memblockq *bq) {
+    unsigned i;
+
     pa_assert(bq);
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_write = NULL;
-        return;
-    }
+    i = PA_MIN(bq->current_read, bq->n_blocks);
 
-    if (PA_UNLIKELY(!bq->current_write))
-        bq->current_write = bq->blocks_tail;
+    /* Usually we are still in the same block or just moved on to the
+     * next one. Otherwise do a full search. */
+    if (i < bq->n_blocks && entry_end(entry(bq, i)) <= bq->read_index)
+        i++;
 
-    /* Scan right */
-    while (PA_UNLIKELY(bq->current_write->index + (int64_t) bq->current_write->chunk.length <= bq->write_index))
+    if ((i >= bq->n_blocks || entry_end(entry(bq, i)) > bq->read_index) &&
+        (i == 0 || entry_end(entry(bq, i - 1)) <= bq->read_index))
+        bq->current_read = i;
+    else
+        bq->current_read = find_block(bq, 0, bq->read_index);
 
-        if (bq->current_write->next)
-            bq->current_write = bq->current_write->next;
-        else
-            break;
+    /* At this point current_read will either point at or left of the
+       next block to play. It is n_blocks in case everything in the
+       queue was already played */
+}
+
+static void grow(pa_memblockq *bq) {
+    struct entry *entries;
+    unsigned n, i;
+
+    pa_assert(bq);
 
-    /* Scan left */
-    while (PA_LIKELY(bq->current_write != NULL) && PA_UNLIKELY(bq->current_write->index > bq->write_index))
-        bq->current_write = bq->current_write->prev;
+    n = bq->n_allocated > 0 ? bq->n_allocated * 2 : 16;
+    entries = pa_xnew(struct entry, n);
 
-    /* At this point current_write will either point at or right of
-       the next block to write data to. It may be NULL in case
-       everything in the queue is still to be played */
+    for (i = 0; i < bq->n_blocks; i++)
+        entries[i] = *entry(bq, i);
+
+    pa_xfree(bq->entries);
+    bq->entries = entries;
+    bq->n_allocated = n;
+    bq->head = 0;
 }
 
-static void drop_block(pa_memblockq *bq, struct list_item *q) {
+/* Replaces the n_remove blocks at pos with n_insert uninitialized
+ * ones. The removed blocks need to be unreferenced already. */
+static void replace_blocks(pa_memblockq *bq, unsigned pos, unsigned n_remove, unsigned n_insert) {
+    unsigned i, n_after;
+
     pa_assert(bq);
-    pa_assert(q);
+    pa_assert(pos + n_remove <= bq->n_blocks);
 
-    pa_assert(bq->n_blocks >= 1);
+    while (bq->n_blocks - n_remove + n_insert > bq->n_allocated)
+        grow(bq);
 
-    if (q->prev)
-        q->prev->next = q->next;
-    else {
-        pa_assert(bq->blocks == q);
-        bq->blocks = q->next;
-    }
+    n_after = bq->n_blocks - pos - n_remove;
 
-    if (q->next)
-        q->next->prev = q->prev;
-    else {
-        pa_assert(bq->blocks_tail == q);
-        bq->blocks_tail = q->prev;
+    if (pos == 0 && n_insert <= n_remove) {
+        /* Dropping from the front only needs to move the head */
+        bq->head = (bq->head + n_remove - n_insert) & (bq->n_allocated - 1);
+    } else if (n_insert > n_remove) {
+        for (i = n_after; i > 0; i--)
+            *entry(bq, pos + n_insert + i - 1) = *entry(bq, pos + n_remove + i - 1);
+    } else if (n_insert < n_remove) {
+        for (i = 0; i < n_after; i++)
+            *entry(bq, pos + n_insert + i) = *entry(bq, pos + n_remove + i);
     }
 
-    if (bq->current_write == q)
-        bq->current_write = q->prev;
+    bq->n_blocks = bq->n_blocks - n_remove + n_insert;
+
+    /* Keep current_read on the same block if it still exists */
+    if (bq->current_read >= pos + n_remove)
+        bq->current_read = bq->current_read - n_remove + n_insert;
+    else if (bq->current_read > pos)
+        bq->current_read = pos;
+}
 
-    if (bq->current_read == q)
-        bq->current_read = q->next;
+static void drop_blocks(pa_memblockq *bq, unsigned pos, unsigned n) {
+    unsigned i;
 
-    pa_memblock_unref(q->chunk.memblock);
+    pa_assert(bq);
+    pa_assert(pos + n <= bq->n_blocks);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(list_items), q) < 0)
-        pa_xfree(q);
+    for (i = pos; i < pos + n; i++)
+        pa_memblock_unref(entry(bq, i)->chunk.memblock);
 
-    bq->n_blocks--;
+    replace_blocks(bq, pos, n, 0);
 }
 
 static void drop_backlog(pa_memblockq *bq) {
@@ -216,8 +239,12 @@ static void drop_backlog(pa_memblockq *bq) {
 
     boundary = bq->read_index - (int64_t) bq->maxrewind;
 
-    while (bq->blocks && (bq->blocks->index + (int64_t) bq->blocks->chunk.length <= boundary))
-        drop_block(bq, bq->blocks);
+    if (bq->n_blocks > 0 && entry_end(entry(bq, 0)) <= boundary)
+        drop_blocks(bq, 0, find_block(bq, 0, boundary));
+}
+
+static int64_t get_end(pa_memblockq *bq, int64_t idx) {
+    return bq->n_blocks > 0 ? entry_end(entry(bq, bq->n_blocks - 1)) : idx;
 }
 
 static bool can_push(pa_memblockq *bq, size_t l) {
@@ -234,7 +261,7 @@ static bool can_push(pa_memblockq *bq, size_t l) {
             return true;
     }
 
-    end = bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->write_index;
+    end = get_end(bq, bq->write_index);
 
     /* Make sure that the list doesn't get too long */
     if (bq->write_index + (int64_t) l > end)
@@ -276,9 +303,10 @@ static void read_index_changed(pa_memblockq *bq, int64_t old_read_index) {
 }
 
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
-    struct list_item *q, *n;
+    struct entry *e;
     pa_memchunk chunk;
-    int64_t old;
+    int64_t old, end;
+    unsigned lo, hi, i;
 
     pa_assert(bq);
     pa_assert(uchunk);
@@ -294,147 +322,100 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
     old = bq->write_index;
     chunk = *uchunk;
+    end = bq->write_index + (int64_t) chunk.length;
 
-    fix_current_write(bq);
-    q = bq->current_write;
-
-    /* First we advance the q pointer right of where we want to
-     * write to */
+    /* Find the blocks [lo, hi) the new data overlaps with. Usually we
+     * append, so check that first. */
+    if (PA_LIKELY(get_end(bq, bq->write_index) <= bq->write_index))
+        lo = hi = bq->n_blocks;
+    else {
+        lo = find_block(bq, 0, bq->write_index);
+        hi = find_block(bq, lo, end);
 
-    if (q) {
-        while (bq->write_index + (int64_t) chunk.length > q->index)
-            if (q->next)
-                q = q->next;
-            else
-                break;
+        if (hi < bq->n_blocks && entry(bq, hi)->index < end)
+            hi++;
     }
 
-    if (!q)
-        q = bq->blocks_tail;
+    if (lo < hi) {
+        e = entry(bq, lo);
 
-    /* We go from back to front to look for the right place to add
-     * this new entry. Drop data we will overwrite on the way */
+        if (e->index < bq->write_index && entry_end(e) > end) {
+            struct entry *t;
+            size_t d;
 
-    while (q) {
+            /* The new data goes into the middle of this block, so we
+             * need to split it and save the end */
+            replace_blocks(bq, lo + 1, 0, 1);
+            e = entry(bq, lo);
+            t = entry(bq, lo + 1);
 
-        if (bq->write_index >= q->index + (int64_t) q->chunk.length)
-            /* We found the entry where we need to place the new entry immediately after */
-            break;
-        else if (bq->write_index + (int64_t) chunk.length <= q->index) {
-            /* This entry isn't touched at all, let's skip it */
-            q = q->prev;
-        } else if (bq->write_index <= q->index &&
-                   bq->write_index + (int64_t) chunk.length >= q->index + (int64_t) q->chunk.length) {
-
-            /* This entry is fully replaced by the new entry, so let's drop it */
-
-            struct list_item *p;
-            p = q;
-            q = q->prev;
-            drop_block(bq, p);
-        } else if (bq->write_index >= q->index) {
-            /* The write index points into this memblock, so let's
-             * truncate or split it */
-
-            if (bq->write_index + (int64_t) chunk.length < q->index + (int64_t) q->chunk.length) {
-
-                /* We need to save the end of this memchunk */
-                struct list_item *p;
-                size_t d;
-
-                /* Create a new list entry for the end of the memchunk */
-                if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-                    p = pa_xnew(struct list_item, 1);
-
-                p->chunk = q->chunk;
-                pa_memblock_ref(p->chunk.memblock);
-
-                /* Calculate offset */
-                d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
-                pa_assert(d > 0);
-
-                /* Drop it from the new entry */
-                p->index = q->index + (int64_t) d;
-                p->chunk.length -= d;
-
-                /* Add it to the list */
-                p->prev = q;
-                if ((p->next = q->next))
-                    q->next->prev = p;
-                else
-                    bq->blocks_tail = p;
-                q->next = p;
-
-                bq->n_blocks++;
-            }
+            *t = *e;
+            pa_memblock_ref(t->chunk.memblock);
 
-            /* Truncate the chunk */
-            if (!(q->chunk.length = (size_t) (bq->write_index - q->index))) {
-                struct list_item *p;
-                p = q;
-                q = q->prev;
-                drop_block(bq, p);
-            }
+            d = (size_t) (end - e->index);
+            t->index += (int64_t) d;
+            t->chunk.index += d;
+            t->chunk.length -= d;
 
-            /* We had to truncate this block, hence we're now at the right position */
-            break;
+            e->chunk.length = (size_t) (bq->write_index - e->index);
+
+            lo = hi = lo + 1;
         } else {
-            size_t d;
 
-            pa_assert(bq->write_index + (int64_t)chunk.length > q->index &&
-                      bq->write_index + (int64_t)chunk.length < q->index + (int64_t)q->chunk.length &&
-                      bq->write_index < q->index);
+            /* Truncate the block the write index points into */
+            if (e->index < bq->write_index) {
+                e->chunk.length = (size_t) (bq->write_index - e->index);
+                lo++;
+            }
+
+            /* Drop the beginning of the block the new data ends in */
+            if (lo < hi) {
+                e = entry(bq, hi - 1);
 
-            /* The job overwrites the current entry at the end, so let's drop the beginning of this entry */
+                if (entry_end(e) > end) {
+                    size_t d = (size_t) (end - e->index);
 
-            d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
-            q->index += (int64_t) d;
-            q->chunk.index += d;
-            q->chunk.length -= d;
+                    e->index += (int64_t) d;
+                    e->chunk.index += d;
+                    e->chunk.length -= d;
+                    hi--;
+                }
+            }
 
-            q = q->prev;
+            /* Everything in between is replaced */
+            for (i = lo; i < hi; i++)
+                pa_memblock_unref(entry(bq, i)->chunk.memblock);
         }
     }
 
-    if (q) {
-        pa_assert(bq->write_index >=  q->index + (int64_t)q->chunk.length);
-        pa_assert(!q->next || (bq->write_index + (int64_t)chunk.length <= q->next->index));
+    pa_assert(lo == 0 || bq->write_index >= entry_end(entry(bq, lo - 1)));
+    pa_assert(hi >= bq->n_blocks || end <= entry(bq, hi)->index);
 
-        /* Try to merge memory blocks */
+    /* Try to merge memory blocks */
+    if (lo > 0) {
+        e = entry(bq, lo - 1);
 
-        if (q->chunk.memblock == chunk.memblock &&
-            q->chunk.index + q->chunk.length == chunk.index &&
-            bq->write_index == q->index + (int64_t) q->chunk.length) {
+        if (e->chunk.memblock == chunk.memblock &&
+            e->chunk.index + e->chunk.length == chunk.index &&
+            bq->write_index == entry_end(e)) {
 
-            q->chunk.length += chunk.length;
+            e->chunk.length += chunk.length;
             bq->write_index += (int64_t) chunk.length;
-            goto finish;
-        }
-    } else
-        pa_assert(!bq->blocks || (bq->write_index + (int64_t)chunk.length <= bq->blocks->index));
-
-    if (!(n = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-        n = pa_xnew(struct list_item, 1);
 
-    n->chunk = chunk;
-    pa_memblock_ref(n->chunk.memblock);
-    n->index = bq->write_index;
-    bq->write_index += (int64_t) n->chunk.length;
+            if (hi > lo)
+                replace_blocks(bq, lo, hi - lo, 0);
 
-    n->next = q ? q->next : bq->blocks;
-    n->prev = q;
-
-    if (n->next)
-        n->next->prev = n;
-    else
-        bq->blocks_tail = n;
+            goto finish;
+        }
+    }
 
-    if (n->prev)
-        n->prev->next = n;
-    else
-        bq->blocks = n;
+    replace_blocks(bq, lo, hi - lo, 1);
 
-    bq->n_blocks++;
+    e = entry(bq, lo);
+    e->chunk = chunk;
+    pa_memblock_ref(e->chunk.memblock);
+    e->index = bq->write_index;
+    bq->write_index += (int64_t) e->chunk.length;
 
 finish:
 
@@ -473,6 +454,7 @@ static bool update_prebuf(pa_memblockq *bq) {
 }
 
 int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
+    struct entry *e;
     int64_t d;
     pa_assert(bq);
     pa_assert(chunk);
@@ -484,12 +466,12 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
     fix_current_read(bq);
 
     /* Do we need to spit out silence? */
-    if (!bq->current_read || bq->current_read->index > bq->read_index) {
+    if (bq->current_read >= bq->n_blocks || entry(bq, bq->current_read)->index > bq->read_index) {
         size_t length;
 
         /* How much silence shall we return? */
-        if (bq->current_read)
-            length = (size_t) (bq->current_read->index - bq->read_index);
+        if (bq->current_read < bq->n_blocks)
+            length = (size_t) (entry(bq, bq->current_read)->index - bq->read_index);
         else if (bq->write_index > bq->read_index)
             length = (size_t) (bq->write_index - bq->read_index);
         else
@@ -519,11 +501,12 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
     }
 
     /* Ok, let's pass real data to the caller */
-    *chunk = bq->current_read->chunk;
+    e = entry(bq, bq->current_read);
+    *chunk = e->chunk;
     pa_memblock_ref(chunk->memblock);
 
-    pa_assert(bq->read_index >= bq->current_read->index);
-    d = bq->read_index - bq->current_read->index;
+    pa_assert(bq->read_index >= e->index);
+    d = bq->read_index - e->index;
     chunk->index += (size_t) d;
     chunk->length -= (size_t) d;
 
@@ -534,7 +517,7 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
     pa_mempool *pool;
     pa_memchunk tchunk, rchunk;
     int64_t ri;
-    struct list_item *item;
+    unsigned item;
 
     pa_assert(bq);
     pa_assert(block_size > 0);
@@ -568,25 +551,25 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
 
     while (rchunk.index < block_size) {
 
-        if (!item || item->index > ri) {
+        if (item >= bq->n_blocks || entry(bq, item)->index > ri) {
             /* Do we need to append silence? */
             tchunk = bq->silence;
 
-            if (item)
-                tchunk.length = PA_MIN(tchunk.length, (size_t) (item->index - ri));
+            if (item < bq->n_blocks)
+                tchunk.length = PA_MIN(tchunk.length, (size_t) (entry(bq, item)->index - ri));
 
         } else {
             int64_t d;
 
             /* We can append real data! */
-            tchunk = item->chunk;
+            tchunk = entry(bq, item)->chunk;
 
-            d = ri - item->index;
+            d = ri - entry(bq, item)->index;
             tchunk.index += (size_t) d;
             tchunk.length -= (size_t) d;
 
             /* Go to next item for the next iteration */
-            item = item->next;
+            item++;
         }
 
         rchunk.length = tchunk.length = PA_MIN(tchunk.length, block_size - rchunk.index);
@@ -618,13 +601,13 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
 
         fix_current_read(bq);
 
-        if (bq->current_read) {
+        if (bq->current_read < bq->n_blocks) {
             int64_t p, d;
 
             /* We go through this piece by piece to make sure we don't
              * drop more than allowed by prebuf */
 
-            p = bq->current_read->index + (int64_t) bq->current_read->chunk.length;
+            p = entry_end(entry(bq, bq->current_read));
             pa_assert(p >= bq->read_index);
             d = p - bq->read_index;
 
@@ -710,7 +693,7 @@ void pa_memblockq_seek(pa_memblockq *bq, int64_t offset, pa_seek_mode_t seek, bo
             bq->write_index = bq->read_index + offset;
             break;
         case PA_SEEK_RELATIVE_END:
-            bq->write_index = (bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->read_index) + offset;
+            bq->write_index = get_end(bq, bq->read_index) + offset;
             break;
         default:
             pa_assert_not_reached();
@@ -983,14 +966,14 @@ int pa_memblockq_splice(pa_memblockq *bq, pa_memblockq *source) {
 }
 
 void pa_memblockq_willneed(pa_memblockq *bq) {
-    struct list_item *q;
+    unsigned i;
 
     pa_assert(bq);
 
     fix_current_read(bq);
 
-    for (q = bq->current_read; q; q = q->next)
-        pa_memchunk_will_need(&q->chunk);
+    for (i = bq->current_read; i < bq->n_blocks; i++)
+        pa_memchunk_will_need(&entry(bq, i)->chunk);
 }
 
 void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
@@ -1009,14 +992,13 @@ void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
 bool pa_memblockq_is_empty(pa_memblockq *bq) {
     pa_assert(bq);
 
-    return !bq->blocks;
+    return bq->n_blocks == 0;
 }
 
 void pa_memblockq_silence(pa_memblockq *bq) {
     pa_assert(bq);
 
-    while (bq->blocks)
-        drop_block(bq, bq->blocks);
+    drop_blocks(bq, 0, bq->n_blocks);
 
     pa_assert(bq->n_blocks == 0);
 }
@@ -0,0 +1,215 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/macro.h>
+
+#include "memchunk-ring.h"
+
+/* A chunk to push, or a seek if memblock is NULL */
+struct op {
+    pa_memchunk chunk;
+    int64_t offset;
+    pa_seek_mode_t seek;
+};
+
+/* Ops that did not fit into the ring, only touched by the producer */
+struct localq {
+    struct op op;
+    PA_LLIST_FIELDS(struct localq);
+};
+
+struct pa_memchunk_ring {
+    unsigned size;
+    struct op *ops;
+
+    /* Number of filled slots, the only thing both sides write */
+    pa_atomic_t count;
+    pa_atomic_t wakeup;
+
+    unsigned read_idx;  /* consumer */
+    unsigned write_idx; /* producer */
+
+    PA_LLIST_HEAD(struct localq, localq);
+    struct localq *last_localq;
+};
+
+pa_memchunk_ring *pa_memchunk_ring_new(unsigned size) {
+    pa_memchunk_ring *r;
+
+    pa_assert(size > 0);
+
+    r = pa_xnew0(pa_memchunk_ring, 1);
+    r->size = size;
+    r->ops = pa_xnew0(struct op, size);
+    pa_atomic_store(&r->count, 0);
+    pa_atomic_store(&r->wakeup, 0);
+
+    PA_LLIST_HEAD_INIT(struct localq, r->localq);
+
+    return r;
+}
+
+static void op_done(struct op *op) {
+    if (op->chunk.memblock)
+        pa_memblock_unref(op->chunk.memblock);
+}
+
+void pa_memchunk_ring_free(pa_memchunk_ring *r) {
+    struct localq *q;
+    unsigned n;
+
+    pa_assert(r);
+
+    /* Both sides must be done with the ring by now */
+    for (n = pa_atomic_load(&r->count); n > 0; n--) {
+        op_done(&r->ops[r->read_idx]);
+        r->read_idx = (r->read_idx + 1) % r->size;
+    }
+
+    while ((q = r->localq)) {
+        op_done(&q->op);
+        PA_LLIST_REMOVE(struct localq, r->localq, q);
+        pa_xfree(q);
+    }
+
+    pa_xfree(r->ops);
+    pa_xfree(r);
+}
+
+/* Called from the producer. Moves as many ops as there is room for
+ * into the ring, starting with the ones left over from before, and
+ * then op if there is one. */
+static bool enqueue(pa_memchunk_ring *r, const struct op *op) {
+    unsigned room, n = 0;
+    struct localq *q;
+
+    room = r->size - (unsigned) pa_atomic_load(&r->count);
+
+    while (n < room && (q = r->last_localq)) {
+        r->ops[r->write_idx] = q->op;
+        r->write_idx = (r->write_idx + 1) % r->size;
+        n++;
+
+        r->last_localq = q->prev;
+        PA_LLIST_REMOVE(struct localq, r->localq, q);
+        pa_xfree(q);
+    }
+
+    if (op && n < room && !r->localq) {
+        r->ops[r->write_idx] = *op;
+        r->write_idx = (r->write_idx + 1) % r->size;
+        n++;
+    } else if (op) {
+        q = pa_xnew(struct localq, 1);
+        q->op = *op;
+        PA_LLIST_PREPEND(struct localq, r->localq, q);
+
+        if (!r->last_localq)
+            r->last_localq = q;
+    }
+
+    /* Publishes the slots written above, the atomic add is a full
+     * memory barrier */
+    if (n > 0)
+        pa_atomic_add(&r->count, (int) n);
+
+    /* A flush leaves a pending wakeup request to the next push */
+    return op && pa_atomic_cmpxchg(&r->wakeup, 1, 0);
+}
+
+bool pa_memchunk_ring_push(pa_memchunk_ring *r, const pa_memchunk *chunk) {
+    struct op op;
+
+    pa_assert(r);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    op.chunk = *chunk;
+    pa_memblock_ref(op.chunk.memblock);
+    op.offset = 0;
+    op.seek = PA_SEEK_RELATIVE;
+
+    return enqueue(r, &op);
+}
+
+bool pa_memchunk_ring_seek(pa_memchunk_ring *r, int64_t offset, pa_seek_mode_t seek) {
+    struct op op;
+
+    pa_assert(r);
+
+    pa_memchunk_reset(&op.chunk);
+    op.offset = offset;
+    op.seek = seek;
+
+    return enqueue(r, &op);
+}
+
+bool pa_memchunk_ring_flush(pa_memchunk_ring *r) {
+    pa_assert(r);
+
+    enqueue(r, NULL);
+
+    return !r->localq;
+}
+
+int64_t pa_memchunk_ring_drain(pa_memchunk_ring *r, pa_memblockq *bq) {
+    unsigned n, i;
+    int64_t bytes = 0;
+
+    pa_assert(r);
+    pa_assert(bq);
+
+    if ((n = (unsigned) pa_atomic_load(&r->count)) == 0)
+        return 0;
+
+    for (i = 0; i < n; i++) {
+        struct op *op = &r->ops[r->read_idx];
+
+        if (op->chunk.memblock) {
+            pa_memblockq_push_align(bq, &op->chunk);
+            bytes += (int64_t) op->chunk.length;
+
+            pa_memblock_unref(op->chunk.memblock);
+            pa_memchunk_reset(&op->chunk);
+        } else {
+            int64_t old = pa_memblockq_get_write_index(bq);
+
+            pa_memblockq_seek(bq, op->offset, op->seek, true);
+            bytes += pa_memblockq_get_write_index(bq) - old;
+        }
+
+        r->read_idx = (r->read_idx + 1) % r->size;
+    }
+
+    pa_atomic_sub(&r->count, (int) n);
+
+    return bytes;
+}
+
+void pa_memchunk_ring_request_wakeup(pa_memchunk_ring *r) {
+    pa_assert(r);
+
+    pa_atomic_store(&r->wakeup, 1);
+}
@@ -0,0 +1,62 @@
+#ifndef foopulsememchunkringhfoo
+#define foopulsememchunkringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/def.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/memchunk.h>
+
+/* A wait-free single producer, single consumer queue for passing audio
+ * from one IO thread to another, e.g. from a source output to a sink
+ * input. The producer pushes chunks and seeks, the consumer replays
+ * them in order into a pa_memblockq of its own, so the usual memblockq
+ * index, seek and rewind semantics apply on the consumer side.
+ *
+ * Unlike posting the chunks through a pa_asyncmsgq nothing is allocated
+ * per chunk and the consumer is not woken up for every one of them. If
+ * the fixed size ring is full, the producer keeps the remaining chunks
+ * to itself and moves them over with its next push or seek that finds
+ * room. That needs an allocation but never blocks. */
+
+typedef struct pa_memchunk_ring pa_memchunk_ring;
+
+pa_memchunk_ring *pa_memchunk_ring_new(unsigned size);
+void pa_memchunk_ring_free(pa_memchunk_ring *r);
+
+/* For the producer. Both return true if the consumer asked to be
+ * woken up by pa_memchunk_ring_request_wakeup(), which is then up to
+ * the caller. */
+bool pa_memchunk_ring_push(pa_memchunk_ring *r, const pa_memchunk *chunk);
+bool pa_memchunk_ring_seek(pa_memchunk_ring *r, int64_t offset, pa_seek_mode_t seek);
+
+/* For the producer. Moves left over chunks into the ring without
+ * pushing anything new. Returns true if none are left. */
+bool pa_memchunk_ring_flush(pa_memchunk_ring *r);
+
+/* For the consumer. Applies everything pushed so far to bq with
+ * pa_memblockq_push_align() and pa_memblockq_seek(). Returns the
+ * number of bytes pushed minus the number of bytes seeked back. */
+int64_t pa_memchunk_ring_drain(pa_memchunk_ring *r, pa_memblockq *bq);
+
+/* For the consumer. Makes the next push or seek return true. */
+void pa_memchunk_ring_request_wakeup(pa_memchunk_ring *r);
+
+#endif
@@ -628,7 +628,7 @@ size_t pa_mix(
     pa_assert(data);
     pa_assert(length);
     pa_assert(spec);
-    pa_assert(nstreams > 1);
+    pa_assert(nstreams > 0);
 
     if (!volume)
         volume = pa_cvolume_reset(&full_volume, spec->channels);
@@ -720,7 +720,9 @@ void pa_volume_memchunk(
 
     ptr = pa_memblock_acquire_chunk(c);
 
-    do_volume(ptr, (void *)linear, spec->channels, c->length);
+    /* With the same volume on all channels the frame layout does not
+     * matter, which saves the volume functions the channel bookkeeping */
+    do_volume(ptr, (void *)linear, pa_cvolume_channels_equal_to(volume, volume->values[0]) ? 1 : spec->channels, c->length);
 
     pa_memblock_release(c->memblock);
 }
@@ -0,0 +1,1379 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
+
+/* The optimized mixers work on blocks of MIX_BLOCK samples. Each stream is
+ * scaled and added to an accumulator (int32 for s16, int64 for s32 and
+ * s24-32, float for float32) one after the other, so that the inner loop is
+ * a plain vector loop over a single stream. The accumulator is then saturated
+ * and written to the output. Streams are summed in the same order and with
+ * the same arithmetic as the generic C code, so the results are identical. */
+#define MIX_BLOCK 512
+
+/* Per-stream volumes are laid out so that a full vector can be loaded at any
+ * channel offset: the volumes repeat with a period that is a multiple of the
+ * channel count and at least one vector wide, followed by one vector of
+ * overread. With at most 16 lanes this never exceeds 64 entries. */
+#define MIX_VOLUME_TABLE (PA_CHANNELS_MAX + 32)
+
+typedef void (*mix_accumulate_func_t) (void *acc, const void *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n);
+typedef void (*mix_store_func_t) (void *dst, const void *acc, pa_reg_x86 n);
+
+typedef struct mix_kernel {
+    unsigned width;         /* samples per vector */
+    mix_accumulate_func_t accumulate;
+    mix_store_func_t store;
+} mix_kernel;
+
+static const mix_kernel *kernels;
+
+static const PA_DECLARE_ALIGNED (32, uint8_t, swap16_mask[32]) = {
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+};
+
+static const PA_DECLARE_ALIGNED (32, uint8_t, swap32_mask[32]) = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+static const PA_DECLARE_ALIGNED (16, int64_t, s32_max[2]) = { 0x7FFFFFFFLL, 0x7FFFFFFFLL };
+static const PA_DECLARE_ALIGNED (16, int64_t, s32_min[2]) = { -0x80000000LL, -0x80000000LL };
+
+/* Sign bit of a 64 bit product after a logical shift right by 16. Used to
+ * emulate an arithmetic shift: ((x >>> 16) ^ m) - m */
+static const PA_DECLARE_ALIGNED (16, int64_t, sign47[2]) = { 1LL << 47, 1LL << 47 };
+
+/* channel += inc; if (channel >= period) channel -= period */
+#define NEXT_CHANNEL(inc)                                                   \
+      " add $"#inc", %2              \n\t"                                  \
+      " cmp %5, %2                   \n\t"                                  \
+      " jb 2f                        \n\t"                                  \
+      " sub %5, %2                   \n\t"                                  \
+      "2:                            \n\t"
+
+/* (p * v) >> 16 for 32 bit p in the s16 range and 32 bit v, split in a
+ * high and an unsigned low part of v like pa_mult_s16_volume():
+ * ((p * vl) >> 16) + p * vh. %%xmm7 holds 0x0000ffff in every lane. */
+#define MULT_S16_VOLUME_SSE                                                 \
+      " movdqu (%4, %2, 4), %%xmm1   \n\t" /* |  v3  ..  v0  | */           \
+      " movdqa %%xmm1, %%xmm2        \n\t"                                  \
+      " psrad $16, %%xmm2            \n\t" /* |  vh3 ..  vh0 | */           \
+      " pand %%xmm7, %%xmm1          \n\t" /* |  vl3 ..  vl0 | */           \
+      " pmulld %%xmm0, %%xmm1        \n\t"                                  \
+      " psrad $16, %%xmm1            \n\t" /* (p * vl) >> 16 */             \
+      " pmulld %%xmm0, %%xmm2        \n\t" /* p * vh */                     \
+      " paddd %%xmm1, %%xmm2         \n\t"
+
+static void mix_accumulate_s16ne_sse4(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " pcmpeqd %%xmm7, %%xmm7       \n\t"
+        " psrld $16, %%xmm7            \n\t"
+
+        "1:                            \n\t"
+        " pmovsxwd (%1), %%xmm0        \n\t" /* |  p3  ..  p0  | */
+        MULT_S16_VOLUME_SSE
+        " paddd (%0), %%xmm2           \n\t"
+        " movdqa %%xmm2, (%0)          \n\t"
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm7"
+    );
+}
+
+static void mix_accumulate_s16re_sse4(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " pcmpeqd %%xmm7, %%xmm7       \n\t"
+        " psrld $16, %%xmm7            \n\t"
+        " movdqa %6, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movq (%1), %%xmm0            \n\t"
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " pmovsxwd %%xmm0, %%xmm0      \n\t" /* |  p3  ..  p0  | */
+        MULT_S16_VOLUME_SSE
+        " paddd (%0), %%xmm2           \n\t"
+        " movdqa %%xmm2, (%0)          \n\t"
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s16ne_sse4(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        " packssdw %%xmm0, %%xmm0      \n\t" /* saturate to s16 */
+        " movq %%xmm0, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $4, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        :
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_store_s16re_sse4(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        " packssdw %%xmm0, %%xmm0      \n\t" /* saturate to s16 */
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " movq %%xmm0, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $4, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+/* (p * v) >> 16 on two 64 bit lanes, p sign extended in %%xmm0. %%xmm5
+ * holds the sign bit used for the arithmetic shift. */
+#define MULT_S32_VOLUME_SSE                                                 \
+      " pmovsxdq (%4, %2, 4), %%xmm1 \n\t" /* |  v1  |  v0  | */            \
+      " pmuldq %%xmm1, %%xmm0        \n\t" /* |  p1*v1 |  p0*v0  | */       \
+      " psrlq $16, %%xmm0            \n\t"                                  \
+      " pxor %%xmm5, %%xmm0          \n\t"                                  \
+      " psubq %%xmm5, %%xmm0         \n\t" /* >> 16, sign extended */       \
+      " paddq (%0), %%xmm0           \n\t"                                  \
+      " movdqa %%xmm0, (%0)          \n\t"
+
+static void mix_accumulate_s32ne_sse4(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %6, %%xmm5            \n\t"
+
+        "1:                            \n\t"
+        " pmovsxdq (%1), %%xmm0        \n\t" /* |  p1  |  p0  | */
+        MULT_S32_VOLUME_SSE
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(2)
+        " sub $2, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5"
+    );
+}
+
+static void mix_accumulate_s32re_sse4(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %6, %%xmm5            \n\t"
+        " movdqa %7, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movq (%1), %%xmm0            \n\t"
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " pmovsxdq %%xmm0, %%xmm0      \n\t" /* |  p1  |  p0  | */
+        MULT_S32_VOLUME_SSE
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(2)
+        " sub $2, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6"
+    );
+}
+
+static void mix_accumulate_s24_32ne_sse4(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %6, %%xmm5            \n\t"
+
+        "1:                            \n\t"
+        " movq (%1), %%xmm0            \n\t"
+        " pslld $8, %%xmm0             \n\t" /* s24 to s32 */
+        " pmovsxdq %%xmm0, %%xmm0      \n\t" /* |  p1  |  p0  | */
+        MULT_S32_VOLUME_SSE
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(2)
+        " sub $2, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5"
+    );
+}
+
+static void mix_accumulate_s24_32re_sse4(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %6, %%xmm5            \n\t"
+        " movdqa %7, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movq (%1), %%xmm0            \n\t"
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " pslld $8, %%xmm0             \n\t" /* s24 to s32 */
+        " pmovsxdq %%xmm0, %%xmm0      \n\t" /* |  p1  |  p0  | */
+        MULT_S32_VOLUME_SSE
+        " add $8, %1                   \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(2)
+        " sub $2, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6"
+    );
+}
+
+/* Saturate two 64 bit sums in %%xmm0 to s32 in the low half of %%xmm2.
+ * %%xmm6 and %%xmm7 hold the maximum and minimum. pcmpgtq is SSE4.2. */
+#define CLAMP_S32_SSE                                                       \
+      " movdqa %%xmm0, %%xmm1        \n\t"                                  \
+      " pcmpgtq %%xmm6, %%xmm1       \n\t" /* x > max */                    \
+      " movdqa %%xmm1, %%xmm2        \n\t"                                  \
+      " pand %%xmm6, %%xmm2          \n\t"                                  \
+      " pandn %%xmm0, %%xmm1         \n\t"                                  \
+      " por %%xmm2, %%xmm1           \n\t" /* x = min(x, max) */            \
+      " movdqa %%xmm7, %%xmm2        \n\t"                                  \
+      " pcmpgtq %%xmm1, %%xmm2       \n\t" /* min > x */                    \
+      " movdqa %%xmm2, %%xmm0        \n\t"                                  \
+      " pand %%xmm7, %%xmm0          \n\t"                                  \
+      " pandn %%xmm1, %%xmm2         \n\t"                                  \
+      " por %%xmm0, %%xmm2           \n\t" /* x = max(x, min) */            \
+      " pshufd $0x08, %%xmm2, %%xmm2 \n\t" /* |  ..  |  x1  |  x0  | */
+
+static void mix_store_s32ne_sse4(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+        " movdqa %4, %%xmm7            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        CLAMP_S32_SSE
+        " movq %%xmm2, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $2, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s32re_sse4(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+        " movdqa %4, %%xmm7            \n\t"
+        " movdqa %5, %%xmm5            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        CLAMP_S32_SSE
+        " pshufb %%xmm5, %%xmm2        \n\t" /* swap bytes */
+        " movq %%xmm2, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $2, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s24_32ne_sse4(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+        " movdqa %4, %%xmm7            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        CLAMP_S32_SSE
+        " psrld $8, %%xmm2             \n\t" /* s32 to s24 */
+        " movq %%xmm2, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $2, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s24_32re_sse4(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+        " movdqa %4, %%xmm7            \n\t"
+        " movdqa %5, %%xmm5            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        CLAMP_S32_SSE
+        " psrld $8, %%xmm2             \n\t" /* s32 to s24 */
+        " pshufb %%xmm5, %%xmm2        \n\t" /* swap bytes */
+        " movq %%xmm2, (%0)            \n\t"
+        " add $16, %1                  \n\t"
+        " add $8, %0                   \n\t"
+        " sub $2, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+static void mix_accumulate_float32ne_sse4(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                            \n\t"
+        " movups (%1), %%xmm0          \n\t"
+        " movups (%4, %2, 4), %%xmm1   \n\t"
+        " mulps %%xmm1, %%xmm0         \n\t"
+        " addps (%0), %%xmm0           \n\t"
+        " movaps %%xmm0, (%0)          \n\t"
+        " add $16, %1                  \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1"
+    );
+}
+
+static void mix_accumulate_float32re_sse4(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %6, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movdqu (%1), %%xmm0          \n\t"
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " movups (%4, %2, 4), %%xmm1   \n\t"
+        " mulps %%xmm1, %%xmm0         \n\t"
+        " addps (%0), %%xmm0           \n\t"
+        " movaps %%xmm0, (%0)          \n\t"
+        " add $16, %1                  \n\t"
+        " add $16, %0                  \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6"
+    );
+}
+
+static void mix_store_float32ne_sse4(float *dst, const float *acc, pa_reg_x86 n) {
+    memcpy(dst, acc, n * sizeof(float));
+}
+
+static void mix_store_float32re_sse4(float *dst, const float *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " movdqa %3, %%xmm6            \n\t"
+
+        "1:                            \n\t"
+        " movdqa (%1), %%xmm0          \n\t"
+        " pshufb %%xmm6, %%xmm0        \n\t" /* swap bytes */
+        " movdqu %%xmm0, (%0)          \n\t"
+        " add $16, %1                  \n\t"
+        " add $16, %0                  \n\t"
+        " sub $4, %2                   \n\t"
+        " jne 1b                       \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+/* AVX2 versions of the above, twice the width. vzeroupper avoids the
+ * AVX to SSE transition penalty in the code that follows. */
+
+#define MULT_S16_VOLUME_AVX2                                                \
+      " vmovdqu (%4, %2, 4), %%ymm1          \n\t"                          \
+      " vpsrad $16, %%ymm1, %%ymm2           \n\t" /* vh */                 \
+      " vpand %%ymm7, %%ymm1, %%ymm1         \n\t" /* vl */                 \
+      " vpmulld %%ymm0, %%ymm1, %%ymm1       \n\t"                          \
+      " vpsrad $16, %%ymm1, %%ymm1           \n\t" /* (p * vl) >> 16 */     \
+      " vpmulld %%ymm0, %%ymm2, %%ymm2       \n\t" /* p * vh */             \
+      " vpaddd %%ymm1, %%ymm2, %%ymm2        \n\t"                          \
+      " vpaddd (%0), %%ymm2, %%ymm2          \n\t"                          \
+      " vmovdqa %%ymm2, (%0)                 \n\t"
+
+static void mix_accumulate_s16ne_avx2(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpcmpeqd %%ymm7, %%ymm7, %%ymm7    \n\t"
+        " vpsrld $16, %%ymm7, %%ymm7         \n\t"
+
+        "1:                                  \n\t"
+        " vpmovsxwd (%1), %%ymm0             \n\t"
+        MULT_S16_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm7"
+    );
+}
+
+static void mix_accumulate_s16re_avx2(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpcmpeqd %%ymm7, %%ymm7, %%ymm7    \n\t"
+        " vpsrld $16, %%ymm7, %%ymm7         \n\t"
+        " vmovdqa %6, %%xmm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%xmm0               \n\t"
+        " vpshufb %%xmm6, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vpmovsxwd %%xmm0, %%ymm0           \n\t"
+        MULT_S16_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s16ne_avx2(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        " vextracti128 $1, %%ymm0, %%xmm1    \n\t"
+        " vpackssdw %%xmm1, %%xmm0, %%xmm0   \n\t" /* saturate to s16 */
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        :
+        : "cc", "memory", "xmm0", "xmm1"
+    );
+}
+
+static void mix_store_s16re_avx2(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %3, %%xmm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        " vextracti128 $1, %%ymm0, %%xmm1    \n\t"
+        " vpackssdw %%xmm1, %%xmm0, %%xmm0   \n\t" /* saturate to s16 */
+        " vpshufb %%xmm6, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6"
+    );
+}
+
+#define MULT_S32_VOLUME_AVX2                                                \
+      " vpmovsxdq (%4, %2, 4), %%ymm1        \n\t"                          \
+      " vpmuldq %%ymm1, %%ymm0, %%ymm0       \n\t"                          \
+      " vpsrlq $16, %%ymm0, %%ymm0           \n\t"                          \
+      " vpxor %%ymm5, %%ymm0, %%ymm0         \n\t"                          \
+      " vpsubq %%ymm5, %%ymm0, %%ymm0        \n\t" /* >> 16, sign extended */ \
+      " vpaddq (%0), %%ymm0, %%ymm0          \n\t"                          \
+      " vmovdqa %%ymm0, (%0)                 \n\t"
+
+static void mix_accumulate_s32ne_avx2(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %6, %%ymm5            \n\t"
+
+        "1:                                  \n\t"
+        " vpmovsxdq (%1), %%ymm0             \n\t"
+        MULT_S32_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5"
+    );
+}
+
+static void mix_accumulate_s32re_avx2(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %6, %%ymm5            \n\t"
+        " vmovdqa %7, %%xmm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%xmm0               \n\t"
+        " vpshufb %%xmm6, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vpmovsxdq %%xmm0, %%ymm0           \n\t"
+        MULT_S32_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6"
+    );
+}
+
+static void mix_accumulate_s24_32ne_avx2(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %6, %%ymm5            \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%xmm0               \n\t"
+        " vpslld $8, %%xmm0, %%xmm0          \n\t" /* s24 to s32 */
+        " vpmovsxdq %%xmm0, %%ymm0           \n\t"
+        MULT_S32_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5"
+    );
+}
+
+static void mix_accumulate_s24_32re_avx2(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %6, %%ymm5            \n\t"
+        " vmovdqa %7, %%xmm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%xmm0               \n\t"
+        " vpshufb %%xmm6, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vpslld $8, %%xmm0, %%xmm0          \n\t" /* s24 to s32 */
+        " vpmovsxdq %%xmm0, %%ymm0           \n\t"
+        MULT_S32_VOLUME_AVX2
+        " add $16, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(4)
+        " sub $4, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*sign47), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6"
+    );
+}
+
+/* Saturate four 64 bit sums in %%ymm0 to s32 in %%xmm0. %%ymm6 and %%ymm7
+ * hold the maximum and minimum. */
+#define CLAMP_S32_AVX2                                                      \
+      " vpcmpgtq %%ymm6, %%ymm0, %%ymm1      \n\t" /* x > max */            \
+      " vpblendvb %%ymm1, %%ymm6, %%ymm0, %%ymm0 \n\t"                      \
+      " vpcmpgtq %%ymm0, %%ymm7, %%ymm1      \n\t" /* min > x */            \
+      " vpblendvb %%ymm1, %%ymm7, %%ymm0, %%ymm0 \n\t"                      \
+      " vpshufd $0x08, %%ymm0, %%ymm0        \n\t"                          \
+      " vpermq $0x08, %%ymm0, %%ymm0         \n\t" /* |  x3 .. x0  | */
+
+static void mix_store_s32ne_avx2(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %3, %%ymm6            \n\t"
+        " vpbroadcastq %4, %%ymm7            \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        CLAMP_S32_AVX2
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $4, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s32re_avx2(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %3, %%ymm6            \n\t"
+        " vpbroadcastq %4, %%ymm7            \n\t"
+        " vmovdqa %5, %%xmm5                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        CLAMP_S32_AVX2
+        " vpshufb %%xmm5, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $4, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s24_32ne_avx2(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %3, %%ymm6            \n\t"
+        " vpbroadcastq %4, %%ymm7            \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        CLAMP_S32_AVX2
+        " vpsrld $8, %%xmm0, %%xmm0          \n\t" /* s32 to s24 */
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $4, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s24_32re_avx2(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpbroadcastq %3, %%ymm6            \n\t"
+        " vpbroadcastq %4, %%ymm7            \n\t"
+        " vmovdqa %5, %%xmm5                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        CLAMP_S32_AVX2
+        " vpsrld $8, %%xmm0, %%xmm0          \n\t" /* s32 to s24 */
+        " vpshufb %%xmm5, %%xmm0, %%xmm0     \n\t" /* swap bytes */
+        " vmovdqu %%xmm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $16, %0                        \n\t"
+        " sub $4, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*s32_max), "m" (*s32_min), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+static void mix_accumulate_float32ne_avx2(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovups (%1), %%ymm0               \n\t"
+        " vmulps (%4, %2, 4), %%ymm0, %%ymm0 \n\t"
+        " vaddps (%0), %%ymm0, %%ymm0        \n\t"
+        " vmovaps %%ymm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_accumulate_float32re_avx2(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %6, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%ymm0               \n\t"
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vmulps (%4, %2, 4), %%ymm0, %%ymm0 \n\t"
+        " vaddps (%0), %%ymm0, %%ymm0        \n\t"
+        " vmovaps %%ymm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+static void mix_store_float32re_avx2(float *dst, const float *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %3, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa (%1), %%ymm0               \n\t"
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vmovdqu %%ymm0, (%0)               \n\t"
+        " add $32, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+/* AVX-512 versions. Saturating down-conversions (vpmovsdw, vpmovsqd) and
+ * the 64 bit arithmetic shift make these simpler than the AVX2 ones. The
+ * byte swapping variants need AVX512BW for vpshufb on 512 bit registers. */
+
+#define MULT_S16_VOLUME_AVX512                                              \
+      " vmovdqu32 (%4, %2, 4), %%zmm1        \n\t"                          \
+      " vpsrad $16, %%zmm1, %%zmm2           \n\t" /* vh */                 \
+      " vpandd %%zmm7, %%zmm1, %%zmm1        \n\t" /* vl */                 \
+      " vpmulld %%zmm0, %%zmm1, %%zmm1       \n\t"                          \
+      " vpsrad $16, %%zmm1, %%zmm1           \n\t" /* (p * vl) >> 16 */     \
+      " vpmulld %%zmm0, %%zmm2, %%zmm2       \n\t" /* p * vh */             \
+      " vpaddd %%zmm1, %%zmm2, %%zmm2        \n\t"                          \
+      " vpaddd (%0), %%zmm2, %%zmm2          \n\t"                          \
+      " vmovdqa32 %%zmm2, (%0)               \n\t"
+
+static void mix_accumulate_s16ne_avx512(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpternlogd $0xff, %%zmm7, %%zmm7, %%zmm7 \n\t"
+        " vpsrld $16, %%zmm7, %%zmm7         \n\t"
+
+        "1:                                  \n\t"
+        " vpmovsxwd (%1), %%zmm0             \n\t"
+        MULT_S16_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(16)
+        " sub $16, %3                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm7"
+    );
+}
+
+static void mix_accumulate_s16re_avx512(int32_t *acc, const int16_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vpternlogd $0xff, %%zmm7, %%zmm7, %%zmm7 \n\t"
+        " vpsrld $16, %%zmm7, %%zmm7         \n\t"
+        " vmovdqa %6, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%ymm0               \n\t"
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vpmovsxwd %%ymm0, %%zmm0           \n\t"
+        MULT_S16_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(16)
+        " sub $16, %3                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+    );
+}
+
+static void mix_store_s16ne_avx512(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovdqa32 (%1), %%zmm0             \n\t"
+        " vpmovsdw %%zmm0, (%0)              \n\t" /* saturate to s16 */
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $16, %2                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        :
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_store_s16re_avx512(int16_t *dst, const int32_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %3, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa32 (%1), %%zmm0             \n\t"
+        " vpmovsdw %%zmm0, %%ymm0            \n\t" /* saturate to s16 */
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vmovdqu %%ymm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $16, %2                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap16_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+#define MULT_S32_VOLUME_AVX512                                              \
+      " vpmovsxdq (%4, %2, 4), %%zmm1        \n\t"                          \
+      " vpmuldq %%zmm1, %%zmm0, %%zmm0       \n\t"                          \
+      " vpsraq $16, %%zmm0, %%zmm0           \n\t"                          \
+      " vpaddq (%0), %%zmm0, %%zmm0          \n\t"                          \
+      " vmovdqa64 %%zmm0, (%0)               \n\t"
+
+static void mix_accumulate_s32ne_avx512(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vpmovsxdq (%1), %%zmm0             \n\t"
+        MULT_S32_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1"
+    );
+}
+
+static void mix_accumulate_s32re_avx512(int64_t *acc, const int32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %6, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%ymm0               \n\t"
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vpmovsxdq %%ymm0, %%zmm0           \n\t"
+        MULT_S32_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6"
+    );
+}
+
+static void mix_accumulate_s24_32ne_avx512(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%ymm0               \n\t"
+        " vpslld $8, %%ymm0, %%ymm0          \n\t" /* s24 to s32 */
+        " vpmovsxdq %%ymm0, %%zmm0           \n\t"
+        MULT_S32_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0", "xmm1"
+    );
+}
+
+static void mix_accumulate_s24_32re_avx512(int64_t *acc, const uint32_t *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %6, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu (%1), %%ymm0               \n\t"
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vpslld $8, %%ymm0, %%ymm0          \n\t" /* s24 to s32 */
+        " vpmovsxdq %%ymm0, %%zmm0           \n\t"
+        MULT_S32_VOLUME_AVX512
+        " add $32, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(8)
+        " sub $8, %3                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm6"
+    );
+}
+
+static void mix_store_s32ne_avx512(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovdqa64 (%1), %%zmm0             \n\t"
+        " vpmovsqd %%zmm0, (%0)              \n\t" /* saturate to s32 */
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        :
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_store_s32re_avx512(int32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %3, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa64 (%1), %%zmm0             \n\t"
+        " vpmovsqd %%zmm0, %%ymm0            \n\t" /* saturate to s32 */
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vmovdqu %%ymm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+static void mix_store_s24_32ne_avx512(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovdqa64 (%1), %%zmm0             \n\t"
+        " vpmovsqd %%zmm0, %%ymm0            \n\t" /* saturate to s32 */
+        " vpsrld $8, %%ymm0, %%ymm0          \n\t" /* s32 to s24 */
+        " vmovdqu %%ymm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        :
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_store_s24_32re_avx512(uint32_t *dst, const int64_t *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vmovdqa %3, %%ymm6                 \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa64 (%1), %%zmm0             \n\t"
+        " vpmovsqd %%zmm0, %%ymm0            \n\t" /* saturate to s32 */
+        " vpsrld $8, %%ymm0, %%ymm0          \n\t" /* s32 to s24 */
+        " vpshufb %%ymm6, %%ymm0, %%ymm0     \n\t" /* swap bytes */
+        " vmovdqu %%ymm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $32, %0                        \n\t"
+        " sub $8, %2                         \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+static void mix_accumulate_float32ne_avx512(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        "1:                                  \n\t"
+        " vmovups (%1), %%zmm0               \n\t"
+        " vmulps (%4, %2, 4), %%zmm0, %%zmm0 \n\t"
+        " vaddps (%0), %%zmm0, %%zmm0        \n\t"
+        " vmovaps %%zmm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(16)
+        " sub $16, %3                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period)
+        : "cc", "memory", "xmm0"
+    );
+}
+
+static void mix_accumulate_float32re_avx512(float *acc, const float *src, const int32_t *volumes, pa_reg_x86 channel, pa_reg_x86 period, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vbroadcasti32x4 %6, %%zmm6         \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqu32 (%1), %%zmm0             \n\t"
+        " vpshufb %%zmm6, %%zmm0, %%zmm0     \n\t" /* swap bytes */
+        " vmulps (%4, %2, 4), %%zmm0, %%zmm0 \n\t"
+        " vaddps (%0), %%zmm0, %%zmm0        \n\t"
+        " vmovaps %%zmm0, (%0)               \n\t"
+        " add $64, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        NEXT_CHANNEL(16)
+        " sub $16, %3                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (acc), "+r" (src), "+r" (channel), "+r" (n)
+        : "r" (volumes), "r" (period), "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+static void mix_store_float32re_avx512(float *dst, const float *acc, pa_reg_x86 n) {
+    __asm__ __volatile__ (
+        " vbroadcasti32x4 %3, %%zmm6         \n\t"
+
+        "1:                                  \n\t"
+        " vmovdqa32 (%1), %%zmm0             \n\t"
+        " vpshufb %%zmm6, %%zmm0, %%zmm0     \n\t" /* swap bytes */
+        " vmovdqu32 %%zmm0, (%0)             \n\t"
+        " add $64, %1                        \n\t"
+        " add $64, %0                        \n\t"
+        " sub $16, %2                        \n\t"
+        " jne 1b                             \n\t"
+        " vzeroupper                         \n\t"
+
+        : "+r" (dst), "+r" (acc), "+r" (n)
+        : "m" (*swap32_mask)
+        : "cc", "memory", "xmm0", "xmm6"
+    );
+}
+
+#define MIX_KERNEL(f, w, accumulate, store)                                 \
+    [f] = { w, (mix_accumulate_func_t) accumulate, (mix_store_func_t) store }
+
+/* The s32 and s24-32 SSE kernels use pcmpgtq from SSE4.2 and are only
+ * registered when it is available. */
+static const mix_kernel kernels_sse4[PA_SAMPLE_MAX] = {
+    MIX_KERNEL(PA_SAMPLE_S16NE, 4, mix_accumulate_s16ne_sse4, mix_store_s16ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_S16RE, 4, mix_accumulate_s16re_sse4, mix_store_s16re_sse4),
+    MIX_KERNEL(PA_SAMPLE_S32NE, 2, mix_accumulate_s32ne_sse4, mix_store_s32ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_S32RE, 2, mix_accumulate_s32re_sse4, mix_store_s32re_sse4),
+    MIX_KERNEL(PA_SAMPLE_S24_32NE, 2, mix_accumulate_s24_32ne_sse4, mix_store_s24_32ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_S24_32RE, 2, mix_accumulate_s24_32re_sse4, mix_store_s24_32re_sse4),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32NE, 4, mix_accumulate_float32ne_sse4, mix_store_float32ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32RE, 4, mix_accumulate_float32re_sse4, mix_store_float32re_sse4)
+};
+
+static const mix_kernel kernels_avx2[PA_SAMPLE_MAX] = {
+    MIX_KERNEL(PA_SAMPLE_S16NE, 8, mix_accumulate_s16ne_avx2, mix_store_s16ne_avx2),
+    MIX_KERNEL(PA_SAMPLE_S16RE, 8, mix_accumulate_s16re_avx2, mix_store_s16re_avx2),
+    MIX_KERNEL(PA_SAMPLE_S32NE, 4, mix_accumulate_s32ne_avx2, mix_store_s32ne_avx2),
+    MIX_KERNEL(PA_SAMPLE_S32RE, 4, mix_accumulate_s32re_avx2, mix_store_s32re_avx2),
+    MIX_KERNEL(PA_SAMPLE_S24_32NE, 4, mix_accumulate_s24_32ne_avx2, mix_store_s24_32ne_avx2),
+    MIX_KERNEL(PA_SAMPLE_S24_32RE, 4, mix_accumulate_s24_32re_avx2, mix_store_s24_32re_avx2),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32NE, 8, mix_accumulate_float32ne_avx2, mix_store_float32ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32RE, 8, mix_accumulate_float32re_avx2, mix_store_float32re_avx2)
+};
+
+static const mix_kernel kernels_avx512[PA_SAMPLE_MAX] = {
+    MIX_KERNEL(PA_SAMPLE_S16NE, 16, mix_accumulate_s16ne_avx512, mix_store_s16ne_avx512),
+    MIX_KERNEL(PA_SAMPLE_S16RE, 16, mix_accumulate_s16re_avx512, mix_store_s16re_avx512),
+    MIX_KERNEL(PA_SAMPLE_S32NE, 8, mix_accumulate_s32ne_avx512, mix_store_s32ne_avx512),
+    MIX_KERNEL(PA_SAMPLE_S32RE, 8, mix_accumulate_s32re_avx512, mix_store_s32re_avx512),
+    MIX_KERNEL(PA_SAMPLE_S24_32NE, 8, mix_accumulate_s24_32ne_avx512, mix_store_s24_32ne_avx512),
+    MIX_KERNEL(PA_SAMPLE_S24_32RE, 8, mix_accumulate_s24_32re_avx512, mix_store_s24_32re_avx512),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32NE, 16, mix_accumulate_float32ne_avx512, mix_store_float32ne_sse4),
+    MIX_KERNEL(PA_SAMPLE_FLOAT32RE, 16, mix_accumulate_float32re_avx512, mix_store_float32re_avx512)
+};
+
+/* Scalar code for the samples left over after the vector loop, doing
+ * exactly what the generic C mixers in mix.c do per sample. */
+static void accumulate_remainder(pa_sample_format_t f, void *acc, const void *src, const pa_mix_info *m, unsigned channel, unsigned channels, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        int32_t cv = m->linear[channel].i;
+
+        switch (f) {
+            case PA_SAMPLE_S16NE:
+                ((int32_t*) acc)[i] += pa_mult_s16_volume(((const int16_t*) src)[i], cv);
+                break;
+            case PA_SAMPLE_S16RE:
+                ((int32_t*) acc)[i] += pa_mult_s16_volume(PA_INT16_SWAP(((const int16_t*) src)[i]), cv);
+                break;
+            case PA_SAMPLE_S32NE:
+                ((int64_t*) acc)[i] += ((int64_t) ((const int32_t*) src)[i] * cv) >> 16;
+                break;
+            case PA_SAMPLE_S32RE:
+                ((int64_t*) acc)[i] += ((int64_t) PA_INT32_SWAP(((const int32_t*) src)[i]) * cv) >> 16;
+                break;
+            case PA_SAMPLE_S24_32NE:
+                ((int64_t*) acc)[i] += ((int64_t) (int32_t) (((const uint32_t*) src)[i] << 8) * cv) >> 16;
+                break;
+            case PA_SAMPLE_S24_32RE:
+                ((int64_t*) acc)[i] += ((int64_t) (int32_t) (PA_UINT32_SWAP(((const uint32_t*) src)[i]) << 8) * cv) >> 16;
+                break;
+            case PA_SAMPLE_FLOAT32NE:
+                ((float*) acc)[i] += ((const float*) src)[i] * m->linear[channel].f;
+                break;
+            case PA_SAMPLE_FLOAT32RE:
+                ((float*) acc)[i] += PA_READ_FLOAT32RE((const float*) src + i) * m->linear[channel].f;
+                break;
+            default:
+                pa_assert_not_reached();
+        }
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void store_remainder(pa_sample_format_t f, void *dst, const void *acc, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        switch (f) {
+            case PA_SAMPLE_S16NE:
+                ((int16_t*) dst)[i] = PA_CLAMP_UNLIKELY(((const int32_t*) acc)[i], -0x8000, 0x7FFF);
+                break;
+            case PA_SAMPLE_S16RE:
+                ((int16_t*) dst)[i] = PA_INT16_SWAP((int16_t) PA_CLAMP_UNLIKELY(((const int32_t*) acc)[i], -0x8000, 0x7FFF));
+                break;
+            case PA_SAMPLE_S32NE:
+                ((int32_t*) dst)[i] = (int32_t) PA_CLAMP_UNLIKELY(((const int64_t*) acc)[i], -0x80000000LL, 0x7FFFFFFFLL);
+                break;
+            case PA_SAMPLE_S32RE:
+                ((int32_t*) dst)[i] = PA_INT32_SWAP((int32_t) PA_CLAMP_UNLIKELY(((const int64_t*) acc)[i], -0x80000000LL, 0x7FFFFFFFLL));
+                break;
+            case PA_SAMPLE_S24_32NE:
+                ((uint32_t*) dst)[i] = ((uint32_t) (int32_t) PA_CLAMP_UNLIKELY(((const int64_t*) acc)[i], -0x80000000LL, 0x7FFFFFFFLL)) >> 8;
+                break;
+            case PA_SAMPLE_S24_32RE:
+                ((uint32_t*) dst)[i] = PA_UINT32_SWAP(((uint32_t) (int32_t) PA_CLAMP_UNLIKELY(((const int64_t*) acc)[i], -0x80000000LL, 0x7FFFFFFFLL)) >> 8);
+                break;
+            case PA_SAMPLE_FLOAT32NE:
+                ((float*) dst)[i] = ((const float*) acc)[i];
+                break;
+            case PA_SAMPLE_FLOAT32RE:
+                PA_WRITE_FLOAT32RE((float*) dst + i, ((const float*) acc)[i]);
+                break;
+            default:
+                pa_assert_not_reached();
+        }
+    }
+}
+
+static bool stream_is_silent(const pa_mix_info *m, unsigned channels) {
+    unsigned c;
+
+    for (c = 0; c < channels; c++)
+        if (m->linear[c].i != 0)
+            return false;
+
+    return true;
+}
+
+static void mix_blocks(pa_sample_format_t f, pa_mix_info streams[], unsigned nstreams, unsigned channels, uint8_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(64, uint8_t, acc[MIX_BLOCK * sizeof(int64_t)]);
+    int32_t volumes[MIX_VOLUME_TABLE];
+    const mix_kernel *k = &kernels[f];
+    size_t ss, as;
+    unsigned period, nsamples, offset;
+
+    ss = pa_sample_size_of_format(f);
+    as = (ss == sizeof(int16_t)) ? sizeof(int32_t) : (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) ? sizeof(float) : sizeof(int64_t);
+
+    /* Smallest multiple of the channel count that is at least one vector */
+    period = channels * ((k->width + channels - 1) / channels);
+    pa_assert(period + k->width <= MIX_VOLUME_TABLE);
+
+    nsamples = length / ss;
+
+    for (offset = 0; offset < nsamples; offset += MIX_BLOCK) {
+        unsigned n = PA_MIN(nsamples - offset, MIX_BLOCK);
+        unsigned nvec = n & ~(k->width - 1);
+        unsigned channel = offset % channels;
+        unsigned i;
+
+        memset(acc, 0, n * as);
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            if (!stream_is_silent(m, channels)) {
+                if (nvec > 0) {
+                    unsigned j, c = 0;
+
+                    for (j = 0; j < period + k->width; j++) {
+                        volumes[j] = m->linear[c].i;
+
+                        if (PA_UNLIKELY(++c >= channels))
+                            c = 0;
+                    }
+
+                    k->accumulate(acc, m->ptr, volumes, channel, period, nvec);
+                }
+
+                accumulate_remainder(f, acc + nvec * as, (uint8_t*) m->ptr + nvec * ss, m, (channel + nvec) % channels, channels, n - nvec);
+            }
+
+            m->ptr = (uint8_t*) m->ptr + n * ss;
+        }
+
+        if (nvec > 0)
+            k->store(data, acc, nvec);
+        store_remainder(f, data + nvec * ss, acc + nvec * as, n - nvec);
+
+        data += n * ss;
+    }
+}
+
+static void pa_mix_s16ne_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S16NE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_s16re_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S16RE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_s32ne_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S32NE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_s32re_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S32RE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_s24_32ne_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S24_32NE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_s24_32re_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_S24_32RE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_float32ne_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_FLOAT32NE, streams, nstreams, channels, data, length);
+}
+
+static void pa_mix_float32re_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    mix_blocks(PA_SAMPLE_FLOAT32RE, streams, nstreams, channels, data, length);
+}
+
+#endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
+    bool s32 = true;
+
+    if ((flags & PA_CPU_X86_AVX512F) && (flags & PA_CPU_X86_AVX512BW)) {
+        pa_log_info("Initialising AVX-512 optimized mixing functions.");
+        kernels = kernels_avx512;
+    } else if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+        kernels = kernels_avx2;
+    } else if ((flags & PA_CPU_X86_SSE4_1) && (flags & PA_CPU_X86_SSSE3)) {
+        pa_log_info("Initialising SSE4 optimized mixing functions.");
+        kernels = kernels_sse4;
+        s32 = !!(flags & PA_CPU_X86_SSE4_2);
+    } else
+        return;
+
+    pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse);
+    pa_set_mix_func(PA_SAMPLE_S16RE, (pa_do_mix_func_t) pa_mix_s16re_sse);
+    pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse);
+    pa_set_mix_func(PA_SAMPLE_FLOAT32RE, (pa_do_mix_func_t) pa_mix_float32re_sse);
+
+    if (s32) {
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse);
+        pa_set_mix_func(PA_SAMPLE_S32RE, (pa_do_mix_func_t) pa_mix_s32re_sse);
+        pa_set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) pa_mix_s24_32ne_sse);
+        pa_set_mix_func(PA_SAMPLE_S24_32RE, (pa_do_mix_func_t) pa_mix_s24_32re_sse);
+    }
+#endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
+}
@@ -26,6 +26,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
 #include <pulsecore/tagstruct.h>
 
 #include "native-common.h"
@@ -36,7 +37,7 @@
 
 /* Check pa_pstream_register_memfd_mempool() for further details */
 int pa_common_command_register_memfd_shmid(pa_pstream *p, pa_pdispatch *pd, uint32_t version,
-                                           uint32_t command, pa_tagstruct *t) {
+                                           uint32_t command, uint32_t tag, pa_tagstruct *t) {
 #if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
     pa_cmsg_ancil_data *ancil = NULL;
     unsigned shm_id;
@@ -64,7 +65,10 @@ int pa_common_command_register_memfd_shmid(pa_pstream *p, pa_pdispatch *pd, uint
     if (version < 31 || pa_tagstruct_getu32(t, &shm_id) < 0 || !pa_tagstruct_eof(t))
         goto finish;
 
-    pa_pstream_attach_memfd_shmid(p, shm_id, ancil->fds[0]);
+    /* A tagged registration wants a reply once the segment is attached,
+     * see pa_pstream_register_memfd_segments() */
+    if (pa_pstream_attach_memfd_shmid(p, shm_id, ancil->fds[0]) == 0 && tag != (uint32_t) -1)
+        pa_pstream_send_simple_ack(p, tag);
 
     ret = 0;
 finish:
@@ -30,11 +30,14 @@
 
 #include "packet.h"
 
-#define MAX_APPENDED_SIZE 128
+/* Almost all commands of the native protocol fit in here */
+#define MAX_APPENDED_SIZE 256
+
+#define N_POOLED_BUFFERS 32
 
 struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_POOLED, PA_PACKET_DYNAMIC } type;
     size_t length;
     uint8_t *data;
     union {
@@ -42,23 +45,63 @@ struct pa_packet {
     } per_type;
 };
 
+static pa_packet_stat packet_stat;
+
 PA_STATIC_FLIST_DECLARE(packets, 0, pa_xfree);
+PA_STATIC_FLIST_DECLARE(buffers, N_POOLED_BUFFERS, pa_xfree);
+
+static pa_packet *packet_new(void) {
+    pa_packet *p;
+
+    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets)))) {
+        p = pa_xnew(pa_packet, 1);
+        pa_atomic_inc(&packet_stat.n_malloced);
+    }
+
+    PA_REFCNT_INIT(p);
+
+    pa_atomic_inc(&packet_stat.n_allocated);
+    pa_atomic_inc(&packet_stat.n_accumulated);
+
+    return p;
+}
+
+void* pa_packet_buffer_new(void) {
+    void *buffer;
+
+    if (!(buffer = pa_flist_pop(PA_STATIC_FLIST_GET(buffers)))) {
+        buffer = pa_xmalloc(PA_PACKET_POOLED_SIZE);
+        pa_atomic_inc(&packet_stat.n_malloced);
+    }
+
+    return buffer;
+}
+
+void pa_packet_buffer_free(void *buffer) {
+    pa_assert(buffer);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(buffers), buffer) < 0)
+        pa_xfree(buffer);
+}
 
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
     pa_assert(length > 0);
 
-    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
-        p = pa_xnew(pa_packet, 1);
-    PA_REFCNT_INIT(p);
+    p = packet_new();
     p->length = length;
-    if (length > MAX_APPENDED_SIZE) {
-        p->data = pa_xmalloc(length);
-        p->type = PA_PACKET_DYNAMIC;
-    } else {
+
+    if (length <= MAX_APPENDED_SIZE) {
         p->data = p->per_type.appended;
         p->type = PA_PACKET_APPENDED;
+    } else if (length <= PA_PACKET_POOLED_SIZE) {
+        p->data = pa_packet_buffer_new();
+        p->type = PA_PACKET_POOLED;
+    } else {
+        p->data = pa_xmalloc(length);
+        p->type = PA_PACKET_DYNAMIC;
+        pa_atomic_inc(&packet_stat.n_malloced);
     }
 
     return p;
@@ -81,13 +124,29 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     pa_assert(data);
     pa_assert(length > 0);
 
-    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
-        p = pa_xnew(pa_packet, 1);
-    PA_REFCNT_INIT(p);
+    p = packet_new();
     p->length = length;
     p->data = data;
     p->type = PA_PACKET_DYNAMIC;
 
+    /* Somebody malloc()ed the data for us */
+    pa_atomic_inc(&packet_stat.n_malloced);
+
+    return p;
+}
+
+pa_packet* pa_packet_new_pooled(void *buffer, size_t length) {
+    pa_packet *p;
+
+    pa_assert(buffer);
+    pa_assert(length > 0);
+    pa_assert(length <= PA_PACKET_POOLED_SIZE);
+
+    p = packet_new();
+    p->length = length;
+    p->data = buffer;
+    p->type = PA_PACKET_POOLED;
+
     return p;
 }
 
@@ -114,9 +173,18 @@ void pa_packet_unref(pa_packet *p) {
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
 
     if (PA_REFCNT_DEC(p) <= 0) {
-        if (p->type == PA_PACKET_DYNAMIC)
+        if (p->type == PA_PACKET_POOLED)
+            pa_packet_buffer_free(p->data);
+        else if (p->type == PA_PACKET_DYNAMIC)
             pa_xfree(p->data);
+
+        pa_atomic_dec(&packet_stat.n_allocated);
+
         if (pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
             pa_xfree(p);
     }
 }
+
+const pa_packet_stat* pa_packet_get_stat(void) {
+    return &packet_stat;
+}
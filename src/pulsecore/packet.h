@@ -23,8 +23,24 @@
 #include <sys/types.h>
 #include <inttypes.h>
 
+#include <pulsecore/atomic.h>
+
 typedef struct pa_packet pa_packet;
 
+/* Anything up to this size, like most introspection replies, gets a
+ * buffer from a free list instead of its own malloc() */
+#define PA_PACKET_POOLED_SIZE 4096
+
+/* Packet structures and the data of packets up to a few KiB are
+ * recycled through process wide free lists, so that sending and
+ * receiving control messages usually does not hit malloc(). These
+ * counters show how well that works. */
+typedef struct pa_packet_stat {
+    pa_atomic_t n_allocated;
+    pa_atomic_t n_accumulated;
+    pa_atomic_t n_malloced; /* Times a packet structure or its data was malloc()ed */
+} pa_packet_stat;
+
 /* create empty packet (either of type appended or dynamic depending
  * on length) */
 pa_packet* pa_packet_new(size_t length);
@@ -37,9 +53,21 @@ pa_packet* pa_packet_new_data(const void* data, size_t length);
  * i.e. memory is free()d with the packet */
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
+/* Takes a buffer of PA_PACKET_POOLED_SIZE bytes from the free list, to
+ * build a packet in place. It must be handed over with
+ * pa_packet_new_pooled() or given back with pa_packet_buffer_free(). */
+void* pa_packet_buffer_new(void);
+void pa_packet_buffer_free(void *buffer);
+
+/* buffer must come from pa_packet_buffer_new(); the packet takes
+ * ownership of it, i.e. it goes back to the free list with the packet */
+pa_packet* pa_packet_new_pooled(void *buffer, size_t length);
+
 const void* pa_packet_data(pa_packet *p, size_t *l);
 
 pa_packet* pa_packet_ref(pa_packet *p);
 void pa_packet_unref(pa_packet *p);
 
+const pa_packet_stat* pa_packet_get_stat(void);
+
 #endif
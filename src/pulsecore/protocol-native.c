@@ -57,6 +57,7 @@
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/mem.h>
+#include <pulsecore/write-ring.h>
 
 #include "protocol-native.h"
 
@@ -121,6 +122,9 @@ typedef struct playback_stream {
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
 
+    /* Shared with the client, which writes into it in place */
+    pa_write_ring *write_ring;
+
     bool adjust_latency:1;
     bool early_requests:1;
 
@@ -188,6 +192,8 @@ struct pa_native_connection {
     pa_subscription *subscription;
     pa_time_event *auth_timeout_event;
     pa_srbchannel *srbpending;
+    /* Tag of the next registration of a memfd segment */
+    uint32_t memfd_tag;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -652,6 +658,9 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    if (s->write_ring)
+        pa_write_ring_free(s->write_ring);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -1839,6 +1848,35 @@ static pa_tagstruct *reply_new(uint32_t tag) {
     return reply;
 }
 
+/* Called from main context */
+static void setup_write_ring(pa_native_connection *c, playback_stream *s) {
+    pa_memchunk chunk;
+
+    /* The ring lives in the srbchannel's pool, which the client can
+     * write to */
+    if (c->version < 32 || !c->rw_mempool)
+        return;
+
+    if (!(s->write_ring = pa_write_ring_new(c->rw_mempool, pa_frame_size(&s->sink_input->sample_spec)))) {
+        pa_log_debug("Failed to allocate write ring for playback stream %u", s->index);
+        return;
+    }
+
+    /* Like with the srbchannel, the memblock directly follows the reply */
+    chunk.memblock = pa_write_ring_get_memblock(s->write_ring);
+    chunk.index = 0;
+    chunk.length = pa_memblock_get_length(chunk.memblock);
+
+    /* The client needs to get the ring in one piece */
+    if (chunk.length > pa_mempool_block_size_max(c->protocol->core->mempool)) {
+        pa_write_ring_free(s->write_ring);
+        s->write_ring = NULL;
+        return;
+    }
+
+    pa_pstream_send_memblock(c->pstream, s->index, 0, PA_SEEK_RELATIVE, &chunk);
+}
+
 static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     playback_stream *s;
@@ -2099,6 +2137,8 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
 
     pa_pstream_send_tagstruct(c->pstream, reply);
 
+    setup_write_ring(c, s);
+
 finish:
     if (p)
         pa_proplist_free(p);
@@ -2447,6 +2487,7 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     pa_memchunk mc;
     pa_tagstruct *t;
     int fdlist[2];
+    uint32_t n_lanes, i;
 
 #ifndef HAVE_CREDS
     pa_log_debug("Disabling srbchannel, reason: No fd passing support");
@@ -2474,7 +2515,8 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         return;
     }
 
-    if (!(c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true))) {
+    if (!(c->rw_mempool = pa_mempool_new_full(shm_type, c->protocol->core->shm_size, true,
+                                              c->protocol->core->shm_hugepages, c->protocol->core->shm_numa_node))) {
         pa_log_warn("Disabling srbchannel, reason: Failed to allocate shared "
                     "writable memory pool.");
         return;
@@ -2489,7 +2531,10 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     }
     pa_mempool_set_is_remote_writable(c->rw_mempool, true);
 
-    srb = pa_srbchannel_new(c->protocol->core->mainloop, c->rw_mempool);
+    /* Clients since v34 take a lane per few streams */
+    n_lanes = c->version >= 34 ? c->options->srbchannel_lanes : 0;
+
+    srb = pa_srbchannel_new_with_lanes(c->protocol->core->mainloop, c->rw_mempool, n_lanes);
     if (!srb) {
         pa_log_debug("Failed to create srbchannel");
         goto fail;
@@ -2501,6 +2546,8 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     t = pa_tagstruct_new();
     pa_tagstruct_putu32(t, PA_COMMAND_ENABLE_SRBCHANNEL);
     pa_tagstruct_putu32(t, (size_t) srb); /* tag */
+    if (c->version >= 34)
+        pa_tagstruct_putu32(t, n_lanes);
     fdlist[0] = srbt.readfd;
     fdlist[1] = srbt.writefd;
     pa_pstream_send_tagstruct_with_fds(c->pstream, t, 2, fdlist, false);
@@ -2511,6 +2558,13 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     mc.length = pa_memblock_get_length(srbt.memblock);
     pa_pstream_send_memblock(c->pstream, 0, 0, 0, &mc);
 
+    /* ...followed by the ones of the lanes */
+    for (i = 0; i < srbt.n_lanes; i++) {
+        mc.memblock = srbt.lanes[i];
+        mc.length = pa_memblock_get_length(srbt.lanes[i]);
+        pa_pstream_send_memblock(c->pstream, 0, 0, 0, &mc);
+    }
+
     c->srbpending = srb;
     return;
 
@@ -2658,6 +2712,12 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
+    if (do_shm && c->version >= 33)
+        pa_pstream_enable_block_id_batching(c->pstream);
+
+    if (do_shm && c->version >= 35)
+        pa_pstream_enable_max_export_slots(c->pstream);
+
     do_memfd =
         do_shm && pa_mempool_is_memfd_backed(c->protocol->core->mempool);
 
@@ -2713,7 +2773,7 @@ static void command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command, uin
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, t))
+    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, tag, t))
         protocol_error(c);
 }
 
@@ -4944,6 +5004,29 @@ static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, pa_cmsg_an
     }
 }
 
+static pa_memblock *pstream_ring_callback(pa_pstream *p, uint32_t channel, size_t index, size_t length, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    output_stream *stream;
+    playback_stream *ps;
+    pa_memblock *b;
+
+    pa_assert(p);
+    pa_native_connection_assert_ref(c);
+
+    if (!(stream = OUTPUT_STREAM(pa_idxset_get_by_index(c->output_streams, channel))) ||
+        !playback_stream_isinstance(stream) ||
+        !(ps = PLAYBACK_STREAM(stream))->write_ring) {
+        pa_log_debug("Client sent ring data for invalid stream.");
+        return NULL;
+    }
+
+    if (!(b = pa_write_ring_take(ps->write_ring, index, length)))
+        pa_log_warn("Client sent ring data out of order: index %lu, length %lu",
+                    (unsigned long) index, (unsigned long) length);
+
+    return b;
+}
+
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     output_stream *stream;
@@ -5062,6 +5145,16 @@ static void pstream_release_callback(pa_pstream *p, uint32_t block_id, void *use
         pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_RELEASE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
 }
 
+static void pstream_memfd_segment_callback(pa_pstream *p, pa_mempool *pool, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+
+    pa_native_connection_assert_ref(c);
+
+    /* New segments of the core's or the client's pool get registered
+     * just like the pool itself */
+    pa_pstream_register_memfd_segments(p, pool, c->version >= 35 ? c->pdispatch : NULL, &c->memfd_tag);
+}
+
 /*** client callbacks ***/
 
 static void client_kill_cb(pa_client *c) {
@@ -5140,6 +5233,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->options = pa_native_options_ref(o);
     c->authorized = false;
     c->srbpending = NULL;
+    c->memfd_tag = 0;
 
     if (o->auth_anonymous) {
         pa_log_info("Client authenticated anonymously.");
@@ -5176,6 +5270,8 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_pstream_set_drain_callback(c->pstream, pstream_drain_callback, c);
     pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
     pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
+    pa_pstream_set_ring_callback(c->pstream, pstream_ring_callback, c);
+    pa_pstream_set_memfd_segment_callback(c->pstream, pstream_memfd_segment_callback, c);
 
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, true, command_table, PA_COMMAND_MAX);
 
@@ -5378,6 +5474,13 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    o->srbchannel_lanes = 4;
+    if (pa_modargs_get_value_u32(ma, "srbchannel-lanes", &o->srbchannel_lanes) < 0 ||
+        o->srbchannel_lanes > PA_SRBCHANNEL_LANES_MAX) {
+        pa_log("srbchannel-lanes= expects a number between 0 and %u.", PA_SRBCHANNEL_LANES_MAX);
+        return -1;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
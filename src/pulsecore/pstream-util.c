@@ -30,17 +30,16 @@
 
 #include "pstream-util.h"
 
+/* In seconds */
+#define MEMFD_SEGMENT_REPLY_TIMEOUT 30
+
 static void pa_pstream_send_tagstruct_with_ancil_data(pa_pstream *p, pa_tagstruct *t, pa_cmsg_ancil_data *ancil_data) {
-    size_t length;
-    const uint8_t *data;
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_data(data, length));
-    pa_tagstruct_free(t);
+    pa_assert_se(packet = pa_tagstruct_free_to_packet(t));
 
     pa_pstream_send_packet(p, packet, ancil_data);
     pa_packet_unref(packet);
@@ -196,3 +195,93 @@ finish:
     return -1;
 #endif
 }
+
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+struct memfd_segment_reply {
+    pa_pstream *pstream;
+    uint32_t shm_id;
+};
+
+static void memfd_segment_reply_free(void *userdata) {
+    struct memfd_segment_reply *r = userdata;
+
+    pa_pstream_unref(r->pstream);
+    pa_xfree(r);
+}
+
+static void memfd_segment_reply_cb(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    struct memfd_segment_reply *r = userdata;
+
+    if (command != PA_COMMAND_REPLY) {
+        pa_log_debug("Registration of memfd SHM ID = %u not confirmed, its blocks keep being copied", r->shm_id);
+        return;
+    }
+
+    pa_pstream_confirm_memfd_shmid(r->pstream, r->shm_id);
+}
+#endif
+
+/* Pools grow by further memfd segments once they are full. Those are
+ * registered the same way as the pool itself, from the pstream's memfd
+ * segment callback, i.e. as soon as a block is sent from a pool that has
+ * got new ones. Only pools registered with
+ * pa_pstream_register_memfd_mempool() before are taken care of.
+ *
+ * Unlike the pool's first segment, the pool keeps their fds open.
+ *
+ * While there is a srbchannel, blocks from these segments are copied
+ * until the other end has replied to their registration. If @pd is not
+ * NULL, each registration is tagged with *@tag, which is advanced, and
+ * the reply is waited for on @pd. Peers older than protocol version 35
+ * do not reply, pass NULL for them. */
+void pa_pstream_register_memfd_segments(pa_pstream *p, pa_mempool *pool, pa_pdispatch *pd, uint32_t *tag) {
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+    unsigned s, n;
+    uint32_t shm_id;
+
+    pa_assert(p);
+    pa_assert(pool);
+    pa_assert(!pd || tag);
+
+    if ((n = pa_mempool_get_n_segments(pool)) <= 1)
+        return;
+
+    if (!pa_mempool_is_memfd_backed(pool) || !pa_pstream_get_memfd(p))
+        return;
+
+    if (pa_mempool_get_shm_id(pool, &shm_id) < 0 || !pa_pstream_memfd_is_registered(p, shm_id))
+        return;
+
+    for (s = 1; s < n; s++) {
+        pa_tagstruct *t;
+        int memfd_fd;
+
+        memfd_fd = pa_mempool_get_segment_memfd(pool, s, &shm_id);
+
+        if (pa_pstream_memfd_is_registered(p, shm_id))
+            continue;
+
+        if (pa_pstream_attach_memfd_shmid(p, shm_id, memfd_fd) < 0)
+            return;
+
+        t = pa_tagstruct_new();
+        pa_tagstruct_putu32(t, PA_COMMAND_REGISTER_MEMFD_SHMID);
+
+        if (pd) {
+            struct memfd_segment_reply *r;
+
+            r = pa_xnew(struct memfd_segment_reply, 1);
+            r->pstream = pa_pstream_ref(p);
+            r->shm_id = shm_id;
+
+            pa_tagstruct_putu32(t, *tag);
+            pa_pdispatch_register_reply(pd, (*tag)++, MEMFD_SEGMENT_REPLY_TIMEOUT,
+                                        memfd_segment_reply_cb, r, memfd_segment_reply_free);
+        } else
+            pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+
+        pa_tagstruct_putu32(t, shm_id);
+        pa_pstream_send_tagstruct_with_fds(p, t, 1, &memfd_fd, false);
+    }
+#endif
+}
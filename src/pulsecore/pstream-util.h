@@ -21,6 +21,7 @@
 ***/
 
 #include <inttypes.h>
+#include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/creds.h>
@@ -35,5 +36,6 @@ void pa_pstream_send_error(pa_pstream *p, uint32_t tag, uint32_t error);
 void pa_pstream_send_simple_ack(pa_pstream *p, uint32_t tag);
 
 int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const char **fail_reason);
+void pa_pstream_register_memfd_segments(pa_pstream *p, pa_mempool *pool, pa_pdispatch *pd, uint32_t *tag);
 
 #endif
@@ -46,12 +46,18 @@
 /* We piggyback information if audio data blocks are stored in SHM on the seek mode */
 #define PA_FLAG_SHMDATA     0x80000000LU
 #define PA_FLAG_SHMDATA_MEMFD_BLOCK         0x20000000LU
+#define PA_FLAG_SHMDATA_RING                0x10000000LU
 #define PA_FLAG_SHMRELEASE  0x40000000LU
 #define PA_FLAG_SHMREVOKE   0xC0000000LU
+#define PA_FLAG_SHMBATCH    0x08000000LU
 #define PA_FLAG_SHMMASK     0xFF000000LU
 #define PA_FLAG_SEEKMASK    0x000000FFLU
 #define PA_FLAG_SHMWRITABLE 0x00800000LU
 
+/* While the srbchannel has lanes, frames sent through it carry an epoch */
+#define PA_FLAG_EPOCHMASK   0x007FFF00LU
+#define PA_FLAG_EPOCHSHIFT  8
+
 /* The sequence descriptor header consists of 5 32bit integers: */
 enum {
     PA_PSTREAM_DESCRIPTOR_LENGTH,
@@ -82,6 +88,18 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
  */
 #define FRAME_SIZE_MAX_ALLOW (1024*1024*16)
 
+/* Maximum number of block IDs sent in a single release or revoke frame */
+#define BLOCK_ID_BATCH_MAX (1024)
+
+/* Frames queued up behind the one being written go out with it in a
+ * single system call, as many as fit in here */
+#define WRITE_AHEAD_MAX (15)
+#define WRITE_BUDGET (64*1024)
+
+/* Anything smaller than this is read from the socket through a buffer
+ * of this size, so that a burst of small frames takes a single read */
+#define READ_BUFFER_SIZE (16*1024)
+
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
 struct item_info {
@@ -89,17 +107,20 @@ struct item_info {
         PA_PSTREAM_ITEM_PACKET,
         PA_PSTREAM_ITEM_MEMBLOCK,
         PA_PSTREAM_ITEM_SHMRELEASE,
-        PA_PSTREAM_ITEM_SHMREVOKE
+        PA_PSTREAM_ITEM_SHMREVOKE,
+        PA_PSTREAM_ITEM_RING,
+        PA_PSTREAM_ITEM_SHMRELEASE_BATCH,
+        PA_PSTREAM_ITEM_SHMREVOKE_BATCH
     } type;
 
-    /* packet info */
+    /* packet info, for batches the block IDs */
     pa_packet *packet;
 #ifdef HAVE_CREDS
     bool with_ancil_data;
     pa_cmsg_ancil_data ancil_data;
 #endif
 
-    /* memblock info */
+    /* memblock info, for ring items only index and length are used */
     pa_memchunk chunk;
     uint32_t channel;
     int64_t offset;
@@ -107,6 +128,15 @@ struct item_info {
 
     /* release/revoke info */
     uint32_t block_id;
+
+    /* Position in the order items were queued in */
+    uint32_t seq;
+};
+
+/* Block IDs to release or revoke, collected until the next write */
+struct block_id_batch {
+    uint32_t *ids;
+    unsigned n, size;
 };
 
 struct pstream_read {
@@ -116,6 +146,35 @@ struct pstream_read {
     uint32_t shm_info[PA_PSTREAM_SHM_MAX];
     void *data;
     size_t index;
+
+    /* For reading from a srbchannel lane */
+    struct pstream_lane *lane;
+
+    /* A frame of a later epoch waits here with only its descriptor read */
+    bool held;
+    uint32_t epoch;
+};
+
+struct pstream_write {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
+};
+
+/* Memblocks of a channel go through lane (channel % n_lanes) of the
+ * srbchannel if it has lanes, so that a stream with a lot of data
+ * queued up does not hold up the others */
+struct pstream_lane {
+    unsigned index;
+    pa_queue *send_queue;
+    struct pstream_write write;
+    struct pstream_read read;
 };
 
 struct pa_pstream {
@@ -131,20 +190,33 @@ struct pa_pstream {
 
     bool dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
-
+    struct pstream_write write;
     struct pstream_read readio, readsrb;
 
+    /* Frames prepared to be written after the current one, see
+     * do_writev() */
+    struct pstream_write write_ahead[WRITE_AHEAD_MAX];
+    unsigned n_write_ahead;
+
+    /* Data read from the socket that has not been processed yet, and
+     * the position in the stream of the next byte and of the start of
+     * the current frame, see read_io() */
+    uint8_t *read_buffer;
+    size_t read_buffer_index, read_buffer_length;
+    uint64_t read_pos, read_frame_start;
+
+    /* System calls on the socket, and the frames that went through it */
+    unsigned n_writes, n_frames_written, n_reads, n_frames_read;
+
+    struct pstream_lane lanes[PA_SRBCHANNEL_LANES_MAX];
+    unsigned n_lanes;
+
+    /* Keeps the order of items across the main ringbuffer and the
+     * lanes, see tag_epoch() */
+    uint32_t next_seq;
+    uint32_t write_epoch, read_epoch;
+    bool writing_lanes;
+
     /* @use_shm: beside copying the full audio data to the other
      * PA end, this pipe supports just sending references of the
      * same audio data blocks if they reside in a SHM pool.
@@ -152,13 +224,27 @@ struct pa_pstream {
      * @use_memfd: pipe supports sending SHM memfd block references
      *
      * @registered_memfd_ids: registered memfd pools SHM IDs. Check
-     * pa_pstream_register_memfd_mempool() for more information. */
+     * pa_pstream_register_memfd_mempool() for more information.
+     *
+     * @confirmed_memfd_ids: those of them the other end has confirmed
+     * to know. Check pa_pstream_confirm_memfd_shmid(). */
     bool use_shm, use_memfd;
     pa_idxset *registered_memfd_ids;
+    pa_idxset *confirmed_memfd_ids;
 
     pa_memimport *import;
     pa_memexport *export;
 
+    /* @max_export_slots: the other end imports as many blocks at a time
+     * as we can export, not just the 160 older versions do */
+    bool max_export_slots;
+
+    /* @batch_block_ids: the other end understands release and revoke
+     * frames carrying more than one block ID */
+    bool batch_block_ids;
+    struct block_id_batch release_batch, revoke_batch;
+    unsigned n_block_ids_sent, n_block_id_frames_sent;
+
     pa_pstream_packet_cb_t receive_packet_callback;
     void *receive_packet_callback_userdata;
 
@@ -177,11 +263,24 @@ struct pa_pstream {
     pa_pstream_block_id_cb_t release_callback;
     void *release_callback_userdata;
 
+    pa_pstream_ring_cb_t ring_callback;
+    void *ring_callback_userdata;
+
+    pa_pstream_mempool_cb_t memfd_segment_callback;
+    void *memfd_segment_callback_userdata;
+
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
     pa_cmsg_ancil_data read_ancil_data, *write_ancil_data;
     bool send_ancil_data_now;
+
+    /* Credentials that came with the data in the read buffer, and fds
+     * not yet handed to the frame they belong to, see attach_read_fds() */
+    pa_creds read_buffer_creds;
+    bool read_buffer_creds_valid;
+    pa_cmsg_ancil_data read_fds_pending;
+    uint64_t read_fds_end;
 #endif
 };
 
@@ -233,7 +332,10 @@ void pa_cmsg_ancil_data_close_fds(struct pa_cmsg_ancil_data *ancil) {
 #endif
 
 static int do_write(pa_pstream *p);
+static void do_write_srb(pa_pstream *p);
 static int do_read(pa_pstream *p, struct pstream_read *re);
+static int do_read_srb(pa_pstream *p);
+static void flush_block_id_batches(pa_pstream *p);
 
 static void do_pstream_read_write(pa_pstream *p) {
     pa_assert(p);
@@ -243,14 +345,21 @@ static void do_pstream_read_write(pa_pstream *p) {
 
     p->mainloop->defer_enable(p->defer_event, 0);
 
+    if (!p->dead)
+        flush_block_id_batches(p);
+
     if (!p->dead && p->srb) {
-         do_write(p);
-         while (!p->dead && do_read(p, &p->readsrb) == 0);
+         do_write_srb(p);
+         if (do_read_srb(p) < 0)
+             goto fail;
     }
 
     if (!p->dead && pa_iochannel_is_readable(p->io)) {
-        if (do_read(p, &p->readio) < 0)
-            goto fail;
+        /* Handle everything that came in with the read */
+        do {
+            if (do_read(p, &p->readio) < 0)
+                goto fail;
+        } while (!p->dead && p->read_buffer_index < p->read_buffer_length);
     } else if (!p->dead && pa_iochannel_is_hungup(p->io))
         goto fail;
 
@@ -375,6 +484,25 @@ int pa_pstream_attach_memfd_shmid(pa_pstream *p, unsigned shm_id, int memfd_fd)
     return 0;
 }
 
+bool pa_pstream_memfd_is_registered(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+
+    return p->use_memfd && pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
+/* Called once the other end has replied to the registration of a
+ * memfd segment. Any packet or memblock frame it receives after that,
+ * through the srbchannel as well, finds the segment attached. */
+void pa_pstream_confirm_memfd_shmid(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (!pa_pstream_memfd_is_registered(p, shm_id))
+        return;
+
+    pa_idxset_put(p->confirmed_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
 static void item_free(void *item) {
     struct item_info *i = item;
     pa_assert(i);
@@ -382,7 +510,9 @@ static void item_free(void *item) {
     if (i->type == PA_PSTREAM_ITEM_MEMBLOCK) {
         pa_assert(i->chunk.memblock);
         pa_memblock_unref(i->chunk.memblock);
-    } else if (i->type == PA_PSTREAM_ITEM_PACKET) {
+    } else if (i->type == PA_PSTREAM_ITEM_PACKET ||
+               i->type == PA_PSTREAM_ITEM_SHMRELEASE_BATCH ||
+               i->type == PA_PSTREAM_ITEM_SHMREVOKE_BATCH) {
         pa_assert(i->packet);
         pa_packet_unref(i->packet);
     }
@@ -400,37 +530,89 @@ static void item_free(void *item) {
         pa_xfree(i);
 }
 
+static void write_state_reset(struct pstream_write *w) {
+    if (w->current)
+        item_free(w->current);
+    w->current = NULL;
+
+    if (w->memchunk.memblock)
+        pa_memblock_unref(w->memchunk.memblock);
+    pa_memchunk_reset(&w->memchunk);
+}
+
+static void read_state_reset(struct pstream_read *re) {
+    if (re->memblock)
+        pa_memblock_unref(re->memblock);
+
+    if (re->packet)
+        pa_packet_unref(re->packet);
+
+    re->memblock = NULL;
+    re->packet = NULL;
+    re->data = NULL;
+    re->index = 0;
+    re->held = false;
+}
+
 static void pstream_free(pa_pstream *p) {
+    unsigned i;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
-
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
-
-    if (p->readsrb.memblock)
-        pa_memblock_unref(p->readsrb.memblock);
+    write_state_reset(&p->write);
 
-    if (p->readsrb.packet)
-        pa_packet_unref(p->readsrb.packet);
+    for (i = 0; i < p->n_write_ahead; i++)
+        write_state_reset(&p->write_ahead[i]);
 
-    if (p->readio.memblock)
-        pa_memblock_unref(p->readio.memblock);
+    read_state_reset(&p->readsrb);
+    read_state_reset(&p->readio);
 
-    if (p->readio.packet)
-        pa_packet_unref(p->readio.packet);
+    for (i = 0; i < PA_SRBCHANNEL_LANES_MAX; i++)
+        read_state_reset(&p->lanes[i].read);
 
     if (p->registered_memfd_ids)
         pa_idxset_free(p->registered_memfd_ids, NULL);
 
+    if (p->confirmed_memfd_ids)
+        pa_idxset_free(p->confirmed_memfd_ids, NULL);
+
+    if (p->n_block_ids_sent > p->n_block_id_frames_sent)
+        pa_log_debug("Sent %u block releases and revokes in %u frames",
+                     p->n_block_ids_sent, p->n_block_id_frames_sent);
+
+    if (p->n_writes > 0 || p->n_reads > 0)
+        pa_log_debug("Wrote %u frames in %u system calls, read %u frames in %u system calls",
+                     p->n_frames_written, p->n_writes, p->n_frames_read, p->n_reads);
+
+    pa_xfree(p->read_buffer);
+
+#ifdef HAVE_CREDS
+    pa_cmsg_ancil_data_close_fds(&p->read_fds_pending);
+#endif
+
+    pa_xfree(p->release_batch.ids);
+    pa_xfree(p->revoke_batch.ids);
+
     pa_xfree(p);
 }
 
+static void push_item(pa_pstream *p, pa_queue *q, struct item_info *i) {
+    i->seq = p->next_seq++;
+    pa_queue_push(q, i);
+}
+
+/* Where memblocks of a channel are queued */
+static pa_queue *channel_queue(pa_pstream *p, uint32_t channel) {
+    if (p->n_lanes > 0)
+        return p->lanes[channel % p->n_lanes].send_queue;
+
+    return p->send_queue;
+}
+
 void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data) {
     struct item_info *i;
 
@@ -461,11 +643,29 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, pa_cmsg_ancil_data
     }
 #endif
 
-    pa_queue_push(p->send_queue, i);
+    push_item(p, p->send_queue, i);
 
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
+/* Whether the pool is registered with us, but the last segment it has
+ * grown by is not yet */
+static bool has_new_memfd_segment(pa_pstream *p, pa_mempool *pool) {
+    unsigned n;
+    uint32_t shm_id;
+
+    if ((n = pa_mempool_get_n_segments(pool)) <= 1 || !pa_mempool_is_memfd_backed(pool))
+        return false;
+
+    pa_mempool_get_segment_memfd(pool, n - 1, &shm_id);
+
+    if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL))
+        return false;
+
+    return pa_mempool_get_shm_id(pool, &shm_id) >= 0 &&
+        pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
     size_t length, idx;
     size_t bsm;
@@ -483,6 +683,17 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
 
     bsm = pa_mempool_block_size_max(p->mempool);
 
+    /* The block may be from a segment the pool has just grown by, give
+     * the owner a chance to register it before the block is queued */
+    if (p->use_memfd && p->memfd_segment_callback) {
+        pa_mempool *pool = pa_memblock_get_pool(chunk->memblock);
+
+        if (has_new_memfd_segment(p, pool))
+            p->memfd_segment_callback(p, pool, p->memfd_segment_callback_userdata);
+
+        pa_mempool_unref(pool);
+    }
+
     while (length > 0) {
         struct item_info *i;
         size_t n;
@@ -503,7 +714,7 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
         i->with_ancil_data = false;
 #endif
 
-        pa_queue_push(p->send_queue, i);
+        push_item(p, channel_queue(p, channel), i);
 
         idx += n;
         length -= n;
@@ -512,25 +723,120 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
-void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
-    struct item_info *item;
+void pa_pstream_send_ring_data(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, size_t index, size_t length) {
+    struct item_info *i;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(channel != (uint32_t) -1);
+    pa_assert(length > 0);
+    pa_assert(p->use_shm);
 
     if (p->dead)
         return;
 
-/*     pa_log("Releasing block %u", block_id); */
+    if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+        i = pa_xnew(struct item_info, 1);
+    i->type = PA_PSTREAM_ITEM_RING;
+
+    i->chunk.memblock = NULL;
+    i->chunk.index = index;
+    i->chunk.length = length;
+
+    i->channel = channel;
+    i->offset = offset;
+    i->seek_mode = seek_mode;
+#ifdef HAVE_CREDS
+    i->with_ancil_data = false;
+#endif
+
+    push_item(p, channel_queue(p, channel), i);
+    p->mainloop->defer_enable(p->defer_event, 1);
+}
+
+static void send_block_id(pa_pstream *p, uint32_t block_id, bool revoke) {
+    struct item_info *item;
 
     if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
         item = pa_xnew(struct item_info, 1);
-    item->type = PA_PSTREAM_ITEM_SHMRELEASE;
+    item->type = revoke ? PA_PSTREAM_ITEM_SHMREVOKE : PA_PSTREAM_ITEM_SHMRELEASE;
     item->block_id = block_id;
 #ifdef HAVE_CREDS
     item->with_ancil_data = false;
 #endif
 
-    pa_queue_push(p->send_queue, item);
+    push_item(p, p->send_queue, item);
+
+    p->n_block_ids_sent++;
+    p->n_block_id_frames_sent++;
+}
+
+static void block_id_batch_push(struct block_id_batch *batch, uint32_t block_id) {
+    if (batch->n >= batch->size) {
+        batch->size = PA_MAX(batch->size * 2, 16U);
+        batch->ids = pa_xrenew(uint32_t, batch->ids, batch->size);
+    }
+
+    batch->ids[batch->n++] = block_id;
+}
+
+/* Turns the block IDs collected since the last write into as few frames
+ * as possible */
+static void flush_block_id_batch(pa_pstream *p, struct block_id_batch *batch, bool revoke) {
+    unsigned done, n, k;
+
+    if (batch->n == 1) {
+        send_block_id(p, batch->ids[0], revoke);
+        batch->n = 0;
+        return;
+    }
+
+    for (done = 0; done < batch->n; done += n) {
+        struct item_info *item;
+        uint32_t *d;
+        size_t plen;
+
+        n = PA_MIN(batch->n - done, (unsigned) BLOCK_ID_BATCH_MAX);
+
+        if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+            item = pa_xnew(struct item_info, 1);
+        item->type = revoke ? PA_PSTREAM_ITEM_SHMREVOKE_BATCH : PA_PSTREAM_ITEM_SHMRELEASE_BATCH;
+        item->packet = pa_packet_new(n * sizeof(uint32_t));
+#ifdef HAVE_CREDS
+        item->with_ancil_data = false;
+#endif
+
+        d = (uint32_t *) pa_packet_data(item->packet, &plen);
+        for (k = 0; k < n; k++)
+            d[k] = htonl(batch->ids[done + k]);
+
+        push_item(p, p->send_queue, item);
+        p->n_block_id_frames_sent++;
+    }
+
+    p->n_block_ids_sent += batch->n;
+    batch->n = 0;
+}
+
+static void flush_block_id_batches(pa_pstream *p) {
+    flush_block_id_batch(p, &p->release_batch, false);
+    flush_block_id_batch(p, &p->revoke_batch, true);
+}
+
+void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->dead)
+        return;
+
+/*     pa_log("Releasing block %u", block_id); */
+
+    if (p->batch_block_ids)
+        block_id_batch_push(&p->release_batch, block_id);
+    else
+        send_block_id(p, block_id, false);
+
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
@@ -551,7 +857,6 @@ static void memimport_release_cb(pa_memimport *i, uint32_t block_id, void *userd
 }
 
 void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
-    struct item_info *item;
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
@@ -559,15 +864,11 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
         return;
 /*     pa_log("Revoking block %u", block_id); */
 
-    if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
-        item = pa_xnew(struct item_info, 1);
-    item->type = PA_PSTREAM_ITEM_SHMREVOKE;
-    item->block_id = block_id;
-#ifdef HAVE_CREDS
-    item->with_ancil_data = false;
-#endif
+    if (p->batch_block_ids)
+        block_id_batch_push(&p->revoke_batch, block_id);
+    else
+        send_block_id(p, block_id, true);
 
-    pa_queue_push(p->send_queue, item);
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
@@ -584,68 +885,102 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+static void prepare_write_item(pa_pstream *p, struct pstream_write *w, pa_queue *q) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    w->current = pa_queue_pop(q);
 
-    if (!p->write.current)
+    if (!w->current)
         return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
-
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
         size_t plen;
 
-        pa_assert(p->write.current->packet);
+        pa_assert(w->current->packet);
+
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+
+        if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+        }
+
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
+
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.data = (void *) pa_packet_data(p->write.current->packet, &plen);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
+
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE_BATCH ||
+               w->current->type == PA_PSTREAM_ITEM_SHMREVOKE_BATCH) {
+        size_t plen;
+
+        /* Like a packet, just with different flags */
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] =
+            htonl(PA_FLAG_SHMBATCH | (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE_BATCH ? PA_FLAG_SHMREVOKE : PA_FLAG_SHMRELEASE));
 
         if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, plen);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_RING) {
+        uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+        size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        /* Only the position in the ring the other end gave us travels */
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] =
+            htonl((uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK) | PA_FLAG_SHMDATA | PA_FLAG_SHMDATA_RING);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+        shm_info[PA_PSTREAM_SHM_BLOCKID] = 0;
+        shm_info[PA_PSTREAM_SHM_SHMID] = 0;
+        shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) w->current->chunk.index);
+        shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+        w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
 
     } else {
         uint32_t flags;
         bool send_payload = true;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             pa_mem_type_t type;
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
-            pa_mempool *current_pool = pa_memblock_get_pool(p->write.current->chunk.memblock);
+            pa_mempool *current_pool = pa_memblock_get_pool(w->current->chunk.memblock);
             pa_memexport *current_export;
 
             if (p->mempool == current_pool)
@@ -654,7 +989,7 @@ static void prepare_next_write_item(pa_pstream *p) {
                 pa_assert_se(current_export = pa_memexport_new(current_pool, memexport_revoke_cb, p));
 
             if (pa_memexport_put(current_export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &type,
                                  &block_id,
                                  &shm_id,
@@ -665,9 +1000,20 @@ static void prepare_next_write_item(pa_pstream *p) {
                     send_payload = false;
 
                 if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd) {
+                    uint32_t pool_shm_id;
+
                     if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
-                        flags |= PA_FLAG_SHMDATA_MEMFD_BLOCK;
-                        send_payload = false;
+                        /* Segments the pool has grown by are registered
+                         * through the socket, while the block reference
+                         * would go through the srbchannel and might
+                         * overtake the registration. Copy those until
+                         * the other end has confirmed it. */
+                        if (!p->srb ||
+                            pa_idxset_get_by_data(p->confirmed_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL) ||
+                            pa_mempool_get_shm_id(current_pool, &pool_shm_id) < 0 || shm_id == pool_shm_id) {
+                            flags |= PA_FLAG_SHMDATA_MEMFD_BLOCK;
+                            send_payload = false;
+                        }
                     } else {
                         if (pa_log_ratelimit(PA_LOG_ERROR)) {
                             pa_log("Cannot send block reference with non-registered memfd ID = %u", shm_id);
@@ -685,11 +1031,11 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                     shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
                     shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                    p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                    w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
                 }
             }
 /*             else */
@@ -702,300 +1048,792 @@ static void prepare_next_write_item(pa_pstream *p) {
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
 #ifdef HAVE_CREDS
-    if ((p->send_ancil_data_now = p->write.current->with_ancil_data))
-        p->write_ancil_data = &p->write.current->ancil_data;
+    if (w == &p->write && (p->send_ancil_data_now = w->current->with_ancil_data))
+        p->write_ancil_data = &w->current->ancil_data;
 #endif
 }
 
+static void process_block_id_batch(pa_pstream *p, pa_packet *packet, uint32_t flags) {
+    const uint32_t *d;
+    size_t plen, k;
+
+    d = pa_packet_data(packet, &plen);
+
+    for (k = 0; k < plen / sizeof(uint32_t); k++) {
+        if ((flags & PA_FLAG_SHMMASK) == (PA_FLAG_SHMREVOKE | PA_FLAG_SHMBATCH)) {
+            pa_assert(p->import);
+            pa_memimport_process_revoke(p->import, ntohl(d[k]));
+        } else {
+            pa_assert(p->export);
+            pa_memexport_process_release(p->export, ntohl(d[k]));
+        }
+    }
+}
+
+static void lanes_free(pa_pstream *p) {
+    unsigned i;
+
+    for (i = 0; i < p->n_lanes; i++) {
+        struct pstream_lane *lane = &p->lanes[i];
+
+        pa_queue_free(lane->send_queue, item_free);
+        lane->send_queue = NULL;
+
+        write_state_reset(&lane->write);
+    }
+
+    p->n_lanes = 0;
+}
+
+static void lanes_init(pa_pstream *p) {
+    unsigned i;
+
+    p->n_lanes = pa_srbchannel_get_n_lanes(p->srb);
+
+    for (i = 0; i < p->n_lanes; i++) {
+        struct pstream_lane *lane = &p->lanes[i];
+
+        lane->index = i;
+        lane->send_queue = pa_queue_new();
+
+        read_state_reset(&lane->read);
+        lane->read.lane = lane;
+    }
+
+    p->readsrb.held = false;
+    p->write_epoch = p->read_epoch = 0;
+    p->writing_lanes = false;
+}
+
+static bool lanes_are_pending(pa_pstream *p) {
+    unsigned i;
+
+    for (i = 0; i < p->n_lanes; i++)
+        if (p->lanes[i].write.current || !pa_queue_isempty(p->lanes[i].send_queue))
+            return true;
+
+    return false;
+}
+
 static void check_srbpending(pa_pstream *p) {
     if (!p->is_srbpending)
         return;
 
-    if (p->srb)
+    if (p->srb) {
+        lanes_free(p);
         pa_srbchannel_free(p->srb);
+    }
 
     p->srb = p->srbpending;
     p->is_srbpending = false;
 
-    if (p->srb)
+    if (p->srb) {
+        lanes_init(p);
         pa_srbchannel_set_callback(p->srb, srb_callback, p);
+    }
 }
 
-static int do_write(pa_pstream *p) {
-    void *d;
-    size_t l;
-    ssize_t r;
-    pa_memblock *release_memblock = NULL;
+#define SEQ_BEFORE(a, b) ((int32_t) ((a) - (b)) < 0)
 
-    pa_assert(p);
-    pa_assert(PA_REFCNT_VALUE(p) > 0);
+/* Whether a lane still has to write an item queued before seq */
+static bool lanes_have_before(pa_pstream *p, uint32_t seq) {
+    unsigned i;
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
+    for (i = 0; i < p->n_lanes; i++) {
+        struct pstream_lane *lane = &p->lanes[i];
 
-    if (!p->write.current) {
-        /* The out queue is empty, so switching channels is safe */
-        check_srbpending(p);
-        return 0;
+        if (!lane->write.current)
+            prepare_write_item(p, &lane->write, lane->send_queue);
+
+        if (lane->write.current && SEQ_BEFORE(lane->write.current->seq, seq))
+            return true;
+    }
+
+    return false;
+}
+
+/* Items never overtake items queued before them on another ring, so
+ * the writing goes back and forth between the main ringbuffer and the
+ * lanes, with the lanes only passing each other. Each such turn starts
+ * a new epoch, and the frame descriptors carry the epoch they were
+ * written in. Since a turn only ends once all of its frames are
+ * complete, the other end keeps the order by handling the frames of
+ * one epoch at a time, see do_read_srb(). */
+static void tag_epoch(pa_pstream *p, struct pstream_write *w, bool lane) {
+    uint32_t flags;
+
+    if (p->writing_lanes != lane) {
+        p->write_epoch = (p->write_epoch + 1) & (PA_FLAG_EPOCHMASK >> PA_FLAG_EPOCHSHIFT);
+        p->writing_lanes = lane;
     }
 
-    if (p->write.minibuf_validsize > 0) {
-        d = p->write.minibuf + p->write.index;
-        l = p->write.minibuf_validsize - p->write.index;
-    } else if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
+    flags = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & ~PA_FLAG_EPOCHMASK;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags | (p->write_epoch << PA_FLAG_EPOCHSHIFT));
+}
+
+static void *get_write_data(struct pstream_write *w, size_t *l, pa_memblock **release_memblock) {
+    void *d;
+
+    if (w->minibuf_validsize > 0) {
+        d = w->minibuf + w->index;
+        *l = w->minibuf_validsize - w->index;
+    } else if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        d = (uint8_t*) w->descriptor + w->index;
+        *l = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
     } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+        pa_assert(w->data || w->memchunk.memblock);
 
-        if (p->write.data)
-            d = p->write.data;
+        if (w->data)
+            d = w->data;
         else {
-            d = pa_memblock_acquire_chunk(&p->write.memchunk);
-            release_memblock = p->write.memchunk.memblock;
+            d = pa_memblock_acquire_chunk(&w->memchunk);
+            *release_memblock = w->memchunk.memblock;
         }
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+        d = (uint8_t*) d + w->index - PA_PSTREAM_DESCRIPTOR_SIZE;
+        *l = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (w->index - PA_PSTREAM_DESCRIPTOR_SIZE);
     }
 
-    pa_assert(l > 0);
-
-#ifdef HAVE_CREDS
-    if (p->send_ancil_data_now) {
-        if (p->write_ancil_data->creds_valid) {
-            pa_assert(p->write_ancil_data->nfd == 0);
-            if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_ancil_data->creds)) < 0)
-                goto fail;
-        }
-        else
-            if ((r = pa_iochannel_write_with_fds(p->io, d, l, p->write_ancil_data->nfd, p->write_ancil_data->fds)) < 0)
-                goto fail;
-
-        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
-        p->send_ancil_data_now = false;
-    } else
-#endif
-    if (p->srb)
-        r = pa_srbchannel_write(p->srb, d, l);
-    else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
-        goto fail;
+    pa_assert(*l > 0);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    return d;
+}
 
-    p->write.index += (size_t) r;
+/* Returns 1 if all l bytes have been written */
+static int write_done(pa_pstream *p, struct pstream_write *w, size_t r, size_t l) {
+    w->index += r;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
+    if (w->index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
+        pa_assert(w->current);
+        item_free(w->current);
+        w->current = NULL;
 
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+        if (w->memchunk.memblock)
+            pa_memblock_unref(w->memchunk.memblock);
 
-        pa_memchunk_reset(&p->write.memchunk);
+        pa_memchunk_reset(&w->memchunk);
 
         if (p->drain_callback && !pa_pstream_is_pending(p))
             p->drain_callback(p, p->drain_callback_userdata);
     }
 
-    return (size_t) r == l ? 1 : 0;
+    return r == l ? 1 : 0;
+}
 
-fail:
-#ifdef HAVE_CREDS
-    if (p->send_ancil_data_now)
-        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
-#endif
+#ifdef HAVE_SYS_UIO_H
+/* Like get_write_data(), but returns everything that is left of the
+ * frame, in up to two buffers */
+static unsigned get_write_iov(struct pstream_write *w, struct iovec *iov, pa_memblock **release_memblock) {
+    unsigned n = 0;
+    size_t length;
+
+    if (w->minibuf_validsize > 0) {
+        iov[0].iov_base = w->minibuf + w->index;
+        iov[0].iov_len = w->minibuf_validsize - w->index;
+        return 1;
+    }
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        iov[n].iov_base = (uint8_t*) w->descriptor + w->index;
+        iov[n].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+        n++;
+    }
 
-    return -1;
+    if ((length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) > 0) {
+        size_t skip = w->index > PA_PSTREAM_DESCRIPTOR_SIZE ? w->index - PA_PSTREAM_DESCRIPTOR_SIZE : 0;
+        void *d;
+
+        pa_assert(w->data || w->memchunk.memblock);
+
+        if (w->data)
+            d = w->data;
+        else {
+            d = pa_memblock_acquire_chunk(&w->memchunk);
+            *release_memblock = w->memchunk.memblock;
+        }
+
+        iov[n].iov_base = (uint8_t*) d + skip;
+        iov[n].iov_len = length - skip;
+        n++;
+    }
+
+    return n;
 }
 
-static void memblock_complete(pa_pstream *p, struct pstream_read *re) {
-    pa_memchunk chunk;
-    int64_t offset;
+/* Writes the current frame to the socket together with the ones queued
+ * behind it, up to WRITE_BUDGET bytes. Frames with ancillary data are
+ * not pulled in, they start a write of their own so that the other end
+ * can tell which frame the data belongs to. Frames that did not make
+ * it out completely stay prepared in write_ahead for the next call. */
+static int do_writev(pa_pstream *p) {
+    struct iovec iov[2 * (WRITE_AHEAD_MAX + 1)];
+    pa_memblock *release_memblocks[WRITE_AHEAD_MAX + 1];
+    unsigned n_iov = 0, n_release = 0, i, k;
+    size_t l = 0, written;
+    ssize_t r;
 
-    if (!p->receive_memblock_callback)
-        return;
+    for (i = 0; i <= WRITE_AHEAD_MAX; i++) {
+        struct pstream_write *w = i == 0 ? &p->write : &p->write_ahead[i - 1];
+        pa_memblock *release_memblock = NULL;
+        unsigned n;
 
-    chunk.memblock = re->memblock;
-    chunk.index = 0;
-    chunk.length = re->index - PA_PSTREAM_DESCRIPTOR_SIZE;
+        if (i > p->n_write_ahead) {
+            struct item_info *next;
 
-    offset = (int64_t) (
-             (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
-             (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
+            if (l >= WRITE_BUDGET || !(next = pa_queue_peek(p->send_queue)))
+                break;
 
-    p->receive_memblock_callback(
-        p,
-        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
-        offset,
-        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
-        &chunk,
-        p->receive_memblock_callback_userdata);
+#ifdef HAVE_CREDS
+            if (next->with_ancil_data)
+                break;
+#endif
+
+            prepare_write_item(p, w, p->send_queue);
+            p->n_write_ahead++;
+        }
+
+        n = get_write_iov(w, iov + n_iov, &release_memblock);
+
+        for (k = 0; k < n; k++)
+            l += iov[n_iov + k].iov_len;
+
+        n_iov += n;
+
+        if (release_memblock)
+            release_memblocks[n_release++] = release_memblock;
+    }
+
+    r = pa_iochannel_writev(p->io, iov, n_iov);
+    p->n_writes++;
+
+    for (k = 0; k < n_release; k++)
+        pa_memblock_release(release_memblocks[k]);
+
+    if (r < 0)
+        return -1;
+
+    /* Retire the frames that went out completely */
+    for (written = (size_t) r; written > 0;) {
+        size_t left = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - p->write.index;
+
+        if (written < left) {
+            p->write.index += written;
+            break;
+        }
+
+        written -= left;
+        p->n_frames_written++;
+        write_done(p, &p->write, left, left);
+
+        if (p->n_write_ahead == 0)
+            break;
+
+        p->write = p->write_ahead[0];
+        p->n_write_ahead--;
+        memmove(p->write_ahead, p->write_ahead + 1, p->n_write_ahead * sizeof(struct pstream_write));
+    }
+
+    return (size_t) r == l ? 1 : 0;
 }
+#endif
 
-static int do_read(pa_pstream *p, struct pstream_read *re) {
+static int do_write(pa_pstream *p) {
     void *d;
     size_t l;
     ssize_t r;
     pa_memblock *release_memblock = NULL;
+    bool socket_write = true;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (re->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) re->descriptor + re->index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - re->index;
-    } else {
-        pa_assert(re->data || re->memblock);
-
-        if (re->data)
-            d = re->data;
-        else {
-            d = pa_memblock_acquire(re->memblock);
-            release_memblock = re->memblock;
-        }
+    if (!p->write.current)
+        prepare_write_item(p, &p->write, p->send_queue);
 
-        d = (uint8_t*) d + re->index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (re->index - PA_PSTREAM_DESCRIPTOR_SIZE);
+    if (!p->write.current) {
+        /* The out queues are empty, so switching channels is safe */
+        if (!lanes_are_pending(p))
+            check_srbpending(p);
+        return 0;
     }
 
-    if (re == &p->readsrb) {
-        r = pa_srbchannel_read(p->srb, d, l);
-        if (r == 0) {
-            if (release_memblock)
-                pa_memblock_release(release_memblock);
-            return 1;
-        }
+    if (p->write.index == 0 && p->n_lanes > 0) {
+        if (lanes_have_before(p, p->write.current->seq))
+            return 0;
+
+#ifdef HAVE_CREDS
+        if (!p->send_ancil_data_now)
+#endif
+            tag_epoch(p, &p->write, false);
     }
-    else
+
+#ifdef HAVE_SYS_UIO_H
 #ifdef HAVE_CREDS
-    {
-        pa_cmsg_ancil_data b;
+    if (!p->srb && !p->send_ancil_data_now)
+#else
+    if (!p->srb)
+#endif
+        return do_writev(p);
+#endif
 
-        if ((r = pa_iochannel_read_with_ancil_data(p->io, d, l, &b)) <= 0)
-            goto fail;
+    d = get_write_data(&p->write, &l, &release_memblock);
 
-        if (b.creds_valid) {
-            p->read_ancil_data.creds_valid = true;
-            p->read_ancil_data.creds = b.creds;
+#ifdef HAVE_CREDS
+    if (p->send_ancil_data_now) {
+        if (p->write_ancil_data->creds_valid) {
+            pa_assert(p->write_ancil_data->nfd == 0);
+            if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_ancil_data->creds)) < 0)
+                goto fail;
         }
-        if (b.nfd > 0) {
-            pa_assert(b.nfd <= MAX_ANCIL_DATA_FDS);
-            p->read_ancil_data.nfd = b.nfd;
-            memcpy(p->read_ancil_data.fds, b.fds, sizeof(int) * b.nfd);
-            p->read_ancil_data.close_fds_on_cleanup = b.close_fds_on_cleanup;
+        else
+            if ((r = pa_iochannel_write_with_fds(p->io, d, l, p->write_ancil_data->nfd, p->write_ancil_data->fds)) < 0)
+                goto fail;
+
+        /* If nothing went out, the ancillary data has to go with the
+         * next try */
+        if (r > 0) {
+            pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
+            p->send_ancil_data_now = false;
         }
-    }
-#else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
+    } else
+#endif
+    if (p->srb) {
+        r = pa_srbchannel_write(p->srb, d, l);
+        socket_write = false;
+    } else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
         goto fail;
+
+    if (release_memblock)
+        pa_memblock_release(release_memblock);
+
+    if (socket_write) {
+        p->n_writes++;
+
+        if (p->write.index + (size_t) r >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]))
+            p->n_frames_written++;
+    }
+
+    return write_done(p, &p->write, (size_t) r, l);
+
+fail:
+#ifdef HAVE_CREDS
+    if (p->send_ancil_data_now)
+        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
 #endif
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
 
-    re->index += (size_t) r;
+    return -1;
+}
 
-    if (re->index == PA_PSTREAM_DESCRIPTOR_SIZE) {
-        uint32_t flags, length, channel;
-        /* Reading of frame descriptor complete */
+static int do_write_lane(pa_pstream *p, struct pstream_lane *lane) {
+    struct pstream_write *w = &lane->write;
+    void *d;
+    size_t l, r;
+    pa_memblock *release_memblock = NULL;
 
-        flags = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
+    if (!w->current)
+        prepare_write_item(p, w, lane->send_queue);
 
-        if (!p->use_shm && (flags & PA_FLAG_SHMMASK) != 0) {
-            pa_log_warn("Received SHM frame on a socket where SHM is disabled.");
-            return -1;
-        }
+    if (!w->current)
+        return 0;
+
+    if (w->index == 0) {
+        if (!p->write.current)
+            prepare_write_item(p, &p->write, p->send_queue);
+
+        if (p->write.current && SEQ_BEFORE(p->write.current->seq, w->current->seq))
+            return 0;
+
+        tag_epoch(p, w, true);
+    }
+
+    d = get_write_data(w, &l, &release_memblock);
+
+    r = pa_srbchannel_write_lane(p->srb, lane->index, d, l);
+
+    if (release_memblock)
+        pa_memblock_release(release_memblock);
+
+    return write_done(p, w, r, l);
+}
+
+static void do_write_srb(pa_pstream *p) {
+    bool progress;
+
+    do {
+        unsigned i;
+
+        progress = false;
+
+        for (i = 0; i < p->n_lanes && !p->dead; i++)
+            while (!p->dead && i < p->n_lanes && do_write_lane(p, &p->lanes[i]) > 0)
+                progress = true;
+
+        if (!p->dead && p->srb && do_write(p) > 0)
+            progress = true;
+
+    } while (progress && !p->dead && p->srb);
+}
+
+static void memblock_complete(pa_pstream *p, struct pstream_read *re) {
+    pa_memchunk chunk;
+    int64_t offset;
+
+    if (!p->receive_memblock_callback)
+        return;
+
+    chunk.memblock = re->memblock;
+    chunk.index = 0;
+    chunk.length = re->index - PA_PSTREAM_DESCRIPTOR_SIZE;
+
+    offset = (int64_t) (
+             (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
+             (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
 
-        if (flags == PA_FLAG_SHMRELEASE) {
+    p->receive_memblock_callback(
+        p,
+        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+        offset,
+        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
+        &chunk,
+        p->receive_memblock_callback_userdata);
+}
 
-            /* This is a SHM memblock release frame with no payload */
+static void read_frame_done(pa_pstream *p, struct pstream_read *re) {
+    if (re == &p->readio)
+        p->n_frames_read++;
+
+    re->memblock = NULL;
+    re->packet = NULL;
+    re->index = 0;
+    re->data = NULL;
+
+#ifdef HAVE_CREDS
+    /* FIXME: Close received ancillary data fds if the pstream's
+     * receive_packet_callback did not do so.
+     *
+     * Malicious clients can attach fds to unknown commands, or attach them
+     * to commands that does not expect fds. By doing so, server will reach
+     * its open fd limit and future clients' SHM transfers will always fail.
+     */
+    p->read_ancil_data.creds_valid = false;
+    p->read_ancil_data.nfd = 0;
+#endif
+}
+
+/* Reading of frame descriptor complete */
+static int handle_descriptor(pa_pstream *p, struct pstream_read *re) {
+    uint32_t flags, length, channel;
+
+    flags = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
+
+    if (!p->use_shm && (flags & PA_FLAG_SHMMASK) != 0) {
+        pa_log_warn("Received SHM frame on a socket where SHM is disabled.");
+        return -1;
+    }
+
+    if (flags == PA_FLAG_SHMRELEASE) {
+
+        /* This is a SHM memblock release frame with no payload */
 
 /*             pa_log("Got release frame for %u", ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
-            pa_assert(p->export);
-            pa_memexport_process_release(p->export, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+        pa_assert(p->export);
+        pa_memexport_process_release(p->export, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
 
-            goto frame_done;
+        read_frame_done(p, re);
+        return 0;
 
-        } else if (flags == PA_FLAG_SHMREVOKE) {
+    } else if (flags == PA_FLAG_SHMREVOKE) {
 
-            /* This is a SHM memblock revoke frame with no payload */
+        /* This is a SHM memblock revoke frame with no payload */
 
 /*             pa_log("Got revoke frame for %u", ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
-            pa_assert(p->import);
-            pa_memimport_process_revoke(p->import, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+        pa_assert(p->import);
+        pa_memimport_process_revoke(p->import, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+
+        read_frame_done(p, re);
+        return 0;
+    }
+
+    length = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+
+    if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
+        pa_log_warn("Received invalid frame size: %lu", (unsigned long) length);
+        return -1;
+    }
+
+    pa_assert(!re->packet && !re->memblock);
+
+    channel = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]);
 
-            goto frame_done;
+    if (channel == (uint32_t) -1) {
+        size_t plen;
+
+        if (re->lane) {
+            pa_log_warn("Received packet frame on a srbchannel lane.");
+            return -1;
         }
 
-        length = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+        if (flags == (PA_FLAG_SHMRELEASE | PA_FLAG_SHMBATCH) || flags == (PA_FLAG_SHMREVOKE | PA_FLAG_SHMBATCH)) {
 
-        if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
-            pa_log_warn("Received invalid frame size: %lu", (unsigned long) length);
+            if (length % sizeof(uint32_t) != 0) {
+                pa_log_warn("Received block ID batch frame with invalid frame length.");
+                return -1;
+            }
+
+        } else if (flags != 0) {
+            pa_log_warn("Received packet frame with invalid flags value.");
             return -1;
         }
 
-        pa_assert(!re->packet && !re->memblock);
+        /* Frame is a packet frame, or a batch of block IDs */
+        re->packet = pa_packet_new(length);
+        re->data = (void *) pa_packet_data(re->packet, &plen);
 
-        channel = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]);
+    } else {
 
-        if (channel == (uint32_t) -1) {
-            size_t plen;
+        if ((flags & PA_FLAG_SEEKMASK) > PA_SEEK_RELATIVE_END) {
+            pa_log_warn("Received memblock frame with invalid seek mode.");
+            return -1;
+        }
 
-            if (flags != 0) {
-                pa_log_warn("Received packet frame with invalid flags value.");
+        if (((flags & PA_FLAG_SHMMASK) & PA_FLAG_SHMDATA) != 0) {
+
+            if (length != sizeof(re->shm_info)) {
+                pa_log_warn("Received SHM memblock frame with invalid frame length.");
                 return -1;
             }
 
-            /* Frame is a packet frame */
-            re->packet = pa_packet_new(length);
-            re->data = (void *) pa_packet_data(re->packet, &plen);
+            /* Frame is a memblock frame referencing an SHM memblock */
+            re->data = re->shm_info;
+
+        } else if ((flags & PA_FLAG_SHMMASK) == 0) {
+
+            /* Frame is a memblock frame */
 
+            re->memblock = pa_memblock_new(p->mempool, length);
+            re->data = NULL;
         } else {
 
-            if ((flags & PA_FLAG_SEEKMASK) > PA_SEEK_RELATIVE_END) {
-                pa_log_warn("Received memblock frame with invalid seek mode.");
-                return -1;
-            }
+            pa_log_warn("Received memblock frame with invalid flags value.");
+            return -1;
+        }
+    }
 
-            if (((flags & PA_FLAG_SHMMASK) & PA_FLAG_SHMDATA) != 0) {
+    return 0;
+}
 
-                if (length != sizeof(re->shm_info)) {
-                    pa_log_warn("Received SHM memblock frame with invalid frame length.");
-                    return -1;
-                }
+#ifdef HAVE_CREDS
+/* The kernel hands out fds with the read that reaches the data they
+ * were sent with, and ends that read right after this data. Since fds
+ * are only ever sent along with the start of a frame, they belong to
+ * the last frame that starts before the end of that read. */
+static void attach_read_fds(pa_pstream *p, struct pstream_read *re) {
+    uint64_t frame_end;
+
+    if (p->read_fds_pending.nfd <= 0)
+        return;
 
-                /* Frame is a memblock frame referencing an SHM memblock */
-                re->data = re->shm_info;
+    /* Wait for the length of the frame */
+    if (re->index < PA_PSTREAM_DESCRIPTOR_SIZE)
+        return;
 
-            } else if ((flags & PA_FLAG_SHMMASK) == 0) {
+    frame_end = p->read_frame_start + PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 
-                /* Frame is a memblock frame */
+    /* Another frame starts before the end of the read */
+    if (frame_end < p->read_fds_end)
+        return;
 
-                re->memblock = pa_memblock_new(p->mempool, length);
-                re->data = NULL;
-            } else {
+    p->read_ancil_data.nfd = p->read_fds_pending.nfd;
+    memcpy(p->read_ancil_data.fds, p->read_fds_pending.fds, sizeof(int) * p->read_fds_pending.nfd);
+    p->read_ancil_data.close_fds_on_cleanup = p->read_fds_pending.close_fds_on_cleanup;
 
-                pa_log_warn("Received memblock frame with invalid flags value.");
-                return -1;
+    p->read_fds_pending.nfd = 0;
+    p->read_fds_pending.close_fds_on_cleanup = false;
+}
+#endif
+
+static ssize_t read_socket(pa_pstream *p, struct pstream_read *re, void *d, size_t l) {
+    ssize_t r;
+#ifdef HAVE_CREDS
+    pa_cmsg_ancil_data b;
+
+    r = pa_iochannel_read_with_ancil_data(p->io, d, l, &b);
+    p->n_reads++;
+
+    if (r <= 0)
+        return r;
+
+    if ((p->read_buffer_creds_valid = b.creds_valid)) {
+        p->read_buffer_creds = b.creds;
+        p->read_ancil_data.creds_valid = true;
+        p->read_ancil_data.creds = b.creds;
+    }
+
+    if (b.nfd > 0) {
+        pa_assert(b.nfd <= MAX_ANCIL_DATA_FDS);
+
+        /* Never happens unless the other end sent fds in the middle of
+         * a frame descriptor */
+        if (p->read_fds_pending.nfd > 0) {
+            pa_log_warn("Received file descriptors for a frame that has none.");
+            pa_cmsg_ancil_data_close_fds(&p->read_fds_pending);
+        }
+
+        p->read_fds_pending.nfd = b.nfd;
+        memcpy(p->read_fds_pending.fds, b.fds, sizeof(int) * b.nfd);
+        p->read_fds_pending.close_fds_on_cleanup = b.close_fds_on_cleanup;
+        p->read_fds_end = p->read_pos + (size_t) r;
+
+        attach_read_fds(p, re);
+    }
+#else
+    r = pa_iochannel_read(p->io, d, l);
+    p->n_reads++;
+#endif
+
+    return r;
+}
+
+/* Reads from the socket through the read buffer, unless there is more
+ * to read for the current frame than fits in there anyway */
+static ssize_t read_io(pa_pstream *p, struct pstream_read *re, void *d, size_t l) {
+    ssize_t r;
+
+    if (re->index == 0) {
+        p->read_frame_start = p->read_pos;
+
+#ifdef HAVE_CREDS
+        if (p->read_buffer_index < p->read_buffer_length && p->read_buffer_creds_valid) {
+            p->read_ancil_data.creds_valid = true;
+            p->read_ancil_data.creds = p->read_buffer_creds;
+        }
+#endif
+    }
+
+    if (p->read_buffer_index >= p->read_buffer_length) {
+        size_t n = READ_BUFFER_SIZE;
+
+        p->read_buffer_index = p->read_buffer_length = 0;
+
+        if (l >= READ_BUFFER_SIZE) {
+            if ((r = read_socket(p, re, d, l)) > 0)
+                p->read_pos += (size_t) r;
+
+            return r;
+        }
+
+#ifdef HAVE_CREDS
+        /* Don't read past the descriptor of the frame that waits for
+         * its fds, so that no other fds come in before it got them */
+        if (p->read_fds_pending.nfd > 0)
+            n = l;
+#endif
+
+        if (!p->read_buffer)
+            p->read_buffer = pa_xmalloc(READ_BUFFER_SIZE);
+
+        if ((r = read_socket(p, re, p->read_buffer, n)) <= 0)
+            return r;
+
+        p->read_buffer_length = (size_t) r;
+    }
+
+    r = (ssize_t) PA_MIN(l, p->read_buffer_length - p->read_buffer_index);
+    memcpy(d, p->read_buffer + p->read_buffer_index, (size_t) r);
+    p->read_buffer_index += (size_t) r;
+    p->read_pos += (size_t) r;
+
+    return r;
+}
+
+static int do_read(pa_pstream *p, struct pstream_read *re) {
+    void *d;
+    size_t l;
+    ssize_t r;
+    pa_memblock *release_memblock = NULL;
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (re->held) {
+        if (re->epoch != p->read_epoch)
+            return 1;
+
+        re->held = false;
+        return handle_descriptor(p, re);
+    }
+
+    if (re->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        d = (uint8_t*) re->descriptor + re->index;
+        l = PA_PSTREAM_DESCRIPTOR_SIZE - re->index;
+    } else {
+        pa_assert(re->data || re->memblock);
+
+        if (re->data)
+            d = re->data;
+        else {
+            d = pa_memblock_acquire(re->memblock);
+            release_memblock = re->memblock;
+        }
+
+        d = (uint8_t*) d + re->index - PA_PSTREAM_DESCRIPTOR_SIZE;
+        l = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (re->index - PA_PSTREAM_DESCRIPTOR_SIZE);
+    }
+
+    if (re == &p->readsrb || re->lane) {
+        if (re->lane)
+            r = pa_srbchannel_read_lane(p->srb, re->lane->index, d, l);
+        else
+            r = pa_srbchannel_read(p->srb, d, l);
+        if (r == 0) {
+            if (release_memblock)
+                pa_memblock_release(release_memblock);
+            return 1;
+        }
+    }
+    else if ((r = read_io(p, re, d, l)) <= 0)
+        goto fail;
+
+    if (release_memblock)
+        pa_memblock_release(release_memblock);
+
+    re->index += (size_t) r;
+
+    if (re->index == PA_PSTREAM_DESCRIPTOR_SIZE) {
+
+#ifdef HAVE_CREDS
+        if (re == &p->readio)
+            attach_read_fds(p, re);
+#endif
+
+        if (p->n_lanes > 0 && re != &p->readio) {
+            uint32_t flags = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
+
+            re->epoch = (flags & PA_FLAG_EPOCHMASK) >> PA_FLAG_EPOCHSHIFT;
+            re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags & ~PA_FLAG_EPOCHMASK);
+
+            /* Frames of a later epoch wait for the current one to end */
+            if (re->epoch != p->read_epoch) {
+                re->held = true;
+                return 0;
             }
         }
 
+        return handle_descriptor(p, re);
+
     } else if (re->index >= ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) + PA_PSTREAM_DESCRIPTOR_SIZE) {
         /* Frame complete */
 
@@ -1005,6 +1843,13 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
             /* This was a memblock frame. We can unref the memblock now */
             pa_memblock_unref(re->memblock);
 
+        } else if (re->packet && ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) != 0) {
+
+            /* This is a batch of SHM memblock releases or revokes */
+            process_block_id_batch(p, re->packet, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]));
+
+            pa_packet_unref(re->packet);
+
         } else if (re->packet) {
 
             if (p->receive_packet_callback)
@@ -1025,7 +1870,19 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
             pa_assert(((flags & PA_FLAG_SHMMASK) & PA_FLAG_SHMDATA) != 0);
             pa_assert(p->import);
 
-            if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd &&
+            if (flags & PA_FLAG_SHMDATA_RING) {
+
+                if (p->ring_callback)
+                    b = p->ring_callback(p,
+                                         ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+                                         ntohl(re->shm_info[PA_PSTREAM_SHM_INDEX]),
+                                         ntohl(re->shm_info[PA_PSTREAM_SHM_LENGTH]),
+                                         p->ring_callback_userdata);
+
+                if (!b && pa_log_ratelimit(PA_LOG_DEBUG))
+                    pa_log_debug("Failed to take ring data.");
+
+            } else if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd &&
                 !pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
 
                 if (pa_log_ratelimit(PA_LOG_ERROR))
@@ -1074,22 +1931,7 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
     return 0;
 
 frame_done:
-    re->memblock = NULL;
-    re->packet = NULL;
-    re->index = 0;
-    re->data = NULL;
-
-#ifdef HAVE_CREDS
-    /* FIXME: Close received ancillary data fds if the pstream's
-     * receive_packet_callback did not do so.
-     *
-     * Malicious clients can attach fds to unknown commands, or attach them
-     * to commands that does not expect fds. By doing so, server will reach
-     * its open fd limit and future clients' SHM transfers will always fail.
-     */
-    p->read_ancil_data.creds_valid = false;
-    p->read_ancil_data.nfd = 0;
-#endif
+    read_frame_done(p, re);
 
     return 0;
 
@@ -1100,6 +1942,75 @@ fail:
     return -1;
 }
 
+/* Once every ring of the srbchannel is either drained or held up by a
+ * frame of a later epoch, the current epoch is over, see tag_epoch() */
+static void next_read_epoch(pa_pstream *p) {
+    uint32_t mask = PA_FLAG_EPOCHMASK >> PA_FLAG_EPOCHSHIFT;
+    uint32_t next = p->read_epoch, distance = mask + 1, d;
+    unsigned i;
+
+    if (p->readsrb.held) {
+        distance = (p->readsrb.epoch - p->read_epoch) & mask;
+        next = p->readsrb.epoch;
+    }
+
+    for (i = 0; i < p->n_lanes; i++) {
+        struct pstream_read *re = &p->lanes[i].read;
+
+        if (re->held && (d = (re->epoch - p->read_epoch) & mask) < distance) {
+            distance = d;
+            next = re->epoch;
+        }
+    }
+
+    p->read_epoch = next;
+}
+
+static int do_read_srb(pa_pstream *p) {
+    int r = 0;
+
+    if (p->n_lanes == 0) {
+        while (!p->dead && (r = do_read(p, &p->readsrb)) == 0);
+        return p->dead ? 0 : r;
+    }
+
+    for (;;) {
+        bool progress = false, held;
+        unsigned i;
+
+        while (!p->dead && (r = do_read(p, &p->readsrb)) == 0)
+            progress = true;
+        if (r < 0)
+            return -1;
+
+        held = p->readsrb.held;
+
+        for (i = 0; i < p->n_lanes && !p->dead; i++) {
+            while (!p->dead && i < p->n_lanes && (r = do_read(p, &p->lanes[i].read)) == 0)
+                progress = true;
+            if (r < 0)
+                return -1;
+
+            held = held || p->lanes[i].read.held;
+        }
+
+        if (p->dead || p->n_lanes == 0)
+            return 0;
+
+        /* A frame of a later epoch may only be seen after all frames of
+         * the current one are complete. Anything that was still missing
+         * when the first of them was seen has been read by now, unless
+         * this round still made progress. */
+        if (progress)
+            continue;
+
+        if (!held)
+            return 0;
+
+        next_read_epoch(p);
+    }
+}
+
 void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -1140,6 +2051,22 @@ void pa_pstream_set_release_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb,
     p->release_callback_userdata = userdata;
 }
 
+void pa_pstream_set_ring_callback(pa_pstream *p, pa_pstream_ring_cb_t cb, void *userdata) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->ring_callback = cb;
+    p->ring_callback_userdata = userdata;
+}
+
+void pa_pstream_set_memfd_segment_callback(pa_pstream *p, pa_pstream_mempool_cb_t cb, void *userdata) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->memfd_segment_callback = cb;
+    p->memfd_segment_callback_userdata = userdata;
+}
+
 void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -1157,7 +2084,9 @@ bool pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = false;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write.current || p->n_write_ahead > 0 || !pa_queue_isempty(p->send_queue) ||
+            p->release_batch.n > 0 || p->revoke_batch.n > 0 ||
+            lanes_are_pending(p);
 
     return b;
 }
@@ -1213,6 +2142,7 @@ void pa_pstream_unlink(pa_pstream *p) {
     p->drain_callback = NULL;
     p->receive_packet_callback = NULL;
     p->receive_memblock_callback = NULL;
+    p->ring_callback = NULL;
 }
 
 void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
@@ -1223,9 +2153,13 @@ void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
 
     if (enable) {
 
-        if (!p->export)
+        if (!p->export) {
             p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
 
+            if (p->max_export_slots)
+                pa_memexport_enable_max_slots(p->export);
+        }
+
     } else {
 
         if (p->export) {
@@ -1244,9 +2178,51 @@ void pa_pstream_enable_memfd(pa_pstream *p) {
 
     if (!p->registered_memfd_ids) {
         p->registered_memfd_ids = pa_idxset_new(NULL, NULL);
+        p->confirmed_memfd_ids = pa_idxset_new(NULL, NULL);
     }
 }
 
+void pa_pstream_enable_max_export_slots(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->max_export_slots = true;
+
+    if (p->export)
+        pa_memexport_enable_max_slots(p->export);
+}
+
+void pa_pstream_enable_block_id_batching(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->batch_block_ids = true;
+}
+
+void pa_pstream_get_block_id_stat(pa_pstream *p, unsigned *n_block_ids, unsigned *n_frames) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(n_block_ids);
+    pa_assert(n_frames);
+
+    *n_block_ids = p->n_block_ids_sent;
+    *n_frames = p->n_block_id_frames_sent;
+}
+
+void pa_pstream_get_io_stat(pa_pstream *p, unsigned *n_frames_written, unsigned *n_writes, unsigned *n_frames_read, unsigned *n_reads) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(n_frames_written);
+    pa_assert(n_writes);
+    pa_assert(n_frames_read);
+    pa_assert(n_reads);
+
+    *n_frames_written = p->n_frames_written;
+    *n_writes = p->n_writes;
+    *n_frames_read = p->n_frames_read;
+    *n_reads = p->n_reads;
+}
+
 bool pa_pstream_get_shm(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
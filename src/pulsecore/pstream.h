@@ -40,6 +40,8 @@ typedef void (*pa_pstream_packet_cb_t)(pa_pstream *p, pa_packet *packet, pa_cmsg
 typedef void (*pa_pstream_memblock_cb_t)(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
 typedef void (*pa_pstream_notify_cb_t)(pa_pstream *p, void *userdata);
 typedef void (*pa_pstream_block_id_cb_t)(pa_pstream *p, uint32_t block_id, void *userdata);
+typedef pa_memblock *(*pa_pstream_ring_cb_t)(pa_pstream *p, uint32_t channel, size_t index, size_t length, void *userdata);
+typedef void (*pa_pstream_mempool_cb_t)(pa_pstream *p, pa_mempool *pool, void *userdata);
 
 pa_pstream* pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *p);
 
@@ -49,9 +51,12 @@ void pa_pstream_unref(pa_pstream*p);
 void pa_pstream_unlink(pa_pstream *p);
 
 int pa_pstream_attach_memfd_shmid(pa_pstream *p, unsigned shm_id, int memfd_fd);
+bool pa_pstream_memfd_is_registered(pa_pstream *p, unsigned shm_id);
+void pa_pstream_confirm_memfd_shmid(pa_pstream *p, unsigned shm_id);
 
 void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data);
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk);
+void pa_pstream_send_ring_data(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, size_t index, size_t length);
 void pa_pstream_send_release(pa_pstream *p, uint32_t block_id);
 void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id);
 
@@ -62,10 +67,38 @@ void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void
 void pa_pstream_set_release_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb, void *userdata);
 void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb, void *userdata);
 
+/* Resolves data written into a pa_write_ring by the other end. The
+ * returned memblock is passed on to the memblock callback and unreffed
+ * afterwards. If NULL is returned, the data is skipped over. */
+void pa_pstream_set_ring_callback(pa_pstream *p, pa_pstream_ring_cb_t cb, void *userdata);
+
+/* Called when a block is about to be sent from a memfd pool that is
+ * registered with the pstream, but has grown by segments that are not.
+ * The callback may register them before the block is queued. Blocks
+ * from unregistered segments are copied. */
+void pa_pstream_set_memfd_segment_callback(pa_pstream *p, pa_pstream_mempool_cb_t cb, void *userdata);
+
 bool pa_pstream_is_pending(pa_pstream *p);
 
 void pa_pstream_enable_shm(pa_pstream *p, bool enable);
 void pa_pstream_enable_memfd(pa_pstream *p);
+
+/* Releases and revokes are then collected and sent together with the
+ * next write. Only for peers with protocol version 33 or newer. */
+void pa_pstream_enable_block_id_batching(pa_pstream *p);
+
+/* Lets as many blocks be exported to the other end at a time as the
+ * memexport can hold, instead of the 128 that older peers can take.
+ * Only for peers with protocol version 35 or newer. */
+void pa_pstream_enable_max_export_slots(pa_pstream *p);
+
+/* Block IDs released or revoked so far, and the frames it took */
+void pa_pstream_get_block_id_stat(pa_pstream *p, unsigned *n_block_ids, unsigned *n_frames);
+
+/* Frames written to and read from the socket so far, and the system
+ * calls it took */
+void pa_pstream_get_io_stat(pa_pstream *p, unsigned *n_frames_written, unsigned *n_writes, unsigned *n_frames_read, unsigned *n_reads);
+
 bool pa_pstream_get_shm(pa_pstream *p);
 bool pa_pstream_get_memfd(pa_pstream *p);
 
@@ -22,8 +22,11 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -121,13 +124,620 @@ static void remap_mono_to_stereo_float32ne_sse2(pa_remap_t *m, float *dst, const
     );
 }
 
+
+/* State of the matrix and arrangement remappers, stored in m->state.
+ *
+ * The matrix kernels compute one output frame at a time as the sum over
+ * all input channels of the broadcast input sample times that channel's
+ * column of factors, which covers up to 8 output channels. Like the
+ * generic C code, factors <= 0 are skipped and factors >= 1 add the
+ * sample unscaled, so for s16 each term is stored as the low 16 bits of
+ * the factor for pmulhw plus a mask selecting the sample itself: for
+ * factors in [0x8000, 0x10000] pmulhw with the (negative) low bits
+ * yields (s * vol >> 16) - s. This reproduces the C code exactly. */
+struct remap_matrix {
+    float cols_f[PA_CHANNELS_MAX][8];
+    int16_t cols_i[PA_CHANNELS_MAX][2][8];
+
+    /* the N -> stereo downmix handles several frames per register,
+     * the factors are repeated for each of them */
+    float rows_f[2][8];
+    float pairs_f[PA_CHANNELS_MAX][4];
+    int16_t pairs_i[PA_CHANNELS_MAX][2][8];
+
+    int32_t load_mask[8];
+    int32_t store_mask[8];
+
+    /* arrangement: vpermps indices, lanes to clear and pshufb table */
+    int32_t perm[8];
+    int32_t keep_mask[8];
+    uint8_t shuffle[16];
+    int8_t arrange[PA_CHANNELS_MAX];
+};
+
+static struct remap_matrix *remap_matrix_new(const pa_remap_t *m, const int8_t *arrange) {
+    struct remap_matrix *t;
+    unsigned n_ic, n_oc, ic, oc;
+
+    n_ic = m->i_ss.channels;
+    n_oc = m->o_ss.channels;
+
+    t = pa_xnew0(struct remap_matrix, 1);
+
+    for (ic = 0; ic < n_ic; ic++) {
+        for (oc = 0; oc < n_oc && oc < 8; oc++) {
+            float f = m->map_table_f[oc][ic];
+            int32_t v = m->map_table_i[oc][ic];
+
+            t->cols_f[ic][oc] = PA_CLAMP_UNLIKELY(f, 0.0f, 1.0f);
+
+            if (v <= 0)
+                continue;
+
+            if (v >= 0x10000) {
+                t->cols_i[ic][1][oc] = -1;
+            } else {
+                t->cols_i[ic][0][oc] = (int16_t) (uint16_t) v;
+                t->cols_i[ic][1][oc] = v >= 0x8000 ? -1 : 0;
+            }
+        }
+
+        for (oc = 0; oc < 8; oc++) {
+            t->pairs_i[ic][0][oc] = t->cols_i[ic][0][oc % 2];
+            t->pairs_i[ic][1][oc] = t->cols_i[ic][1][oc % 2];
+        }
+
+        for (oc = 0; oc < 4; oc++)
+            t->pairs_f[ic][oc] = t->cols_f[ic][oc % 2];
+
+        if (ic < 8) {
+            t->rows_f[0][ic] = t->cols_f[ic][0];
+            t->rows_f[1][ic] = t->cols_f[ic][1];
+        }
+    }
+
+    for (oc = 0; oc < 8; oc++) {
+        t->load_mask[oc] = oc < n_ic ? -1 : 0;
+        t->store_mask[oc] = oc < n_oc ? -1 : 0;
+    }
+
+    if (arrange) {
+        memcpy(t->arrange, arrange, PA_CHANNELS_MAX);
+
+        for (oc = 0; oc < 8; oc++) {
+            if (oc < n_oc && arrange[oc] >= 0) {
+                t->perm[oc] = arrange[oc];
+                t->keep_mask[oc] = -1;
+                t->shuffle[oc * 2 + 0] = arrange[oc] * 2 + 0;
+                t->shuffle[oc * 2 + 1] = arrange[oc] * 2 + 1;
+            } else {
+                /* pshufb clears lanes with the top bit set */
+                t->shuffle[oc * 2 + 0] = 0x80;
+                t->shuffle[oc * 2 + 1] = 0x80;
+            }
+        }
+    }
+
+    return t;
+}
+
+/* Number of leading frames for which a vector of 'width' samples can be
+ * loaded or stored at the frame start without running past the end of
+ * a buffer of n frames of 'channels' samples. Stores that spill into
+ * the next frame are fine as it is written afterwards. */
+static unsigned frames_with_room(unsigned n, unsigned channels, unsigned width) {
+    unsigned tail = (width + channels - 1) / channels;
+
+    return n >= tail ? n - tail + 1 : 0;
+}
+
+/* Scalar versions of the matrix kernels for the last few frames */
+static void remap_matrix_frames_s16ne(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc, ic;
+
+    for (; n > 0; n--, src += n_ic) {
+        for (oc = 0; oc < n_oc; oc++) {
+            int16_t d = 0;
+
+            for (ic = 0; ic < n_ic; ic++) {
+                int32_t vol = m->map_table_i[oc][ic];
+
+                if (vol <= 0)
+                    continue;
+
+                if (vol >= 0x10000)
+                    d += src[ic];
+                else
+                    d += (int16_t) (((int32_t) src[ic] * vol) >> 16);
+            }
+
+            *dst++ = d;
+        }
+    }
+}
+
+static void remap_matrix_frames_float32ne(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc, ic;
+
+    for (; n > 0; n--, src += n_ic) {
+        for (oc = 0; oc < n_oc; oc++) {
+            float d = 0.0f;
+
+            for (ic = 0; ic < n_ic; ic++) {
+                float vol = m->map_table_f[oc][ic];
+
+                if (vol <= 0.0f)
+                    continue;
+
+                if (vol >= 1.0f)
+                    d += src[ic];
+                else
+                    d += src[ic] * vol;
+            }
+
+            *dst++ = d;
+        }
+    }
+}
+
+static void remap_arrange_frames_s16ne(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc;
+
+    for (; n > 0; n--, src += n_ic)
+        for (oc = 0; oc < n_oc; oc++)
+            *dst++ = t->arrange[oc] >= 0 ? src[t->arrange[oc]] : 0;
+}
+
+/* General matrix, up to 4 output channels, one xmm register per frame */
+static void remap_matrix_ch4_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const float *cols = t->cols_f[0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->o_ss.channels * sizeof(float);
+    pa_reg_x86 frames, temp, temp2;
+
+    frames = frames_with_room(n, m->o_ss.channels, 4);
+    n -= frames;
+
+    if (frames > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " xorps %%xmm0, %%xmm0          \n\t"
+            " mov %5, %3                    \n\t"
+            " mov %6, %4                    \n\t"
+            "2:                             \n\t"
+            " movss (%1), %%xmm2            \n\t"
+            " shufps $0, %%xmm2, %%xmm2     \n\t"
+            " movups (%3), %%xmm4           \n\t"
+            " mulps %%xmm4, %%xmm2          \n\t"
+            " addps %%xmm2, %%xmm0          \n\t"
+            " add $4, %1                    \n\t"
+            " add $32, %3                   \n\t"
+            " dec %4                        \n\t"
+            " jne 2b                        \n\t"
+            " movups %%xmm0, (%0)           \n\t"
+            " add %7, %0                    \n\t"
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            : "+r" (dst), "+r" (src), "+r" (frames), "=&r" (temp), "=&r" (temp2)
+            : "m" (cols), "m" (n_ic), "m" (stride)
+            : "cc", "memory", "xmm0", "xmm2", "xmm4"
+        );
+    }
+
+    remap_matrix_frames_float32ne(m, dst, src, n);
+}
+
+/* General matrix, up to 8 output channels in two xmm registers */
+static void remap_matrix_ch8_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const float *cols = t->cols_f[0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->o_ss.channels * sizeof(float);
+    pa_reg_x86 frames, temp, temp2;
+
+    frames = frames_with_room(n, m->o_ss.channels, 8);
+    n -= frames;
+
+    if (frames > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " xorps %%xmm0, %%xmm0          \n\t"
+            " xorps %%xmm1, %%xmm1          \n\t"
+            " mov %5, %3                    \n\t"
+            " mov %6, %4                    \n\t"
+            "2:                             \n\t"
+            " movss (%1), %%xmm2            \n\t"
+            " shufps $0, %%xmm2, %%xmm2     \n\t"
+            " movaps %%xmm2, %%xmm3         \n\t"
+            " movups (%3), %%xmm4           \n\t"
+            " movups 16(%3), %%xmm5         \n\t"
+            " mulps %%xmm4, %%xmm2          \n\t"
+            " mulps %%xmm5, %%xmm3          \n\t"
+            " addps %%xmm2, %%xmm0          \n\t"
+            " addps %%xmm3, %%xmm1          \n\t"
+            " add $4, %1                    \n\t"
+            " add $32, %3                   \n\t"
+            " dec %4                        \n\t"
+            " jne 2b                        \n\t"
+            " movups %%xmm0, (%0)           \n\t"
+            " movups %%xmm1, 16(%0)         \n\t"
+            " add %7, %0                    \n\t"
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            : "+r" (dst), "+r" (src), "+r" (frames), "=&r" (temp), "=&r" (temp2)
+            : "m" (cols), "m" (n_ic), "m" (stride)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5"
+        );
+    }
+
+    remap_matrix_frames_float32ne(m, dst, src, n);
+}
+
+/* General matrix, up to 8 output channels in one xmm register */
+static void remap_matrix_ch8_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const int16_t *cols = t->cols_i[0][0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->o_ss.channels * sizeof(int16_t);
+    pa_reg_x86 frames, temp, temp2;
+
+    frames = frames_with_room(n, m->o_ss.channels, 8);
+    n -= frames;
+
+    if (frames > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " pxor %%xmm0, %%xmm0           \n\t"
+            " mov %5, %3                    \n\t"
+            " mov %6, %4                    \n\t"
+            "2:                             \n\t"
+            " pinsrw $0, (%1), %%xmm1       \n\t" /* broadcast the sample */
+            " pshuflw $0, %%xmm1, %%xmm1    \n\t"
+            " punpcklqdq %%xmm1, %%xmm1     \n\t"
+            " movdqu (%3), %%xmm2           \n\t" /* low bits of the factors */
+            " movdqu 16(%3), %%xmm3         \n\t" /* add sample mask */
+            " pand %%xmm1, %%xmm3           \n\t"
+            " pmulhw %%xmm1, %%xmm2         \n\t"
+            " paddw %%xmm2, %%xmm0          \n\t"
+            " paddw %%xmm3, %%xmm0          \n\t"
+            " add $2, %1                    \n\t"
+            " add $32, %3                   \n\t"
+            " dec %4                        \n\t"
+            " jne 2b                        \n\t"
+            " movdqu %%xmm0, (%0)           \n\t"
+            " add %7, %0                    \n\t"
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            : "+r" (dst), "+r" (src), "+r" (frames), "=&r" (temp), "=&r" (temp2)
+            : "m" (cols), "m" (n_ic), "m" (stride)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    remap_matrix_frames_s16ne(m, dst, src, n);
+}
+
+/* N channels to stereo, four frames per iteration. The samples of an
+ * input channel are gathered from the four frames and duplicated for
+ * both outputs, i.e. [f0 f0 f1 f1 f2 f2 f3 f3]. */
+static void remap_chN_to_stereo_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const int16_t *cols = t->pairs_i[0][0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->i_ss.channels * sizeof(int16_t);
+    pa_reg_x86 skip = 3 * stride;
+    const int16_t *end = dst + (n & ~3) * 2;
+    pa_reg_x86 temp, temp2, temp3;
+
+    if (n >= 4) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " pxor %%xmm0, %%xmm0           \n\t"
+            " mov %5, %3                    \n\t"
+            " mov %6, %4                    \n\t"
+            "2:                             \n\t"
+            " mov %1, %2                    \n\t"
+            " pinsrw $0, (%2), %%xmm1       \n\t"
+            " add %7, %2                    \n\t"
+            " pinsrw $1, (%2), %%xmm1       \n\t"
+            " add %7, %2                    \n\t"
+            " pinsrw $2, (%2), %%xmm1       \n\t"
+            " add %7, %2                    \n\t"
+            " pinsrw $3, (%2), %%xmm1       \n\t"
+            " punpcklwd %%xmm1, %%xmm1      \n\t"
+            " movdqu (%3), %%xmm2           \n\t"
+            " movdqu 16(%3), %%xmm3         \n\t"
+            " pand %%xmm1, %%xmm3           \n\t"
+            " pmulhw %%xmm1, %%xmm2         \n\t"
+            " paddw %%xmm2, %%xmm0          \n\t"
+            " paddw %%xmm3, %%xmm0          \n\t"
+            " add $2, %1                    \n\t"
+            " add $32, %3                   \n\t"
+            " dec %4                        \n\t"
+            " jne 2b                        \n\t"
+            " movdqu %%xmm0, (%0)           \n\t"
+            " add %8, %1                    \n\t"
+            " add $16, %0                   \n\t"
+            " cmp %9, %0                    \n\t"
+            " jb 1b                         \n\t"
+            : "+r" (dst), "+r" (src), "=&r" (temp), "=&r" (temp2), "=&r" (temp3)
+            : "m" (cols), "m" (n_ic), "m" (stride), "m" (skip), "m" (end)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    remap_matrix_frames_s16ne(m, dst, src, n & 3);
+}
+
+static void remap_chN_to_stereo_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const float *cols = t->pairs_f[0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->i_ss.channels * sizeof(float);
+    pa_reg_x86 skip = 3 * stride;
+    const float *end = dst + (n & ~3) * 2;
+    pa_reg_x86 temp, temp2, temp3;
+
+    if (n >= 4) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " xorps %%xmm0, %%xmm0          \n\t"
+            " xorps %%xmm6, %%xmm6          \n\t"
+            " mov %5, %3                    \n\t"
+            " mov %6, %4                    \n\t"
+            "2:                             \n\t"
+            " mov %1, %2                    \n\t"
+            " movss (%2), %%xmm1            \n\t"
+            " add %7, %2                    \n\t"
+            " movss (%2), %%xmm2            \n\t"
+            " add %7, %2                    \n\t"
+            " movss (%2), %%xmm3            \n\t"
+            " add %7, %2                    \n\t"
+            " movss (%2), %%xmm4            \n\t"
+            " unpcklps %%xmm2, %%xmm1       \n\t"
+            " unpcklps %%xmm1, %%xmm1       \n\t"
+            " unpcklps %%xmm4, %%xmm3       \n\t"
+            " unpcklps %%xmm3, %%xmm3       \n\t"
+            " movups (%3), %%xmm5           \n\t"
+            " mulps %%xmm5, %%xmm1          \n\t"
+            " mulps %%xmm5, %%xmm3          \n\t"
+            " addps %%xmm1, %%xmm0          \n\t"
+            " addps %%xmm3, %%xmm6          \n\t"
+            " add $4, %1                    \n\t"
+            " add $16, %3                   \n\t"
+            " dec %4                        \n\t"
+            " jne 2b                        \n\t"
+            " movups %%xmm0, (%0)           \n\t"
+            " movups %%xmm6, 16(%0)         \n\t"
+            " add %8, %1                    \n\t"
+            " add $32, %0                   \n\t"
+            " cmp %9, %0                    \n\t"
+            " jb 1b                         \n\t"
+            : "+r" (dst), "+r" (src), "=&r" (temp), "=&r" (temp2), "=&r" (temp3)
+            : "m" (cols), "m" (n_ic), "m" (stride), "m" (skip), "m" (end)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6"
+        );
+    }
+
+    remap_matrix_frames_float32ne(m, dst, src, n & 3);
+}
+
+/* General matrix, up to 8 output channels. Masked stores never touch
+ * the next frame, so no scalar tail is needed. */
+static void remap_matrix_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    const float *cols = t->cols_f[0];
+    pa_reg_x86 n_ic = m->i_ss.channels;
+    pa_reg_x86 stride = m->o_ss.channels * sizeof(float);
+    pa_reg_x86 frames = n, temp, temp2;
+
+    if (frames == 0)
+        return;
+
+    __asm__ __volatile__ (
+        " vmovdqu %8, %%ymm7            \n\t"
+        "1:                             \n\t"
+        " vxorps %%ymm0, %%ymm0, %%ymm0 \n\t"
+        " mov %5, %3                    \n\t"
+        " mov %6, %4                    \n\t"
+        "2:                             \n\t"
+        " vbroadcastss (%1), %%ymm1     \n\t"
+        " vmulps (%3), %%ymm1, %%ymm1   \n\t"
+        " vaddps %%ymm1, %%ymm0, %%ymm0 \n\t"
+        " add $4, %1                    \n\t"
+        " add $32, %3                   \n\t"
+        " dec %4                        \n\t"
+        " jne 2b                        \n\t"
+        " vmaskmovps %%ymm0, %%ymm7, (%0) \n\t"
+        " add %7, %0                    \n\t"
+        " dec %2                        \n\t"
+        " jne 1b                        \n\t"
+        " vzeroupper                    \n\t"
+        : "+r" (dst), "+r" (src), "+r" (frames), "=&r" (temp), "=&r" (temp2)
+        : "m" (cols), "m" (n_ic), "m" (stride), "m" (*(const int32_t (*)[8]) t->store_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm7"
+    );
+}
+
+/* Stereo to 3..8 channels */
+static void remap_stereo_to_chN_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    pa_reg_x86 stride = m->o_ss.channels * sizeof(float);
+    pa_reg_x86 frames = n;
+
+    if (frames == 0)
+        return;
+
+    __asm__ __volatile__ (
+        " vmovdqu %4, %%ymm7            \n\t"
+        " vmovups %5, %%ymm5            \n\t"
+        " vmovups %6, %%ymm6            \n\t"
+        "1:                             \n\t"
+        " vbroadcastss (%1), %%ymm0     \n\t"
+        " vbroadcastss 4(%1), %%ymm1    \n\t"
+        " vmulps %%ymm5, %%ymm0, %%ymm0 \n\t"
+        " vmulps %%ymm6, %%ymm1, %%ymm1 \n\t"
+        " vaddps %%ymm1, %%ymm0, %%ymm0 \n\t"
+        " vmaskmovps %%ymm0, %%ymm7, (%0) \n\t"
+        " add $8, %1                    \n\t"
+        " add %3, %0                    \n\t"
+        " dec %2                        \n\t"
+        " jne 1b                        \n\t"
+        " vzeroupper                    \n\t"
+        : "+r" (dst), "+r" (src), "+r" (frames)
+        : "m" (stride), "m" (*(const int32_t (*)[8]) t->store_mask),
+          "m" (*(const float (*)[8]) t->cols_f[0]), "m" (*(const float (*)[8]) t->cols_f[1])
+        : "cc", "memory", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+/* 3..8 channels to stereo, two frames per iteration. Each frame is
+ * multiplied with both rows and the products are summed horizontally,
+ * so the result may differ from the C code in the last bits. */
+static void remap_chN_to_stereo_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    pa_reg_x86 stride = m->i_ss.channels * sizeof(float);
+    pa_reg_x86 frames = n / 2;
+
+    __asm__ __volatile__ (
+        " vmovdqu %4, %%ymm5            \n\t"
+        " vmovups %5, %%ymm6            \n\t"
+        " vmovups %6, %%ymm7            \n\t"
+        " test %2, %2                   \n\t"
+        " je 2f                         \n\t"
+        "1:                             \n\t"
+        " vmaskmovps (%1), %%ymm5, %%ymm0 \n\t"
+        " add %3, %1                    \n\t"
+        " vmaskmovps (%1), %%ymm5, %%ymm1 \n\t"
+        " add %3, %1                    \n\t"
+        " vmulps %%ymm6, %%ymm0, %%ymm2 \n\t"
+        " vmulps %%ymm7, %%ymm0, %%ymm3 \n\t"
+        " vmulps %%ymm6, %%ymm1, %%ymm4 \n\t"
+        " vmulps %%ymm7, %%ymm1, %%ymm1 \n\t"
+        " vhaddps %%ymm3, %%ymm2, %%ymm2 \n\t"
+        " vhaddps %%ymm1, %%ymm4, %%ymm4 \n\t"
+        " vhaddps %%ymm4, %%ymm2, %%ymm2 \n\t"
+        " vextractf128 $1, %%ymm2, %%xmm3 \n\t"
+        " vaddps %%xmm3, %%xmm2, %%xmm2 \n\t"
+        " vmovups %%xmm2, (%0)          \n\t"
+        " add $16, %0                   \n\t"
+        " dec %2                        \n\t"
+        " jne 1b                        \n\t"
+        "2:                             \n\t"
+        " vzeroupper                    \n\t"
+        : "+r" (dst), "+r" (src), "+r" (frames)
+        : "r" (stride), "m" (*(const int32_t (*)[8]) t->load_mask),
+          "m" (*(const float (*)[8]) t->rows_f[0]), "m" (*(const float (*)[8]) t->rows_f[1])
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+    );
+
+    if (n & 1)
+        remap_matrix_frames_float32ne(m, dst, src, 1);
+}
+
+/* Arrangement of up to 8 input to up to 8 output channels */
+static void remap_arrange_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    pa_reg_x86 istride = m->i_ss.channels * sizeof(float);
+    pa_reg_x86 ostride = m->o_ss.channels * sizeof(float);
+    pa_reg_x86 frames = n;
+
+    if (frames == 0)
+        return;
+
+    __asm__ __volatile__ (
+        " vmovdqu %5, %%ymm4            \n\t"
+        " vmovdqu %6, %%ymm5            \n\t"
+        " vmovdqu %7, %%ymm6            \n\t"
+        " vmovdqu %8, %%ymm7            \n\t"
+        "1:                             \n\t"
+        " vmaskmovps (%1), %%ymm4, %%ymm0 \n\t"
+        " vpermps %%ymm0, %%ymm6, %%ymm0 \n\t"
+        " vandps %%ymm7, %%ymm0, %%ymm0 \n\t"
+        " vmaskmovps %%ymm0, %%ymm5, (%0) \n\t"
+        " add %3, %1                    \n\t"
+        " add %4, %0                    \n\t"
+        " dec %2                        \n\t"
+        " jne 1b                        \n\t"
+        " vzeroupper                    \n\t"
+        : "+r" (dst), "+r" (src), "+r" (frames)
+        : "m" (istride), "m" (ostride),
+          "m" (*(const int32_t (*)[8]) t->load_mask), "m" (*(const int32_t (*)[8]) t->store_mask),
+          "m" (*(const int32_t (*)[8]) t->perm), "m" (*(const int32_t (*)[8]) t->keep_mask)
+        : "cc", "memory", "xmm0", "xmm4", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+static void remap_arrange_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const struct remap_matrix *t = m->state;
+    pa_reg_x86 istride = m->i_ss.channels * sizeof(int16_t);
+    pa_reg_x86 ostride = m->o_ss.channels * sizeof(int16_t);
+    pa_reg_x86 frames;
+
+    /* Loads and stores are 16 bytes wide, leave the last frames to C */
+    frames = PA_MIN(frames_with_room(n, m->i_ss.channels, 8), frames_with_room(n, m->o_ss.channels, 8));
+    n -= frames;
+
+    if (frames > 0) {
+        __asm__ __volatile__ (
+            " vmovdqu %5, %%xmm7            \n\t"
+            "1:                             \n\t"
+            " vmovdqu (%1), %%xmm0          \n\t"
+            " vpshufb %%xmm7, %%xmm0, %%xmm0 \n\t"
+            " vmovdqu %%xmm0, (%0)          \n\t"
+            " add %3, %1                    \n\t"
+            " add %4, %0                    \n\t"
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            : "+r" (dst), "+r" (src), "+r" (frames)
+            : "m" (istride), "m" (ostride), "m" (*(const uint8_t (*)[16]) t->shuffle)
+            : "cc", "memory", "xmm0", "xmm7"
+        );
+    }
+
+    remap_arrange_frames_s16ne(m, dst, src, n);
+}
+
+/* Channel layouts the generic C code already has special kernels for */
+static bool remap_is_special_c(const pa_remap_t *m, bool is_arrange) {
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+
+    if (is_arrange && (n_oc == 1 || n_oc == 2 || n_oc == 4))
+        return true;
+
+    if (n_ic == 2 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x8000 && m->map_table_i[0][1] == 0x8000)
+        return true;
+
+    if (n_ic == 1 && n_oc == 4 &&
+            m->map_table_i[0][0] == 0x10000 && m->map_table_i[1][0] == 0x10000 &&
+            m->map_table_i[2][0] == 0x10000 && m->map_table_i[3][0] == 0x10000)
+        return true;
+
+    if (n_ic == 4 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x4000 && m->map_table_i[0][1] == 0x4000 &&
+            m->map_table_i[0][2] == 0x4000 && m->map_table_i[0][3] == 0x4000)
+        return true;
+
+    return false;
+}
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
+    int8_t arrange[PA_CHANNELS_MAX];
+    bool is_arrange;
 
     n_oc = m->o_ss.channels;
     n_ic = m->i_ss.channels;
 
+    is_arrange = pa_setup_remap_arrange(m, arrange);
+
     /* find some common channel remappings, fall back to full matrix operation. */
     if (n_ic == 1 && n_oc == 2 &&
             m->map_table_i[0][0] == 0x10000 && m->map_table_i[1][0] == 0x10000) {
@@ -135,6 +745,79 @@ static void init_remap_sse2(pa_remap_t *m) {
         pa_log_info("Using SSE2 mono to stereo remapping");
         pa_set_remap_func(m, (pa_do_remap_func_t) remap_mono_to_stereo_s16ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_float32ne_sse2);
+    } else if (is_arrange || remap_is_special_c(m, is_arrange)) {
+        /* leave it to the C code, which skips unused channels */
+    } else if (n_ic > 2 && n_oc == 2) {
+
+        pa_log_info("Using SSE2 %u-channel to stereo remapping", n_ic);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_chN_to_stereo_s16ne_sse2,
+            (pa_do_remap_func_t) remap_chN_to_stereo_float32ne_sse2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, NULL);
+    } else if (n_oc <= 8) {
+
+        pa_log_info("Using SSE2 %u-channel to %u-channel matrix remapping", n_ic, n_oc);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_ch8_s16ne_sse2,
+            n_oc <= 4 ? (pa_do_remap_func_t) remap_matrix_ch4_float32ne_sse2 :
+                (pa_do_remap_func_t) remap_matrix_ch8_float32ne_sse2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, NULL);
+    }
+}
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+    int8_t arrange[PA_CHANNELS_MAX];
+    bool is_arrange;
+
+    n_oc = m->o_ss.channels;
+    n_ic = m->i_ss.channels;
+
+    is_arrange = pa_setup_remap_arrange(m, arrange);
+
+    if (n_ic == 1 && n_oc == 2 &&
+            m->map_table_i[0][0] == 0x10000 && m->map_table_i[1][0] == 0x10000) {
+
+        /* the SSE2 unpacking is as good as it gets */
+        init_remap_sse2(m);
+    } else if (remap_is_special_c(m, is_arrange)) {
+        /* leave it to the C code */
+    } else if (is_arrange && n_ic <= 8 && n_oc <= 8) {
+
+        pa_log_info("Using AVX2 %u-channel to %u-channel arrange remapping", n_ic, n_oc);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_arrange_s16ne_avx2,
+            (pa_do_remap_func_t) remap_arrange_float32ne_avx2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, arrange);
+    } else if (n_ic > 2 && n_ic <= 8 && n_oc == 2) {
+
+        pa_log_info("Using AVX2 %u-channel to stereo remapping", n_ic);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_chN_to_stereo_s16ne_sse2,
+            (pa_do_remap_func_t) remap_chN_to_stereo_float32ne_avx2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, NULL);
+    } else if (n_ic == 2 && n_oc > 2 && n_oc <= 8) {
+
+        pa_log_info("Using AVX2 stereo to %u-channel remapping", n_oc);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_ch8_s16ne_sse2,
+            (pa_do_remap_func_t) remap_stereo_to_chN_float32ne_avx2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, NULL);
+    } else if (is_arrange) {
+        /* leave it to the C code, which skips unused channels */
+    } else if (n_oc <= 8) {
+
+        pa_log_info("Using AVX2 %u-channel to %u-channel matrix remapping", n_ic, n_oc);
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_ch8_s16ne_sse2,
+            (pa_do_remap_func_t) remap_matrix_float32ne_avx2);
+
+        /* setup state */
+        m->state = remap_matrix_new(m, NULL);
     }
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -142,7 +825,10 @@ static void init_remap_sse2(pa_remap_t *m) {
 void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags) {
 #if defined (__i386__) || defined (__amd64__)
 
-    if (flags & PA_CPU_X86_SSE2) {
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+        pa_set_init_remap_func ((pa_init_remap_func_t) init_remap_avx2);
+    } else if (flags & PA_CPU_X86_SSE2) {
         pa_log_info("Initialising SSE2 optimized remappers.");
         pa_set_init_remap_func ((pa_init_remap_func_t) init_remap_sse2);
     }
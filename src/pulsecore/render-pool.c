@@ -0,0 +1,224 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
+
+#include "render-pool.h"
+
+enum {
+    WORKER_IDLE,
+    WORKER_ARMED,
+    WORKER_RUNNING,
+    WORKER_QUIT
+};
+
+struct worker {
+    pa_render_pool *pool;
+    pa_thread *thread;
+
+    /* One of WORKER_xxx. ARMED -> RUNNING is done by the worker,
+     * ARMED -> IDLE by pa_render_pool_join() if the worker did not
+     * wake up in time. */
+    pa_atomic_t state;
+
+    pa_semaphore *wakeup;
+    pa_semaphore *done;
+};
+
+struct pa_render_pool {
+    pa_thread_mq *thread_mq;
+    bool realtime;
+    int rtprio;
+
+    pa_mutex *mutex;
+
+    /* The batch currently in flight */
+    pa_render_pool_job_cb_t cb;
+    void *userdata;
+    unsigned n_jobs;
+    pa_atomic_t next_job;
+    unsigned n_armed;
+
+    struct worker *workers;
+    unsigned n_workers;
+};
+
+static void run_jobs(pa_render_pool *p) {
+    unsigned idx;
+
+    while ((idx = (unsigned) pa_atomic_inc(&p->next_job)) < p->n_jobs)
+        p->cb(p->userdata, idx);
+}
+
+static void thread_func(void *userdata) {
+    struct worker *w = userdata;
+    pa_render_pool *p = w->pool;
+
+    pa_thread_mq_install(p->thread_mq);
+
+    if (p->realtime)
+        pa_make_realtime(p->rtprio);
+
+    for (;;) {
+        pa_semaphore_wait(w->wakeup);
+
+        if (pa_atomic_load(&w->state) == WORKER_QUIT)
+            break;
+
+        /* We might have been disarmed because the batch was already
+         * completed without us. Then we just swallow the wakeup. */
+        if (!pa_atomic_cmpxchg(&w->state, WORKER_ARMED, WORKER_RUNNING))
+            continue;
+
+        run_jobs(p);
+
+        pa_atomic_store(&w->state, WORKER_IDLE);
+        pa_semaphore_post(w->done);
+    }
+}
+
+pa_render_pool *pa_render_pool_new(unsigned n_threads, pa_thread_mq *thread_mq, bool realtime, int rtprio) {
+    pa_render_pool *p;
+    unsigned i;
+
+    pa_assert(n_threads > 0);
+    pa_assert(thread_mq);
+
+    p = pa_xnew0(pa_render_pool, 1);
+    p->thread_mq = thread_mq;
+    p->realtime = realtime;
+    p->rtprio = rtprio;
+    p->mutex = pa_mutex_new(true, false);
+    pa_atomic_store(&p->next_job, 0);
+
+    p->workers = pa_xnew0(struct worker, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        struct worker *w = &p->workers[i];
+
+        w->pool = p;
+        pa_atomic_store(&w->state, WORKER_IDLE);
+        w->wakeup = pa_semaphore_new(0);
+        w->done = pa_semaphore_new(0);
+
+        if (!(w->thread = pa_thread_new("render-pool", thread_func, w))) {
+            pa_log("Failed to create render thread.");
+            pa_semaphore_free(w->wakeup);
+            pa_semaphore_free(w->done);
+            break;
+        }
+
+        p->n_workers++;
+    }
+
+    if (p->n_workers == 0) {
+        pa_render_pool_free(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+void pa_render_pool_free(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(p->n_armed == 0);
+
+    for (i = 0; i < p->n_workers; i++) {
+        struct worker *w = &p->workers[i];
+
+        pa_atomic_store(&w->state, WORKER_QUIT);
+        pa_semaphore_post(w->wakeup);
+        pa_thread_free(w->thread);
+
+        pa_semaphore_free(w->wakeup);
+        pa_semaphore_free(w->done);
+    }
+
+    pa_xfree(p->workers);
+    pa_mutex_free(p->mutex);
+    pa_xfree(p);
+}
+
+void pa_render_pool_start(pa_render_pool *p, pa_render_pool_job_cb_t cb, void *userdata, unsigned n_jobs) {
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(cb);
+    pa_assert(p->n_armed == 0);
+
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n_jobs = n_jobs;
+    pa_atomic_store(&p->next_job, 0);
+
+    /* The calling thread takes one of the jobs itself */
+    p->n_armed = n_jobs > 0 ? PA_MIN(p->n_workers, n_jobs - 1) : 0;
+
+    for (i = 0; i < p->n_armed; i++) {
+        struct worker *w = &p->workers[i];
+
+        pa_atomic_store(&w->state, WORKER_ARMED);
+        pa_semaphore_post(w->wakeup);
+    }
+}
+
+void pa_render_pool_join(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    run_jobs(p);
+
+    /* All jobs are claimed now. Workers still sleeping are no longer
+     * needed, the others finish the job they are on and report back. */
+    for (i = 0; i < p->n_armed; i++) {
+        struct worker *w = &p->workers[i];
+
+        if (!pa_atomic_cmpxchg(&w->state, WORKER_ARMED, WORKER_IDLE))
+            pa_semaphore_wait(w->done);
+    }
+
+    p->n_armed = 0;
+    p->cb = NULL;
+    p->userdata = NULL;
+}
+
+void pa_render_pool_lock(pa_render_pool *p) {
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+}
+
+void pa_render_pool_unlock(pa_render_pool *p) {
+    pa_assert(p);
+
+    pa_mutex_unlock(p->mutex);
+}
@@ -0,0 +1,53 @@
+#ifndef foorenderpoolhfoo
+#define foorenderpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+
+#include <pulsecore/thread-mq.h>
+
+/* A small pool of helper threads that lets an IO thread run a batch
+ * of independent jobs concurrently. The thread that starts a batch
+ * takes part in it and pa_render_pool_join() only ever waits for jobs
+ * that a worker has already begun. Workers that did not get to run
+ * before all jobs were claimed are disarmed, not waited for. Hence a
+ * batch never takes longer than running its jobs serially in the
+ * calling thread, plus the time of the longest single job.
+ *
+ * Workers install the thread_mq of the IO thread they serve, so code
+ * run in a job sees the same IO context as the caller. */
+
+typedef struct pa_render_pool pa_render_pool;
+
+typedef void (*pa_render_pool_job_cb_t)(void *userdata, unsigned idx);
+
+pa_render_pool *pa_render_pool_new(unsigned n_threads, pa_thread_mq *thread_mq, bool realtime, int rtprio);
+void pa_render_pool_free(pa_render_pool *p);
+
+/* Calls cb(userdata, idx) for every idx in [0, n_jobs), potentially
+ * concurrently. Only one batch can be in flight at any time. */
+void pa_render_pool_start(pa_render_pool *p, pa_render_pool_job_cb_t cb, void *userdata, unsigned n_jobs);
+void pa_render_pool_join(pa_render_pool *p);
+
+/* Serializes access to state shared between the jobs of a batch and
+ * the thread owning the pool */
+void pa_render_pool_lock(pa_render_pool *p);
+void pa_render_pool_unlock(pa_render_pool *p);
+
+#endif
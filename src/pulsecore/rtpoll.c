@@ -44,6 +44,12 @@
 
 /* #define DEBUG_TIMING */
 
+/* The busy poll window never shrinks below this */
+#define BUSY_POLL_MIN_USEC 20
+
+/* How often to pause between two non-blocking polls while busy polling */
+#define BUSY_POLL_PAUSES 32
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
@@ -51,6 +57,10 @@ struct pa_rtpoll {
     struct timeval next_elapse;
     bool timer_enabled:1;
 
+    /* How long before the timer elapses we may stop sleeping and spin
+     * instead, and how long we currently do. 0 if busy polling is off. */
+    pa_usec_t busy_poll_max, busy_poll_usec;
+
     bool scan_for_dead:1;
     bool running:1;
     bool rebuild_needed:1;
@@ -201,10 +211,46 @@ static void reset_all_revents(pa_rtpoll *p) {
     }
 }
 
+/* Polls the fds without blocking until one of them is ready or the
+ * timer elapses */
+static int busy_poll(pa_rtpoll *p) {
+    pa_usec_t deadline;
+    int r, k;
+
+    deadline = pa_timeval_load(&p->next_elapse);
+
+    for (;;) {
+        if ((r = pa_poll(p->pollfd, p->n_pollfd_used, 0)) != 0)
+            return r;
+
+        if (pa_rtclock_now() >= deadline)
+            return 0;
+
+        for (k = 0; k < BUSY_POLL_PAUSES; k++)
+            pa_cpu_relax();
+    }
+}
+
+/* Makes the busy poll window follow how late we wake up from the
+ * sleep: it grows right away when we wake up later than before, and
+ * shrinks slowly after that */
+static void busy_poll_adjust(pa_rtpoll *p, pa_usec_t late) {
+    pa_usec_t u;
+
+    if (late * 2 > p->busy_poll_usec)
+        u = late * 2;
+    else
+        u = p->busy_poll_usec - p->busy_poll_usec / 16;
+
+    p->busy_poll_usec = PA_CLAMP(u, PA_MIN(BUSY_POLL_MIN_USEC, p->busy_poll_max), p->busy_poll_max);
+}
+
 int pa_rtpoll_run(pa_rtpoll *p) {
     pa_rtpoll_item *i;
     int r = 0;
     struct timeval timeout;
+    pa_usec_t wakeup = 0;
+    bool busy = false;
 
     pa_assert(p);
     pa_assert(!p->running);
@@ -289,6 +335,19 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 
         if (pa_timeval_cmp(&p->next_elapse, &now) > 0)
             pa_timeval_add(&timeout, pa_timeval_diff(&p->next_elapse, &now));
+
+        /* Wake up early and spin for the rest of the time */
+        if (p->busy_poll_max > 0) {
+            pa_usec_t t = pa_timeval_load(&timeout);
+
+            busy = true;
+
+            if (t > p->busy_poll_usec) {
+                wakeup = pa_timeval_load(&now) + t - p->busy_poll_usec;
+                pa_timeval_store(&timeout, t - p->busy_poll_usec);
+            } else
+                pa_zero(timeout);
+        }
     }
 
 #ifdef DEBUG_TIMING
@@ -317,6 +376,17 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
 #endif
 
+    if (busy && r == 0) {
+        if (wakeup > 0) {
+            pa_usec_t now = pa_rtclock_now();
+
+            if (now > wakeup)
+                busy_poll_adjust(p, now - wakeup);
+        }
+
+        r = busy_poll(p);
+    }
+
     p->timer_elapsed = r == 0;
 
 #ifdef DEBUG_TIMING
@@ -390,6 +460,12 @@ void pa_rtpoll_set_timer_relative(pa_rtpoll *p, pa_usec_t usec) {
     p->timer_enabled = true;
 }
 
+void pa_rtpoll_set_busy_poll(pa_rtpoll *p, pa_usec_t usec) {
+    pa_assert(p);
+
+    p->busy_poll_max = p->busy_poll_usec = usec;
+}
+
 void pa_rtpoll_set_timer_disabled(pa_rtpoll *p) {
     pa_assert(p);
 
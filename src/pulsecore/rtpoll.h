@@ -64,6 +64,14 @@ void pa_rtpoll_set_timer_absolute(pa_rtpoll *p, pa_usec_t usec);
 void pa_rtpoll_set_timer_relative(pa_rtpoll *p, pa_usec_t usec);
 void pa_rtpoll_set_timer_disabled(pa_rtpoll *p);
 
+/* Stop sleeping up to usec before the timer elapses and spin for the
+ * rest of the time, polling the fds without blocking. This trades CPU
+ * time for less wakeup jitter and is only sensible on a CPU of its
+ * own. How long to spin is adapted to how late the wakeups from the
+ * sleep are, with usec as upper limit. 0 disables busy polling, which
+ * is the default. */
+void pa_rtpoll_set_busy_poll(pa_rtpoll *p, pa_usec_t usec);
+
 /* Return true when the elapsed timer was the reason for
  * the last pa_rtpoll_run() invocation to finish */
 bool pa_rtpoll_timer_elapsed(pa_rtpoll *p);
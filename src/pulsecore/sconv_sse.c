@@ -25,11 +25,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <pulsecore/g711.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 
 #include "cpu-x86.h"
 #include "sconv.h"
+#include "sconv-s16le.h"
 
 #if (!defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
 
@@ -158,20 +160,847 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
+static const PA_DECLARE_ALIGNED (16, float, scale_to[4]) = { 1.0f / (1U << 31), 1.0f / (1U << 31), 1.0f / (1U << 31), 1.0f / (1U << 31) };
+static const PA_DECLARE_ALIGNED (16, float, scale_from[4]) = { 1U << 31, 1U << 31, 1U << 31, 1U << 31 };
+
+/* s16le -> float: the samples are moved to the upper half of 32 bits,
+ * which converts them exactly like the C code with a single scale. */
+static void pa_sconv_s16le_to_float32ne_sse2(unsigned n, const int16_t *a, float *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            " movaps %3, %%xmm5             \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm2           \n\t" /* read 8 samples */
+            " pxor %%xmm0, %%xmm0           \n\t"
+            " pxor %%xmm1, %%xmm1           \n\t"
+            " punpcklwd %%xmm2, %%xmm0      \n\t" /* s << 16 */
+            " punpckhwd %%xmm2, %%xmm1      \n\t"
+            " cvtdq2ps %%xmm0, %%xmm0       \n\t"
+            " cvtdq2ps %%xmm1, %%xmm1       \n\t"
+            " mulps %%xmm5, %%xmm0          \n\t"
+            " mulps %%xmm5, %%xmm1          \n\t"
+            " movups %%xmm0, (%2)           \n\t"
+            " movups %%xmm1, 16(%2)         \n\t"
+
+            " add $16, %1                   \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "m" (*scale_to)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm5"
+        );
+    }
+
+    pa_sconv_s16le_to_float32ne(n - k, a, b);
+}
+
+static void pa_sconv_s32le_to_float32ne_sse2(unsigned n, const int32_t *a, float *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            " movaps %3, %%xmm5             \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t" /* read 8 samples */
+            " movdqu 16(%1), %%xmm1         \n\t"
+            " cvtdq2ps %%xmm0, %%xmm0       \n\t"
+            " cvtdq2ps %%xmm1, %%xmm1       \n\t"
+            " mulps %%xmm5, %%xmm0          \n\t"
+            " mulps %%xmm5, %%xmm1          \n\t"
+            " movups %%xmm0, (%2)           \n\t"
+            " movups %%xmm1, 16(%2)         \n\t"
+
+            " add $32, %1                   \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "m" (*scale_to)
+            : "cc", "memory", "xmm0", "xmm1", "xmm5"
+        );
+    }
+
+    pa_sconv_s32le_to_float32ne(n - k, a, b);
+}
+
+/* cvtps2dq returns 0x80000000 for anything out of range, the values
+ * that overflowed in the positive direction are flipped to 0x7fffffff */
+static void pa_sconv_s32le_from_float32ne_sse2(unsigned n, const float *a, int32_t *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            " movaps %3, %%xmm5             \n\t"
+
+            "1:                             \n\t"
+            " movups (%1), %%xmm0           \n\t" /* read 8 floats */
+            " movups 16(%1), %%xmm1         \n\t"
+            " mulps %%xmm5, %%xmm0          \n\t" /* *= 0x80000000 */
+            " mulps %%xmm5, %%xmm1          \n\t"
+            " movaps %%xmm0, %%xmm2         \n\t"
+            " movaps %%xmm1, %%xmm3         \n\t"
+            " cmpnltps %%xmm5, %%xmm2       \n\t" /* positive overflow */
+            " cmpnltps %%xmm5, %%xmm3       \n\t"
+            " cvtps2dq %%xmm0, %%xmm0       \n\t"
+            " cvtps2dq %%xmm1, %%xmm1       \n\t"
+            " pxor %%xmm2, %%xmm0           \n\t"
+            " pxor %%xmm3, %%xmm1           \n\t"
+            " movdqu %%xmm0, (%2)           \n\t"
+            " movdqu %%xmm1, 16(%2)         \n\t"
+
+            " add $32, %1                   \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "m" (*scale_from)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm5"
+        );
+    }
+
+    pa_sconv_s32le_from_float32ne(n - k, a, b);
+}
+
+static void pa_sconv_s16_swap_sse2(unsigned n, const int16_t *a, int16_t *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t" /* read 8 samples */
+            " movdqa %%xmm0, %%xmm1         \n\t"
+            " psrlw $8, %%xmm1              \n\t"
+            " psllw $8, %%xmm0              \n\t"
+            " por %%xmm1, %%xmm0            \n\t"
+            " movdqu %%xmm0, (%2)           \n\t"
+
+            " add $16, %1                   \n\t"
+            " add $16, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            :
+            : "cc", "memory", "xmm0", "xmm1"
+        );
+    }
+
+    for (n -= k; n > 0; n--, a++, b++)
+        *b = PA_INT16_SWAP(*a);
+}
+
+/* The other formats are done with byte shuffles (SSSE3 pshufb, or AVX2
+ * vpshufb on two lanes) described by a table per format. Integer
+ * samples are shuffled into the upper bytes of 32 bits for conversion
+ * to float, and picked from there after conversion from float, which
+ * gives the same results as the C code, including clipping. The SSE2
+ * functions above are faster for their formats and kept for them. */
+struct sconv_desc {
+    /* Reorders the input bytes of one lane, e.g. to s32 */
+    PA_DECLARE_ALIGNED (16, uint8_t, in_mask[16]);
+    /* Picks the output bytes of one lane */
+    PA_DECLARE_ALIGNED (16, uint8_t, out_mask[16]);
+    /* Applied after the input shuffle, or before the output shuffle */
+    PA_DECLARE_ALIGNED (16, uint8_t, xor_mask[16]);
+    /* Scale factor for int <-> float, and the clamp range after scaling
+     * for float -> int */
+    float scale, lo, hi;
+
+    /* Bytes per sample and samples per lane */
+    unsigned in_width, out_width, lane;
+
+    /* The function replaced, used for leftovers */
+    pa_convert_func_t tail;
+};
+
+#define Z 0x80
+
+#define TO_FLOAT(iw) \
+    .scale = 1.0f / (1U << 31), .in_width = iw, .out_width = 4, .lane = 4
+#define FROM_FLOAT16(ow) \
+    .scale = 0x8000, .lo = -32768.0f, .hi = 32767.0f, .in_width = 4, .out_width = ow, .lane = 4
+#define FROM_FLOAT32(ow) \
+    .scale = 1U << 31, .lo = -2147483648.0f, .hi = 2147483648.0f, .in_width = 4, .out_width = ow, .lane = 4
+#define SHUFFLE(iw, ow, l) \
+    .in_width = iw, .out_width = ow, .lane = l
+
+#define IDENTITY    { 0,1,2,3, 4,5,6,7, 8,9,10,11, 12,13,14,15 }
+#define SWAP32      { 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12 }
+#define S16_TO_S32  { Z,Z,0,1, Z,Z,2,3, Z,Z,4,5, Z,Z,6,7 }
+#define S32_TO_S16  { 0,1, 4,5, 8,9, 12,13, Z,Z,Z,Z, Z,Z,Z,Z }
+
+/* to float32ne */
+static struct sconv_desc u8_to_float = {
+    .in_mask = { Z,Z,Z,0, Z,Z,Z,1, Z,Z,Z,2, Z,Z,Z,3 },
+    .xor_mask = { 0,0,0,0x80, 0,0,0,0x80, 0,0,0,0x80, 0,0,0,0x80 },
+    TO_FLOAT(1)
+};
+static struct sconv_desc s16be_to_float = { .in_mask = { Z,Z,1,0, Z,Z,3,2, Z,Z,5,4, Z,Z,7,6 }, TO_FLOAT(2) };
+static struct sconv_desc s32be_to_float = { .in_mask = SWAP32, TO_FLOAT(4) };
+static struct sconv_desc s24le_to_float = { .in_mask = { Z,0,1,2, Z,3,4,5, Z,6,7,8, Z,9,10,11 }, TO_FLOAT(3) };
+static struct sconv_desc s24be_to_float = { .in_mask = { Z,2,1,0, Z,5,4,3, Z,8,7,6, Z,11,10,9 }, TO_FLOAT(3) };
+static struct sconv_desc s24_32le_to_float = { .in_mask = { Z,0,1,2, Z,4,5,6, Z,8,9,10, Z,12,13,14 }, TO_FLOAT(4) };
+static struct sconv_desc s24_32be_to_float = { .in_mask = { Z,3,2,1, Z,7,6,5, Z,11,10,9, Z,15,14,13 }, TO_FLOAT(4) };
+static struct sconv_desc float_swap = { .in_mask = SWAP32, SHUFFLE(4, 4, 4) };
+
+/* from float32ne */
+static struct sconv_desc u8_from_float = {
+    .in_mask = IDENTITY,
+    .out_mask = { 0,4,8,12, Z,Z,Z,Z, Z,Z,Z,Z, Z,Z,Z,Z },
+    .xor_mask = { 0x80,0,0,0, 0x80,0,0,0, 0x80,0,0,0, 0x80,0,0,0 },
+    .scale = 127.0f, .lo = -128.0f, .hi = 127.0f, .in_width = 4, .out_width = 1, .lane = 4
+};
+static struct sconv_desc s16be_from_float = {
+    .in_mask = IDENTITY, .out_mask = { 1,0, 5,4, 9,8, 13,12, Z,Z,Z,Z, Z,Z,Z,Z }, FROM_FLOAT16(2)
+};
+static struct sconv_desc s32be_from_float = { .in_mask = IDENTITY, .out_mask = SWAP32, FROM_FLOAT32(4) };
+static struct sconv_desc s24le_from_float = {
+    .in_mask = IDENTITY, .out_mask = { 1,2,3, 5,6,7, 9,10,11, 13,14,15, Z,Z,Z,Z }, FROM_FLOAT32(3)
+};
+static struct sconv_desc s24be_from_float = {
+    .in_mask = IDENTITY, .out_mask = { 3,2,1, 7,6,5, 11,10,9, 15,14,13, Z,Z,Z,Z }, FROM_FLOAT32(3)
+};
+static struct sconv_desc s24_32le_from_float = {
+    .in_mask = IDENTITY, .out_mask = { 1,2,3,Z, 5,6,7,Z, 9,10,11,Z, 13,14,15,Z }, FROM_FLOAT32(4)
+};
+static struct sconv_desc s24_32be_from_float = {
+    .in_mask = IDENTITY, .out_mask = { Z,3,2,1, Z,7,6,5, Z,11,10,9, Z,15,14,13 }, FROM_FLOAT32(4)
+};
+
+/* to s16ne */
+static struct sconv_desc u8_to_s16 = {
+    .in_mask = { Z,0, Z,1, Z,2, Z,3, Z,4, Z,5, Z,6, Z,7 },
+    .xor_mask = { 0,0x80, 0,0x80, 0,0x80, 0,0x80, 0,0x80, 0,0x80, 0,0x80, 0,0x80 },
+    SHUFFLE(1, 2, 8)
+};
+static struct sconv_desc float32be_to_s16 = { .in_mask = SWAP32, .out_mask = S32_TO_S16, FROM_FLOAT16(2) };
+static struct sconv_desc s32le_to_s16 = { .in_mask = { 2,3, 6,7, 10,11, 14,15, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(4, 2, 4) };
+static struct sconv_desc s32be_to_s16 = { .in_mask = { 1,0, 5,4, 9,8, 13,12, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(4, 2, 4) };
+static struct sconv_desc s24le_to_s16 = { .in_mask = { 1,2, 4,5, 7,8, 10,11, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(3, 2, 4) };
+static struct sconv_desc s24be_to_s16 = { .in_mask = { 1,0, 4,3, 7,6, 10,9, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(3, 2, 4) };
+static struct sconv_desc s24_32le_to_s16 = { .in_mask = { 1,2, 5,6, 9,10, 13,14, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(4, 2, 4) };
+static struct sconv_desc s24_32be_to_s16 = { .in_mask = { 2,1, 6,5, 10,9, 14,13, Z,Z,Z,Z, Z,Z,Z,Z }, SHUFFLE(4, 2, 4) };
+
+/* from s16ne */
+static struct sconv_desc u8_from_s16 = {
+    .in_mask = { 1,3,5,7, 9,11,13,15, Z,Z,Z,Z, Z,Z,Z,Z },
+    .xor_mask = { 0x80,0x80,0x80,0x80, 0x80,0x80,0x80,0x80, 0,0,0,0, 0,0,0,0 },
+    SHUFFLE(2, 1, 8)
+};
+static struct sconv_desc float32be_from_s16 = { .in_mask = S16_TO_S32, .out_mask = SWAP32, TO_FLOAT(2) };
+static struct sconv_desc s32le_from_s16 = { .in_mask = S16_TO_S32, SHUFFLE(2, 4, 4) };
+static struct sconv_desc s32be_from_s16 = { .in_mask = { 1,0,Z,Z, 3,2,Z,Z, 5,4,Z,Z, 7,6,Z,Z }, SHUFFLE(2, 4, 4) };
+static struct sconv_desc s24le_from_s16 = { .in_mask = { Z,0,1, Z,2,3, Z,4,5, Z,6,7, Z,Z,Z,Z }, SHUFFLE(2, 3, 4) };
+static struct sconv_desc s24be_from_s16 = { .in_mask = { 1,0,Z, 3,2,Z, 5,4,Z, 7,6,Z, Z,Z,Z,Z }, SHUFFLE(2, 3, 4) };
+static struct sconv_desc s24_32le_from_s16 = { .in_mask = { Z,0,1,Z, Z,2,3,Z, Z,4,5,Z, Z,6,7,Z }, SHUFFLE(2, 4, 4) };
+static struct sconv_desc s24_32be_from_s16 = { .in_mask = { Z,1,0,Z, Z,3,2,Z, Z,5,4,Z, Z,7,6,Z }, SHUFFLE(2, 4, 4) };
+
+#undef Z
+#undef TO_FLOAT
+#undef FROM_FLOAT16
+#undef FROM_FLOAT32
+#undef SHUFFLE
+#undef IDENTITY
+#undef SWAP32
+#undef S16_TO_S32
+#undef S32_TO_S16
+
+/* Number of samples that can be done in blocks of 'lanes' lanes. Each
+ * lane loads and stores 16 bytes, no matter how many of them it uses,
+ * so we stop early enough not to touch memory past the buffers. */
+static unsigned shuffle_frames(const struct sconv_desc *d, unsigned n, unsigned lanes) {
+    unsigned block = d->lane * lanes;
+    unsigned blocks = n / block, w;
+
+    for (w = 0; w < 2; w++) {
+        unsigned width = w ? d->out_width : d->in_width;
+        unsigned extra = (lanes - 1) * d->lane * width + 16;
+
+        if (n * width < extra)
+            return 0;
+
+        blocks = PA_MIN(blocks, (n * width - extra) / (block * width) + 1);
+    }
+
+    return blocks * block;
+}
+
+static void shuffle_to_float_ssse3(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 1);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 4, step = 4 * d->in_width;
+
+        __asm__ __volatile__ (
+            " movdqa %4, %%xmm5             \n\t"
+            " movdqa %5, %%xmm6             \n\t"
+            " movss %6, %%xmm7              \n\t"
+            " shufps $0, %%xmm7, %%xmm7     \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t"
+            " pshufb %%xmm5, %%xmm0         \n\t" /* to s32 */
+            " pxor %%xmm6, %%xmm0           \n\t"
+            " cvtdq2ps %%xmm0, %%xmm0       \n\t"
+            " mulps %%xmm7, %%xmm0          \n\t"
+            " movups %%xmm0, (%2)           \n\t"
+
+            " add %3, %1                    \n\t"
+            " add $16, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->xor_mask), "m" (d->scale)
+            : "cc", "memory", "xmm0", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_to_float32re_ssse3(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 1);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 4, step = 4 * d->in_width;
+
+        __asm__ __volatile__ (
+            " movdqa %4, %%xmm5             \n\t"
+            " movdqa %5, %%xmm4             \n\t"
+            " movss %6, %%xmm7              \n\t"
+            " shufps $0, %%xmm7, %%xmm7     \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t"
+            " pshufb %%xmm5, %%xmm0         \n\t" /* to s32 */
+            " cvtdq2ps %%xmm0, %%xmm0       \n\t"
+            " mulps %%xmm7, %%xmm0          \n\t"
+            " pshufb %%xmm4, %%xmm0         \n\t" /* swap the floats */
+            " movdqu %%xmm0, (%2)           \n\t"
+
+            " add %3, %1                    \n\t"
+            " add $16, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->out_mask), "m" (d->scale)
+            : "cc", "memory", "xmm0", "xmm4", "xmm5", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_from_float_ssse3(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 1);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 4, step = 4 * d->out_width;
+
+        __asm__ __volatile__ (
+            " movdqa %5, %%xmm5             \n\t"
+            " movdqa %6, %%xmm6             \n\t"
+            " movss %7, %%xmm7              \n\t"
+            " shufps $0, %%xmm7, %%xmm7     \n\t"
+            " movss %8, %%xmm3              \n\t"
+            " shufps $0, %%xmm3, %%xmm3     \n\t"
+            " movss %9, %%xmm4              \n\t"
+            " shufps $0, %%xmm4, %%xmm4     \n\t"
+            " movaps %10, %%xmm2            \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t"
+            " pshufb %4, %%xmm0             \n\t" /* byte order of the floats */
+            " mulps %%xmm7, %%xmm0          \n\t"
+            " maxps %%xmm3, %%xmm0          \n\t" /* clamp */
+            " minps %%xmm4, %%xmm0          \n\t"
+            " movaps %%xmm0, %%xmm1         \n\t"
+            " cmpnltps %%xmm2, %%xmm1       \n\t" /* positive overflow */
+            " cvtps2dq %%xmm0, %%xmm0       \n\t"
+            " pxor %%xmm1, %%xmm0           \n\t"
+            " pxor %%xmm6, %%xmm0           \n\t"
+            " pshufb %%xmm5, %%xmm0         \n\t" /* pick the output bytes */
+            " movdqu %%xmm0, (%2)           \n\t"
+
+            " add $16, %1                   \n\t"
+            " add %3, %2                    \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->out_mask), "m" (*d->xor_mask),
+              "m" (d->scale), "m" (d->lo), "m" (d->hi), "m" (*scale_from)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_bytes_ssse3(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 1);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / d->lane;
+        pa_reg_x86 in_step = d->lane * d->in_width, out_step = d->lane * d->out_width;
+
+        __asm__ __volatile__ (
+            " movdqa %5, %%xmm5             \n\t"
+            " movdqa %6, %%xmm6             \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t"
+            " pshufb %%xmm5, %%xmm0         \n\t"
+            " pxor %%xmm6, %%xmm0           \n\t"
+            " movdqu %%xmm0, (%2)           \n\t"
+
+            " add %3, %1                    \n\t"
+            " add %4, %2                    \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (in_step), "r" (out_step), "m" (*d->in_mask), "m" (*d->xor_mask)
+            : "cc", "memory", "xmm0", "xmm5", "xmm6"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+/* The AVX2 versions run the same shuffles on two lanes. The second
+ * lane is loaded from and stored to right after the first one. */
+static void shuffle_to_float_avx2(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 2);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8, step = 4 * d->in_width;
+
+        __asm__ __volatile__ (
+            " vbroadcasti128 %4, %%ymm5     \n\t"
+            " vbroadcasti128 %5, %%ymm6     \n\t"
+            " vbroadcastss %6, %%ymm7       \n\t"
+
+            "1:                             \n\t"
+            " vmovdqu (%1), %%xmm0          \n\t"
+            " vinserti128 $1, (%1,%3), %%ymm0, %%ymm0 \n\t"
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t" /* to s32 */
+            " vpxor %%ymm6, %%ymm0, %%ymm0  \n\t"
+            " vcvtdq2ps %%ymm0, %%ymm0      \n\t"
+            " vmulps %%ymm7, %%ymm0, %%ymm0 \n\t"
+            " vmovups %%ymm0, (%2)          \n\t"
+
+            " add %3, %1                    \n\t"
+            " add %3, %1                    \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->xor_mask), "m" (d->scale)
+            : "cc", "memory", "xmm0", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_to_float32re_avx2(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 2);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8, step = 4 * d->in_width;
+
+        __asm__ __volatile__ (
+            " vbroadcasti128 %4, %%ymm5     \n\t"
+            " vbroadcasti128 %5, %%ymm4     \n\t"
+            " vbroadcastss %6, %%ymm7       \n\t"
+
+            "1:                             \n\t"
+            " vmovdqu (%1), %%xmm0          \n\t"
+            " vinserti128 $1, (%1,%3), %%ymm0, %%ymm0 \n\t"
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t" /* to s32 */
+            " vcvtdq2ps %%ymm0, %%ymm0      \n\t"
+            " vmulps %%ymm7, %%ymm0, %%ymm0 \n\t"
+            " vpshufb %%ymm4, %%ymm0, %%ymm0 \n\t" /* swap the floats */
+            " vmovdqu %%ymm0, (%2)          \n\t"
+
+            " add %3, %1                    \n\t"
+            " add %3, %1                    \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->out_mask), "m" (d->scale)
+            : "cc", "memory", "xmm0", "xmm4", "xmm5", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_from_float_avx2(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 2);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8, step = 4 * d->out_width;
+
+        __asm__ __volatile__ (
+            " vbroadcasti128 %5, %%ymm5     \n\t"
+            " vbroadcasti128 %6, %%ymm6     \n\t"
+            " vbroadcastss %7, %%ymm7       \n\t"
+            " vbroadcastss %8, %%ymm3       \n\t"
+            " vbroadcastss %9, %%ymm4       \n\t"
+            " vbroadcastss %10, %%ymm2      \n\t"
+
+            "1:                             \n\t"
+            " vmovdqu (%1), %%ymm0          \n\t"
+            " vbroadcasti128 %4, %%ymm1     \n\t"
+            " vpshufb %%ymm1, %%ymm0, %%ymm0 \n\t" /* byte order of the floats */
+            " vmulps %%ymm7, %%ymm0, %%ymm0 \n\t"
+            " vmaxps %%ymm3, %%ymm0, %%ymm0 \n\t" /* clamp */
+            " vminps %%ymm4, %%ymm0, %%ymm0 \n\t"
+            " vcmpnltps %%ymm2, %%ymm0, %%ymm1 \n\t" /* positive overflow */
+            " vcvtps2dq %%ymm0, %%ymm0      \n\t"
+            " vpxor %%ymm1, %%ymm0, %%ymm0  \n\t"
+            " vpxor %%ymm6, %%ymm0, %%ymm0  \n\t"
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t" /* pick the output bytes */
+            " vmovdqu %%xmm0, (%2)          \n\t"
+            " vextracti128 $1, %%ymm0, (%2,%3) \n\t"
+
+            " add $32, %1                   \n\t"
+            " add %3, %2                    \n\t"
+            " add %3, %2                    \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (step), "m" (*d->in_mask), "m" (*d->out_mask), "m" (*d->xor_mask),
+              "m" (d->scale), "m" (d->lo), "m" (d->hi), "m" (*scale_from)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void shuffle_bytes_avx2(struct sconv_desc *d, unsigned n, const void *a, void *b) {
+    unsigned k = shuffle_frames(d, n, 2);
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / (2 * d->lane);
+        pa_reg_x86 in_step = d->lane * d->in_width, out_step = d->lane * d->out_width;
+
+        __asm__ __volatile__ (
+            " vbroadcasti128 %5, %%ymm5     \n\t"
+            " vbroadcasti128 %6, %%ymm6     \n\t"
+
+            "1:                             \n\t"
+            " vmovdqu (%1), %%xmm0          \n\t"
+            " vinserti128 $1, (%1,%3), %%ymm0, %%ymm0 \n\t"
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t"
+            " vpxor %%ymm6, %%ymm0, %%ymm0  \n\t"
+            " vmovdqu %%xmm0, (%2)          \n\t"
+            " vextracti128 $1, %%ymm0, (%2,%4) \n\t"
+
+            " add %3, %1                    \n\t"
+            " add %3, %1                    \n\t"
+            " add %4, %2                    \n\t"
+            " add %4, %2                    \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (in_step), "r" (out_step), "m" (*d->in_mask), "m" (*d->xor_mask)
+            : "cc", "memory", "xmm0", "xmm5", "xmm6"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+/* G.711 is decoded by gathering from a table with one entry per code */
+static PA_DECLARE_ALIGNED (32, float, ulaw_float_table[256]);
+static PA_DECLARE_ALIGNED (32, float, alaw_float_table[256]);
+static PA_DECLARE_ALIGNED (32, int32_t, ulaw_s16_table[256]);
+static PA_DECLARE_ALIGNED (32, int32_t, alaw_s16_table[256]);
+
+static struct sconv_desc ulaw_to_float = { .in_width = 1, .out_width = 4, .lane = 8 };
+static struct sconv_desc alaw_to_float = { .in_width = 1, .out_width = 4, .lane = 8 };
+static struct sconv_desc ulaw_to_s16 = { .in_width = 1, .out_width = 2, .lane = 8 };
+static struct sconv_desc alaw_to_s16 = { .in_width = 1, .out_width = 2, .lane = 8 };
+
+static void g711_tables_init(void) {
+    unsigned i;
+
+    for (i = 0; i < 256; i++) {
+        ulaw_s16_table[i] = st_ulaw2linear16((uint8_t) i);
+        alaw_s16_table[i] = st_alaw2linear16((uint8_t) i);
+        ulaw_float_table[i] = (float) ulaw_s16_table[i] / 0x8000;
+        alaw_float_table[i] = (float) alaw_s16_table[i] / 0x8000;
+    }
+}
+
+static void g711_to_float_avx2(struct sconv_desc *d, const float *table, unsigned n, const uint8_t *a, float *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " vpmovzxbd (%1), %%ymm1        \n\t" /* 8 codes */
+            " vpcmpeqd %%ymm2, %%ymm2, %%ymm2 \n\t"
+            " vgatherdps %%ymm2, (%3,%%ymm1,4), %%ymm0 \n\t"
+            " vmovups %%ymm0, (%2)          \n\t"
+
+            " add $8, %1                    \n\t"
+            " add $32, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (table)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void g711_to_s16_avx2(struct sconv_desc *d, const int32_t *table, unsigned n, const uint8_t *a, int16_t *b) {
+    unsigned k = n & ~7U;
+
+    if (k > 0) {
+        pa_reg_x86 cnt = k / 8;
+
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " vpmovzxbd (%1), %%ymm1        \n\t" /* 8 codes */
+            " vpcmpeqd %%ymm2, %%ymm2, %%ymm2 \n\t"
+            " vpgatherdd %%ymm2, (%3,%%ymm1,4), %%ymm0 \n\t"
+            " vpackssdw %%ymm0, %%ymm0, %%ymm0 \n\t"
+            " vpermq $0x08, %%ymm0, %%ymm0  \n\t" /* both lanes to the low half */
+            " vmovdqu %%xmm0, (%2)          \n\t"
+
+            " add $8, %1                    \n\t"
+            " add $16, %2                   \n\t"
+            " dec %0                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (cnt), "+r" (a), "+r" (b)
+            : "r" (table)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2"
+        );
+    }
+
+    d->tail(n - k, a, b);
+}
+
+static void ulaw_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    g711_to_float_avx2(&ulaw_to_float, ulaw_float_table, n, a, b);
+}
+
+static void alaw_to_float32ne_avx2(unsigned n, const uint8_t *a, float *b) {
+    g711_to_float_avx2(&alaw_to_float, alaw_float_table, n, a, b);
+}
+
+static void ulaw_to_s16ne_avx2(unsigned n, const uint8_t *a, int16_t *b) {
+    g711_to_s16_avx2(&ulaw_to_s16, ulaw_s16_table, n, a, b);
+}
+
+static void alaw_to_s16ne_avx2(unsigned n, const uint8_t *a, int16_t *b) {
+    g711_to_s16_avx2(&alaw_to_s16, alaw_s16_table, n, a, b);
+}
+
+#define SHUFFLE_FUNCS(name, kernel)                                                 \
+    static void name##_ssse3(unsigned n, const void *a, void *b) {                  \
+        kernel##_ssse3(&name, n, a, b);                                             \
+    }                                                                               \
+    static void name##_avx2(unsigned n, const void *a, void *b) {                   \
+        kernel##_avx2(&name, n, a, b);                                              \
+    }
+
+SHUFFLE_FUNCS(u8_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s16be_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s32be_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s24le_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s24be_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s24_32le_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(s24_32be_to_float, shuffle_to_float)
+SHUFFLE_FUNCS(float_swap, shuffle_bytes)
+
+SHUFFLE_FUNCS(u8_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s16be_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s32be_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s24le_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s24be_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s24_32le_from_float, shuffle_from_float)
+SHUFFLE_FUNCS(s24_32be_from_float, shuffle_from_float)
+
+SHUFFLE_FUNCS(u8_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(float32be_to_s16, shuffle_from_float)
+SHUFFLE_FUNCS(s32le_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s32be_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24le_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24be_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24_32le_to_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24_32be_to_s16, shuffle_bytes)
+
+SHUFFLE_FUNCS(u8_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(float32be_from_s16, shuffle_to_float32re)
+SHUFFLE_FUNCS(s32le_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s32be_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24le_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24be_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24_32le_from_s16, shuffle_bytes)
+SHUFFLE_FUNCS(s24_32be_from_s16, shuffle_bytes)
+
+#undef SHUFFLE_FUNCS
+
+enum {
+    TO_FLOAT32NE,
+    FROM_FLOAT32NE,
+    TO_S16NE,
+    FROM_S16NE
+};
+
+static pa_convert_func_t (* const get_funcs[])(pa_sample_format_t f) = {
+    [TO_FLOAT32NE] = pa_get_convert_to_float32ne_function,
+    [FROM_FLOAT32NE] = pa_get_convert_from_float32ne_function,
+    [TO_S16NE] = pa_get_convert_to_s16ne_function,
+    [FROM_S16NE] = pa_get_convert_from_s16ne_function,
+};
+
+static void (* const set_funcs[])(pa_sample_format_t f, pa_convert_func_t func) = {
+    [TO_FLOAT32NE] = pa_set_convert_to_float32ne_function,
+    [FROM_FLOAT32NE] = pa_set_convert_from_float32ne_function,
+    [TO_S16NE] = pa_set_convert_to_s16ne_function,
+    [FROM_S16NE] = pa_set_convert_from_s16ne_function,
+};
+
+#define ENTRY(dir, f, name) \
+    { dir, f, &name, (pa_convert_func_t) name##_ssse3, (pa_convert_func_t) name##_avx2 }
+
+static const struct {
+    int dir;
+    pa_sample_format_t format;
+    struct sconv_desc *desc;
+    pa_convert_func_t ssse3, avx2;
+} shuffle_funcs[] = {
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_U8, u8_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S16BE, s16be_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S32BE, s32be_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S24LE, s24le_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S24BE, s24be_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S24_32LE, s24_32le_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_S24_32BE, s24_32be_to_float),
+    ENTRY(TO_FLOAT32NE, PA_SAMPLE_FLOAT32BE, float_swap),
+
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_U8, u8_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S16BE, s16be_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S32BE, s32be_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S24LE, s24le_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S24BE, s24be_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S24_32LE, s24_32le_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_S24_32BE, s24_32be_from_float),
+    ENTRY(FROM_FLOAT32NE, PA_SAMPLE_FLOAT32BE, float_swap),
+
+    ENTRY(TO_S16NE, PA_SAMPLE_U8, u8_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_FLOAT32BE, float32be_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S32LE, s32le_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S32BE, s32be_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S24LE, s24le_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S24BE, s24be_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S24_32LE, s24_32le_to_s16),
+    ENTRY(TO_S16NE, PA_SAMPLE_S24_32BE, s24_32be_to_s16),
+
+    ENTRY(FROM_S16NE, PA_SAMPLE_U8, u8_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_FLOAT32BE, float32be_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S32LE, s32le_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S32BE, s32be_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S24LE, s24le_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S24BE, s24be_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S24_32LE, s24_32le_from_s16),
+    ENTRY(FROM_S16NE, PA_SAMPLE_S24_32BE, s24_32be_from_s16),
+};
+
+#undef ENTRY
+
+/* The functions we replace handle the leftovers. Remember them only the
+ * first time around, later they might be our own. */
+static void set_func(struct sconv_desc *d, int dir, pa_sample_format_t f, pa_convert_func_t func) {
+    if (!d->tail)
+        d->tail = get_funcs[dir](f);
+
+    set_funcs[dir](f, func);
+}
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
 #if (!defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
 
+    unsigned i;
+
     if (flags & PA_CPU_X86_SSE2) {
         pa_log_info("Initialising SSE2 optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
         pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_to_float32ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_to_float32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_from_float32ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) pa_sconv_s16_swap_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) pa_sconv_s16_swap_sse2);
     } else if (flags & PA_CPU_X86_SSE) {
         pa_log_info("Initialising SSE optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
         pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
     }
 
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized conversions.");
+
+        for (i = 0; i < PA_ELEMENTSOF(shuffle_funcs); i++)
+            set_func(shuffle_funcs[i].desc, shuffle_funcs[i].dir, shuffle_funcs[i].format, shuffle_funcs[i].avx2);
+
+        g711_tables_init();
+        set_func(&ulaw_to_float, TO_FLOAT32NE, PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_to_float32ne_avx2);
+        set_func(&alaw_to_float, TO_FLOAT32NE, PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_to_float32ne_avx2);
+        set_func(&ulaw_to_s16, TO_S16NE, PA_SAMPLE_ULAW, (pa_convert_func_t) ulaw_to_s16ne_avx2);
+        set_func(&alaw_to_s16, TO_S16NE, PA_SAMPLE_ALAW, (pa_convert_func_t) alaw_to_s16ne_avx2);
+    } else if (flags & PA_CPU_X86_SSSE3) {
+        pa_log_info("Initialising SSSE3 optimized conversions.");
+
+        for (i = 0; i < PA_ELEMENTSOF(shuffle_funcs); i++)
+            set_func(shuffle_funcs[i].desc, shuffle_funcs[i].dir, shuffle_funcs[i].format, shuffle_funcs[i].ssse3);
+    }
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 }
@@ -37,6 +37,10 @@
 #include <sys/mman.h>
 #endif
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 /* This is deprecated on glibc but is still used by FreeBSD */
 #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
 # define MAP_ANONYMOUS MAP_ANON
@@ -60,6 +64,17 @@
 #define MADV_REMOVE 9
 #endif
 
+#if defined(__linux__) && !defined(MADV_HUGEPAGE)
+#define MADV_HUGEPAGE 14
+#endif
+
+/* From <numaif.h>, we don't want to depend on libnuma for mbind() */
+#ifdef __linux__
+#define MPOL_PREFERRED 1
+#define MPOL_MF_MOVE (1<<1)
+#define NUMA_MAX_NODES 1024
+#endif
+
 /* 1 GiB at max */
 #define MAX_SHM_SIZE (PA_ALIGN(1024*1024*1024))
 
@@ -107,21 +122,80 @@ static char *segment_name(char *fn, size_t l, unsigned id) {
 }
 #endif
 
-static int privatemem_create(pa_shm *m, size_t size) {
+/* The size of the pages MAP_HUGETLB and MFD_HUGETLB give us, or 0
+ * if we don't know */
+static size_t huge_page_size(void) {
+    size_t size = 0;
+#ifdef __linux__
+    FILE *f;
+    char line[128];
+    unsigned long kb;
+
+    if (!(f = pa_fopen_cloexec("/proc/meminfo", "r")))
+        return 0;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+            size = (size_t) kb * 1024;
+            break;
+        }
+
+    fclose(f);
+#endif
+
+    return size;
+}
+
+/* Transparent huge pages are only a hint, the kernel may still back
+ * the memory with normal pages */
+static pa_mem_hugepages_t advise_hugepages(void *ptr, size_t size) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(ptr, size, MADV_HUGEPAGE) >= 0)
+        return PA_MEM_HUGEPAGES_TRANSPARENT;
+
+    pa_log_info("madvise(MADV_HUGEPAGE) failed: %s", pa_cstrerror(errno));
+#endif
+
+    return PA_MEM_HUGEPAGES_NO;
+}
+
+static int privatemem_create(pa_shm *m, size_t size, pa_mem_hugepages_t hugepages) {
     pa_assert(m);
     pa_assert(size > 0);
 
     m->type = PA_MEM_TYPE_PRIVATE;
     m->id = 0;
     m->size = size;
+    m->hugepages = PA_MEM_HUGEPAGES_NO;
     m->do_unlink = false;
     m->fd = -1;
 
 #ifdef MAP_ANONYMOUS
+#ifdef MAP_HUGETLB
+    if (hugepages == PA_MEM_HUGEPAGES_YES) {
+        size_t huge_size;
+
+        if ((huge_size = huge_page_size()) > 0) {
+            m->size = PA_ROUND_UP(size, huge_size);
+
+            if ((m->ptr = mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB, -1, (off_t) 0)) != MAP_FAILED) {
+                m->hugepages = PA_MEM_HUGEPAGES_YES;
+                return 0;
+            }
+
+            pa_log_info("Failed to allocate huge pages, trying transparent ones: %s", pa_cstrerror(errno));
+            m->size = size;
+        }
+    }
+#endif
+
     if ((m->ptr = mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, (off_t) 0)) == MAP_FAILED) {
         pa_log("mmap() failed: %s", pa_cstrerror(errno));
         return -1;
     }
+
+    if (hugepages != PA_MEM_HUGEPAGES_NO)
+        m->hugepages = advise_hugepages(m->ptr, m->size);
 #elif defined(HAVE_POSIX_MEMALIGN)
     {
         int r;
@@ -138,7 +212,37 @@ static int privatemem_create(pa_shm *m, size_t size) {
     return 0;
 }
 
-static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+#ifdef HAVE_MEMFD
+/* Returns a memfd that is already mapped to m->ptr, or -1 if there
+ * are no huge pages to be had */
+static int hugetlb_memfd_create(pa_shm *m, size_t size) {
+    size_t huge_size;
+    int fd;
+
+    if ((huge_size = huge_page_size()) == 0)
+        return -1;
+
+    if ((fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING|MFD_HUGETLB)) < 0) {
+        pa_log_info("memfd_create(MFD_HUGETLB) failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    m->size = PA_ROUND_UP(size, huge_size);
+
+    if (ftruncate(fd, (off_t) m->size) < 0 ||
+        (m->ptr = mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log_info("Failed to allocate huge pages, trying transparent ones: %s", pa_cstrerror(errno));
+        m->ptr = NULL;
+        pa_close(fd);
+        return -1;
+    }
+
+    m->hugepages = PA_MEM_HUGEPAGES_YES;
+    return fd;
+}
+#endif
+
+static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, pa_mem_hugepages_t hugepages) {
 #if defined(HAVE_SHM_OPEN) || defined(HAVE_MEMFD)
     char fn[32];
     int fd = -1;
@@ -150,6 +254,8 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
     pa_shm_cleanup();
 
     pa_random(&m->id, sizeof(m->id));
+    m->ptr = NULL;
+    m->hugepages = PA_MEM_HUGEPAGES_NO;
 
     switch (type) {
 #ifdef HAVE_SHM_OPEN
@@ -161,7 +267,11 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
 #endif
 #ifdef HAVE_MEMFD
     case PA_MEM_TYPE_SHARED_MEMFD:
-        fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING);
+        if (hugepages == PA_MEM_HUGEPAGES_YES)
+            fd = hugetlb_memfd_create(m, size);
+
+        if (fd < 0)
+            fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING);
         break;
 #endif
     default:
@@ -174,21 +284,28 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
     }
 
     m->type = type;
-    m->size = size + shm_marker_size(type);
     m->do_unlink = do_unlink;
 
-    if (ftruncate(fd, (off_t) m->size) < 0) {
-        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
-        goto fail;
-    }
-
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
 #endif
 
-    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
-        pa_log("mmap() failed: %s", pa_cstrerror(errno));
-        goto fail;
+    /* Unless we got a mapping of huge pages already */
+    if (!m->ptr) {
+        m->size = size + shm_marker_size(type);
+
+        if (ftruncate(fd, (off_t) m->size) < 0) {
+            pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
+            pa_log("mmap() failed: %s", pa_cstrerror(errno));
+            goto fail;
+        }
+
+        if (hugepages != PA_MEM_HUGEPAGES_NO)
+            m->hugepages = advise_hugepages(m->ptr, PA_PAGE_ALIGN(m->size));
     }
 
     if (type == PA_MEM_TYPE_SHARED_POSIX) {
@@ -225,7 +342,7 @@ fail:
     return -1;
 }
 
-int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, pa_mem_hugepages_t hugepages) {
     pa_assert(m);
     pa_assert(size > 0);
     pa_assert(size <= MAX_SHM_SIZE);
@@ -236,9 +353,9 @@ int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
     size = PA_PAGE_ALIGN(size);
 
     if (type == PA_MEM_TYPE_PRIVATE)
-        return privatemem_create(m, size);
+        return privatemem_create(m, size, hugepages);
 
-    return sharedmem_create(m, type, size, mode);
+    return sharedmem_create(m, type, size, mode, hugepages);
 }
 
 static void privatemem_free(pa_shm *m) {
@@ -314,6 +431,11 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
     /* You're welcome to implement this as NOOP on systems that don't
      * support it */
 
+    /* Huge pages can't be given back partially, and for transparent
+     * ones it would split them up again */
+    if (m->hugepages != PA_MEM_HUGEPAGES_NO)
+        return;
+
     /* Align the pointer up to multiples of the page size */
     ptr = (uint8_t*) m->ptr + offset;
     o = (size_t) ((uint8_t*) ptr - (uint8_t*) PA_PAGE_ALIGN_PTR(ptr));
@@ -344,6 +466,38 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
 #endif
 }
 
+int pa_shm_bind_numa_node(pa_shm *m, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+    const unsigned bits = 8 * sizeof(unsigned long);
+
+    pa_assert(m);
+    pa_assert(m->ptr);
+    pa_assert(node >= 0);
+
+    if (node >= NUMA_MAX_NODES) {
+        pa_log("Invalid NUMA node %i", node);
+        return -1;
+    }
+
+    pa_zero(mask);
+    mask[node / bits] = 1UL << (node % bits);
+
+    /* Preferred rather than strictly bound, so that we still get
+     * memory when the node runs out of it. Pages that are already
+     * there are moved over. */
+    if (syscall(SYS_mbind, m->ptr, PA_PAGE_ALIGN(m->size), MPOL_PREFERRED, mask, (unsigned long) NUMA_MAX_NODES + 1, MPOL_MF_MOVE) < 0) {
+        pa_log_warn("mbind() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    pa_log_warn("Binding memory to a NUMA node is not supported on this platform");
+    return -1;
+#endif
+}
+
 static int shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable, bool for_cleanup) {
 #if defined(HAVE_SHM_OPEN) || defined(HAVE_MEMFD)
     char fn[32];
@@ -404,6 +558,7 @@ static int shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd,
     m->type = type;
     m->id = id;
     m->size = (size_t) st.st_size;
+    m->hugepages = PA_MEM_HUGEPAGES_NO;
     m->do_unlink = false;
     m->fd = -1;
 
@@ -31,6 +31,10 @@ typedef struct pa_shm {
     void *ptr;
     size_t size;
 
+    /* What the memory is actually backed with. Only set for memory
+     * we created. */
+    pa_mem_hugepages_t hugepages;
+
     /* Only for type = PA_MEM_TYPE_SHARED_POSIX */
     bool do_unlink:1;
 
@@ -49,11 +53,15 @@ typedef struct pa_shm {
     int fd;
 } pa_shm;
 
-int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode);
+int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, pa_mem_hugepages_t hugepages);
 int pa_shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable);
 
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
 
+/* Moves the memory to the given NUMA node, and makes sure it is
+ * allocated from there in the future if possible */
+int pa_shm_bind_numa_node(pa_shm *m, int node);
+
 void pa_shm_free(pa_shm *m);
 
 int pa_shm_cleanup(void);
@@ -49,7 +49,8 @@
 
 #include "sink.h"
 
-#define MAX_MIX_CHANNELS 32
+#define MIX_INFO_MIN 32
+#define MIX_INFO_ALIGN 64
 #define MIX_BUFFER_LENGTH (pa_page_size())
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
@@ -146,6 +147,28 @@ void pa_sink_new_data_done(pa_sink_new_data *data) {
     pa_xfree(data->active_port);
 }
 
+/* Called from main context or IO thread context, whichever owns
+ * thread_info at that point */
+static void mix_info_reserve(pa_sink *s, unsigned n) {
+    unsigned size;
+
+    pa_assert(s);
+
+    if (n <= s->thread_info.n_mix_info)
+        return;
+
+    size = PA_MAX(s->thread_info.n_mix_info, MIX_INFO_MIN);
+    while (size < n)
+        size *= 2;
+
+    /* The old contents are only valid during a single render call, so
+     * there is nothing to carry over */
+    pa_xfree(s->thread_info.mix_info_mem);
+    s->thread_info.mix_info_mem = pa_xmalloc(sizeof(pa_mix_info) * size + MIX_INFO_ALIGN - 1);
+    s->thread_info.mix_info = (pa_mix_info*) (((uintptr_t) s->thread_info.mix_info_mem + MIX_INFO_ALIGN - 1) & ~((uintptr_t) MIX_INFO_ALIGN - 1));
+    s->thread_info.n_mix_info = size;
+}
+
 /* Called from main context */
 static void reset_callbacks(pa_sink *s) {
     pa_assert(s);
@@ -327,6 +350,11 @@ pa_sink* pa_sink_new(
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL,
                                                 (pa_free_cb_t) pa_sink_input_unref);
+    s->thread_info.mix_info = NULL;
+    s->thread_info.mix_info_mem = NULL;
+    s->thread_info.n_mix_info = 0;
+    mix_info_reserve(s, MIX_INFO_MIN);
+    s->thread_info.render_pool = NULL;
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
@@ -735,6 +763,10 @@ static void sink_free(pa_object *o) {
 
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
+    pa_xfree(s->thread_info.mix_info_mem);
+
+    if (s->thread_info.render_pool)
+        pa_render_pool_free(s->thread_info.render_pool);
 
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
@@ -1024,6 +1056,118 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     }
 }
 
+/* Called from IO thread context */
+static void render_pool_attach(pa_sink *s, pa_sink_input *i) {
+    pa_thread_mq *thread_mq;
+
+    pa_sink_assert_ref(s);
+    pa_sink_input_assert_ref(i);
+
+    /* Only filter sinks hang a whole subtree off their sink input,
+     * that's where running in parallel actually pays off */
+    if (!i->origin_sink || s->thread_info.render_pool || s->core->render_threads == 0)
+        return;
+
+    if (!(thread_mq = pa_thread_mq_get()))
+        return;
+
+    s->thread_info.render_pool = pa_render_pool_new(s->core->render_threads, thread_mq,
+                                                     s->core->realtime_scheduling, s->core->realtime_priority);
+}
+
+/* Called from IO thread context */
+static void render_pool_detach(pa_sink *s) {
+    pa_sink_input *i;
+    void *state = NULL;
+
+    pa_sink_assert_ref(s);
+
+    if (!s->thread_info.render_pool)
+        return;
+
+    /* Keep the pool while there is any filter left to run on it */
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        if (i->origin_sink)
+            return;
+
+    pa_render_pool_free(s->thread_info.render_pool);
+    s->thread_info.render_pool = NULL;
+}
+
+/* Called from IO thread context or a render pool thread */
+static void peek_filter_input(void *userdata, unsigned idx) {
+    pa_sink *s = userdata;
+    pa_mix_info *info = s->thread_info.mix_info + idx;
+    pa_sink_input *i = info->userdata;
+
+    if (!i->origin_sink)
+        return;
+
+    pa_sink_input_peek(i, info->chunk.length, &info->chunk, &info->volume);
+}
+
+/* Called from IO thread context */
+static unsigned fill_mix_info_parallel(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+    pa_sink_input *i;
+    unsigned k, n = 0, n_infos = 0, n_filters = 0;
+    void *state = NULL;
+    size_t mixlength = *length;
+
+    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && n_infos < maxinfo) {
+        pa_sink_input_assert_ref(i);
+
+        info[n_infos].userdata = i;
+        info[n_infos].chunk.length = *length;
+        n_infos++;
+
+        if (i->origin_sink)
+            n_filters++;
+    }
+
+    if (n_filters > 1)
+        pa_render_pool_start(s->thread_info.render_pool, peek_filter_input, s, n_infos);
+
+    /* Everything that is not a filter subtree is peeked from this
+     * thread, in parallel with the filters */
+    for (k = 0; k < n_infos; k++) {
+        i = info[k].userdata;
+
+        if (i->origin_sink && n_filters > 1)
+            continue;
+
+        pa_sink_input_peek(i, *length, &info[k].chunk, &info[k].volume);
+    }
+
+    if (n_filters > 1)
+        pa_render_pool_join(s->thread_info.render_pool);
+
+    for (k = 0; k < n_infos; k++) {
+        i = info[k].userdata;
+
+        if (mixlength == 0 || info[k].chunk.length < mixlength)
+            mixlength = info[k].chunk.length;
+
+        if (pa_memblock_is_silence(info[k].chunk.memblock)) {
+            pa_memblock_unref(info[k].chunk.memblock);
+            continue;
+        }
+
+        pa_assert(info[k].chunk.memblock);
+        pa_assert(info[k].chunk.length > 0);
+
+        if (n != k)
+            info[n] = info[k];
+
+        info[n].userdata = pa_sink_input_ref(i);
+        n++;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    return n;
+}
+
 /* Called from IO thread context */
 static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
     pa_sink_input *i;
@@ -1035,6 +1179,9 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->thread_info.render_pool)
+        return fill_mix_info_parallel(s, length, info, maxinfo);
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
@@ -1164,7 +1311,7 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t block_size_max;
 
@@ -1195,7 +1342,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = s->thread_info.mix_info;
+    n = fill_mix_info(s, &length, info, s->thread_info.n_mix_info);
 
     if (n == 0) {
 
@@ -1224,8 +1372,22 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
-            pa_volume_memchunk(result, &s->sample_spec, &volume);
+            void *ptr;
+
+            /* Instead of copying the block and scaling the copy, let
+             * pa_mix() scale it into a new block in a single pass */
+            pa_memblock_unref(result->memblock);
+            result->memblock = pa_memblock_new(s->core->mempool, result->length);
+
+            ptr = pa_memblock_acquire(result->memblock);
+            result->length = pa_mix(info, 1,
+                                    ptr, result->length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    false);
+            pa_memblock_release(result->memblock);
+
+            result->index = 0;
         }
     } else {
         void *ptr;
@@ -1249,7 +1411,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
 /* Called from IO thread context */
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t length, block_size_max;
 
@@ -1278,7 +1440,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = s->thread_info.mix_info;
+    n = fill_mix_info(s, &length, info, s->thread_info.n_mix_info);
 
     if (n == 0) {
         if (target->length > length)
@@ -1295,7 +1458,20 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk(target, &s->sample_spec);
-        else {
+        else if (!pa_cvolume_is_norm(&volume)) {
+            void *ptr;
+
+            /* Scale straight into the target, no intermediate copy */
+            ptr = pa_memblock_acquire(target->memblock);
+
+            target->length = pa_mix(info, 1,
+                                    (uint8_t*) ptr + target->index, target->length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    false);
+
+            pa_memblock_release(target->memblock);
+        } else {
             pa_memchunk vchunk;
 
             vchunk = info[0].chunk;
@@ -1304,11 +1480,6 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             if (vchunk.length > length)
                 vchunk.length = length;
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
-
             pa_memchunk_memcpy(target, &vchunk);
             pa_memblock_unref(vchunk.memblock);
         }
@@ -1518,6 +1689,7 @@ pa_usec_t pa_sink_get_latency(pa_sink *s) {
 pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s) {
     pa_usec_t usec = 0;
     pa_msgobject *o;
+    int r;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1535,7 +1707,15 @@ pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s) {
 
     /* FIXME: We probably should make this a proper vtable callback instead of going through process_msg() */
 
-    if (o->process_msg(o, PA_SINK_MESSAGE_GET_LATENCY, &usec, 0, NULL) < 0)
+    if (s->thread_info.render_pool)
+        pa_render_pool_lock(s->thread_info.render_pool);
+
+    r = o->process_msg(o, PA_SINK_MESSAGE_GET_LATENCY, &usec, 0, NULL);
+
+    if (s->thread_info.render_pool)
+        pa_render_pool_unlock(s->thread_info.render_pool);
+
+    if (r < 0)
         return -1;
 
     /* usec is unsigned, so check that the offset can be added to usec without
@@ -2470,6 +2650,8 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
              * PA_SINK_MESSAGE_FINISH_MOVE, too. */
 
             pa_hashmap_put(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index), pa_sink_input_ref(i));
+            mix_info_reserve(s, pa_hashmap_size(s->thread_info.inputs));
+            render_pool_attach(s, i);
 
             /* Since the caller sleeps in pa_sink_input_put(), we can
              * safely access data outside of thread_info even though
@@ -2559,6 +2741,7 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             }
 
             pa_hashmap_remove_and_free(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index));
+            render_pool_detach(s);
             pa_sink_invalidate_requested_latency(s, true);
             pa_sink_request_rewind(s, (size_t) -1);
 
@@ -2640,6 +2823,7 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
             /* Let's remove the sink input ...*/
             pa_hashmap_remove_and_free(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index));
+            render_pool_detach(s);
 
             pa_sink_invalidate_requested_latency(s, true);
 
@@ -2661,6 +2845,8 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(!i->thread_info.sync_prev);
 
             pa_hashmap_put(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index), pa_sink_input_ref(i));
+            mix_info_reserve(s, pa_hashmap_size(s->thread_info.inputs));
+            render_pool_attach(s, i);
 
             pa_assert(!i->thread_info.attached);
             i->thread_info.attached = true;
@@ -2964,15 +3150,23 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
 
     nbytes = PA_MIN(nbytes, s->thread_info.max_rewind);
 
-    if (s->thread_info.rewind_requested &&
-        nbytes <= s->thread_info.rewind_nbytes)
-        return;
+    /* Filter subtrees rendered from the render pool may ask us to
+     * rewind concurrently */
+    if (s->thread_info.render_pool)
+        pa_render_pool_lock(s->thread_info.render_pool);
+
+    if (!s->thread_info.rewind_requested ||
+        nbytes > s->thread_info.rewind_nbytes) {
 
-    s->thread_info.rewind_nbytes = nbytes;
-    s->thread_info.rewind_requested = true;
+        s->thread_info.rewind_nbytes = nbytes;
+        s->thread_info.rewind_requested = true;
+
+        if (s->request_rewind)
+            s->request_rewind(s);
+    }
 
-    if (s->request_rewind)
-        s->request_rewind(s);
+    if (s->thread_info.render_pool)
+        pa_render_pool_unlock(s->thread_info.render_pool);
 }
 
 /* Called from IO thread */
@@ -33,6 +33,7 @@
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/mix.h>
 #include <pulsecore/source.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
@@ -41,6 +42,7 @@
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/render-pool.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/sink-input.h>
 
@@ -254,6 +256,18 @@ struct pa_sink {
         pa_sink_state_t state;
         pa_hashmap *inputs;
 
+        /* Scratch space for pa_sink_render() and friends. It is grown
+         * whenever an input is attached so that rendering never has to
+         * allocate, and is aligned to a cache line. */
+        pa_mix_info *mix_info;
+        void *mix_info_mem;
+        unsigned n_mix_info;
+
+        /* Helper threads peeking filter sink inputs concurrently,
+         * created when the first one is attached if the core has
+         * render_threads set, and freed when the last one leaves */
+        pa_render_pool *render_pool;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
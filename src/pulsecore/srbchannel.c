@@ -75,11 +75,21 @@ static void pa_ringbuffer_end_write(pa_ringbuffer *r, int count) {
     r->writeindex %= r->capacity;
 }
 
+/* An extra pair of ringbuffers in a shm block of its own. Lanes are
+ * signalled through the semaphores of the srbchannel they belong to. */
+struct srblane {
+    pa_ringbuffer rb_read, rb_write;
+    pa_memblock *memblock;
+};
+
 struct pa_srbchannel {
     pa_ringbuffer rb_read, rb_write;
     pa_fdsem *sem_read, *sem_write;
     pa_memblock *memblock;
 
+    struct srblane lanes[PA_SRBCHANNEL_LANES_MAX];
+    unsigned n_lanes;
+
     void *cb_userdata;
     pa_srbchannel_cb_t callback;
 
@@ -97,12 +107,12 @@ struct pa_srbchannel {
  *    completely full, and want the other side to continue writing
 */
 
-size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
+static size_t ringbuffer_write(pa_srbchannel *sr, pa_ringbuffer *rb, const void *data, size_t l) {
     size_t written = 0;
 
     while (l > 0) {
         int towrite;
-        void *ptr = pa_ringbuffer_begin_write(&sr->rb_write, &towrite);
+        void *ptr = pa_ringbuffer_begin_write(rb, &towrite);
 
         if ((size_t) towrite > l)
             towrite = l;
@@ -115,7 +125,7 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
         }
 
         memcpy(ptr, data, towrite);
-        pa_ringbuffer_end_write(&sr->rb_write, towrite);
+        pa_ringbuffer_end_write(rb, towrite);
         written += towrite;
         data = (uint8_t*) data + towrite;
         l -= towrite;
@@ -128,12 +138,12 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
     return written;
 }
 
-size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
+static size_t ringbuffer_read(pa_srbchannel *sr, pa_ringbuffer *rb, void *data, size_t l) {
     size_t isread = 0;
 
     while (l > 0) {
         int toread;
-        void *ptr = pa_ringbuffer_peek(&sr->rb_read, &toread);
+        void *ptr = pa_ringbuffer_peek(rb, &toread);
 
         if ((size_t) toread > l)
             toread = l;
@@ -143,7 +153,7 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
 
         memcpy(data, ptr, toread);
 
-        if (pa_ringbuffer_drop(&sr->rb_read, toread)) {
+        if (pa_ringbuffer_drop(rb, toread)) {
 #ifdef DEBUG_SRBCHANNEL
             pa_log("Read from full output buffer, signalling fdsem");
 #endif
@@ -162,6 +172,30 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
     return isread;
 }
 
+size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
+    return ringbuffer_write(sr, &sr->rb_write, data, l);
+}
+
+size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
+    return ringbuffer_read(sr, &sr->rb_read, data, l);
+}
+
+size_t pa_srbchannel_write_lane(pa_srbchannel *sr, unsigned lane, const void *data, size_t l) {
+    pa_assert(lane < sr->n_lanes);
+
+    return ringbuffer_write(sr, &sr->lanes[lane].rb_write, data, l);
+}
+
+size_t pa_srbchannel_read_lane(pa_srbchannel *sr, unsigned lane, void *data, size_t l) {
+    pa_assert(lane < sr->n_lanes);
+
+    return ringbuffer_read(sr, &sr->lanes[lane].rb_read, data, l);
+}
+
+unsigned pa_srbchannel_get_n_lanes(pa_srbchannel *sr) {
+    return sr->n_lanes;
+}
+
 /* This is the memory layout of the ringbuffer shm block. It is followed by
    read and write ringbuffer memory. */
 struct srbheader {
@@ -221,37 +255,89 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
     srbchannel_rwloop(sr);
 }
 
-pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p) {
+/* Lays out a read and a write ringbuffer in a fresh shm block */
+static struct srbheader *setup_ringbuffers(pa_memblock *b, pa_ringbuffer *rb_read, pa_ringbuffer *rb_write) {
     int capacity;
-    int readfd;
     struct srbheader *srh;
 
-    pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
-    sr->mainloop = m;
-    sr->memblock = pa_memblock_new_pool(p, -1);
-    if (!sr->memblock)
-        goto fail;
-
-    srh = pa_memblock_acquire(sr->memblock);
+    srh = pa_memblock_acquire(b);
     pa_zero(*srh);
 
-    sr->rb_read.memory = (uint8_t*) srh + PA_ALIGN(sizeof(*srh));
-    srh->readbuf_offset = sr->rb_read.memory - (uint8_t*) srh;
+    rb_read->memory = (uint8_t*) srh + PA_ALIGN(sizeof(*srh));
+    srh->readbuf_offset = rb_read->memory - (uint8_t*) srh;
 
-    capacity = (pa_memblock_get_length(sr->memblock) - srh->readbuf_offset) / 2;
+    capacity = (pa_memblock_get_length(b) - srh->readbuf_offset) / 2;
 
-    sr->rb_write.memory = PA_ALIGN_PTR(sr->rb_read.memory + capacity);
-    srh->writebuf_offset = sr->rb_write.memory - (uint8_t*) srh;
+    rb_write->memory = PA_ALIGN_PTR(rb_read->memory + capacity);
+    srh->writebuf_offset = rb_write->memory - (uint8_t*) srh;
 
     capacity = PA_MIN(capacity, srh->writebuf_offset - srh->readbuf_offset);
 
     pa_log_debug("SHM block is %d bytes, ringbuffer capacity is 2 * %d bytes",
-        (int) pa_memblock_get_length(sr->memblock), capacity);
+        (int) pa_memblock_get_length(b), capacity);
+
+    srh->capacity = rb_read->capacity = rb_write->capacity = capacity;
+
+    rb_read->count = &srh->read_count;
+    rb_write->count = &srh->write_count;
+
+    return srh;
+}
+
+/* Picks up the ringbuffers the other side has laid out in b */
+static struct srbheader *attach_ringbuffers(pa_memblock *b, pa_ringbuffer *rb_read, pa_ringbuffer *rb_write) {
+    struct srbheader *srh;
+    size_t length = pa_memblock_get_length(b);
+
+    srh = pa_memblock_acquire(b);
 
-    srh->capacity = sr->rb_read.capacity = sr->rb_write.capacity = capacity;
+    if (length < sizeof(*srh) || srh->capacity <= 0 ||
+        srh->readbuf_offset < (int) sizeof(*srh) || srh->writebuf_offset < (int) sizeof(*srh) ||
+        (size_t) srh->readbuf_offset + (size_t) srh->capacity > length ||
+        (size_t) srh->writebuf_offset + (size_t) srh->capacity > length) {
+        pa_memblock_release(b);
+        return NULL;
+    }
+
+    rb_read->capacity = rb_write->capacity = srh->capacity;
+    rb_read->count = &srh->read_count;
+    rb_write->count = &srh->write_count;
+
+    rb_read->memory = (uint8_t*) srh + srh->readbuf_offset;
+    rb_write->memory = (uint8_t*) srh + srh->writebuf_offset;
+
+    return srh;
+}
+
+pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p) {
+    return pa_srbchannel_new_with_lanes(m, p, 0);
+}
+
+pa_srbchannel* pa_srbchannel_new_with_lanes(pa_mainloop_api *m, pa_mempool *p, unsigned n_lanes) {
+    int readfd;
+    struct srbheader *srh;
+    unsigned i;
+
+    pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
+
+    pa_assert(n_lanes <= PA_SRBCHANNEL_LANES_MAX);
+
+    sr->mainloop = m;
+    sr->memblock = pa_memblock_new_pool(p, -1);
+    if (!sr->memblock)
+        goto fail;
+
+    srh = setup_ringbuffers(sr->memblock, &sr->rb_read, &sr->rb_write);
+
+    for (i = 0; i < n_lanes; i++) {
+        struct srblane *lane = &sr->lanes[i];
 
-    sr->rb_read.count = &srh->read_count;
-    sr->rb_write.count = &srh->write_count;
+        if (!(lane->memblock = pa_memblock_new_pool(p, -1)))
+            goto fail;
+
+        sr->n_lanes++;
+        setup_ringbuffers(lane->memblock, &lane->rb_read, &lane->rb_write);
+    }
 
     sr->sem_read = pa_fdsem_new_shm(&srh->read_semdata);
     if (!sr->sem_read)
@@ -280,30 +366,45 @@ fail:
 
 static void pa_srbchannel_swap(pa_srbchannel *sr) {
     pa_srbchannel temp = *sr;
+    unsigned i;
 
     sr->sem_read = temp.sem_write;
     sr->sem_write = temp.sem_read;
     sr->rb_read = temp.rb_write;
     sr->rb_write = temp.rb_read;
+
+    for (i = 0; i < sr->n_lanes; i++) {
+        sr->lanes[i].rb_read = temp.lanes[i].rb_write;
+        sr->lanes[i].rb_write = temp.lanes[i].rb_read;
+    }
 }
 
 pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel_template *t)
 {
     int temp;
     struct srbheader *srh;
+    unsigned i;
     pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
 
+    pa_assert(t->n_lanes <= PA_SRBCHANNEL_LANES_MAX);
+
     sr->mainloop = m;
-    sr->memblock = t->memblock;
-    pa_memblock_ref(sr->memblock);
-    srh = pa_memblock_acquire(sr->memblock);
 
-    sr->rb_read.capacity = sr->rb_write.capacity = srh->capacity;
-    sr->rb_read.count = &srh->read_count;
-    sr->rb_write.count = &srh->write_count;
+    srh = attach_ringbuffers(t->memblock, &sr->rb_read, &sr->rb_write);
+    if (!srh)
+        goto fail;
+
+    sr->memblock = pa_memblock_ref(t->memblock);
+
+    for (i = 0; i < t->n_lanes; i++) {
+        struct srblane *lane = &sr->lanes[i];
 
-    sr->rb_read.memory = (uint8_t*) srh + srh->readbuf_offset;
-    sr->rb_write.memory = (uint8_t*) srh + srh->writebuf_offset;
+        if (!attach_ringbuffers(t->lanes[i], &lane->rb_read, &lane->rb_write))
+            goto fail;
+
+        lane->memblock = pa_memblock_ref(t->lanes[i]);
+        sr->n_lanes++;
+    }
 
     sr->sem_read = pa_fdsem_open_shm(&srh->read_semdata, t->readfd);
     if (!sr->sem_read)
@@ -332,9 +433,15 @@ fail:
 }
 
 void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t) {
+    unsigned i;
+
     t->memblock = sr->memblock;
     t->readfd = pa_fdsem_get(sr->sem_read);
     t->writefd = pa_fdsem_get(sr->sem_write);
+
+    for (i = 0; i < sr->n_lanes; i++)
+        t->lanes[i] = sr->lanes[i].memblock;
+    t->n_lanes = sr->n_lanes;
 }
 
 void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback, void *userdata) {
@@ -355,6 +462,8 @@ void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback,
 
 void pa_srbchannel_free(pa_srbchannel *sr)
 {
+    unsigned i;
+
 #ifdef DEBUG_SRBCHANNEL
     pa_log("Freeing srbchannel");
 #endif
@@ -375,5 +484,10 @@ void pa_srbchannel_free(pa_srbchannel *sr)
         pa_memblock_unref(sr->memblock);
     }
 
+    for (i = 0; i < sr->n_lanes; i++) {
+        pa_memblock_release(sr->lanes[i].memblock);
+        pa_memblock_unref(sr->lanes[i].memblock);
+    }
+
     pa_xfree(sr);
 }
@@ -25,16 +25,26 @@
 #include <pulsecore/memblock.h>
 
 /* An shm ringbuffer that is used for low overhead server-client communication.
- * Signaling is done through eventfd semaphores (pa_fdsem). */
+ * Signaling is done through eventfd semaphores (pa_fdsem).
+ *
+ * Besides the main pair of ringbuffers a srbchannel can carry a few lanes,
+ * further pairs of ringbuffers in shm blocks of their own that share the
+ * main pair's semaphores. They let independent streams of data pass each
+ * other instead of queueing up behind one another. */
+
+#define PA_SRBCHANNEL_LANES_MAX 8
 
 typedef struct pa_srbchannel pa_srbchannel;
 
 typedef struct pa_srbchannel_template {
     int readfd, writefd;
     pa_memblock *memblock;
+    pa_memblock *lanes[PA_SRBCHANNEL_LANES_MAX];
+    unsigned n_lanes;
 } pa_srbchannel_template;
 
 pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p);
+pa_srbchannel* pa_srbchannel_new_with_lanes(pa_mainloop_api *m, pa_mempool *p, unsigned n_lanes);
 /* Note: this creates a srbchannel with swapped read and write. */
 pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel_template *t);
 
@@ -45,6 +55,10 @@ void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t);
 size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l);
 size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 
+unsigned pa_srbchannel_get_n_lanes(pa_srbchannel *sr);
+size_t pa_srbchannel_write_lane(pa_srbchannel *sr, unsigned lane, const void *data, size_t l);
+size_t pa_srbchannel_read_lane(pa_srbchannel *sr, unsigned lane, void *data, size_t l);
+
 /* Set the callback function that is called whenever data becomes available for reading.
  * It can also be called if the output buffer was full and can now be written to.
  *
@@ -249,6 +249,301 @@ static void pa_volume_s16re_sse2(int16_t *samples, const int32_t *volumes, unsig
     );
 }
 
+/* swap 32 bits, uses xmm4 */
+#define SWAP_32(s) \
+      " pshuflw $0xb1, "#s", "#s"    \n\t" /* .. | l h | */ \
+      " pshufhw $0xb1, "#s", "#s"    \n\t"                  \
+      SWAP_16(s)
+
+/* The functions below do 8 samples per iteration and leave the rest to
+ * the function they replace. */
+static pa_do_volume_func_t fallback_funcs[PA_SAMPLE_MAX];
+
+static unsigned block_channels(unsigned channels) {
+    /* Must be at least 8 and a multiple of the original number, see
+     * above */
+    return channels < 8 ? (unsigned) channel_overread_table[channels] : channels;
+}
+
+static void volume_tail(pa_sample_format_t f, void *samples, const int32_t *volumes, unsigned channel,
+                        unsigned channels, unsigned length) {
+    if (length > 0)
+        fallback_funcs[f](samples, volumes + channel % channels, channels, length);
+}
+
+static void pa_volume_float32ne_sse2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(float), k = n & ~7U;
+    pa_reg_x86 channel = 0, temp, cnt = k / 8;
+
+    if (k > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " movups (%1, %3, 4), %%xmm1    \n\t" /* 8 volumes */
+            " movups 16(%1, %3, 4), %%xmm2  \n\t"
+            " movups (%0), %%xmm0           \n\t" /* 8 samples */
+            " movups 16(%0), %%xmm3         \n\t"
+            " mulps %%xmm1, %%xmm0          \n\t"
+            " mulps %%xmm2, %%xmm3          \n\t"
+            " movups %%xmm0, (%0)           \n\t"
+            " movups %%xmm3, 16(%0)         \n\t"
+            " add $32, %0                   \n\t"
+            MOD_ADD ($8, %5)
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)
+            : "rm" ((pa_reg_x86) block_channels(channels))
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    volume_tail(PA_SAMPLE_FLOAT32NE, samples, (const int32_t *) volumes, channel, channels, (n - k) * sizeof(float));
+}
+
+static void pa_volume_float32re_sse2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(float), k = n & ~7U;
+    pa_reg_x86 channel = 0, temp, cnt = k / 8;
+
+    if (k > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " movups (%1, %3, 4), %%xmm1    \n\t" /* 8 volumes */
+            " movups 16(%1, %3, 4), %%xmm2  \n\t"
+            " movdqu (%0), %%xmm0           \n\t" /* 8 samples */
+            " movdqu 16(%0), %%xmm3         \n\t"
+            SWAP_32 (%%xmm0)
+            SWAP_32 (%%xmm3)
+            " mulps %%xmm1, %%xmm0          \n\t"
+            " mulps %%xmm2, %%xmm3          \n\t"
+            SWAP_32 (%%xmm0)
+            SWAP_32 (%%xmm3)
+            " movdqu %%xmm0, (%0)           \n\t"
+            " movdqu %%xmm3, 16(%0)         \n\t"
+            " add $32, %0                   \n\t"
+            MOD_ADD ($8, %5)
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)
+            : "rm" ((pa_reg_x86) block_channels(channels))
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4"
+        );
+    }
+
+    volume_tail(PA_SAMPLE_FLOAT32RE, samples, (const int32_t *) volumes, channel, channels, (n - k) * sizeof(float));
+}
+
+static const PA_DECLARE_ALIGNED (32, uint8_t, swap32_mask[32]) = {
+    3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12, 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12
+};
+
+static void pa_volume_float32ne_avx2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(float), k = n & ~7U;
+    pa_reg_x86 channel = 0, temp, cnt = k / 8;
+
+    if (k > 0) {
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " vmovups (%1, %3, 4), %%ymm1   \n\t" /* 8 volumes */
+            " vmulps (%0), %%ymm1, %%ymm0   \n\t"
+            " vmovups %%ymm0, (%0)          \n\t"
+            " add $32, %0                   \n\t"
+            MOD_ADD ($8, %5)
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)
+            : "rm" ((pa_reg_x86) block_channels(channels))
+            : "cc", "memory", "xmm0", "xmm1"
+        );
+    }
+
+    volume_tail(PA_SAMPLE_FLOAT32NE, samples, (const int32_t *) volumes, channel, channels, (n - k) * sizeof(float));
+}
+
+static void pa_volume_float32re_avx2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(float), k = n & ~7U;
+    pa_reg_x86 channel = 0, temp, cnt = k / 8;
+
+    if (k > 0) {
+        __asm__ __volatile__ (
+            " vmovdqa %6, %%ymm5            \n\t"
+
+            "1:                             \n\t"
+            " vmovups (%1, %3, 4), %%ymm1   \n\t" /* 8 volumes */
+            " vmovdqu (%0), %%ymm0          \n\t" /* 8 samples */
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t"
+            " vmulps %%ymm1, %%ymm0, %%ymm0 \n\t"
+            " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t"
+            " vmovdqu %%ymm0, (%0)          \n\t"
+            " add $32, %0                   \n\t"
+            MOD_ADD ($8, %5)
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            " vzeroupper                    \n\t"
+
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)
+            : "rm" ((pa_reg_x86) block_channels(channels)), "m" (*swap32_mask)
+            : "cc", "memory", "xmm0", "xmm1", "xmm5"
+        );
+    }
+
+    volume_tail(PA_SAMPLE_FLOAT32RE, samples, (const int32_t *) volumes, channel, channels, (n - k) * sizeof(float));
+}
+
+/* The 32 bit integer formats need the full 64 bit product of sample and
+ * volume like the C code. It is clamped to the range that fits in 32 bits
+ * after >> 16, then bits 16..47 are what we want. Samples in ymm0,
+ * volumes in ymm1, the clamp range in ymm6/ymm7. */
+#define VOLUME_32x8_AVX2 \
+      " vpmuldq %%ymm1, %%ymm0, %%ymm2 \n\t" /* even products */                \
+      " vpsrlq $32, %%ymm0, %%ymm0    \n\t"                                     \
+      " vpsrlq $32, %%ymm1, %%ymm1    \n\t"                                     \
+      " vpmuldq %%ymm1, %%ymm0, %%ymm3 \n\t" /* odd products */                 \
+      " vpcmpgtq %%ymm6, %%ymm2, %%ymm4 \n\t"                                   \
+      " vblendvpd %%ymm4, %%ymm6, %%ymm2, %%ymm2 \n\t"                          \
+      " vpcmpgtq %%ymm6, %%ymm3, %%ymm4 \n\t"                                   \
+      " vblendvpd %%ymm4, %%ymm6, %%ymm3, %%ymm3 \n\t"                          \
+      " vpcmpgtq %%ymm2, %%ymm7, %%ymm4 \n\t"                                   \
+      " vblendvpd %%ymm4, %%ymm7, %%ymm2, %%ymm2 \n\t"                          \
+      " vpcmpgtq %%ymm3, %%ymm7, %%ymm4 \n\t"                                   \
+      " vblendvpd %%ymm4, %%ymm7, %%ymm3, %%ymm3 \n\t"                          \
+      " vpsrlq $16, %%ymm2, %%ymm2    \n\t" /* even results to the low half */  \
+      " vpsllq $16, %%ymm3, %%ymm3    \n\t" /* odd results to the high half */  \
+      " vpblendd $0xaa, %%ymm3, %%ymm2, %%ymm0 \n\t"
+
+static const int64_t product_max = 0x7fffffffffffLL;
+static const int64_t product_min = -0x800000000000LL;
+
+/* Generates the function for a format where all 8 samples fit in one
+ * register. load and store convert in place from and to 32 bits in
+ * ymm0. */
+#define VOLUME_32_FUNC_AVX2(name, format, type, load, store)                                    \
+static void name(type *samples, const int32_t *volumes, unsigned channels, unsigned length) {   \
+    unsigned n = length / sizeof(type), k = n & ~7U;                                            \
+    pa_reg_x86 channel = 0, temp, cnt = k / 8;                                                  \
+                                                                                                \
+    if (k > 0) {                                                                                \
+        __asm__ __volatile__ (                                                                  \
+            " vpbroadcastq %6, %%ymm6       \n\t"                                               \
+            " vpbroadcastq %7, %%ymm7       \n\t"                                               \
+            " vmovdqa %8, %%ymm5            \n\t"                                               \
+                                                                                                \
+            "1:                             \n\t"                                               \
+            " vmovdqu (%0), %%ymm0          \n\t" /* 8 samples */                               \
+            load                                                                                \
+            " vmovdqu (%1, %3, 4), %%ymm1   \n\t" /* 8 volumes */                               \
+            VOLUME_32x8_AVX2                                                                    \
+            store                                                                               \
+            " vmovdqu %%ymm0, (%0)          \n\t"                                               \
+            " add $32, %0                   \n\t"                                               \
+            MOD_ADD ($8, %5)                                                                    \
+            " dec %2                        \n\t"                                               \
+            " jne 1b                        \n\t"                                               \
+            " vzeroupper                    \n\t"                                               \
+                                                                                                \
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)          \
+            : "rm" ((pa_reg_x86) block_channels(channels)), "m" (product_max), "m" (product_min), \
+              "m" (*swap32_mask)                                                                \
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"    \
+        );                                                                                      \
+    }                                                                                           \
+                                                                                                \
+    volume_tail(format, samples, volumes, channel, channels, (n - k) * sizeof(type));           \
+}
+
+VOLUME_32_FUNC_AVX2(pa_volume_s32ne_avx2, PA_SAMPLE_S32NE, int32_t,
+    "",
+    "")
+VOLUME_32_FUNC_AVX2(pa_volume_s32re_avx2, PA_SAMPLE_S32RE, int32_t,
+    " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t",
+    " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t")
+VOLUME_32_FUNC_AVX2(pa_volume_s24_32ne_avx2, PA_SAMPLE_S24_32NE, uint32_t,
+    " vpslld $8, %%ymm0, %%ymm0     \n\t",
+    " vpsrld $8, %%ymm0, %%ymm0     \n\t")
+VOLUME_32_FUNC_AVX2(pa_volume_s24_32re_avx2, PA_SAMPLE_S24_32RE, uint32_t,
+    " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t"
+    " vpslld $8, %%ymm0, %%ymm0     \n\t",
+    " vpsrld $8, %%ymm0, %%ymm0     \n\t"
+    " vpshufb %%ymm5, %%ymm0, %%ymm0 \n\t")
+
+/* Packed 24 bit samples: 8 samples are 6 dwords. We load 8 dwords and
+ * spread them over the two lanes with vpermd, and store back only the 6
+ * we own. */
+#define Z 0x80
+static const PA_DECLARE_ALIGNED (32, int32_t, s24_spread[8]) = { 0, 1, 2, 6, 3, 4, 5, 6 };
+static const PA_DECLARE_ALIGNED (32, int32_t, s24_gather[8]) = { 0, 1, 2, 4, 5, 6, 3, 7 };
+static const PA_DECLARE_ALIGNED (32, uint8_t, s24ne_load[32]) = {
+    Z,0,1,2, Z,3,4,5, Z,6,7,8, Z,9,10,11, Z,0,1,2, Z,3,4,5, Z,6,7,8, Z,9,10,11
+};
+static const PA_DECLARE_ALIGNED (32, uint8_t, s24ne_store[32]) = {
+    1,2,3, 5,6,7, 9,10,11, 13,14,15, Z,Z,Z,Z, 1,2,3, 5,6,7, 9,10,11, 13,14,15, Z,Z,Z,Z
+};
+static const PA_DECLARE_ALIGNED (32, uint8_t, s24re_load[32]) = {
+    Z,2,1,0, Z,5,4,3, Z,8,7,6, Z,11,10,9, Z,2,1,0, Z,5,4,3, Z,8,7,6, Z,11,10,9
+};
+static const PA_DECLARE_ALIGNED (32, uint8_t, s24re_store[32]) = {
+    3,2,1, 7,6,5, 11,10,9, 15,14,13, Z,Z,Z,Z, 3,2,1, 7,6,5, 11,10,9, 15,14,13, Z,Z,Z,Z
+};
+#undef Z
+
+#define VOLUME_S24_FUNC_AVX2(name, format, load_mask, store_mask)                                 \
+static void name(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) { \
+    unsigned n = length / 3, k;                                                                 \
+    pa_reg_x86 channel = 0, temp, cnt;                                                          \
+                                                                                                \
+    /* The last block must leave room for the 8 bytes we read beyond it */                     \
+    k = length >= 32 ? ((length - 8) / 24) * 8 : 0;                                             \
+    cnt = k / 8;                                                                                \
+                                                                                                \
+    if (k > 0) {                                                                                \
+        __asm__ __volatile__ (                                                                  \
+            " vpbroadcastq %6, %%ymm6       \n\t"                                               \
+            " vpbroadcastq %7, %%ymm7       \n\t"                                               \
+                                                                                                \
+            "1:                             \n\t"                                               \
+            " vmovdqu (%0), %%ymm0          \n\t" /* 8 samples and 8 more bytes */              \
+            " vmovdqa %8, %%ymm4            \n\t"                                               \
+            " vpermd %%ymm0, %%ymm4, %%ymm0 \n\t"                                               \
+            " vpshufb %10, %%ymm0, %%ymm0   \n\t" /* to 32 bits */                              \
+            " vmovdqu (%1, %3, 4), %%ymm1   \n\t" /* 8 volumes */                               \
+            VOLUME_32x8_AVX2                                                                    \
+            " vpshufb %11, %%ymm0, %%ymm0   \n\t" /* back to 24 bits */                         \
+            " vmovdqa %9, %%ymm4            \n\t"                                               \
+            " vpermd %%ymm0, %%ymm4, %%ymm0 \n\t"                                               \
+            " vmovdqu %%xmm0, (%0)          \n\t"                                               \
+            " vextracti128 $1, %%ymm0, %%xmm0 \n\t"                                             \
+            " vmovq %%xmm0, 16(%0)          \n\t"                                               \
+            " add $24, %0                   \n\t"                                               \
+            MOD_ADD ($8, %5)                                                                    \
+            " dec %2                        \n\t"                                               \
+            " jne 1b                        \n\t"                                               \
+            " vzeroupper                    \n\t"                                               \
+                                                                                                \
+            : "+r" (samples), "+r" (volumes), "+r" (cnt), "+r" (channel), "=&r" (temp)          \
+            : "rm" ((pa_reg_x86) block_channels(channels)), "m" (product_max), "m" (product_min), \
+              "m" (*s24_spread), "m" (*s24_gather),                                             \
+              "m" (*load_mask), "m" (*store_mask)                                               \
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"    \
+        );                                                                                      \
+    }                                                                                           \
+                                                                                                \
+    volume_tail(format, samples, volumes, channel, channels, (n - k) * 3);                      \
+}
+
+VOLUME_S24_FUNC_AVX2(pa_volume_s24ne_avx2, PA_SAMPLE_S24NE, s24ne_load, s24ne_store)
+VOLUME_S24_FUNC_AVX2(pa_volume_s24re_avx2, PA_SAMPLE_S24RE, s24re_load, s24re_store)
+
+static void set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
+    /* Remember the function we replace only the first time, later it
+     * might be our own */
+    if (!fallback_funcs[f])
+        fallback_funcs[f] = pa_get_volume_func(f);
+
+    pa_set_volume_func(f, func);
+}
+
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -258,6 +553,21 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
 
         pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_sse2);
         pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_sse2);
+        set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_sse2);
+        set_volume_func(PA_SAMPLE_FLOAT32RE, (pa_do_volume_func_t) pa_volume_float32re_sse2);
+    }
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized volume functions.");
+
+        set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx2);
+        set_volume_func(PA_SAMPLE_FLOAT32RE, (pa_do_volume_func_t) pa_volume_float32re_avx2);
+        set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx2);
+        set_volume_func(PA_SAMPLE_S32RE, (pa_do_volume_func_t) pa_volume_s32re_avx2);
+        set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_avx2);
+        set_volume_func(PA_SAMPLE_S24_32RE, (pa_do_volume_func_t) pa_volume_s24_32re_avx2);
+        set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_avx2);
+        set_volume_func(PA_SAMPLE_S24RE, (pa_do_volume_func_t) pa_volume_s24re_avx2);
     }
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 }
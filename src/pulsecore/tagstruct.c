@@ -36,12 +36,12 @@
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/packet.h>
 
 #include "tagstruct.h"
 
 #define MAX_TAG_SIZE (64*1024)
 #define MAX_APPENDED_SIZE 128
-#define GROW_TAG_SIZE 100
 
 struct pa_tagstruct {
     uint8_t *data;
@@ -51,7 +51,8 @@ struct pa_tagstruct {
     enum {
         PA_TAGSTRUCT_FIXED, /* The tagstruct does not own the data, buffer was provided by caller. */
         PA_TAGSTRUCT_DYNAMIC, /* Buffer owned by tagstruct, data must be freed. */
-        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to dynamic if needed. */
+        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to pooled or dynamic if needed. */
+        PA_TAGSTRUCT_POOLED, /* Buffer taken from the packet free list, must be given back. Will change to dynamic if needed. */
     } type;
     union {
         uint8_t appended[MAX_APPENDED_SIZE];
@@ -93,24 +94,54 @@ void pa_tagstruct_free(pa_tagstruct*t) {
 
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
         pa_xfree(t->data);
+    else if (t->type == PA_TAGSTRUCT_POOLED)
+        pa_packet_buffer_free(t->data);
     if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
         pa_xfree(t);
 }
 
-static inline void extend(pa_tagstruct*t, size_t l) {
-    pa_assert(t);
-    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+static void grow(pa_tagstruct *t, size_t l) {
+    size_t allocated;
 
-    if (t->length+l <= t->allocated)
+    /* Most replies fit into a buffer from the packet free list, which
+     * then becomes the packet without a copy or a malloc() */
+    if (t->type == PA_TAGSTRUCT_APPENDED && t->length + l <= PA_PACKET_POOLED_SIZE) {
+        t->type = PA_TAGSTRUCT_POOLED;
+        t->data = pa_packet_buffer_new();
+        memcpy(t->data, t->per_type.appended, t->length);
+        t->allocated = PA_PACKET_POOLED_SIZE;
         return;
+    }
+
+    /* Introspection replies can get big, so grow exponentially to
+     * keep the number of reallocations down */
+    allocated = PA_MAX(t->allocated * 2, t->length + l);
 
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        t->data = pa_xrealloc(t->data, t->allocated = t->length + l + GROW_TAG_SIZE);
-    else if (t->type == PA_TAGSTRUCT_APPENDED) {
+        t->data = pa_xrealloc(t->data, allocated);
+    else {
+        uint8_t *data = pa_xmalloc(allocated);
+
+        memcpy(data, t->data, t->length);
+
+        if (t->type == PA_TAGSTRUCT_POOLED)
+            pa_packet_buffer_free(t->data);
+
         t->type = PA_TAGSTRUCT_DYNAMIC;
-        t->data = pa_xmalloc(t->allocated = t->length + l + GROW_TAG_SIZE);
-        memcpy(t->data, t->per_type.appended, t->length);
+        t->data = data;
     }
+
+    t->allocated = allocated;
+}
+
+static inline void extend(pa_tagstruct*t, size_t l) {
+    pa_assert(t);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+
+    if (PA_LIKELY(t->length+l <= t->allocated))
+        return;
+
+    grow(t, l);
 }
 
 static void write_u8(pa_tagstruct *t, uint8_t u) {
@@ -455,6 +486,28 @@ int pa_tagstruct_eof(pa_tagstruct*t) {
     return t->rindex >= t->length;
 }
 
+pa_packet *pa_tagstruct_free_to_packet(pa_tagstruct *t) {
+    pa_packet *packet;
+
+    pa_assert(t);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+    pa_assert(t->length > 0);
+
+    /* Hand the buffer over instead of copying it */
+    if (t->type == PA_TAGSTRUCT_POOLED) {
+        packet = pa_packet_new_pooled(t->data, t->length);
+        t->type = PA_TAGSTRUCT_FIXED;
+    } else if (t->type == PA_TAGSTRUCT_DYNAMIC) {
+        packet = pa_packet_new_dynamic(t->data, t->length);
+        t->type = PA_TAGSTRUCT_FIXED;
+    } else
+        packet = pa_packet_new_data(t->data, t->length);
+
+    pa_tagstruct_free(t);
+
+    return packet;
+}
+
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l) {
     pa_assert(t);
     pa_assert(l);
@@ -604,9 +657,6 @@ int pa_tagstruct_get_proplist(pa_tagstruct *t, pa_proplist *p) {
         if (!k)
             break;
 
-        if (!pa_proplist_key_valid(k))
-            return -1;
-
         if (pa_tagstruct_getu32(t, &length) < 0)
             return -1;
 
@@ -616,8 +666,12 @@ int pa_tagstruct_get_proplist(pa_tagstruct *t, pa_proplist *p) {
         if (pa_tagstruct_get_arbitrary(t, &d, length) < 0)
             return -1;
 
-        if (p)
-            pa_assert_se(pa_proplist_set(p, k, d, length) >= 0);
+        /* pa_proplist_set() checks the key itself */
+        if (p) {
+            if (pa_proplist_set(p, k, d, length) < 0)
+                return -1;
+        } else if (!pa_proplist_key_valid(k))
+            return -1;
     }
 
     return 0;
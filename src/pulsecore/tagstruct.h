@@ -31,6 +31,7 @@
 #include <pulse/proplist.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
 
 typedef struct pa_tagstruct pa_tagstruct;
 
@@ -67,6 +68,10 @@ void pa_tagstruct_free(pa_tagstruct*t);
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
+/* Frees the tagstruct and returns a packet with its contents. Larger
+ * tagstructs hand their buffer over to the packet without copying. */
+pa_packet *pa_tagstruct_free_to_packet(pa_tagstruct *t);
+
 void pa_tagstruct_put(pa_tagstruct *t, ...);
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s);
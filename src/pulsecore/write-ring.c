@@ -0,0 +1,313 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/flist.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/refcnt.h>
+
+#include "write-ring.h"
+
+/* Lives at the start of the ring memblock, shared by both sides */
+struct ring_header {
+    /* Bytes committed by the client and not given back by the server */
+    pa_atomic_t count;
+};
+
+#define RING_HEADER_SIZE PA_ALIGN(sizeof(struct ring_header))
+
+/* A region handed out by the server. Regions are given back to the
+ * client in the order they were taken, even if their memblocks go away
+ * in a different order. */
+struct region {
+    pa_write_ring *ring;
+    size_t length;
+    bool done;
+    PA_LLIST_FIELDS(struct region);
+};
+
+PA_STATIC_FLIST_DECLARE(regions, 0, pa_xfree);
+
+struct pa_write_ring {
+    PA_REFCNT_DECLARE;
+
+    bool server;
+    pa_memblock *memblock;
+    struct ring_header *header;
+    uint8_t *data;
+    size_t capacity, frame_size;
+
+    /* Where the next region starts, on both sides */
+    size_t write_pos;
+
+    /* Client side: the current reservation, and the bytes at the end of
+     * the ring it skips if it starts over at 0 */
+    size_t reserved_index, reserved, skipped;
+
+    /* Server side */
+    pa_mempool *pool;
+    pa_mutex *mutex;
+    size_t in_use;
+    PA_LLIST_HEAD(struct region, regions);
+    struct region *last_region;
+};
+
+static pa_write_ring *ring_new(pa_memblock *b, size_t frame_size, bool server) {
+    pa_write_ring *r;
+    size_t length;
+
+    length = pa_memblock_get_length(b);
+    if (length < RING_HEADER_SIZE + frame_size)
+        return NULL;
+
+    r = pa_xnew0(pa_write_ring, 1);
+    PA_REFCNT_INIT(r);
+    r->server = server;
+    r->memblock = pa_memblock_ref(b);
+    r->header = pa_memblock_acquire(b);
+    r->data = (uint8_t *) r->header + RING_HEADER_SIZE;
+    r->frame_size = frame_size;
+    r->capacity = ((length - RING_HEADER_SIZE) / frame_size) * frame_size;
+
+    return r;
+}
+
+static void ring_unref(pa_write_ring *r) {
+    pa_assert(r);
+    pa_assert(PA_REFCNT_VALUE(r) >= 1);
+
+    if (PA_REFCNT_DEC(r) > 0)
+        return;
+
+    pa_assert(!r->regions);
+
+    pa_memblock_release(r->memblock);
+    pa_memblock_unref(r->memblock);
+
+    if (r->pool)
+        pa_mempool_unref(r->pool);
+    if (r->mutex)
+        pa_mutex_free(r->mutex);
+
+    pa_xfree(r);
+}
+
+pa_write_ring *pa_write_ring_new(pa_mempool *pool, size_t frame_size) {
+    pa_write_ring *r;
+    pa_memblock *b;
+
+    pa_assert(pool);
+    pa_assert(frame_size > 0);
+
+    if (!(b = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))))
+        return NULL;
+
+    r = ring_new(b, frame_size, true);
+    pa_memblock_unref(b);
+
+    if (!r)
+        return NULL;
+
+    pa_atomic_store(&r->header->count, 0);
+
+    r->pool = pa_mempool_ref(pool);
+    r->mutex = pa_mutex_new(false, false);
+    PA_LLIST_HEAD_INIT(struct region, r->regions);
+
+    return r;
+}
+
+pa_memblock *pa_write_ring_get_memblock(pa_write_ring *r) {
+    pa_assert(r);
+    pa_assert(r->server);
+
+    return r->memblock;
+}
+
+/* Called with the mutex held */
+static void give_back_done_regions(pa_write_ring *r) {
+    struct region *g;
+
+    while ((g = r->regions) && g->done) {
+        pa_atomic_sub(&r->header->count, (int) g->length);
+        r->in_use -= g->length;
+
+        PA_LLIST_REMOVE(struct region, r->regions, g);
+        if (r->last_region == g)
+            r->last_region = NULL;
+
+        if (pa_flist_push(PA_STATIC_FLIST_GET(regions), g) < 0)
+            pa_xfree(g);
+    }
+}
+
+/* Called with the mutex held */
+static struct region *push_region(pa_write_ring *r, size_t length) {
+    struct region *g;
+
+    if (!(g = pa_flist_pop(PA_STATIC_FLIST_GET(regions))))
+        g = pa_xnew(struct region, 1);
+
+    g->ring = r;
+    g->length = length;
+    g->done = false;
+
+    if (r->last_region)
+        PA_LLIST_INSERT_AFTER(struct region, r->regions, r->last_region, g);
+    else
+        PA_LLIST_PREPEND(struct region, r->regions, g);
+    r->last_region = g;
+
+    r->in_use += length;
+
+    return g;
+}
+
+/* Might be called from any thread */
+static void region_free_cb(void *userdata) {
+    struct region *g = userdata;
+    pa_write_ring *r = g->ring;
+
+    pa_mutex_lock(r->mutex);
+    g->done = true;
+    give_back_done_regions(r);
+    pa_mutex_unlock(r->mutex);
+
+    ring_unref(r);
+}
+
+pa_memblock *pa_write_ring_take(pa_write_ring *r, size_t index, size_t length) {
+    struct region *g;
+    size_t skipped = 0;
+
+    pa_assert(r);
+    pa_assert(r->server);
+
+    if (length == 0 || length % r->frame_size != 0)
+        return NULL;
+
+    pa_mutex_lock(r->mutex);
+
+    /* The client may only continue where it left off, or start over at
+     * the beginning if there is not enough room left at the end */
+    if (index != r->write_pos) {
+        if (index != 0)
+            goto fail;
+
+        skipped = r->capacity - r->write_pos;
+    }
+
+    if (length > r->capacity - index || skipped + length > r->capacity - r->in_use)
+        goto fail;
+
+    if (skipped > 0)
+        push_region(r, skipped)->done = true;
+
+    g = push_region(r, length);
+    r->write_pos = (index + length) % r->capacity;
+
+    give_back_done_regions(r);
+    pa_mutex_unlock(r->mutex);
+
+    PA_REFCNT_INC(r);
+
+    return pa_memblock_new_user(r->pool, r->data + index, length, region_free_cb, g, true);
+
+fail:
+    pa_mutex_unlock(r->mutex);
+    return NULL;
+}
+
+pa_write_ring *pa_write_ring_attach(pa_memblock *b, size_t frame_size) {
+    pa_assert(b);
+    pa_assert(frame_size > 0);
+
+    if (pa_memblock_is_read_only(b))
+        return NULL;
+
+    return ring_new(b, frame_size, false);
+}
+
+void *pa_write_ring_begin_write(pa_write_ring *r, size_t *nbytes) {
+    size_t free_bytes, tail;
+
+    pa_assert(r);
+    pa_assert(!r->server);
+    pa_assert(nbytes);
+    pa_assert(*nbytes > 0);
+
+    free_bytes = r->capacity - (size_t) pa_atomic_load(&r->header->count);
+    tail = r->capacity - r->write_pos;
+
+    if (tail >= *nbytes && free_bytes >= *nbytes) {
+        r->reserved_index = r->write_pos;
+        r->reserved = PA_MIN(tail, free_bytes);
+        r->skipped = 0;
+    } else if (r->write_pos > 0 && free_bytes >= tail + *nbytes) {
+        r->reserved_index = 0;
+        r->reserved = free_bytes - tail;
+        r->skipped = tail;
+    } else
+        return NULL;
+
+    *nbytes = r->reserved;
+
+    return r->data + r->reserved_index;
+}
+
+size_t pa_write_ring_end_write(pa_write_ring *r, size_t length) {
+    size_t index;
+
+    pa_assert(r);
+    pa_assert(!r->server);
+    pa_assert(length <= r->reserved);
+    pa_assert(length % r->frame_size == 0);
+
+    index = r->reserved_index;
+
+    if (length > 0) {
+        /* The atomic add is a full memory barrier, so the data is in
+         * place before the server can learn about it */
+        pa_atomic_add(&r->header->count, (int) (r->skipped + length));
+        r->write_pos = (index + length) % r->capacity;
+    }
+
+    r->reserved_index = r->reserved = r->skipped = 0;
+
+    return index;
+}
+
+size_t pa_write_ring_get_capacity(pa_write_ring *r) {
+    pa_assert(r);
+
+    return r->capacity;
+}
+
+void pa_write_ring_free(pa_write_ring *r) {
+    pa_assert(r);
+
+    /* Memblocks still out there keep the ring alive on the server side */
+    ring_unref(r);
+}
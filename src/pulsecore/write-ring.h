@@ -0,0 +1,64 @@
+#ifndef foopulsewriteringhfoo
+#define foopulsewriteringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/types.h>
+
+#include <pulsecore/memblock.h>
+
+/* A ring in a single shared memblock that a client writes playback data
+ * into in place. The server allocates the ring from the connection's
+ * remote writable pool and sends it to the client once. From then on
+ * the client only tells the server where in the ring it has written,
+ * and the server hands that region on as a read-only memblock of its
+ * own. When the last reference to such a memblock is gone, its region
+ * is given back to the client through a counter in the ring itself, so
+ * no memexport slots and no release frames are involved. */
+
+typedef struct pa_write_ring pa_write_ring;
+
+/* Server side. Returns NULL if the pool has no room for the ring. */
+pa_write_ring *pa_write_ring_new(pa_mempool *pool, size_t frame_size);
+
+/* Server side. The memblock to send to the client. */
+pa_memblock *pa_write_ring_get_memblock(pa_write_ring *r);
+
+/* Server side. Returns a new memblock covering what the client has
+ * written at index, or NULL if that region is not what the client may
+ * have written next. */
+pa_memblock *pa_write_ring_take(pa_write_ring *r, size_t index, size_t length);
+
+/* Client side. Returns NULL if b cannot be used as a ring. */
+pa_write_ring *pa_write_ring_attach(pa_memblock *b, size_t frame_size);
+
+/* Client side. Reserves at least *nbytes of contiguous space, and sets
+ * *nbytes to the size of the whole space available there. Returns NULL
+ * if there is not enough room at the moment. */
+void *pa_write_ring_begin_write(pa_write_ring *r, size_t *nbytes);
+
+/* Client side. Commits the first length bytes of the reservation and
+ * returns their index in the ring, to be passed to the server. A length
+ * of 0 drops the reservation. */
+size_t pa_write_ring_end_write(pa_write_ring *r, size_t length);
+
+size_t pa_write_ring_get_capacity(pa_write_ring *r);
+
+void pa_write_ring_free(pa_write_ring *r);
+
+#endif
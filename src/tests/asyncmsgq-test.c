@@ -30,6 +30,11 @@
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
+#include "runtime-test-util.h"
+
+#define PING_PONG_TIMES 1000
+#define PING_PONG_TIMES2 20
+
 enum {
     OPERATION_A,
     OPERATION_B,
@@ -105,15 +110,70 @@ START_TEST (asyncmsgq_test) {
 }
 END_TEST
 
+static pa_asyncmsgq *ping_q, *pong_q;
+
+/* Bounces every message back, either on pong_q or, for messages that
+ * were sent synchronously, by completing them */
+static void pong_thread(void *userdata) {
+    int code;
+
+    do {
+        pa_assert_se(pa_asyncmsgq_get(ping_q, NULL, &code, NULL, NULL, NULL, true) == 0);
+        pa_asyncmsgq_done(ping_q, 0);
+
+        if (code == OPERATION_A)
+            pa_asyncmsgq_post(pong_q, NULL, OPERATION_A, NULL, 0, NULL, NULL);
+
+    } while (code != QUIT);
+}
+
+START_TEST (asyncmsgq_wakeup_benchmark) {
+    pa_thread *t;
+
+    ping_q = pa_asyncmsgq_new(0);
+    pong_q = pa_asyncmsgq_new(0);
+
+    t = pa_thread_new("pong", pong_thread, NULL);
+    fail_unless(t != NULL);
+
+    /* Both sides sleep in pa_asyncmsgq_get() */
+    PA_RUNTIME_TEST_RUN_START("post/get round trips", PING_PONG_TIMES, PING_PONG_TIMES2) {
+        int code;
+
+        pa_asyncmsgq_post(ping_q, NULL, OPERATION_A, NULL, 0, NULL, NULL);
+        pa_assert_se(pa_asyncmsgq_get(pong_q, NULL, &code, NULL, NULL, NULL, true) == 0);
+        pa_asyncmsgq_done(pong_q, 0);
+        fail_unless(code == OPERATION_A);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    /* The sender sleeps on the semaphore of the message */
+    PA_RUNTIME_TEST_RUN_START("send round trips", PING_PONG_TIMES, PING_PONG_TIMES2) {
+        fail_unless(pa_asyncmsgq_send(ping_q, NULL, OPERATION_B, NULL, 0, NULL) == 0);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_asyncmsgq_post(ping_q, NULL, QUIT, NULL, 0, NULL, NULL);
+    pa_thread_free(t);
+
+    pa_asyncmsgq_unref(pong_q);
+    pa_asyncmsgq_unref(ping_q);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
     s = suite_create("Async Message Queue");
     tc = tcase_create("asyncmsgq");
     tcase_add_test(tc, asyncmsgq_test);
+    tcase_add_test(tc, asyncmsgq_wakeup_benchmark);
+    /* the benchmark takes a while on slow machines */
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
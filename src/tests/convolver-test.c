@@ -0,0 +1,183 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "modules/convolver.h"
+#include "runtime-test-util.h"
+
+#define N_INPUTS 6
+#define N_OUTPUTS 2
+#define FRAMES 4096
+#define TIMES2 10
+
+static float random_float(void) {
+    return (float) rand() / RAND_MAX - 0.5f;
+}
+
+static pa_convolver *convolver_new(pa_convolver_engine_t engine, unsigned n_taps, const float *taps) {
+    pa_convolver *c;
+    unsigned i, o;
+
+    fail_unless((c = pa_convolver_new(engine, N_INPUTS, N_OUTPUTS, n_taps)) != NULL);
+
+    for (i = 0; i < N_INPUTS; i++)
+        for (o = 0; o < N_OUTPUTS; o++)
+            pa_convolver_set_filter(c, i, o, taps + i * N_OUTPUTS + o, N_INPUTS * N_OUTPUTS);
+
+    return c;
+}
+
+static void run_convolver_test(unsigned n_taps) {
+    pa_convolver *direct, *fft;
+    float *taps, *src, *dst_direct, *dst_fft;
+    unsigned k, n, done, pass;
+
+    taps = pa_xnew(float, n_taps * N_INPUTS * N_OUTPUTS);
+    src = pa_xnew(float, FRAMES * N_INPUTS);
+    dst_direct = pa_xnew(float, FRAMES * N_OUTPUTS);
+    dst_fft = pa_xnew(float, FRAMES * N_OUTPUTS);
+
+    /* Scale so that the outputs stay around 1 */
+    for (k = 0; k < n_taps * N_INPUTS * N_OUTPUTS; k++)
+        taps[k] = random_float() / sqrtf(n_taps * N_INPUTS);
+    for (k = 0; k < FRAMES * N_INPUTS; k++)
+        src[k] = random_float();
+
+    direct = convolver_new(PA_CONVOLVER_DIRECT, n_taps, taps);
+    fft = convolver_new(PA_CONVOLVER_FFT, n_taps, taps);
+
+    /* The second pass checks that reset forgets everything */
+    for (pass = 0; pass < 2; pass++) {
+        pa_convolver_run(direct, src, dst_direct, FRAMES);
+
+        /* Feed the FFT engine in odd sized pieces, so that blocks get
+         * completed in between as well as by a single call */
+        for (done = 0; done < FRAMES; done += n) {
+            n = PA_MIN(FRAMES - done, (unsigned) (rand() % 700) + 1);
+            pa_convolver_run(fft, src + done * N_INPUTS, dst_fft + done * N_OUTPUTS, n);
+        }
+
+        for (k = 0; k < FRAMES * N_OUTPUTS; k++)
+            fail_unless(fabsf(dst_direct[k] - dst_fft[k]) < 1e-4f,
+                        "%u taps: sample %u is %f, expected %f", n_taps, k, dst_fft[k], dst_direct[k]);
+
+        pa_convolver_reset(direct);
+        pa_convolver_reset(fft);
+    }
+
+    pa_convolver_free(direct);
+    pa_convolver_free(fft);
+
+    pa_xfree(taps);
+    pa_xfree(src);
+    pa_xfree(dst_direct);
+    pa_xfree(dst_fft);
+}
+
+START_TEST (convolver_test) {
+    run_convolver_test(1);
+    run_convolver_test(64);
+    run_convolver_test(100);
+    run_convolver_test(513);
+    run_convolver_test(1500);
+}
+END_TEST
+
+static void run_convolver_perf_test(unsigned n_taps) {
+    pa_convolver *direct, *fft;
+    float *taps, *src, *dst;
+    unsigned k;
+
+    taps = pa_xnew(float, n_taps * N_INPUTS * N_OUTPUTS);
+    src = pa_xnew(float, FRAMES * N_INPUTS);
+    dst = pa_xnew(float, FRAMES * N_OUTPUTS);
+
+    for (k = 0; k < n_taps * N_INPUTS * N_OUTPUTS; k++)
+        taps[k] = random_float();
+    for (k = 0; k < FRAMES * N_INPUTS; k++)
+        src[k] = random_float();
+
+    direct = convolver_new(PA_CONVOLVER_DIRECT, n_taps, taps);
+    fft = convolver_new(PA_CONVOLVER_FFT, n_taps, taps);
+
+    pa_log_debug("Testing %u channel convolution performance with %u taps", N_INPUTS, n_taps);
+
+    /* The direct engine is far too slow for long filters to be run as
+     * often as the FFT one */
+    PA_RUNTIME_TEST_RUN_START("direct", 1, TIMES2) {
+        pa_convolver_run(direct, src, dst, FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("fft", 1, TIMES2) {
+        pa_convolver_run(fft, src, dst, FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    /* Requests as small as a low latency sink would make */
+    PA_RUNTIME_TEST_RUN_START("fft, 64 frames per request", 1, TIMES2) {
+        for (k = 0; k < FRAMES; k += 64)
+            pa_convolver_run(fft, src + k * N_INPUTS, dst + k * N_OUTPUTS, 64);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_convolver_free(direct);
+    pa_convolver_free(fft);
+
+    pa_xfree(taps);
+    pa_xfree(src);
+    pa_xfree(dst);
+}
+
+START_TEST (convolver_perf_test) {
+    run_convolver_perf_test(128);
+    run_convolver_perf_test(512);
+    run_convolver_perf_test(4096);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Convolver");
+    tc = tcase_create("convolver");
+    tcase_add_test(tc, convolver_test);
+    tcase_add_test(tc, convolver_perf_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
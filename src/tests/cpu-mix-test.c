@@ -21,10 +21,14 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/mix.h>
 
 #include "runtime-test-util.h"
@@ -32,6 +36,7 @@
 #define SAMPLES 1028
 #define TIMES 1000
 #define TIMES2 100
+#define MAX_STREAMS 32
 
 static void acquire_mix_streams(pa_mix_info streams[], unsigned nstreams) {
     unsigned i;
@@ -145,6 +150,120 @@ static void run_mix_test(
     pa_mempool_unref(pool);
 }
 
+static void run_mix_format_test(
+        pa_sample_format_t f,
+        pa_do_mix_func_t func,
+        pa_do_mix_func_t orig_func,
+        unsigned nstreams,
+        unsigned channels,
+        int align,
+        bool correct,
+        bool perf) {
+
+    pa_sample_spec ss;
+    pa_mempool *pool;
+    pa_mix_info m[MAX_STREAMS];
+    uint8_t *in[MAX_STREAMS];
+    uint8_t *out, *out_ref;
+    size_t length;
+    unsigned i, c, nsamples;
+
+    pa_assert(nstreams <= MAX_STREAMS);
+
+    ss.format = f;
+    ss.rate = 44100;
+    ss.channels = channels;
+
+    /* Force sample alignment as requested */
+    nsamples = channels * (SAMPLES - (8 - align));
+    length = nsamples * pa_sample_size(&ss);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    for (i = 0; i < nstreams; i++) {
+        in[i] = pa_xmalloc(length + 64);
+
+        if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) {
+            float *p = (float *) (in[i] + (8 - align) * sizeof(float));
+            unsigned j;
+
+            /* Random bits could be NaN, which never compares equal */
+            for (j = 0; j < nsamples; j++) {
+                int16_t r;
+
+                pa_random(&r, sizeof(r));
+                p[j] = r / (float) 0x8000;
+                if (f == PA_SAMPLE_FLOAT32RE)
+                    PA_WRITE_FLOAT32RE(p + j, p[j]);
+            }
+        } else
+            pa_random(in[i] + (8 - align) * pa_sample_size(&ss), length);
+
+        m[i].chunk.memblock = pa_memblock_new_fixed(pool, in[i] + (8 - align) * pa_sample_size(&ss), length, false);
+        m[i].chunk.length = length;
+        m[i].chunk.index = 0;
+        m[i].volume.channels = channels;
+
+        for (c = 0; c < channels; c++) {
+            m[i].volume.values[c] = PA_VOLUME_NORM;
+
+            /* Some muted channels, some amplified ones */
+            if ((i + c) % 7 == 3)
+                m[i].linear[c].i = 0;
+            else if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE)
+                m[i].linear[c].f = 0.1f + 0.2f * ((i + 3 * c) % 9);
+            else
+                m[i].linear[c].i = 0x1234 + 0x1357 * ((i + 3 * c) % 23);
+        }
+    }
+
+    out = pa_xmalloc(length + 64);
+    out_ref = pa_xmalloc(length + 64);
+
+    if (correct) {
+        acquire_mix_streams(m, nstreams);
+        orig_func(m, nstreams, channels, out_ref + (8 - align), length);
+        release_mix_streams(m, nstreams);
+
+        acquire_mix_streams(m, nstreams);
+        func(m, nstreams, channels, out + (8 - align), length);
+        release_mix_streams(m, nstreams);
+
+        if (memcmp(out + (8 - align), out_ref + (8 - align), length) != 0) {
+            pa_log_debug("Correctness test failed: format=%s, streams=%u, channels=%u, align=%d",
+                         pa_sample_format_to_string(f), nstreams, channels, align);
+            ck_abort();
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s %u-stream %u-channel mixing performance with %d sample alignment",
+                     pa_sample_format_to_string(f), nstreams, channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES / 10, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            func(m, nstreams, channels, out + (8 - align), length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES / 10, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            orig_func(m, nstreams, channels, out_ref + (8 - align), length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    for (i = 0; i < nstreams; i++) {
+        pa_memblock_unref(m[i].chunk.memblock);
+        pa_xfree(in[i]);
+    }
+
+    pa_xfree(out);
+    pa_xfree(out_ref);
+
+    pa_mempool_unref(pool);
+}
+
 START_TEST (mix_special_test) {
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_do_mix_func_t orig_func, special_func;
@@ -196,6 +315,67 @@ START_TEST (mix_neon_test) {
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#if defined (__i386__) || defined (__amd64__)
+static void run_mix_sse_tests(pa_cpu_x86_flag_t flags, pa_do_mix_func_t orig_funcs[]) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_S16NE, PA_SAMPLE_S16RE,
+        PA_SAMPLE_S32NE, PA_SAMPLE_S32RE,
+        PA_SAMPLE_S24_32NE, PA_SAMPLE_S24_32RE,
+        PA_SAMPLE_FLOAT32NE, PA_SAMPLE_FLOAT32RE
+    };
+    static const unsigned channels[] = { 1, 2, 3, 6, 8, 11 };
+    unsigned i, j;
+
+    pa_mix_func_init_sse(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        pa_do_mix_func_t func = pa_get_mix_func(formats[i]);
+
+        if (func == orig_funcs[formats[i]])
+            continue;
+
+        pa_log_debug("Checking SSE mix (%s)", pa_sample_format_to_string(formats[i]));
+
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            run_mix_format_test(formats[i], func, orig_funcs[formats[i]], 2, channels[j], 7, true, false);
+            run_mix_format_test(formats[i], func, orig_funcs[formats[i]], 5, channels[j], 5, true, false);
+        }
+
+        run_mix_format_test(formats[i], func, orig_funcs[formats[i]], 24, 2, 8, true, true);
+    }
+}
+
+START_TEST (mix_sse_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX];
+    unsigned i;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE4_1)) {
+        pa_log_info("SSE4.1 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < PA_SAMPLE_MAX; i++)
+        orig_funcs[i] = pa_get_mix_func(i);
+
+    pa_log_debug("Checking SSE4 mixing");
+    run_mix_sse_tests(flags & ~(PA_CPU_X86_AVX2 | PA_CPU_X86_AVX512F | PA_CPU_X86_AVX512BW), orig_funcs);
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_debug("Checking AVX2 mixing");
+        run_mix_sse_tests(flags & ~(PA_CPU_X86_AVX512F | PA_CPU_X86_AVX512BW), orig_funcs);
+    }
+
+    if ((flags & PA_CPU_X86_AVX512F) && (flags & PA_CPU_X86_AVX512BW)) {
+        pa_log_debug("Checking AVX-512 mixing");
+        run_mix_sse_tests(flags, orig_funcs);
+    }
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -211,6 +391,9 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, mix_special_test);
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
+#endif
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_sse_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
@@ -315,12 +315,108 @@ START_TEST (remap_sse2_test) {
 
     pa_log_debug("Checking SSE2 remap (float, mono->stereo)");
     orig_init_func = pa_get_init_remap_func();
-    pa_remap_func_init_sse(flags);
+    pa_remap_func_init_sse(flags & ~PA_CPU_X86_AVX2);
     init_func = pa_get_init_remap_func();
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, false);
 
     pa_log_debug("Checking SSE2 remap (s16, mono->stereo)");
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
+
+    pa_log_debug("Checking SSE2 remap (float, 5.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 2, false);
+    pa_log_debug("Checking SSE2 remap (s16, 5.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 6, 2, false);
+
+    pa_log_debug("Checking SSE2 remap (float, 7.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 2, false);
+    pa_log_debug("Checking SSE2 remap (s16, 7.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 2, false);
+
+    pa_log_debug("Checking SSE2 remap (float, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, false);
+    pa_log_debug("Checking SSE2 remap (s16, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 6, false);
+
+    pa_log_debug("Checking SSE2 remap (float, stereo->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 8, false);
+    pa_log_debug("Checking SSE2 remap (s16, stereo->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 8, false);
+
+    pa_log_debug("Checking SSE2 remap (float, 3-channel->5-channel)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 3, 5, false);
+    pa_log_debug("Checking SSE2 remap (s16, 3-channel->5-channel)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 3, 5, false);
+}
+END_TEST
+
+START_TEST (remap_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_sse(flags);
+    init_func = pa_get_init_remap_func();
+
+    pa_log_debug("Checking AVX2 remap (float, 5.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 2, false);
+    pa_log_debug("Checking AVX2 remap (float, 7.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 2, false);
+    pa_log_debug("Checking AVX2 remap (s16, 7.1->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 2, false);
+    pa_log_debug("Checking AVX2 remap (float, 3-channel->stereo)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 3, 2, false);
+
+    pa_log_debug("Checking AVX2 remap (float, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, false);
+    pa_log_debug("Checking AVX2 remap (float, stereo->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 8, false);
+
+    pa_log_debug("Checking AVX2 remap (float, 3-channel->5-channel)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 3, 5, false);
+    pa_log_debug("Checking AVX2 remap (float, 8-channel->8-channel)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 8, false);
+}
+END_TEST
+
+START_TEST (rearrange_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_sse(flags);
+    init_func = pa_get_init_remap_func();
+
+    pa_log_debug("Checking AVX2 remap (float, stereo->5.1 rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, true);
+    pa_log_debug("Checking AVX2 remap (s16, stereo->5.1 rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 6, true);
+
+    pa_log_debug("Checking AVX2 remap (float, stereo->7.1 rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 8, true);
+    pa_log_debug("Checking AVX2 remap (s16, stereo->7.1 rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 8, true);
+
+    pa_log_debug("Checking AVX2 remap (float, 6-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 6, true);
+    pa_log_debug("Checking AVX2 remap (s16, 6-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 6, 6, true);
+
+    pa_log_debug("Checking AVX2 remap (float, 8-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 8, true);
+    pa_log_debug("Checking AVX2 remap (s16, 8-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 8, true);
 }
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -410,6 +506,7 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
+    tcase_add_test(tc, remap_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
@@ -419,6 +516,9 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("rearrange");
     tcase_add_test(tc, rearrange_special_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, rearrange_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, rearrange_neon_test);
 #endif
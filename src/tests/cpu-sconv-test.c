@@ -26,6 +26,7 @@
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/sconv.h>
+#include <pulsecore/endianmacros.h>
 
 #include "runtime-test-util.h"
 
@@ -134,6 +135,129 @@ static void run_conv_test_s16_to_float(
 }
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#if defined (__i386__) || defined (__amd64__)
+enum {
+    TO_FLOAT32NE,
+    FROM_FLOAT32NE,
+    TO_S16NE,
+    FROM_S16NE,
+    N_DIRECTIONS
+};
+
+static const char *direction_names[] = { "to float", "from float", "to s16", "from s16" };
+
+static pa_convert_func_t get_convert_function(int dir, pa_sample_format_t f) {
+    switch (dir) {
+        case TO_FLOAT32NE: return pa_get_convert_to_float32ne_function(f);
+        case FROM_FLOAT32NE: return pa_get_convert_from_float32ne_function(f);
+        case TO_S16NE: return pa_get_convert_to_s16ne_function(f);
+        default: return pa_get_convert_from_s16ne_function(f);
+    }
+}
+
+/* Runs a conversion of any format in any direction against the C code.
+ * The complete output buffers are compared, so writing past the end of
+ * the output is caught as well. */
+static void run_conv_test_format(
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        pa_sample_format_t in_format,
+        pa_sample_format_t out_format,
+        int align,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, in[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, out[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, out_ref[SAMPLES * 4]) = { 0 };
+    size_t in_size = pa_sample_size_of_format(in_format);
+    size_t out_size = pa_sample_size_of_format(out_format);
+    uint8_t *src, *dst, *dst_ref;
+    int i, nsamples;
+
+    /* Force sample alignment as requested */
+    src = in + (8 - align) * in_size;
+    dst = out + (8 - align) * out_size;
+    dst_ref = out_ref + (8 - align) * out_size;
+    nsamples = SAMPLES - 8;
+
+    if (in_format == PA_SAMPLE_FLOAT32LE || in_format == PA_SAMPLE_FLOAT32BE) {
+        /* Some of the samples clip */
+        for (i = 0; i < nsamples; i++) {
+            float v = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+
+            if (in_format == PA_SAMPLE_FLOAT32NE)
+                ((float *) src)[i] = v;
+            else
+                PA_WRITE_FLOAT32RE((float *) src + i, v);
+        }
+    } else
+        pa_random(src, nsamples * in_size);
+
+    if (correct) {
+        orig_func(nsamples, src, dst_ref);
+        func(nsamples, src, dst);
+
+        for (i = 0; i < (int) sizeof(out); i++) {
+            /* The C code converts float to u8 in double precision */
+            if (out_format == PA_SAMPLE_U8 && abs(out[i] - out_ref[i]) <= 1)
+                continue;
+
+            if (out[i] != out_ref[i]) {
+                pa_log_debug("Correctness test failed: %s -> %s, align=%d",
+                             pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), align);
+                pa_log_debug("byte %d: %02x != %02x", i - (int) ((8 - align) * out_size), out[i], out_ref[i]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing sconv performance (%s -> %s) with %d sample alignment",
+                     pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, src, dst);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, src, dst_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+/* Checks every conversion that pa_convert_func_init_sse() replaces for
+ * the given flags */
+static void run_conv_test_all_formats(pa_cpu_x86_flag_t flags) {
+    pa_convert_func_t orig[N_DIRECTIONS][PA_SAMPLE_MAX];
+    pa_sample_format_t f;
+    int dir, align;
+
+    for (dir = 0; dir < N_DIRECTIONS; dir++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++)
+            orig[dir][f] = get_convert_function(dir, f);
+
+    pa_convert_func_init_sse(flags);
+
+    for (dir = 0; dir < N_DIRECTIONS; dir++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            pa_convert_func_t func = get_convert_function(dir, f);
+            pa_sample_format_t in_format, out_format;
+
+            if (func == orig[dir][f])
+                continue;
+
+            in_format = dir == FROM_FLOAT32NE ? PA_SAMPLE_FLOAT32NE : dir == FROM_S16NE ? PA_SAMPLE_S16NE : f;
+            out_format = dir == TO_FLOAT32NE ? PA_SAMPLE_FLOAT32NE : dir == TO_S16NE ? PA_SAMPLE_S16NE : f;
+
+            pa_log_debug("Checking sconv (%s, %s)", direction_names[dir], pa_sample_format_to_string(f));
+
+            for (align = 0; align < 8; align++)
+                run_conv_test_format(func, orig[dir][f], in_format, out_format, align, true, align == 7);
+        }
+}
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (sconv_sse2_test) {
     pa_cpu_x86_flag_t flags = 0;
@@ -188,6 +312,51 @@ START_TEST (sconv_sse_test) {
     run_conv_test_float_to_s16(sse_func, orig_func, 7, true, true);
 }
 END_TEST
+
+START_TEST (sconv_sse2_formats_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking SSE2 sconv (all formats)");
+    run_conv_test_all_formats(PA_CPU_X86_SSE2);
+}
+END_TEST
+
+START_TEST (sconv_ssse3_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSSE3)) {
+        pa_log_info("SSSE3 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking SSSE3 sconv (all formats)");
+    run_conv_test_all_formats(PA_CPU_X86_SSSE3);
+}
+END_TEST
+
+START_TEST (sconv_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking AVX2 sconv (all formats)");
+    run_conv_test_all_formats(PA_CPU_X86_AVX2);
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -247,6 +416,9 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
+    tcase_add_test(tc, sconv_sse2_formats_test);
+    tcase_add_test(tc, sconv_ssse3_test);
+    tcase_add_test(tc, sconv_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
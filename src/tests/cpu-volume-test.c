@@ -26,6 +26,7 @@
 #include <pulsecore/cpu-orc.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/sample-util.h>
 
 #include "runtime-test-util.h"
@@ -100,6 +101,95 @@ static void run_volume_test(
     }
 }
 
+/* Like run_volume_test(), but for any sample format. Volumes go up to
+ * 3.0 to exercise clipping. */
+static void run_volume_test_format(
+        pa_do_volume_func_t func,
+        pa_do_volume_func_t orig_func,
+        pa_sample_format_t format,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_ref[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_orig[SAMPLES * 4]) = { 0 };
+    int32_t volumes[channels + PADDING];
+    float *fvolumes = (float *) volumes;
+    uint8_t *samples, *samples_ref, *samples_orig;
+    size_t ss = pa_sample_size_of_format(format);
+    int i, padding, nsamples, size;
+
+    samples = s + (8 - align) * ss;
+    samples_ref = s_ref + (8 - align) * ss;
+    samples_orig = s_orig + (8 - align) * ss;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * ss;
+
+    if (format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE) {
+        float *f = (float *) samples;
+
+        /* Random bits might be NaNs, whose payload is not ours to compare */
+        for (i = 0; i < nsamples; i++) {
+            float v = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+
+            if (format == PA_SAMPLE_FLOAT32RE)
+                PA_WRITE_FLOAT32RE(&f[i], v);
+            else
+                f[i] = v;
+        }
+    } else
+        pa_random(samples, size);
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    for (i = 0; i < channels; i++) {
+        volumes[i] = rand() % 0x30000;
+        if (format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE)
+            fvolumes[i] = (float) volumes[i] / 0x10000;
+    }
+    for (padding = 0; padding < PADDING; padding++, i++)
+        volumes[i] = volumes[padding];
+
+    if (correct) {
+        orig_func(samples_ref, volumes, channels, size);
+        func(samples, volumes, channels, size);
+
+        for (i = 0; i < nsamples; i++) {
+            if (memcmp(samples + i * ss, samples_ref + i * ss, ss)) {
+                pa_log_debug("Correctness test failed: format=%s, align=%d, channels=%d",
+                             pa_sample_format_to_string(format), align, channels);
+                pa_log_debug("sample %d differs (volume %08x)", i, volumes[i % channels]);
+                ck_abort();
+            }
+        }
+
+        /* Nothing outside of the buffer must be touched */
+        fail_unless(memcmp(s, s_ref, sizeof(s)) == 0);
+    }
+
+    if (perf) {
+        pa_log_debug("Testing svolume %s %dch performance with %d sample alignment",
+                     pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (svolume_mmx_test) {
     pa_do_volume_func_t orig_func, mmx_func;
@@ -154,6 +244,67 @@ START_TEST (svolume_sse_test) {
     run_volume_test(sse_func, orig_func, 7, 3, true, true);
 }
 END_TEST
+
+static void run_volume_test_all_formats(pa_cpu_x86_flag_t flags, const pa_sample_format_t *formats) {
+    pa_do_volume_func_t orig_funcs[PA_SAMPLE_MAX];
+    const pa_sample_format_t *f;
+    int i, j;
+
+    for (f = formats; *f != PA_SAMPLE_INVALID; f++)
+        orig_funcs[*f] = pa_get_volume_func(*f);
+
+    pa_volume_func_init_sse(flags);
+
+    for (f = formats; *f != PA_SAMPLE_INVALID; f++) {
+        pa_do_volume_func_t func = pa_get_volume_func(*f);
+
+        fail_unless(func != orig_funcs[*f]);
+
+        pa_log_debug("Checking %s svolume", pa_sample_format_to_string(*f));
+        for (i = 1; i <= 9; i++) {
+            for (j = 0; j < 7; j++)
+                run_volume_test_format(func, orig_funcs[*f], *f, j, i, true, false);
+        }
+        run_volume_test_format(func, orig_funcs[*f], *f, 7, 1, true, true);
+        run_volume_test_format(func, orig_funcs[*f], *f, 7, 2, true, true);
+    }
+}
+
+START_TEST (svolume_sse_float_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_FLOAT32NE, PA_SAMPLE_FLOAT32RE, PA_SAMPLE_INVALID
+    };
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    run_volume_test_all_formats(PA_CPU_X86_SSE2, formats);
+}
+END_TEST
+
+START_TEST (svolume_avx2_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_FLOAT32NE, PA_SAMPLE_FLOAT32RE, PA_SAMPLE_S32NE, PA_SAMPLE_S32RE,
+        PA_SAMPLE_S24_32NE, PA_SAMPLE_S24_32RE, PA_SAMPLE_S24NE, PA_SAMPLE_S24RE,
+        PA_SAMPLE_INVALID
+    };
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    run_volume_test_all_formats(flags, formats);
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__)
@@ -230,6 +381,8 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
+    tcase_add_test(tc, svolume_sse_float_test);
+    tcase_add_test(tc, svolume_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
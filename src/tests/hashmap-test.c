@@ -0,0 +1,194 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+
+#define N_KEYS 5000
+
+static char *make_key(unsigned i) {
+    return pa_sprintf_malloc("key-%u", i);
+}
+
+/* Checks that the map holds exactly the keys i with (i % step) == 0 up
+ * to n, in insertion order, both ways */
+static void check_contents(pa_hashmap *h, unsigned n, unsigned step) {
+    void *state = NULL;
+    const void *key;
+    unsigned i, v, count = 0;
+
+    for (i = 0; i < n; i += step) {
+        char *k = make_key(i);
+
+        fail_unless(pa_hashmap_get(h, k) == PA_UINT_TO_PTR(i + 1), "key %s not found", k);
+        pa_xfree(k);
+        count++;
+    }
+
+    fail_unless(pa_hashmap_size(h) == count);
+
+    i = 0;
+    while ((v = PA_PTR_TO_UINT(pa_hashmap_iterate(h, &state, &key)))) {
+        fail_unless(v == i + 1, "got %u, expected %u", v - 1, i);
+        fail_unless(pa_atou((const char *) key + 4, &v) >= 0 && v == i);
+        i += step;
+    }
+    fail_unless(i == count * step);
+    fail_unless(key == NULL);
+
+    state = NULL;
+    while ((v = PA_PTR_TO_UINT(pa_hashmap_iterate_backwards(h, &state, NULL)))) {
+        i -= step;
+        fail_unless(v == i + 1, "got %u, expected %u", v - 1, i);
+    }
+    fail_unless(i == 0);
+}
+
+START_TEST (hashmap_test) {
+    pa_hashmap *h;
+    void *state = NULL, *v;
+    unsigned i;
+    char *k;
+
+    h = pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, pa_xfree, NULL);
+
+    fail_unless(pa_hashmap_isempty(h));
+    fail_unless(pa_hashmap_first(h) == NULL);
+    fail_unless(pa_hashmap_iterate(h, &state, NULL) == NULL);
+
+    for (i = 0; i < N_KEYS; i++)
+        fail_unless(pa_hashmap_put(h, make_key(i), PA_UINT_TO_PTR(i + 1)) == 0);
+
+    /* Duplicates are refused */
+    k = make_key(N_KEYS / 2);
+    fail_unless(pa_hashmap_put(h, k, PA_UINT_TO_PTR(1)) < 0);
+    pa_xfree(k);
+
+    check_contents(h, N_KEYS, 1);
+    fail_unless(pa_hashmap_first(h) == PA_UINT_TO_PTR(1));
+    fail_unless(pa_hashmap_last(h) == PA_UINT_TO_PTR(N_KEYS));
+
+    /* Removing the entry that was just returned while iterating is fine */
+    state = NULL;
+    while ((v = pa_hashmap_iterate(h, &state, NULL))) {
+        i = PA_PTR_TO_UINT(v) - 1;
+
+        if (i % 2) {
+            k = make_key(i);
+            fail_unless(pa_hashmap_remove(h, k) == v);
+            pa_xfree(k);
+        }
+    }
+
+    check_contents(h, N_KEYS, 2);
+
+    /* Looking up and removing keys that are gone fails */
+    k = make_key(1);
+    fail_unless(pa_hashmap_get(h, k) == NULL);
+    fail_unless(pa_hashmap_remove_and_free(h, k) < 0);
+    pa_xfree(k);
+
+    /* Shrink down to a few entries and grow again */
+    for (i = 0; i < N_KEYS - 10; i += 2)
+        fail_unless(PA_PTR_TO_UINT(pa_hashmap_steal_first(h)) == i + 1);
+
+    for (i = 1; i < N_KEYS; i += 2)
+        fail_unless(pa_hashmap_put(h, make_key(i), PA_UINT_TO_PTR(i + 1)) == 0);
+
+    fail_unless(pa_hashmap_size(h) == 5 + N_KEYS / 2);
+    fail_unless(pa_hashmap_first(h) == PA_UINT_TO_PTR(N_KEYS - 10 + 1));
+    fail_unless(pa_hashmap_last(h) == PA_UINT_TO_PTR(N_KEYS));
+
+    pa_hashmap_remove_all(h);
+    fail_unless(pa_hashmap_isempty(h));
+
+    for (i = 0; i < N_KEYS; i++)
+        fail_unless(pa_hashmap_put(h, make_key(i), PA_UINT_TO_PTR(i + 1)) == 0);
+    check_contents(h, N_KEYS, 1);
+
+    pa_hashmap_free(h);
+}
+END_TEST
+
+START_TEST (hashmap_benchmark) {
+    static const unsigned sizes[] = { 10, 100, 1000, 10000, 100000 };
+    unsigned s;
+
+    for (s = 0; s < PA_ELEMENTSOF(sizes); s++) {
+        unsigned n = sizes[s], i, times = PA_MAX(1u, 100000 / n);
+        pa_hashmap *h;
+        char label[64];
+
+        h = pa_hashmap_new(NULL, NULL);
+
+        pa_snprintf(label, sizeof(label), "%u entries, put/remove", n);
+        PA_RUNTIME_TEST_RUN_START(label, times, 5) {
+            for (i = 1; i <= n; i++)
+                pa_hashmap_put(h, PA_UINT_TO_PTR(i), PA_UINT_TO_PTR(i));
+            for (i = 1; i <= n; i++)
+                pa_hashmap_remove(h, PA_UINT_TO_PTR(i));
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        for (i = 1; i <= n; i++)
+            pa_hashmap_put(h, PA_UINT_TO_PTR(i), PA_UINT_TO_PTR(i));
+
+        pa_snprintf(label, sizeof(label), "%u entries, get", n);
+        PA_RUNTIME_TEST_RUN_START(label, times, 5) {
+            for (i = 1; i <= n; i++)
+                fail_unless(pa_hashmap_get(h, PA_UINT_TO_PTR(i)) == PA_UINT_TO_PTR(i));
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_hashmap_free(h);
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Hashmap");
+    tc = tcase_create("hashmap");
+    tcase_add_test(tc, hashmap_test);
+    tcase_add_test(tc, hashmap_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,176 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+
+#define N_ITEMS 5000
+
+START_TEST (idxset_test) {
+    pa_idxset *s;
+    void *state = NULL, *v;
+    uint32_t idx, i, n;
+
+    s = pa_idxset_new(NULL, NULL);
+
+    fail_unless(pa_idxset_isempty(s));
+    fail_unless(pa_idxset_first(s, &idx) == NULL && idx == PA_IDXSET_INVALID);
+
+    /* Data i + 1 gets index i */
+    for (i = 0; i < N_ITEMS; i++) {
+        fail_unless(pa_idxset_put(s, PA_UINT32_TO_PTR(i + 1), &idx) == 0);
+        fail_unless(idx == i);
+    }
+
+    fail_unless(pa_idxset_put(s, PA_UINT32_TO_PTR(N_ITEMS / 2 + 1), &idx) < 0);
+    fail_unless(idx == N_ITEMS / 2);
+
+    for (i = 0; i < N_ITEMS; i++) {
+        fail_unless(pa_idxset_get_by_index(s, i) == PA_UINT32_TO_PTR(i + 1));
+        fail_unless(pa_idxset_get_by_data(s, PA_UINT32_TO_PTR(i + 1), &idx) == PA_UINT32_TO_PTR(i + 1));
+        fail_unless(idx == i);
+    }
+    fail_unless(pa_idxset_get_by_index(s, N_ITEMS) == NULL);
+
+    /* Remove every third item while iterating */
+    i = 0;
+    PA_IDXSET_FOREACH(v, s, idx) {
+        fail_unless(idx == i && v == PA_UINT32_TO_PTR(i + 1));
+
+        if (i % 3 == 0)
+            fail_unless(pa_idxset_remove_by_index(s, idx) == v);
+        i++;
+    }
+    fail_unless(i == N_ITEMS);
+    fail_unless(pa_idxset_size(s) == N_ITEMS - (N_ITEMS + 2) / 3);
+
+    /* pa_idxset_next() moves on from removed indexes */
+    idx = 3;
+    fail_unless(pa_idxset_next(s, &idx) == PA_UINT32_TO_PTR(5) && idx == 4);
+    fail_unless(pa_idxset_next(s, &idx) == PA_UINT32_TO_PTR(6) && idx == 5);
+    idx = N_ITEMS - 1;
+    fail_unless(pa_idxset_next(s, &idx) == NULL && idx == PA_IDXSET_INVALID);
+
+    /* pa_idxset_rrobin() wraps around */
+    idx = N_ITEMS - 1;
+    fail_unless(pa_idxset_rrobin(s, &idx) == PA_UINT32_TO_PTR(2) && idx == 1);
+
+    /* Indexes are never reused */
+    fail_unless(pa_idxset_put(s, PA_UINT32_TO_PTR(1), &idx) == 0);
+    fail_unless(idx == N_ITEMS);
+
+    fail_unless(pa_idxset_remove_by_data(s, PA_UINT32_TO_PTR(2), &idx) == PA_UINT32_TO_PTR(2) && idx == 1);
+    fail_unless(pa_idxset_remove_by_data(s, PA_UINT32_TO_PTR(2), NULL) == NULL);
+
+    /* Iteration order is insertion order */
+    n = 0;
+    state = NULL;
+    while ((v = pa_idxset_iterate(s, &state, &idx))) {
+        if (idx != N_ITEMS)
+            fail_unless(PA_PTR_TO_UINT32(v) == idx + 1);
+        n++;
+    }
+    fail_unless(idx == PA_IDXSET_INVALID);
+    fail_unless(n == pa_idxset_size(s));
+    fail_unless(pa_idxset_first(s, &idx) == PA_UINT32_TO_PTR(3) && idx == 2);
+
+    /* Drain down to nothing, which shrinks the tables, and refill */
+    for (; n > 0; n--)
+        fail_unless(pa_idxset_steal_first(s, NULL) != NULL);
+    fail_unless(pa_idxset_isempty(s));
+
+    for (i = 0; i < N_ITEMS; i++)
+        fail_unless(pa_idxset_put(s, PA_UINT32_TO_PTR(i + 1), NULL) == 0);
+    for (i = 0; i < N_ITEMS; i++) {
+        fail_unless(pa_idxset_get_by_index(s, N_ITEMS + 1 + i) == PA_UINT32_TO_PTR(i + 1));
+        fail_unless(pa_idxset_get_by_index(s, i) == NULL);
+    }
+
+    pa_idxset_free(s, NULL);
+}
+END_TEST
+
+START_TEST (idxset_benchmark) {
+    static const unsigned sizes[] = { 10, 100, 1000, 10000, 100000 };
+    unsigned s;
+
+    for (s = 0; s < PA_ELEMENTSOF(sizes); s++) {
+        unsigned n = sizes[s], i, times = PA_MAX(1u, 100000 / n);
+        pa_idxset *set;
+        uint32_t first;
+        char label[64];
+
+        set = pa_idxset_new(NULL, NULL);
+
+        pa_snprintf(label, sizeof(label), "%u entries, put/remove", n);
+        PA_RUNTIME_TEST_RUN_START(label, times, 5) {
+            for (i = 1; i <= n; i++)
+                pa_idxset_put(set, PA_UINT_TO_PTR(i), NULL);
+            for (i = 1; i <= n; i++)
+                pa_idxset_remove_by_data(set, PA_UINT_TO_PTR(i), NULL);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_idxset_put(set, PA_UINT_TO_PTR(1), &first);
+        for (i = 2; i <= n; i++)
+            pa_idxset_put(set, PA_UINT_TO_PTR(i), NULL);
+
+        pa_snprintf(label, sizeof(label), "%u entries, get", n);
+        PA_RUNTIME_TEST_RUN_START(label, times, 5) {
+            for (i = 0; i < n; i++) {
+                fail_unless(pa_idxset_get_by_index(set, first + i) == PA_UINT_TO_PTR(i + 1));
+                fail_unless(pa_idxset_get_by_data(set, PA_UINT_TO_PTR(i + 1), NULL) != NULL);
+            }
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_idxset_free(set, NULL);
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Idxset");
+    tc = tcase_create("idxset");
+    tcase_add_test(tc, idxset_test);
+    tcase_add_test(tc, idxset_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,8 +20,11 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <assert.h>
 #include <check.h>
 
@@ -40,6 +43,18 @@ static GMainLoop* glib_main_loop = NULL;
 
 #else /* GLIB_MAIN_LOOP */
 #include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+
+#define N_FDS 1000
+#define BENCHMARK_TIMES 1000
+#define BENCHMARK_TIMES2 20
+#define N_TIMERS 10000
+#define N_ORDER_TIMERS 200
 #endif /* GLIB_MAIN_LOOP */
 
 static pa_defer_event *de;
@@ -120,15 +135,364 @@ START_TEST (mainloop_test) {
 }
 END_TEST
 
+#ifndef GLIB_MAIN_LOOP
+
+static const char * const backends[] = { "poll", "epoll" };
+
+static void count_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned *n = userdata;
+
+    fail_unless(f & PA_IO_EVENT_INPUT);
+    (*n)++;
+}
+
+static void read_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned *n = userdata;
+    char c;
+
+    fail_unless(read(fd, &c, 1) == 1);
+    (*n)++;
+}
+
+START_TEST (mainloop_io_test) {
+    unsigned b;
+
+    for (b = 0; b < PA_ELEMENTSOF(backends); b++) {
+        pa_mainloop *m;
+        pa_mainloop_api *a;
+        pa_io_event *e1, *e2, *e3;
+        unsigned n1 = 0, n2 = 0, n3 = 0;
+        int fds[2], null_fd;
+
+        pa_log_debug("Testing the %s backend", backends[b]);
+        setenv("PULSE_MAINLOOP_BACKEND", backends[b], 1);
+
+        fail_unless(m = pa_mainloop_new());
+        a = pa_mainloop_get_api(m);
+        fail_unless(pipe(fds) == 0);
+
+        /* Two io events for the same fd */
+        e1 = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, count_cb, &n1);
+        e2 = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, count_cb, &n2);
+
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+        fail_unless(n1 == 0 && n2 == 0);
+
+        fail_unless(write(fds[1], "x", 1) == 1);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 2);
+        fail_unless(n1 == 1 && n2 == 1);
+
+        a->io_enable(e1, 0);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        fail_unless(n1 == 1 && n2 == 2);
+
+        a->io_free(e2);
+        a->io_enable(e1, PA_IO_EVENT_INPUT);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        fail_unless(n1 == 2 && n2 == 2);
+
+        /* epoll does not support /dev/null, so this makes the epoll
+         * backend go back to poll(), and nothing may get lost */
+        fail_unless((null_fd = open("/dev/null", O_RDONLY)) >= 0);
+        e3 = a->io_new(a, null_fd, PA_IO_EVENT_INPUT, count_cb, &n3);
+
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 2);
+        fail_unless(n1 == 3 && n3 == 1);
+
+        a->io_free(e3);
+        pa_assert_se(close(null_fd) == 0);
+        a->io_free(e1);
+
+        e1 = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, read_cb, &n1);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        fail_unless(n1 == 4);
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+
+        a->io_free(e1);
+        pa_mainloop_free(m);
+
+        pa_assert_se(close(fds[0]) == 0);
+        pa_assert_se(close(fds[1]) == 0);
+    }
+
+    unsetenv("PULSE_MAINLOOP_BACKEND");
+}
+END_TEST
+
+/* The fd is closed before its io event is freed, while a dup() of it
+ * keeps the file description open */
+START_TEST (mainloop_io_closed_fd_test) {
+    unsigned b;
+
+    for (b = 0; b < PA_ELEMENTSOF(backends); b++) {
+        pa_mainloop *m;
+        pa_mainloop_api *a;
+        pa_io_event *e1, *e2;
+        unsigned n1 = 0, n2 = 0;
+        int fds[2], fd;
+
+        pa_log_debug("Testing the %s backend", backends[b]);
+        setenv("PULSE_MAINLOOP_BACKEND", backends[b], 1);
+
+        fail_unless(m = pa_mainloop_new());
+        a = pa_mainloop_get_api(m);
+        fail_unless(pipe(fds) == 0);
+        fail_unless((fd = dup(fds[0])) >= 0);
+
+        e1 = a->io_new(a, fd, PA_IO_EVENT_INPUT, count_cb, &n1);
+        fail_unless(write(fds[1], "x", 1) == 1);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        fail_unless(n1 == 1);
+
+        pa_assert_se(close(fd) == 0);
+        a->io_free(e1);
+
+        /* Neither the freed io event nor anything else is dispatched,
+         * although the pipe is still readable */
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+        fail_unless(n1 == 1);
+
+        /* Nothing is left that would make the main loop wake up */
+        fail_unless(pa_mainloop_prepare(m, 0) >= 0);
+        fail_unless(pa_mainloop_poll(m) == 0);
+        fail_unless(pa_mainloop_dispatch(m) == 0);
+
+        /* Other io events still work */
+        e2 = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, read_cb, &n2);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        fail_unless(n1 == 1 && n2 == 1);
+
+        a->io_free(e2);
+        pa_mainloop_free(m);
+
+        pa_assert_se(close(fds[0]) == 0);
+        pa_assert_se(close(fds[1]) == 0);
+    }
+
+    unsetenv("PULSE_MAINLOOP_BACKEND");
+}
+END_TEST
+
+START_TEST (mainloop_io_benchmark) {
+    struct rlimit rl;
+    unsigned b, k, n_fds;
+    int fds[N_FDS][2];
+
+    /* Two fds per pipe, and then some. Where the hard limit is lower,
+     * make do with as many pipes as we get. */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 2 * N_FDS + 64) {
+        rl.rlim_cur = PA_MIN(rl.rlim_max, (rlim_t) 2 * N_FDS + 64);
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    for (n_fds = 0; n_fds < N_FDS; n_fds++)
+        if (pipe(fds[n_fds]) < 0)
+            break;
+
+    if (n_fds < N_FDS / 2) {
+        pa_log_info("Could only open %u of %u pipes, skipping the io event benchmark", n_fds, N_FDS);
+
+        for (k = 0; k < n_fds; k++)
+            pa_close_pipe(fds[k]);
+
+        return;
+    }
+
+    /* Leave some fds for the mainloop itself */
+    for (k = n_fds - 16; k < n_fds; k++)
+        pa_close_pipe(fds[k]);
+    n_fds -= 16;
+
+    for (b = 0; b < PA_ELEMENTSOF(backends); b++) {
+        pa_mainloop *m;
+        pa_mainloop_api *a;
+        pa_io_event *e[N_FDS];
+        unsigned n = 0, i = 0;
+        char label[64];
+
+        setenv("PULSE_MAINLOOP_BACKEND", backends[b], 1);
+        fail_unless(m = pa_mainloop_new());
+        a = pa_mainloop_get_api(m);
+
+        for (k = 0; k < n_fds; k++)
+            e[k] = a->io_new(a, fds[k][0], PA_IO_EVENT_INPUT, read_cb, &n);
+
+        /* One fd out of many becomes readable per iteration */
+        pa_snprintf(label, sizeof(label), "%s, %u fds", backends[b], n_fds);
+        PA_RUNTIME_TEST_RUN_START(label, BENCHMARK_TIMES, BENCHMARK_TIMES2) {
+            fail_unless(write(fds[i++ % n_fds][1], "x", 1) == 1);
+            fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(n == BENCHMARK_TIMES * BENCHMARK_TIMES2);
+
+        for (k = 0; k < n_fds; k++)
+            a->io_free(e[k]);
+
+        pa_mainloop_free(m);
+    }
+
+    for (k = 0; k < n_fds; k++) {
+        pa_assert_se(close(fds[k][0]) == 0);
+        pa_assert_se(close(fds[k][1]) == 0);
+    }
+
+    unsetenv("PULSE_MAINLOOP_BACKEND");
+}
+END_TEST
+
+struct timer {
+    pa_time_event *event;
+    pa_usec_t time;
+};
+
+static pa_usec_t last_fired;
+static unsigned n_fired;
+
+static void order_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timer *t = userdata;
+
+    /* Timers that are due at the same time fire in the order of their
+     * times */
+    fail_unless(t->time >= last_fired);
+    fail_unless(tv->tv_sec == (time_t) (t->time / PA_USEC_PER_SEC));
+    fail_unless((tv->tv_usec & ~PA_TIMEVAL_RTCLOCK) == (suseconds_t) (t->time % PA_USEC_PER_SEC));
+    last_fired = t->time;
+    n_fired++;
+}
+
+START_TEST (mainloop_time_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    struct timer timers[N_ORDER_TIMERS];
+    struct timeval tv;
+    pa_usec_t now;
+    unsigned k, n_expected = 0;
+
+    fail_unless(m = pa_mainloop_new());
+    a = pa_mainloop_get_api(m);
+
+    now = pa_rtclock_now();
+    srand(0);
+
+    for (k = 0; k < N_ORDER_TIMERS; k++) {
+        timers[k].time = now + (pa_usec_t) (rand() % 20000);
+        timers[k].event = a->time_new(a, pa_timeval_rtstore(&tv, timers[k].time, true), order_cb, &timers[k]);
+    }
+
+    /* Move some around, disable some and free some */
+    for (k = 0; k < N_ORDER_TIMERS; k += 7) {
+        timers[k].time = now + (pa_usec_t) (rand() % 20000);
+        a->time_restart(timers[k].event, pa_timeval_rtstore(&tv, timers[k].time, true));
+    }
+
+    for (k = 3; k < N_ORDER_TIMERS; k += 11)
+        a->time_restart(timers[k].event, NULL);
+
+    for (k = 5; k < N_ORDER_TIMERS; k += 13) {
+        a->time_free(timers[k].event);
+        timers[k].event = NULL;
+    }
+
+    /* Everything that was not disabled or freed fires */
+    for (k = 0; k < N_ORDER_TIMERS; k++)
+        if (timers[k].event && k % 11 != 3)
+            n_expected++;
+
+    while (n_fired < n_expected)
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+    fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+    fail_unless(n_fired == n_expected);
+
+    for (k = 0; k < N_ORDER_TIMERS; k++)
+        if (timers[k].event)
+            a->time_free(timers[k].event);
+
+    pa_mainloop_free(m);
+}
+END_TEST
+
+static void rearm_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    unsigned *n = userdata;
+    struct timeval now;
+
+    a->time_restart(e, pa_timeval_rtstore(&now, pa_rtclock_now(), true));
+    (*n)++;
+}
+
+static void never_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    fail_unless(false);
+}
+
+START_TEST (mainloop_time_benchmark) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_time_event **events, *e;
+    struct timeval tv;
+    pa_usec_t now;
+    unsigned k, n = 0;
+
+    fail_unless(m = pa_mainloop_new());
+    a = pa_mainloop_get_api(m);
+
+    /* Many timers far away, and one that is due all the time */
+    events = pa_xnew(pa_time_event*, N_TIMERS);
+    now = pa_rtclock_now();
+    srand(0);
+
+    for (k = 0; k < N_TIMERS; k++)
+        events[k] = a->time_new(a, pa_timeval_rtstore(&tv, now + 1000 * PA_USEC_PER_SEC + (pa_usec_t) rand(), true), never_cb, NULL);
+
+    e = a->time_new(a, pa_timeval_rtstore(&tv, now, true), rearm_cb, &n);
+
+    PA_RUNTIME_TEST_RUN_START("10000 timers, one due per iteration", BENCHMARK_TIMES, BENCHMARK_TIMES2) {
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    fail_unless(n == BENCHMARK_TIMES * BENCHMARK_TIMES2);
+
+    /* Moving timers around */
+    k = 0;
+    PA_RUNTIME_TEST_RUN_START("10000 timers, restarting one per iteration", BENCHMARK_TIMES, BENCHMARK_TIMES2) {
+        a->time_restart(events[(k++ * 7919) % N_TIMERS], pa_timeval_rtstore(&tv, now + 1000 * PA_USEC_PER_SEC + (pa_usec_t) rand(), true));
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    a->time_free(e);
+    for (k = 0; k < N_TIMERS; k++)
+        a->time_free(events[k]);
+    pa_xfree(events);
+
+    pa_mainloop_free(m);
+}
+END_TEST
+
+#endif /* GLIB_MAIN_LOOP */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+#ifndef GLIB_MAIN_LOOP
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+#endif
+
     s = suite_create("MainLoop");
     tc = tcase_create("mainloop");
     tcase_add_test(tc, mainloop_test);
+#ifndef GLIB_MAIN_LOOP
+    tcase_add_test(tc, mainloop_io_test);
+    tcase_add_test(tc, mainloop_io_closed_fd_test);
+    tcase_add_test(tc, mainloop_io_benchmark);
+    tcase_add_test(tc, mainloop_time_test);
+    tcase_add_test(tc, mainloop_time_benchmark);
+    tcase_set_timeout(tc, 120);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
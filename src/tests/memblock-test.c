@@ -20,6 +20,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <check.h>
@@ -176,6 +177,280 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+START_TEST (memblock_hugepages_test) {
+    pa_mem_type_t types[] = { PA_MEM_TYPE_PRIVATE, PA_MEM_TYPE_SHARED_POSIX, PA_MEM_TYPE_SHARED_MEMFD };
+    pa_mem_hugepages_t hugepages[] = { PA_MEM_HUGEPAGES_NO, PA_MEM_HUGEPAGES_TRANSPARENT, PA_MEM_HUGEPAGES_YES };
+    unsigned t, h, i;
+
+    for (t = 0; t < PA_ELEMENTSOF(types); t++) {
+        if (types[t] == PA_MEM_TYPE_SHARED_MEMFD && !pa_memfd_is_locally_supported())
+            continue;
+
+        for (h = 0; h < PA_ELEMENTSOF(hugepages); h++) {
+            pa_mempool *pool;
+            const pa_mempool_stat *stat;
+            pa_memblock *blocks[16];
+            int r;
+
+            pool = pa_mempool_new_full(types[t], 0, true, hugepages[h], 0);
+            fail_unless(pool != NULL);
+
+            /* We may get less than we asked for, but never more */
+            stat = pa_mempool_get_stat(pool);
+            r = pa_atomic_load(&stat->hugepages);
+            pa_log("%s pool with huge pages %s got %s, NUMA node %i",
+                   pa_mem_type_to_string(types[t]),
+                   pa_mem_hugepages_to_string(hugepages[h]),
+                   pa_mem_hugepages_to_string((pa_mem_hugepages_t) r),
+                   pa_atomic_load(&stat->numa_node));
+            fail_unless(r <= (int) hugepages[h]);
+            fail_unless(pa_atomic_load(&stat->numa_node) == -1 || pa_atomic_load(&stat->numa_node) == 0);
+
+            for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+                uint8_t *d;
+
+                blocks[i] = pa_memblock_new_pool(pool, 4096);
+                fail_unless(blocks[i] != NULL);
+
+                d = pa_memblock_acquire(blocks[i]);
+                memset(d, (int) i, 4096);
+                pa_memblock_release(blocks[i]);
+            }
+
+            for (i = 0; i < PA_ELEMENTSOF(blocks); i += 2)
+                pa_memblock_unref(blocks[i]);
+
+            /* Must leave the blocks still in use alone */
+            pa_mempool_vacuum(pool);
+
+            for (i = 1; i < PA_ELEMENTSOF(blocks); i += 2) {
+                uint8_t *d = pa_memblock_acquire(blocks[i]);
+
+                fail_unless(d[0] == i && d[4095] == i);
+                pa_memblock_release(blocks[i]);
+                pa_memblock_unref(blocks[i]);
+            }
+
+            pa_mempool_unref(pool);
+        }
+    }
+}
+END_TEST
+
+START_TEST (memblock_slot_classes_test) {
+    pa_mempool *pool;
+    const pa_mempool_stat *stat;
+    pa_memblock *blocks[60], *b;
+    size_t small, large;
+    unsigned i, k;
+
+    /* Just four pool blocks, each of which fits 16 of the smallest
+     * slots */
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 4 * 64 * 1024, true);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+
+    small = pa_mempool_slot_size(pool, 0);
+    large = pa_mempool_slot_size(pool, PA_MEMPOOL_SLOT_CLASSES - 1);
+    fail_unless(small < large);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        uint8_t *d;
+
+        /* Alternate between blocks with the header in the slot and
+         * blocks that take the whole slot */
+        blocks[i] = pa_memblock_new_pool(pool, i % 2 ? small : 1000);
+        fail_unless(blocks[i] != NULL, "allocation %u failed", i);
+        fail_unless(pa_memblock_get_length(blocks[i]) == (i % 2 ? small : 1000));
+
+        d = pa_memblock_acquire(blocks[i]);
+        memset(d, (int) i, pa_memblock_get_length(blocks[i]));
+        pa_memblock_release(blocks[i]);
+    }
+
+    fail_unless(pa_atomic_load(&stat->n_slots_allocated_by_class[0]) == PA_ELEMENTSOF(blocks));
+    fail_unless(pa_atomic_load(&stat->n_blocks_by_class[0]) == 4);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_type[PA_MEMBLOCK_POOL]) == PA_ELEMENTSOF(blocks) / 2);
+    fail_unless(pa_atomic_load(&stat->n_allocated_by_type[PA_MEMBLOCK_POOL_EXTERNAL]) == PA_ELEMENTSOF(blocks) / 2);
+
+    /* All pool blocks are split up already, so the pool has to grow */
+    fail_unless(pa_atomic_load(&stat->n_segments) == 1);
+    fail_unless((b = pa_memblock_new_pool(pool, large)) != NULL);
+    fail_unless(pa_atomic_load(&stat->n_segments) == 2);
+    pa_memblock_unref(b);
+
+    /* Neighbouring slots must not overlap */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        uint8_t *d = pa_memblock_acquire(blocks[i]);
+
+        for (k = 0; k < pa_memblock_get_length(blocks[i]); k++)
+            fail_unless(d[k] == (uint8_t) i, "block %u byte %u is %u", i, k, d[k]);
+
+        pa_memblock_release(blocks[i]);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    fail_unless(pa_atomic_load(&stat->n_slots_allocated_by_class[0]) == 0);
+
+    /* Freed slots are reused */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, 1000)) != NULL);
+
+    fail_unless(pa_atomic_load(&stat->n_blocks_by_class[0]) == 4);
+    fail_unless(pa_atomic_load(&stat->n_slots_accumulated_by_class[0]) == 2 * PA_ELEMENTSOF(blocks));
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_mempool_unref(pool);
+
+    /* Large blocks still get a whole pool block */
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 4 * 64 * 1024, true);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+
+    fail_unless((b = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+    fail_unless(pa_atomic_load(&stat->n_slots_allocated_by_class[PA_MEMPOOL_SLOT_CLASSES - 1]) == 1);
+    pa_memblock_unref(b);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+START_TEST (memblock_grow_test) {
+    pa_mempool *pool_a, *pool_b;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    const pa_mempool_stat *stat;
+    pa_memblock *blocks[200], *b;
+    pa_mem_type_t mem_type;
+    uint32_t id, shm_id;
+    size_t offset, size;
+    unsigned i, n;
+
+    /* Two pool blocks per segment, split into 32 of the smallest slots */
+    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 2 * 64 * 1024, true);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    fail_unless(pool_b != NULL);
+    stat = pa_mempool_get_stat(pool_a);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        uint8_t *d;
+
+        blocks[i] = pa_memblock_new_pool(pool_a, 1000);
+        fail_unless(blocks[i] != NULL, "allocation %u failed", i);
+
+        d = pa_memblock_acquire(blocks[i]);
+        memset(d, (int) i, 1000);
+        pa_memblock_release(blocks[i]);
+    }
+
+    n = pa_mempool_get_n_segments(pool_a);
+    fail_unless(n == (PA_ELEMENTSOF(blocks) + 31) / 32);
+    fail_unless(pa_atomic_load(&stat->n_segments) == (int) n);
+    fail_unless(pa_atomic_load(&stat->n_pool_full) == 0);
+
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+
+    /* Older peers only get a single chunk of export slots */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        if (pa_memexport_put(export_a, blocks[i], &mem_type, &id, &shm_id, &offset, &size) < 0)
+            break;
+
+    fail_unless(i == 128, "%u blocks exported", i);
+    pa_memexport_free(export_a);
+
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    pa_memexport_enable_max_slots(export_a);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    /* More blocks in flight than a single chunk of export slots holds,
+     * from all segments */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        uint8_t *d;
+
+        fail_unless(pa_memexport_put(export_a, blocks[i], &mem_type, &id, &shm_id, &offset, &size) >= 0, "export %u failed", i);
+        fail_unless(size == 1000);
+
+        b = pa_memimport_get(import_b, mem_type, id, shm_id, offset, size, false);
+        fail_unless(b != NULL, "import %u failed", i);
+
+        d = pa_memblock_acquire(b);
+        fail_unless(d[0] == (uint8_t) i && d[999] == (uint8_t) i);
+        pa_memblock_release(b);
+
+        /* Keeps the export slot in use until the import is gone */
+        pa_memblock_unref(blocks[i]);
+        blocks[i] = b;
+    }
+
+    fail_unless(pa_atomic_load(&stat->n_exported) == PA_ELEMENTSOF(blocks));
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_memimport_free(import_b);
+    pa_memexport_free(export_a);
+
+    fail_unless(pa_atomic_load(&stat->n_allocated) == 0);
+
+    /* Growing stops at some point */
+    for (n = 0; (blocks[n] = pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a))); n++)
+        fail_unless(n < PA_ELEMENTSOF(blocks) - 1);
+
+    fail_unless(pa_atomic_load(&stat->n_pool_full) > 0);
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_mempool_unref(pool_a);
+    pa_mempool_unref(pool_b);
+}
+END_TEST
+
+static void grow_cb(pa_mempool *p, void *userdata) {
+    unsigned *n_calls = userdata;
+
+    (*n_calls)++;
+}
+
+START_TEST (memblock_grow_callback_test) {
+    pa_mempool *pool;
+    pa_memblock *blocks[3];
+    unsigned n_calls = 0;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 2 * 64 * 1024, true);
+    fail_unless(pool != NULL);
+    pa_mempool_set_grow_callback(pool, grow_cb, &n_calls);
+
+    /* The next segment is asked for before the pool is full */
+    fail_unless((blocks[0] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+    fail_unless(n_calls == 0);
+    fail_unless((blocks[1] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+    fail_unless(n_calls == 1);
+
+    /* Allocating never adds it by itself, nor asks for it twice */
+    fail_unless(pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool)) == NULL);
+    fail_unless(n_calls == 1);
+    fail_unless(pa_mempool_get_n_segments(pool) == 1);
+
+    pa_mempool_grow(pool);
+    fail_unless(pa_mempool_get_n_segments(pool) == 2);
+    fail_unless((blocks[2] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+
+    pa_memblock_unref(blocks[0]);
+    pa_memblock_unref(blocks[1]);
+    pa_memblock_unref(blocks[2]);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,6 +463,10 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_hugepages_test);
+    tcase_add_test(tc, memblock_slot_classes_test);
+    tcase_add_test(tc, memblock_grow_test);
+    tcase_add_test(tc, memblock_grow_callback_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
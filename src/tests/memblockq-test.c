@@ -33,6 +33,8 @@
 
 #include <pulse/xmalloc.h>
 
+#include "runtime-test-util.h"
+
 static const char *fixed[] = {
     "1122444411441144__22__11______3333______________________________",
     "__________________3333__________________________________________"
@@ -597,6 +599,222 @@ START_TEST (memblockq_test_tlength_change) {
 }
 END_TEST
 
+/* Applies random pushes, seeks, drops and rewinds to a memblockq and
+ * to a flat model of the stream, and checks that every peek agrees
+ * with the model */
+#define MODEL_SIZE (1024*1024)
+#define MODEL_MAXREWIND 256
+#define MODEL_MAX_CHUNK 64
+
+START_TEST (memblockq_test_random) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk src, chunk;
+    uint8_t *data, *d;
+    bool *valid;
+    int64_t floor = 0, r = 0, w = 0;
+    size_t last_end = 0, k;
+    unsigned i;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_U8,
+        .rate = 48000,
+        .channels = 1
+    };
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    ck_assert_ptr_ne(p, NULL);
+
+    src.memblock = pa_memblock_new(p, 32768);
+    src.index = 0;
+    src.length = pa_memblock_get_length(src.memblock);
+    d = pa_memblock_acquire(src.memblock);
+    for (k = 0; k < src.length; k++)
+        d[k] = (uint8_t) rand();
+
+    data = pa_xnew0(uint8_t, MODEL_SIZE);
+    valid = pa_xnew0(bool, MODEL_SIZE);
+
+    bq = pa_memblockq_new("test memblockq", 0, MODEL_SIZE, 0, &ss, 0, 0, MODEL_MAXREWIND, NULL);
+    fail_unless(bq != NULL);
+
+    srand(4711);
+
+    for (i = 0; w < MODEL_SIZE - 2 * MODEL_MAX_CHUNK; i++) {
+        int64_t n, j;
+
+        switch (rand() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                /* Sometimes continue the previous push so that the
+                 * queue has a chance to merge the two */
+                chunk = src;
+                chunk.length = (size_t) (rand() % MODEL_MAX_CHUNK) + 1;
+                if (rand() % 2 && last_end + chunk.length <= src.length)
+                    chunk.index = last_end;
+                else
+                    chunk.index = (size_t) rand() % (src.length - chunk.length);
+                last_end = chunk.index + chunk.length;
+
+                fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+
+                for (j = 0; j < (int64_t) chunk.length; j++) {
+                    data[w + j] = d[chunk.index + j];
+                    valid[w + j] = true;
+                }
+                w += (int64_t) chunk.length;
+                break;
+
+            case 3:
+                n = rand() % (3 * MODEL_MAX_CHUNK) - 2 * MODEL_MAX_CHUNK;
+                if (w + n < 0)
+                    n = -w;
+                pa_memblockq_seek(bq, n, PA_SEEK_RELATIVE, true);
+                w += n;
+                floor = PA_MAX(floor, r - MODEL_MAXREWIND);
+                break;
+
+            case 4:
+            case 5:
+                n = rand() % (2 * MODEL_MAX_CHUNK);
+                if (r + n > w + MODEL_MAX_CHUNK)
+                    n = PA_MAX(w + MODEL_MAX_CHUNK - r, 0);
+                pa_memblockq_drop(bq, (size_t) n);
+                r += n;
+                floor = PA_MAX(floor, r - MODEL_MAXREWIND);
+                break;
+
+            case 6:
+                n = PA_MIN(rand() % MODEL_MAXREWIND, r - floor);
+                pa_memblockq_rewind(bq, (size_t) n);
+                r -= n;
+                break;
+
+            case 7:
+                break;
+        }
+
+        fail_unless(pa_memblockq_get_read_index(bq) == r);
+        fail_unless(pa_memblockq_get_write_index(bq) == w);
+
+        if (pa_memblockq_peek(bq, &chunk) < 0) {
+            for (j = r; j < MODEL_SIZE; j++)
+                fail_unless(!valid[j]);
+            fail_unless(w <= r);
+            continue;
+        }
+
+        if (chunk.memblock) {
+            uint8_t *c = pa_memblock_acquire_chunk(&chunk);
+
+            for (j = 0; j < (int64_t) chunk.length; j++) {
+                fail_unless(valid[r + j], "%u: byte %lli should be a hole", i, (long long) (r + j));
+fail_unless(c[j] == data[r + j], "%u: byte %lli differs", i, (long long) (r + j));
+            }
+
+            pa_memblock_release(chunk.memblock);
+            pa_memblock_unref(chunk.memblock);
+        } else {
+            for (j = 0; j < (int64_t) chunk.length; j++)
+                fail_unless(!valid[r + j], "%u: byte %lli should not be a hole", i, (long long) (r + j));
+
+            /* Holes stop at the next piece of data or at the write index */
+            fail_unless(valid[r + j] || r + j == w);
+        }
+    }
+
+    pa_memblock_release(src.memblock);
+    pa_memblock_unref(src.memblock);
+
+    pa_memblockq_free(bq);
+    pa_xfree(data);
+    pa_xfree(valid);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+/* Keeps a deep queue of small chunks filled, like a sink input with a
+ * long buffer and a low latency sink would, and rewinds and rewrites
+ * now and then */
+#define PERF_CHUNK 192
+#define PERF_DEPTH 2000
+#define PERF_REWIND 32
+#define PERF_ROUNDS 20000
+
+START_TEST (memblockq_perf_test) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk a, b, chunk;
+    unsigned i;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    ck_assert_ptr_ne(p, NULL);
+
+    /* Two blocks pushed alternately, so that no chunks get merged */
+    a.memblock = pa_memblock_new(p, PERF_CHUNK);
+    b.memblock = pa_memblock_new(p, PERF_CHUNK);
+    a.index = b.index = 0;
+    a.length = b.length = PERF_CHUNK;
+
+    bq = pa_memblockq_new("test memblockq", 0, 2 * PERF_CHUNK * PERF_DEPTH, 0, &ss, 0, 0, PERF_CHUNK * PERF_REWIND, NULL);
+    fail_unless(bq != NULL);
+
+    for (i = 0; i < PERF_DEPTH; i++)
+        fail_unless(pa_memblockq_push(bq, i % 2 ? &a : &b) == 0);
+
+    pa_log_debug("Testing memblockq performance with %u queued chunks", pa_memblockq_get_nblocks(bq));
+
+    PA_RUNTIME_TEST_RUN_START("push, peek and drop", 1, 10) {
+        for (i = 0; i < PERF_ROUNDS; i++) {
+            pa_memblockq_push(bq, i % 2 ? &a : &b);
+
+            pa_memblockq_peek(bq, &chunk);
+            pa_memblock_unref(chunk.memblock);
+            pa_memblockq_drop(bq, PERF_CHUNK);
+        }
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("with rewinds and rewrites", 1, 10) {
+        for (i = 0; i < PERF_ROUNDS; i++) {
+            pa_memblockq_push(bq, i % 2 ? &a : &b);
+
+            if (i % 64 == 63) {
+                unsigned j;
+
+                /* Read again what was played last... */
+                pa_memblockq_rewind(bq, PERF_CHUNK * PERF_REWIND);
+                for (j = 0; j < PERF_REWIND; j++) {
+                    pa_memblockq_peek(bq, &chunk);
+                    pa_memblock_unref(chunk.memblock);
+                    pa_memblockq_drop(bq, PERF_CHUNK);
+                }
+
+                /* ...and replace the newest data */
+                pa_memblockq_seek(bq, -PERF_CHUNK * PERF_REWIND, PA_SEEK_RELATIVE, true);
+                for (j = 0; j < PERF_REWIND; j++)
+                    pa_memblockq_push(bq, j % 2 ? &b : &a);
+            }
+
+            pa_memblockq_peek(bq, &chunk);
+            pa_memblock_unref(chunk.memblock);
+            pa_memblockq_drop(bq, PERF_CHUNK);
+        }
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    fail_unless(pa_memblockq_get_length(bq) == PERF_CHUNK * PERF_DEPTH);
+
+    pa_memblockq_free(bq);
+    pa_memblock_unref(a.memblock);
+    pa_memblock_unref(b.memblock);
+    pa_mempool_unref(p);
+}
+END_TEST
+
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -615,6 +833,8 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, memblockq_test_length_changes);
     tcase_add_test(tc, memblockq_test_pop_missing);
     tcase_add_test(tc, memblockq_test_tlength_change);
+    tcase_add_test(tc, memblockq_test_random);
+    tcase_add_test(tc, memblockq_perf_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
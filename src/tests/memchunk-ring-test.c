@@ -0,0 +1,169 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/memchunk-ring.h>
+#include <pulsecore/thread.h>
+
+/* A tiny ring, so that the producer overflows into its local queue */
+#define RING_SIZE 4
+#define N_CHUNKS 20000
+#define CHUNK_SIZE 16
+#define REWIND 8
+
+static pa_mempool *pool;
+static pa_memchunk_ring *ring;
+static pa_memblockq *bq;
+static pa_atomic_t producer_done = PA_ATOMIC_INIT(0);
+static pa_atomic_t wakeups = PA_ATOMIC_INIT(0);
+static int64_t written, received;
+
+/* Writes a byte pattern that follows the stream position, and now
+ * and then rewinds a bit and writes that part again */
+static void producer(void *userdata) {
+    unsigned i, k;
+
+    for (i = 0; i < N_CHUNKS; i++) {
+        pa_memchunk chunk;
+        uint8_t *d;
+
+        chunk.memblock = pa_memblock_new(pool, CHUNK_SIZE);
+        chunk.index = 0;
+        chunk.length = CHUNK_SIZE;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        for (k = 0; k < CHUNK_SIZE; k++)
+            d[k] = (uint8_t) (written + k);
+        pa_memblock_release(chunk.memblock);
+
+        if (pa_memchunk_ring_push(ring, &chunk))
+            pa_atomic_inc(&wakeups);
+        pa_memblock_unref(chunk.memblock);
+        written += CHUNK_SIZE;
+
+        if (i % 7 == 6) {
+            if (pa_memchunk_ring_seek(ring, -REWIND, PA_SEEK_RELATIVE))
+                pa_atomic_inc(&wakeups);
+            written -= REWIND;
+        }
+
+        if (i % 1000 == 0)
+            pa_thread_yield();
+    }
+
+    /* Hand over what did not fit into the ring yet */
+    while (!pa_memchunk_ring_flush(ring))
+        pa_thread_yield();
+
+    pa_atomic_store(&producer_done, 1);
+}
+
+static void consumer(void *userdata) {
+    for (;;) {
+        bool done = pa_atomic_load(&producer_done);
+
+        received += pa_memchunk_ring_drain(ring, bq);
+
+        if (done)
+            break;
+
+        pa_memchunk_ring_request_wakeup(ring);
+        pa_thread_yield();
+    }
+}
+
+START_TEST (memchunk_ring_test) {
+    pa_thread *t1, *t2;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_U8,
+        .rate = 48000,
+        .channels = 1
+    };
+    pa_memchunk chunk;
+    int64_t pos = 0;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(pool != NULL);
+
+    ring = pa_memchunk_ring_new(RING_SIZE);
+    bq = pa_memblockq_new("test memblockq", 0, N_CHUNKS * CHUNK_SIZE, 0, &ss, 0, 0, 0, NULL);
+
+    t1 = pa_thread_new("producer", producer, NULL);
+    fail_unless(t1 != NULL);
+    t2 = pa_thread_new("consumer", consumer, NULL);
+    fail_unless(t2 != NULL);
+
+    pa_thread_free(t1);
+    pa_thread_free(t2);
+
+    fail_unless(received == written);
+    fail_unless(pa_memblockq_get_write_index(bq) == written);
+    fail_unless(pa_atomic_load(&wakeups) > 0);
+
+    /* All rewinds must have been replayed in order */
+    while (pa_memblockq_peek(bq, &chunk) >= 0) {
+        uint8_t *d;
+        size_t k;
+
+        d = pa_memblock_acquire_chunk(&chunk);
+        for (k = 0; k < chunk.length; k++)
+            fail_unless(d[k] == (uint8_t) (pos + k), "byte %lli is %u", (long long) (pos + k), d[k]);
+        pa_memblock_release(chunk.memblock);
+
+        pos += chunk.length;
+        pa_memblockq_drop(bq, chunk.length);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    fail_unless(pos == written);
+
+    pa_memblockq_free(bq);
+    pa_memchunk_ring_free(ring);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Memchunk Ring");
+    tc = tcase_create("memchunk-ring");
+    tcase_add_test(tc, memchunk_ring_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -333,6 +333,15 @@ START_TEST (mix_test) {
 
         compare_block(&a, &k, 2);
 
+        /* A single stream gets scaled like pa_volume_memchunk() does */
+        m[0].volume = v;
+
+        ptr = pa_memblock_acquire_chunk(&k);
+        pa_mix(m, 1, ptr, k.length, &a, NULL, false);
+        pa_memblock_release(k.memblock);
+
+        compare_block(&a, &k, 1);
+
         pa_memblock_unref(i.memblock);
         pa_memblock_unref(j.memblock);
         pa_memblock_unref(k.memblock);
@@ -0,0 +1,209 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+
+#include "runtime-test-util.h"
+
+#define N_PACKETS 10000
+#define N_IN_FLIGHT 16
+#define MAX_PAYLOAD 4000
+
+static unsigned malloced(void) {
+    return (unsigned) pa_atomic_load(&pa_packet_get_stat()->n_malloced);
+}
+
+START_TEST (packet_test) {
+    static const size_t sizes[] = { 1, 100, 256, 257, 1000, 4096, 4097, 100000 };
+    const pa_packet_stat *stat = pa_packet_get_stat();
+    unsigned i, n_allocated, n_accumulated, n_malloced;
+
+    n_allocated = pa_atomic_load(&stat->n_allocated);
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++) {
+        pa_packet *p, *q;
+        uint8_t *d;
+        const uint8_t *e;
+        size_t l, j;
+
+        p = pa_packet_new(sizes[i]);
+        d = (uint8_t *) pa_packet_data(p, &l);
+        fail_unless(l == sizes[i]);
+        for (j = 0; j < l; j++)
+            d[j] = (uint8_t) j;
+
+        q = pa_packet_new_data(d, l);
+        pa_packet_unref(p);
+
+        e = pa_packet_data(q, &l);
+        fail_unless(l == sizes[i]);
+        for (j = 0; j < l; j++)
+            fail_unless(e[j] == (uint8_t) j);
+
+        fail_unless(pa_atomic_load(&stat->n_allocated) == (int) n_allocated + 1);
+        pa_packet_unref(q);
+    }
+
+    fail_unless(pa_atomic_load(&stat->n_allocated) == (int) n_allocated);
+
+    /* Once warmed up, only packets too big for the pooled buffers need
+     * malloc() */
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++)
+        pa_packet_unref(pa_packet_new(sizes[i]));
+
+    n_accumulated = pa_atomic_load(&stat->n_accumulated);
+    n_malloced = malloced();
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++)
+        pa_packet_unref(pa_packet_new(sizes[i]));
+
+    fail_unless(pa_atomic_load(&stat->n_accumulated) == (int) (n_accumulated + PA_ELEMENTSOF(sizes)));
+    fail_unless(malloced() == n_malloced + 2);
+
+    pa_packet_unref(pa_packet_new_dynamic(pa_xmalloc(10), 10));
+    fail_unless(malloced() == n_malloced + 3);
+}
+END_TEST
+
+static unsigned packets_received;
+
+static void packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    packets_received++;
+}
+
+static void send_packets(pa_mainloop *ml, pa_pstream *p1, size_t length, bool tagstruct) {
+    static const uint8_t payload[MAX_PAYLOAD];
+    pa_packet *packet;
+    unsigned i;
+
+    pa_assert(length <= MAX_PAYLOAD);
+
+    packets_received = 0;
+
+    for (i = 0; i < N_PACKETS; i++) {
+        if (tagstruct) {
+            /* Like a reply of the native protocol */
+            pa_tagstruct *t = pa_tagstruct_new();
+
+            pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+            pa_tagstruct_putu32(t, i);
+            pa_tagstruct_put_arbitrary(t, payload, length);
+            pa_pstream_send_tagstruct(p1, t);
+        } else {
+            packet = pa_packet_new(length);
+            memset((void *) pa_packet_data(packet, &length), 0, length);
+            pa_pstream_send_packet(p1, packet, NULL);
+            pa_packet_unref(packet);
+        }
+
+        /* Like a client that does not wait for every reply */
+        while (i + 1 - packets_received >= N_IN_FLIGHT)
+            pa_mainloop_iterate(ml, 1, NULL);
+    }
+
+    while (packets_received < N_PACKETS)
+        pa_mainloop_iterate(ml, 1, NULL);
+}
+
+/* Sending and receiving control messages through a pstream should
+ * not malloc() every packet */
+START_TEST (pstream_packet_test) {
+    static const size_t sizes[] = { 20, 200, 2000, MAX_PAYLOAD };
+    pa_mainloop *ml;
+    pa_mempool *mp;
+    pa_pstream *p1, *p2;
+    int pipefd[4];
+    unsigned i;
+
+    ml = pa_mainloop_new();
+    mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]), mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]), mp);
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+
+    for (i = 0; i < 2 * PA_ELEMENTSOF(sizes); i++) {
+        size_t size = sizes[i % PA_ELEMENTSOF(sizes)];
+        bool tagstruct = i >= PA_ELEMENTSOF(sizes);
+        unsigned n_malloced;
+        char label[64];
+
+        send_packets(ml, p1, size, tagstruct);
+        n_malloced = malloced();
+
+        pa_snprintf(label, sizeof(label), "%u %s of %u bytes", N_PACKETS, tagstruct ? "tagstructs" : "packets", (unsigned) size);
+        PA_RUNTIME_TEST_RUN_START(label, 1, 5) {
+            send_packets(ml, p1, size, tagstruct);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_log_debug("%u malloc() calls for %u packets", malloced() - n_malloced, 5 * 2 * N_PACKETS);
+        fail_unless(malloced() - n_malloced < N_PACKETS / 100);
+    }
+
+    pa_pstream_unlink(p1);
+    pa_pstream_unlink(p2);
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Packet");
+    tc = tcase_create("packet");
+    tcase_add_test(tc, packet_test);
+    tcase_add_test(tc, pstream_packet_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
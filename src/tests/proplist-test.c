@@ -21,6 +21,10 @@
 
 #include <stdio.h>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 #include <check.h>
 
 #include <pulse/proplist.h>
@@ -29,6 +33,10 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
 
+#include "runtime-test-util.h"
+
+#define N_STREAMS 500
+
 START_TEST (proplist_test) {
     pa_modargs *ma;
     pa_proplist *a, *b, *c, *d;
@@ -96,6 +104,189 @@ START_TEST (proplist_test) {
 }
 END_TEST
 
+START_TEST (proplist_copy_test) {
+    pa_proplist *a, *b;
+    const char *title, *key;
+    void *state = NULL;
+    unsigned i, n;
+
+    a = pa_proplist_new();
+    fail_unless(pa_proplist_sets(a, PA_PROP_MEDIA_TITLE, "Goldbergvariationen") == 0);
+    fail_unless(pa_proplist_sets(a, "x-test.foo", "bar") == 0);
+
+    /* Lots of properties, well known and made up ones */
+    for (i = 0; i < 100; i++) {
+        char k[32], v[32];
+
+        pa_snprintf(k, sizeof(k), "x-test.key%u", i);
+        pa_snprintf(v, sizeof(v), "value %u", i);
+        fail_unless(pa_proplist_sets(a, k, v) == 0);
+    }
+    fail_unless(pa_proplist_sets(a, PA_PROP_MEDIA_ARTIST, "Johann Sebastian Bach") == 0);
+    fail_unless(pa_proplist_size(a) == 103);
+
+    title = pa_proplist_gets(a, PA_PROP_MEDIA_TITLE);
+    fail_unless(pa_streq(title, "Goldbergvariationen"));
+
+    b = pa_proplist_copy(a);
+    fail_unless(pa_proplist_equal(a, b));
+
+    /* Changing either copy leaves the other alone, and values that are
+     * not changed stay where they are */
+    fail_unless(pa_proplist_sets(b, PA_PROP_MEDIA_TITLE, "Brandenburgische Konzerte") == 0);
+    fail_unless(pa_proplist_unset(a, "x-test.foo") == 0);
+    fail_unless(pa_proplist_sets(a, "x-test.key50", "changed") == 0);
+
+    fail_unless(pa_proplist_gets(a, PA_PROP_MEDIA_TITLE) == title);
+    fail_unless(pa_streq(pa_proplist_gets(b, PA_PROP_MEDIA_TITLE), "Brandenburgische Konzerte"));
+    fail_unless(pa_streq(pa_proplist_gets(b, "x-test.foo"), "bar"));
+    fail_unless(pa_streq(pa_proplist_gets(b, "x-test.key50"), "value 50"));
+    fail_unless(pa_streq(pa_proplist_gets(a, "x-test.key50"), "changed"));
+    fail_unless(!pa_proplist_equal(a, b));
+
+    /* Insertion order is kept, also for replaced values */
+    n = 0;
+    while ((key = pa_proplist_iterate(a, &state))) {
+        if (n == 0)
+            fail_unless(pa_streq(key, PA_PROP_MEDIA_TITLE));
+        else if (n == 101)
+            fail_unless(pa_streq(key, PA_PROP_MEDIA_ARTIST));
+        else
+            fail_unless(pa_streq(key + 10, pa_proplist_gets(a, key) + 6) || n == 51);
+        n++;
+    }
+    fail_unless(n == 102);
+
+    /* Removing the current key while iterating does not skip any */
+    n = 0;
+    state = NULL;
+    while ((key = pa_proplist_iterate(b, &state))) {
+        n++;
+        if (pa_startswith(key, "x-test."))
+            fail_unless(pa_proplist_unset(b, key) == 0);
+    }
+    fail_unless(n == 103);
+    fail_unless(pa_proplist_size(b) == 2);
+    fail_unless(pa_proplist_contains(b, PA_PROP_MEDIA_ARTIST) == 1);
+    fail_unless(pa_proplist_contains(b, "x-test.key0") == 0);
+
+    pa_proplist_update(b, PA_UPDATE_MERGE, a);
+    fail_unless(pa_proplist_size(b) == 102);
+    fail_unless(pa_streq(pa_proplist_gets(b, PA_PROP_MEDIA_TITLE), "Brandenburgische Konzerte"));
+
+    pa_proplist_update(b, PA_UPDATE_SET, a);
+    fail_unless(pa_proplist_equal(a, b));
+
+    pa_proplist_clear(a);
+    fail_unless(pa_proplist_isempty(a));
+    fail_unless(pa_proplist_size(b) == 102);
+
+    /* Well known keys are not copied for each property, made up ones
+     * are */
+    {
+        const char * const keys[] = { PA_PROP_APPLICATION_ICON, PA_PROP_DEVICE_BUS, PA_PROP_MEDIA_ROLE,
+                                      PA_PROP_WINDOW_X, PA_PROP_WINDOW_Y, "x-test.foo" };
+        const char *key_a, *key_b;
+
+        for (i = 0; i < PA_ELEMENTSOF(keys); i++) {
+            pa_proplist_clear(a);
+            pa_proplist_clear(b);
+            fail_unless(pa_proplist_sets(a, keys[i], "a") == 0);
+            fail_unless(pa_proplist_sets(b, keys[i], "b") == 0);
+
+            state = NULL;
+            key_a = pa_proplist_iterate(a, &state);
+            state = NULL;
+            key_b = pa_proplist_iterate(b, &state);
+
+            fail_unless(pa_streq(key_a, keys[i]) && pa_streq(key_b, keys[i]));
+            fail_unless((key_a == key_b) == (i < PA_ELEMENTSOF(keys) - 1), "%s", keys[i]);
+        }
+    }
+
+    pa_proplist_free(a);
+    pa_proplist_free(b);
+}
+END_TEST
+
+static size_t heap_in_use(void) {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+/* A client with N_STREAMS streams, whose properties are set up the way
+ * the native protocol and the sink input code do it */
+START_TEST (proplist_memory_benchmark) {
+    pa_proplist *client, *streams[N_STREAMS];
+    size_t before, after;
+    unsigned i;
+
+    before = heap_in_use();
+
+    client = pa_proplist_new();
+    pa_proplist_sets(client, PA_PROP_APPLICATION_NAME, "Music Player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_ID, "org.example.MusicPlayer");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_VERSION, "3.2.1");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_ICON_NAME, "multimedia-player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_ID, "12345");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_BINARY, "music-player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_USER, "someone");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_HOST, "localhost");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_MACHINE_ID, "0123456789abcdef0123456789abcdef");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_SESSION_ID, "2");
+    pa_proplist_sets(client, "window.x11.display", ":0");
+    pa_proplist_sets(client, "native-protocol.peer", "UNIX socket client");
+    pa_proplist_sets(client, "native-protocol.version", "30");
+
+    PA_RUNTIME_TEST_RUN_START("set up stream properties", 1, 1) {
+        for (i = 0; i < N_STREAMS; i++) {
+            pa_proplist *p;
+            char name[32];
+
+            /* What the client sends */
+            p = pa_proplist_new();
+            pa_snprintf(name, sizeof(name), "Track %u", i);
+            pa_proplist_sets(p, PA_PROP_MEDIA_NAME, name);
+            pa_proplist_sets(p, PA_PROP_MEDIA_ROLE, "music");
+            pa_proplist_sets(p, PA_PROP_MEDIA_TITLE, name);
+            pa_proplist_sets(p, PA_PROP_MEDIA_ARTIST, "Johann Sebastian Bach");
+            pa_proplist_sets(p, "module-stream-restore.id", "sink-input-by-media-role:music");
+
+            /* What the server adds and keeps */
+            pa_proplist_update(p, PA_UPDATE_MERGE, client);
+            streams[i] = pa_proplist_new();
+            pa_proplist_update(streams[i], PA_UPDATE_REPLACE, p);
+            pa_proplist_free(p);
+        }
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    after = heap_in_use();
+    if (after > 0)
+        pa_log_debug("%u streams with %u properties each: %llu bytes", N_STREAMS, pa_proplist_size(streams[0]),
+                     (unsigned long long) (after - before));
+
+    PA_RUNTIME_TEST_RUN_START("copy stream properties", 100, 1) {
+        pa_proplist_free(pa_proplist_copy(streams[_j % N_STREAMS]));
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("look up stream properties", 1, 1) {
+        for (i = 0; i < N_STREAMS; i++) {
+            fail_unless(pa_proplist_gets(streams[i], PA_PROP_MEDIA_ROLE) != NULL);
+            fail_unless(pa_proplist_gets(streams[i], PA_PROP_APPLICATION_PROCESS_BINARY) != NULL);
+            fail_unless(pa_proplist_gets(streams[i], PA_PROP_DEVICE_STRING) == NULL);
+        }
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    for (i = 0; i < N_STREAMS; i++)
+        pa_proplist_free(streams[i]);
+    pa_proplist_free(client);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -108,6 +299,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Property List");
     tc = tcase_create("propertylist");
     tcase_add_test(tc, proplist_test);
+    tcase_add_test(tc, proplist_copy_test);
+    tcase_add_test(tc, proplist_memory_benchmark);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,246 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <check.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/socket.h>
+
+#include "runtime-test-util.h"
+
+#define N_ITEMS 2000
+#define PACKET_SIZE_MAX 100000
+
+/* Every item sent carries its sequence number in the first four
+ * bytes, followed by a pattern derived from it */
+static unsigned n_items_received;
+static unsigned n_fds_received;
+static bool sending_fds;
+
+static size_t item_size(unsigned seq) {
+    /* Mostly small, with the occasional big one */
+    if (seq % 97 == 0)
+        return PACKET_SIZE_MAX - seq;
+
+    return 8 + (seq * 37) % 400;
+}
+
+static bool item_has_fd(unsigned seq) {
+    return seq % 7 == 3;
+}
+
+static void fill(uint8_t *d, size_t length, unsigned seq) {
+    size_t i;
+
+    memcpy(d, &seq, sizeof(seq));
+    for (i = sizeof(seq); i < length; i++)
+        d[i] = (uint8_t) (seq + i);
+}
+
+static void check(const uint8_t *d, size_t length) {
+    unsigned seq;
+    size_t i;
+
+    memcpy(&seq, d, sizeof(seq));
+    fail_unless(seq == n_items_received, "got item %u, expected %u", seq, n_items_received);
+    fail_unless(length == item_size(seq));
+
+    for (i = sizeof(seq); i < length; i++)
+        fail_unless(d[i] == (uint8_t) (seq + i));
+
+    n_items_received++;
+}
+
+static void packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint8_t *d;
+    size_t length;
+    unsigned seq;
+
+    d = pa_packet_data(packet, &length);
+    memcpy(&seq, d, sizeof(seq));
+
+#ifdef HAVE_CREDS
+    /* The fds arrive with exactly the packet they were sent with */
+    if (sending_fds && item_has_fd(seq)) {
+        fail_unless(ancil_data && ancil_data->nfd == 1, "packet %u came without its fd", seq);
+        fail_unless(fcntl(ancil_data->fds[0], F_GETFD) >= 0);
+        pa_cmsg_ancil_data_close_fds(ancil_data);
+        n_fds_received++;
+    } else
+        fail_unless(!ancil_data || ancil_data->nfd == 0, "packet %u came with an fd", seq);
+#endif
+
+    check(d, length);
+}
+
+static void memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    fail_unless(channel == 1);
+
+    check((const uint8_t *) pa_memblock_acquire_chunk(chunk), chunk->length);
+    pa_memblock_release(chunk->memblock);
+}
+
+static void send_items(pa_mainloop *ml, pa_mempool *mp, pa_pstream *p1) {
+    unsigned seq, n_fds_sent = 0;
+
+    n_items_received = 0;
+    n_fds_received = 0;
+
+    /* Queue everything up front, like a busy main loop iteration does */
+    for (seq = 0; seq < N_ITEMS; seq++) {
+        size_t length = item_size(seq);
+
+        if (seq % 5 == 1 && length <= pa_mempool_block_size_max(mp)) {
+            pa_memchunk chunk;
+
+            chunk.memblock = pa_memblock_new(mp, length);
+            chunk.index = 0;
+            chunk.length = length;
+            fill(pa_memblock_acquire(chunk.memblock), length, seq);
+            pa_memblock_release(chunk.memblock);
+
+            pa_pstream_send_memblock(p1, 1, 0, PA_SEEK_RELATIVE, &chunk);
+            pa_memblock_unref(chunk.memblock);
+        } else {
+            pa_packet *packet = pa_packet_new(length);
+
+            fill((uint8_t *) pa_packet_data(packet, &length), length, seq);
+
+#ifdef HAVE_CREDS
+            if (sending_fds && item_has_fd(seq)) {
+                pa_cmsg_ancil_data ancil;
+
+                pa_zero(ancil);
+                ancil.nfd = 1;
+                ancil.fds[0] = open("/dev/null", O_RDONLY|O_CLOEXEC);
+                ancil.close_fds_on_cleanup = true;
+                fail_unless(ancil.fds[0] >= 0);
+
+                pa_pstream_send_packet(p1, packet, &ancil);
+                n_fds_sent++;
+            } else
+#endif
+                pa_pstream_send_packet(p1, packet, NULL);
+
+            pa_packet_unref(packet);
+        }
+    }
+
+    while (n_items_received < N_ITEMS)
+        fail_unless(pa_mainloop_iterate(ml, 1, NULL) >= 0);
+
+    fail_unless(!pa_pstream_is_pending(p1));
+    fail_unless(n_fds_received == n_fds_sent);
+}
+
+static void pstream_test(int fds[4], bool with_fds) {
+    pa_mainloop *ml;
+    pa_mempool *mp;
+    pa_pstream *p1, *p2;
+    unsigned n_frames_written, n_writes, n_frames_read, n_reads;
+
+    ml = pa_mainloop_new();
+    mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    sending_fds = with_fds;
+
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[1]), mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), fds[2], fds[3]), mp);
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+    pa_pstream_set_receive_memblock_callback(p2, memblock_received, NULL);
+
+    PA_RUNTIME_TEST_RUN_START(with_fds ? "burst with fds" : "burst", 1, 5) {
+        send_items(ml, mp, p1);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_pstream_get_io_stat(p1, &n_frames_written, &n_writes, &n_frames_read, &n_reads);
+    pa_log_debug("Wrote %u frames in %u system calls", n_frames_written, n_writes);
+    fail_unless(n_frames_written == 5 * N_ITEMS);
+
+    pa_pstream_get_io_stat(p2, &n_frames_written, &n_writes, &n_frames_read, &n_reads);
+    pa_log_debug("Read %u frames in %u system calls", n_frames_read, n_reads);
+    fail_unless(n_frames_read == 5 * N_ITEMS);
+
+#ifdef HAVE_SYS_UIO_H
+    /* The frames with fds need a system call each on both ends */
+    pa_pstream_get_io_stat(p1, &n_frames_written, &n_writes, &n_frames_read, &n_reads);
+    fail_unless(n_writes < n_frames_written / 2);
+#endif
+    pa_pstream_get_io_stat(p2, &n_frames_written, &n_writes, &n_frames_read, &n_reads);
+    fail_unless(n_reads < n_frames_read / 2);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+
+START_TEST (pstream_pipe_test) {
+    int pipefd[4];
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+
+    pstream_test((int[]) { pipefd[2], pipefd[1], pipefd[0], pipefd[3] }, false);
+}
+END_TEST
+
+START_TEST (pstream_socket_test) {
+    int sv[2];
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    pstream_test((int[]) { sv[0], sv[0], sv[1], sv[1] }, true);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Pstream");
+    tc = tcase_create("pstream");
+    tcase_add_test(tc, pstream_pipe_test);
+    tcase_add_test(tc, pstream_socket_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
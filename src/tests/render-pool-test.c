@@ -0,0 +1,107 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/render-pool.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#define N_THREADS 3
+#define N_JOBS 16
+#define N_BATCHES 2000
+
+static pa_thread_mq thread_mq;
+static pa_atomic_t counts[N_JOBS];
+
+static void job_cb(void *userdata, unsigned idx) {
+    fail_unless(idx < N_JOBS);
+    fail_unless(pa_thread_mq_get() == &thread_mq);
+
+    pa_atomic_inc(&counts[idx]);
+
+    /* Make some jobs slow so that workers overlap with the caller */
+    if (idx % 4 == 0)
+        pa_thread_yield();
+}
+
+START_TEST (render_pool_test) {
+    pa_mainloop *ml;
+    pa_rtpoll *rtpoll;
+    pa_render_pool *pool;
+    unsigned batch, n, k;
+
+    fail_unless((ml = pa_mainloop_new()) != NULL);
+    rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&thread_mq, pa_mainloop_get_api(ml), rtpoll);
+
+    /* We play the IO thread here, which runs jobs too */
+    pa_thread_mq_install(&thread_mq);
+
+    fail_unless((pool = pa_render_pool_new(N_THREADS, &thread_mq, false, 0)) != NULL);
+
+    for (batch = 0; batch < N_BATCHES; batch++) {
+        /* Vary the batch size, including batches smaller than the pool */
+        n = batch % (N_JOBS + 1);
+
+        for (k = 0; k < N_JOBS; k++)
+            pa_atomic_store(&counts[k], 0);
+
+        pa_render_pool_start(pool, job_cb, NULL, n);
+        pa_render_pool_join(pool);
+
+        /* Every job must have run exactly once by the time join()
+         * returns */
+        for (k = 0; k < N_JOBS; k++)
+            fail_unless(pa_atomic_load(&counts[k]) == (k < n ? 1 : 0));
+    }
+
+    pa_render_pool_free(pool);
+
+    pa_thread_mq_done(&thread_mq);
+    pa_rtpoll_free(rtpoll);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Render Pool");
+    tc = tcase_create("render-pool");
+    tcase_add_test(tc, render_pool_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
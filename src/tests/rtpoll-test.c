@@ -21,10 +21,21 @@
 
 #include <check.h>
 #include <signal.h>
+#include <unistd.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+
+#include <pulsecore/core-util.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/thread.h>
+
+#define TIMER_USEC 1000
+#define N_TIMERS 500
 
 static int before(pa_rtpoll_item *i) {
     pa_log("before");
@@ -82,15 +93,116 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+static void writer(void *userdata) {
+    int *fds = userdata;
+
+    /* Most likely lets the reader start spinning first, though nothing
+     * depends on it */
+    pa_msleep(2);
+    pa_assert_se(write(fds[1], "x", 1) == 1);
+}
+
+START_TEST (rtpoll_busy_poll_test) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i;
+    struct pollfd *pollfd;
+    pa_thread *t;
+    pa_usec_t deadline;
+    int fds[2];
+    unsigned n;
+
+    fail_unless(pipe(fds) == 0);
+
+    p = pa_rtpoll_new();
+    pa_rtpoll_set_busy_poll(p, 10 * PA_USEC_PER_SEC);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NEVER, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fds[0];
+    pollfd->events = POLLIN;
+
+    /* The timer is well within the busy poll window, so all of the
+     * waiting is spinning, and the fd still has to end it. It is far
+     * off, so that the fd wins no matter how the threads are
+     * scheduled. */
+    pa_rtpoll_set_timer_relative(p, 5 * PA_USEC_PER_SEC);
+
+    t = pa_thread_new("writer", writer, fds);
+    fail_unless(t != NULL);
+
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+
+    pollfd = pa_rtpoll_item_get_pollfd(i, &n);
+    fail_unless(n == 1);
+    fail_unless(pollfd->revents & POLLIN);
+    pollfd->revents = 0;
+
+    pa_thread_free(t);
+
+    /* Without anything on the fds, the timer ends it, but not early */
+    pa_rtpoll_item_free(i);
+
+    deadline = pa_rtclock_now() + 5 * PA_USEC_PER_MSEC;
+    pa_rtpoll_set_timer_absolute(p, deadline);
+
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(pa_rtclock_now() >= deadline);
+
+    pa_rtpoll_free(p);
+    pa_close_pipe(fds);
+}
+END_TEST
+
+/* Measures how late the timer ends pa_rtpoll_run() */
+static void measure_lateness(const char *label, pa_usec_t busy_poll_usec) {
+    pa_rtpoll *p;
+    pa_usec_t late, sum = 0, max = 0;
+    unsigned k;
+
+    p = pa_rtpoll_new();
+    pa_rtpoll_set_busy_poll(p, busy_poll_usec);
+
+    for (k = 0; k < N_TIMERS; k++) {
+        pa_usec_t deadline;
+
+        deadline = pa_rtclock_now() + TIMER_USEC;
+        pa_rtpoll_set_timer_absolute(p, deadline);
+
+        fail_unless(pa_rtpoll_run(p) > 0);
+        late = pa_rtclock_now() - deadline;
+
+        sum += late;
+        max = PA_MAX(max, late);
+    }
+
+    pa_log_debug("%s: %u timers of %u usec, late by %llu usec on average, %llu usec at most",
+                 label, N_TIMERS, TIMER_USEC, (unsigned long long) (sum / N_TIMERS), (unsigned long long) max);
+
+    pa_rtpoll_free(p);
+}
+
+START_TEST (rtpoll_busy_poll_benchmark) {
+    measure_lateness("sleeping", 0);
+    measure_lateness("busy polling", 200);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_busy_poll_test);
+    tcase_add_test(tc, rtpoll_busy_poll_benchmark);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
@@ -0,0 +1,309 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/macro.h>
+
+/* More inputs than the old fixed size mix info array could hold */
+#define N_INPUTS 200
+#define N_FRAMES 1024
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX
+};
+
+static pa_thread_mq thread_mq;
+static pa_rtpoll *rtpoll;
+
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    if (code == SINK_MESSAGE_RENDER) {
+        /* Like a real sink would, after inputs went away */
+        if (s->thread_info.rewind_requested)
+            pa_sink_process_rewind(s, 0);
+
+        pa_sink_render(s, (size_t) offset, data);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    pa_thread_mq_install(&thread_mq);
+
+    while (pa_rtpoll_run(rtpoll) > 0)
+        ;
+}
+
+/* Every input produces a constant signal of its own value, so the mix
+ * result tells whether each of them was summed exactly once */
+static int input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    int16_t value = (int16_t) PA_PTR_TO_INT(i->userdata);
+    int16_t *d;
+    size_t k;
+
+    chunk->memblock = pa_memblock_new(i->sink->core->mempool, nbytes);
+    chunk->index = 0;
+    chunk->length = nbytes;
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (k = 0; k < nbytes / sizeof(int16_t); k++)
+        d[k] = value;
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+static void input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+static void input_kill_cb(pa_sink_input *i) {
+}
+
+static pa_sink_input *new_input(pa_core *core, pa_sink *sink, pa_sink *origin_sink, int value) {
+    pa_sink_input_new_data input_data;
+    pa_sink_input *i;
+
+    pa_sink_input_new_data_init(&input_data);
+    input_data.driver = __FILE__;
+    input_data.origin_sink = origin_sink;
+    pa_sink_input_new_data_set_sink(&input_data, sink, false);
+    pa_sink_input_new_data_set_sample_spec(&input_data, &sink->sample_spec);
+    pa_sink_input_new_data_set_channel_map(&input_data, &sink->channel_map);
+    fail_unless(pa_sink_input_new(&i, core, &input_data) >= 0);
+    pa_sink_input_new_data_done(&input_data);
+
+    i->pop = input_pop_cb;
+    i->process_rewind = input_process_rewind_cb;
+    i->kill = input_kill_cb;
+    i->userdata = PA_INT_TO_PTR(value);
+
+    pa_sink_input_put(i);
+
+    return i;
+}
+
+static pa_sink *new_sink(pa_core *core, const char *name) {
+    pa_sink_new_data data;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_sink *sink;
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = 44100;
+    ss.channels = 2;
+    pa_channel_map_init_stereo(&map);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    pa_sink_new_data_set_channel_map(&data, &map);
+    sink = pa_sink_new(core, &data, 0);
+    pa_sink_new_data_done(&data);
+    fail_unless(sink != NULL);
+
+    return sink;
+}
+
+static void start_sink(pa_sink *sink, pa_thread **thread) {
+    rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&thread_mq, sink->core->mainloop, rtpoll);
+
+    sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(sink, thread_mq.inq);
+    pa_sink_set_rtpoll(sink, rtpoll);
+
+    fail_unless((*thread = pa_thread_new("render-test", thread_func, NULL)) != NULL);
+
+    pa_sink_put(sink);
+}
+
+static void stop_sink(pa_sink *sink, pa_thread *thread) {
+    pa_sink_unlink(sink);
+
+    pa_asyncmsgq_send(thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+    pa_thread_mq_done(&thread_mq);
+
+    pa_sink_unref(sink);
+    pa_rtpoll_free(rtpoll);
+}
+
+/* Renders from the IO thread and checks that every sample is the sum
+ * of the input values */
+static void check_render(pa_sink *sink, int expected) {
+    pa_memchunk result;
+    int16_t *d;
+    size_t k;
+
+    pa_memchunk_reset(&result);
+    pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), SINK_MESSAGE_RENDER, &result,
+                      (int64_t) (N_FRAMES * pa_frame_size(&sink->sample_spec)), NULL);
+
+    fail_unless(result.memblock != NULL);
+    fail_unless(result.length > 0);
+
+    d = pa_memblock_acquire_chunk(&result);
+    for (k = 0; k < result.length / sizeof(int16_t); k++)
+        fail_unless(d[k] == expected, "sample %u is %i, expected %i", (unsigned) k, d[k], expected);
+    pa_memblock_release(result.memblock);
+    pa_memblock_unref(result.memblock);
+}
+
+START_TEST (sink_render_test) {
+    pa_mainloop *ml;
+    pa_core *core;
+    pa_sink *sink;
+    pa_sink_input *inputs[N_INPUTS];
+    pa_thread *thread;
+    int expected = 0;
+    unsigned j;
+
+    fail_unless((ml = pa_mainloop_new()) != NULL);
+    fail_unless((core = pa_core_new(pa_mainloop_get_api(ml), false, false, 0, PA_MEM_HUGEPAGES_NO, -1)) != NULL);
+
+    sink = new_sink(core, "render_test");
+    start_sink(sink, &thread);
+
+    for (j = 0; j < N_INPUTS; j++) {
+        inputs[j] = new_input(core, sink, NULL, j + 1);
+        expected += j + 1;
+    }
+
+    fail_unless(sink->thread_info.n_mix_info >= N_INPUTS);
+
+    /* Render twice, the second time from the same arena */
+    for (j = 0; j < 2; j++) {
+        pa_mix_info *arena = sink->thread_info.mix_info;
+
+        check_render(sink, expected);
+        fail_unless(sink->thread_info.mix_info == arena);
+    }
+
+    for (j = 0; j < N_INPUTS; j++) {
+        pa_sink_input_unlink(inputs[j]);
+        pa_sink_input_unref(inputs[j]);
+    }
+
+    stop_sink(sink, thread);
+
+    pa_core_unref(core);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+START_TEST (sink_render_pool_test) {
+    pa_mainloop *ml;
+    pa_core *core;
+    pa_sink *sink, *filter;
+    pa_sink_input *input, *filter_inputs[2];
+    pa_thread *thread;
+
+    fail_unless((ml = pa_mainloop_new()) != NULL);
+    fail_unless((core = pa_core_new(pa_mainloop_get_api(ml), false, false, 0, PA_MEM_HUGEPAGES_NO, -1)) != NULL);
+    core->render_threads = 2;
+
+    sink = new_sink(core, "render_test");
+    start_sink(sink, &thread);
+
+    /* Never put, it only marks the inputs below as coming from a
+     * filter sink */
+    filter = new_sink(core, "render_test_filter");
+
+    /* Plain inputs do not need the pool */
+    input = new_input(core, sink, NULL, 1);
+    fail_unless(sink->thread_info.render_pool == NULL);
+    check_render(sink, 1);
+
+    filter_inputs[0] = new_input(core, sink, filter, 10);
+    fail_unless(sink->thread_info.render_pool != NULL);
+    filter_inputs[1] = new_input(core, sink, filter, 100);
+    check_render(sink, 111);
+
+    /* The pool stays as long as any filter is left */
+    pa_sink_input_unlink(filter_inputs[0]);
+    pa_sink_input_unref(filter_inputs[0]);
+    fail_unless(sink->thread_info.render_pool != NULL);
+    check_render(sink, 101);
+
+    pa_sink_input_unlink(filter_inputs[1]);
+    pa_sink_input_unref(filter_inputs[1]);
+    fail_unless(sink->thread_info.render_pool == NULL);
+    check_render(sink, 1);
+
+    /* And comes back with the next one */
+    filter_inputs[0] = new_input(core, sink, filter, 10);
+    filter_inputs[1] = new_input(core, sink, filter, 100);
+    fail_unless(sink->thread_info.render_pool != NULL);
+    check_render(sink, 111);
+
+    pa_sink_input_unlink(filter_inputs[0]);
+    pa_sink_input_unref(filter_inputs[0]);
+    pa_sink_input_unlink(filter_inputs[1]);
+    pa_sink_input_unref(filter_inputs[1]);
+    fail_unless(sink->thread_info.render_pool == NULL);
+
+    pa_sink_input_unlink(input);
+    pa_sink_input_unref(input);
+
+    pa_sink_unlink(filter);
+    pa_sink_unref(filter);
+
+    stop_sink(sink, thread);
+
+    pa_core_unref(core);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Sink Render");
+    tc = tcase_create("sink-render");
+    tcase_add_test(tc, sink_render_test);
+    tcase_add_test(tc, sink_render_pool_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
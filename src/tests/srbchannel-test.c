@@ -22,14 +22,22 @@
 #endif
 
 #include <unistd.h>
+#include <sys/socket.h>
 #include <check.h>
 
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/native-common.h>
 #include <pulsecore/packet.h>
+#include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memblock.h>
 
+#include "runtime-test-util.h"
+
 static unsigned packets_received;
 static unsigned packets_checksum;
 static size_t packets_length;
@@ -80,6 +88,303 @@ static void packet_test(unsigned npackets, size_t plength, pa_mainloop *ml, pa_p
     pa_packet_unref(packet);
 }
 
+#define N_BLOCKS 100
+
+static pa_memblock *blocks_received[N_BLOCKS];
+static unsigned n_blocks_received;
+
+static void memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    fail_unless(chunk->memblock != NULL);
+    fail_unless(n_blocks_received < N_BLOCKS);
+
+    blocks_received[n_blocks_received++] = pa_memblock_ref(chunk->memblock);
+}
+
+/* p1 sends blocks by reference, p2 gives them back all at once */
+static void block_id_batch_test(pa_mainloop *ml, pa_mempool *mp, pa_pstream *p1, pa_pstream *p2) {
+    const pa_mempool_stat *stat = pa_mempool_get_stat(mp);
+    unsigned i, n_ids, n_frames;
+
+    pa_pstream_set_receive_memblock_callback(p2, memblock_received, NULL);
+    n_blocks_received = 0;
+
+    for (i = 0; i < N_BLOCKS; i++) {
+        pa_memchunk chunk;
+
+        chunk.memblock = pa_memblock_new(mp, 64);
+        chunk.index = 0;
+        chunk.length = 64;
+        pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    while (n_blocks_received < N_BLOCKS)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    fail_unless(pa_atomic_load(&stat->n_exported) == N_BLOCKS);
+
+    for (i = 0; i < N_BLOCKS; i++)
+        pa_memblock_unref(blocks_received[i]);
+
+    while (pa_atomic_load(&stat->n_exported) > 0)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    pa_pstream_get_block_id_stat(p2, &n_ids, &n_frames);
+    pa_log_debug("Released %u blocks in %u frames", n_ids, n_frames);
+    fail_unless(n_ids == N_BLOCKS);
+    fail_unless(n_frames == 1);
+}
+
+static void pstreams_new(pa_mainloop *ml, pa_mempool *mp, unsigned n_lanes, pa_pstream **p1, pa_pstream **p2) {
+    int pipefd[4];
+    pa_iochannel *io1, *io2;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]);
+    *p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    *p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    sr1 = pa_srbchannel_new_with_lanes(pa_mainloop_get_api(ml), mp, n_lanes);
+    fail_unless(sr1 != NULL);
+    fail_unless(pa_srbchannel_get_n_lanes(sr1) == n_lanes);
+    pa_srbchannel_export(sr1, &srt);
+    pa_pstream_set_srbchannel(*p1, sr1);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    fail_unless(sr2 != NULL);
+    fail_unless(pa_srbchannel_get_n_lanes(sr2) == n_lanes);
+    pa_pstream_set_srbchannel(*p2, sr2);
+}
+
+/* Every item sent gets a sequence number. Memblocks carry it along with
+ * their channel, packets carry it along with the number of memblocks
+ * sent before them. */
+#define N_ITEMS 2000
+#define N_CHANNELS 5
+#define BLOCK_SIZE_MAX 40000
+
+static uint32_t last_seq[N_CHANNELS];
+static unsigned n_items_received, n_memblocks_received;
+static int32_t last_memblock_seq;
+
+static void ordered_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    uint32_t *d, seq;
+
+    fail_unless(chunk->memblock != NULL);
+    fail_unless(channel < N_CHANNELS);
+
+    d = pa_memblock_acquire_chunk(chunk);
+    seq = d[0];
+    fail_unless(d[1] == channel);
+    pa_memblock_release(chunk->memblock);
+
+    /* Memblocks of one channel arrive in order... */
+    fail_unless(last_seq[channel] == 0 || seq > last_seq[channel]);
+    last_seq[channel] = seq;
+
+    n_items_received++;
+    n_memblocks_received++;
+    last_memblock_seq = PA_MAX(last_memblock_seq, (int32_t) seq);
+}
+
+static void ordered_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint32_t *d;
+    size_t plen;
+
+    d = (const uint32_t *) pa_packet_data(packet, &plen);
+    fail_unless(plen == 2 * sizeof(uint32_t));
+
+    /* ...and packets after exactly the memblocks sent before them */
+    fail_unless(n_memblocks_received == d[1], "packet %u after %u memblocks, sent after %u",
+                d[0], n_memblocks_received, d[1]);
+    fail_unless(last_memblock_seq < (int32_t) d[0]);
+
+    n_items_received++;
+}
+
+static void lanes_order_test(pa_mainloop *ml, pa_mempool *mp, pa_pstream *p1, pa_pstream *p2) {
+    unsigned i, n_memblocks = 0;
+
+    pa_pstream_set_receive_memblock_callback(p2, ordered_memblock_received, NULL);
+    pa_pstream_set_receive_packet_callback(p2, ordered_packet_received, NULL);
+    n_items_received = n_memblocks_received = 0;
+    last_memblock_seq = -1;
+    memset(last_seq, 0, sizeof(last_seq));
+
+    for (i = 1; i <= N_ITEMS; i++) {
+
+        if (i % 7 == 0) {
+            pa_packet *packet = pa_packet_new(2 * sizeof(uint32_t));
+            uint32_t *d;
+            size_t plen;
+
+            d = (uint32_t *) pa_packet_data(packet, &plen);
+            d[0] = i;
+            d[1] = n_memblocks;
+            pa_pstream_send_packet(p1, packet, NULL);
+            pa_packet_unref(packet);
+
+        } else {
+            pa_memchunk chunk;
+            uint32_t *d;
+
+            /* Sizes all over the place, so that frames end up split
+             * across ringbuffer ends when they are copied */
+            chunk.length = PA_ALIGN((i * 7919) % BLOCK_SIZE_MAX + 2 * sizeof(uint32_t));
+            chunk.memblock = pa_memblock_new(mp, chunk.length);
+            chunk.index = 0;
+
+            d = pa_memblock_acquire(chunk.memblock);
+            d[0] = i;
+            d[1] = i % N_CHANNELS;
+            pa_memblock_release(chunk.memblock);
+
+            pa_pstream_send_memblock(p1, i % N_CHANNELS, 0, PA_SEEK_RELATIVE, &chunk);
+            pa_memblock_unref(chunk.memblock);
+            n_memblocks++;
+        }
+
+        if (i % 50 == 0)
+            pa_mainloop_iterate(ml, 0, NULL);
+    }
+
+    while (n_items_received < N_ITEMS)
+        pa_mainloop_iterate(ml, 1, NULL);
+}
+
+/* A big backlog on channel 0 and a single small block on channel 1 */
+#define N_BACKLOG 32
+#define BACKLOG_BLOCK_SIZE 48000
+
+static unsigned n_backlog_received;
+static bool small_received;
+static unsigned backlog_before_small;
+static pa_usec_t small_received_at;
+
+static void backlog_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    if (channel == 0)
+        n_backlog_received++;
+    else {
+        small_received = true;
+        backlog_before_small = n_backlog_received;
+        small_received_at = pa_rtclock_now();
+    }
+}
+
+static pa_usec_t backlog_test(pa_mainloop *ml, pa_mempool *mp, pa_pstream *p1, pa_pstream *p2) {
+    pa_memchunk chunk;
+    pa_usec_t sent_at;
+    unsigned i;
+
+    pa_pstream_set_receive_memblock_callback(p2, backlog_memblock_received, NULL);
+    n_backlog_received = 0;
+    small_received = false;
+
+    chunk.memblock = pa_memblock_new(mp, BACKLOG_BLOCK_SIZE);
+    chunk.index = 0;
+    chunk.length = BACKLOG_BLOCK_SIZE;
+    for (i = 0; i < N_BACKLOG; i++)
+        pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+    pa_memblock_unref(chunk.memblock);
+
+    chunk.memblock = pa_memblock_new(mp, 64);
+    chunk.length = 64;
+    sent_at = pa_rtclock_now();
+    pa_pstream_send_memblock(p1, 1, 0, PA_SEEK_RELATIVE, &chunk);
+    pa_memblock_unref(chunk.memblock);
+
+    while (n_backlog_received < N_BACKLOG || !small_received)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    return small_received_at - sent_at;
+}
+
+#define N_BENCH_BLOCKS 500
+#define TIMES2 5
+
+static unsigned n_bench_received;
+
+static void bench_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    n_bench_received++;
+}
+
+static void throughput_benchmark(pa_mainloop *ml, pa_mempool *mp, pa_pstream *p1, pa_pstream *p2, size_t block_size) {
+    pa_memchunk chunk;
+    char label[64];
+
+    pa_pstream_set_receive_memblock_callback(p2, bench_memblock_received, NULL);
+
+    chunk.memblock = pa_memblock_new(mp, block_size);
+    chunk.index = 0;
+    chunk.length = block_size;
+
+    pa_snprintf(label, sizeof(label), "%u blocks of %u bytes", N_BENCH_BLOCKS, (unsigned) block_size);
+
+    PA_RUNTIME_TEST_RUN_START(label, 1, TIMES2) {
+        unsigned i;
+
+        n_bench_received = 0;
+        for (i = 0; i < N_BENCH_BLOCKS; i++)
+            pa_pstream_send_memblock(p1, i % N_CHANNELS, 0, PA_SEEK_RELATIVE, &chunk);
+
+        while (n_bench_received < N_BENCH_BLOCKS)
+            pa_mainloop_iterate(ml, 1, NULL);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_memblock_unref(chunk.memblock);
+}
+
+static void lanes_run(unsigned n_lanes, bool shm) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_pstream *p1, *p2;
+    pa_usec_t latency = 0;
+    unsigned i;
+
+    pa_log_debug("%u lanes, %s", n_lanes, shm ? "blocks by reference" : "blocks copied");
+
+    pstreams_new(ml, mp, n_lanes, &p1, &p2);
+    pa_pstream_enable_shm(p1, shm);
+    pa_pstream_enable_shm(p2, shm);
+
+    lanes_order_test(ml, mp, p1, p2);
+
+    if (!shm) {
+        for (i = 0; i < TIMES2; i++) {
+            latency += backlog_test(ml, mp, p1, p2);
+
+            /* With lanes the small block passes the backlog */
+            if (n_lanes > 1)
+                fail_unless(backlog_before_small < N_BACKLOG);
+            else
+                fail_unless(backlog_before_small == N_BACKLOG);
+        }
+
+        pa_log_debug("Small block behind a backlog of %u blocks of %u bytes took %llu usec on average",
+                     N_BACKLOG, BACKLOG_BLOCK_SIZE, (unsigned long long) (latency / TIMES2));
+    }
+
+    throughput_benchmark(ml, mp, p1, p2, 64);
+    if (!shm)
+        throughput_benchmark(ml, mp, p1, p2, 16384);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+
+START_TEST (srbchannel_lanes_test) {
+    lanes_run(0, false);
+    lanes_run(4, false);
+    lanes_run(0, true);
+    lanes_run(4, true);
+}
+END_TEST
+
 START_TEST (srbchannel_test) {
 
     int pipefd[4];
@@ -114,13 +419,183 @@ START_TEST (srbchannel_test) {
     packet_test(250, 5, ml, p1, p2);
     packet_test(10, 1234567, ml, p1, p2);
 
+    pa_log_debug("And now releasing blocks in batches...");
+
+    pa_pstream_enable_shm(p1, true);
+    pa_pstream_enable_shm(p2, true);
+    pa_pstream_enable_block_id_batching(p2);
+
+    block_id_batch_test(ml, mp, p1, p2);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+
+static pa_pdispatch *pd_sender, *pd_receiver;
+static uint32_t memfd_tag;
+static pa_memblock *memfd_block_received;
+
+static void command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_pstream *p = userdata;
+
+    fail_unless(pa_common_command_register_memfd_shmid(p, pd, 35, command, tag, t) == 0);
+}
+
+static const pa_pdispatch_cb_t receiver_command_table[PA_COMMAND_MAX] = {
+    [PA_COMMAND_REGISTER_MEMFD_SHMID] = command_register_memfd_shmid,
+};
+
+static void sender_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    fail_unless(pa_pdispatch_run(pd_sender, packet, ancil_data, NULL) == 0);
+}
+
+static void receiver_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    fail_unless(pa_pdispatch_run(pd_receiver, packet, ancil_data, p) == 0);
+}
+
+static void memfd_segment_cb(pa_pstream *p, pa_mempool *pool, void *userdata) {
+    pa_pstream_register_memfd_segments(p, pool, pd_sender, &memfd_tag);
+}
+
+static void memfd_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    uint8_t *d;
+
+    fail_unless(memfd_block_received == NULL);
+    fail_unless(chunk->length == 64);
+
+    d = pa_memblock_acquire_chunk(chunk);
+    fail_unless(d[0] == 0x55 && d[63] == 0x55);
+    pa_memblock_release(chunk->memblock);
+
+    memfd_block_received = pa_memblock_ref(chunk->memblock);
+}
+
+/* Sends a block from the second segment of p1's pool and tells if it
+ * arrived by reference */
+static bool send_memfd_block(pa_mainloop *ml, pa_pstream *p1, pa_memblock *b) {
+    pa_memchunk chunk;
+    bool by_reference;
+
+    chunk.memblock = b;
+    chunk.index = 0;
+    chunk.length = 64;
+    pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+
+    while (!memfd_block_received)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    by_reference = !pa_memblock_is_ours(memfd_block_received);
+    pa_memblock_unref(memfd_block_received);
+    memfd_block_received = NULL;
+
+    return by_reference;
+}
+
+START_TEST (srbchannel_memfd_segment_test) {
+    int sv[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp_memfd, *mp, *mp_srb;
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+    pa_memblock *blocks[3];
+    const char *reason;
+    uint32_t shm_id;
+    unsigned i, n;
+    uint8_t *d;
+
+    /* Two pool blocks per segment */
+    if (!(mp_memfd = pa_mempool_new(PA_MEM_TYPE_SHARED_MEMFD, 2 * 64 * 1024, true))) {
+        pa_log_info("No memfd support, skipping");
+        pa_mainloop_free(ml);
+        return;
+    }
+
+    mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    mp_srb = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    fail_unless(mp != NULL && mp_srb != NULL);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), sv[0], sv[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), sv[1], sv[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp_memfd);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    pd_sender = pa_pdispatch_new(pa_mainloop_get_api(ml), true, NULL, 0);
+    pd_receiver = pa_pdispatch_new(pa_mainloop_get_api(ml), true, receiver_command_table, PA_COMMAND_MAX);
+    memfd_tag = 0;
+
+    pa_pstream_set_receive_packet_callback(p1, sender_packet_received, NULL);
+    pa_pstream_set_receive_packet_callback(p2, receiver_packet_received, NULL);
+    pa_pstream_set_receive_memblock_callback(p2, memfd_memblock_received, NULL);
+    pa_pstream_set_memfd_segment_callback(p1, memfd_segment_cb, NULL);
+
+    pa_pstream_enable_shm(p1, true);
+    pa_pstream_enable_shm(p2, true);
+    pa_pstream_enable_memfd(p1);
+    pa_pstream_enable_memfd(p2);
+
+    /* The pool itself is registered before there is a srbchannel */
+    fail_unless(pa_mempool_get_shm_id(mp_memfd, &shm_id) == 0);
+    fail_unless(pa_pstream_register_memfd_mempool(p1, mp_memfd, &reason) == 0, "%s", reason);
+
+    while (!pa_pstream_memfd_is_registered(p2, shm_id))
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp_srb);
+    fail_unless(sr1 != NULL);
+    pa_srbchannel_export(sr1, &srt);
+    pa_pstream_set_srbchannel(p1, sr1);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    fail_unless(sr2 != NULL);
+    pa_pstream_set_srbchannel(p2, sr2);
+
+    /* The third block needs a second segment */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        blocks[i] = pa_memblock_new_pool(mp_memfd, pa_mempool_block_size_max(mp_memfd));
+        fail_unless(blocks[i] != NULL);
+    }
+
+    fail_unless(pa_mempool_get_n_segments(mp_memfd) == 2);
+
+    d = pa_memblock_acquire(blocks[2]);
+    memset(d, 0x55, 64);
+    pa_memblock_release(blocks[2]);
+
+    /* Copied or not, the first block gets there intact while the
+     * registration of the segment is on its way */
+    send_memfd_block(ml, p1, blocks[2]);
+
+    while (pa_pdispatch_is_pending(pd_sender))
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    /* Once it has been confirmed, the block goes by reference */
+    for (n = 0; n < 10; n++)
+        fail_unless(send_memfd_block(ml, p1, blocks[2]));
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_pdispatch_unref(pd_sender);
+    pa_pdispatch_unref(pd_receiver);
+    pa_pstream_unlink(p1);
+    pa_pstream_unlink(p2);
     pa_pstream_unref(p1);
     pa_pstream_unref(p2);
+    pa_mempool_unref(mp_memfd);
     pa_mempool_unref(mp);
+    pa_mempool_unref(mp_srb);
     pa_mainloop_free(ml);
 }
 END_TEST
 
+#endif
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -134,6 +609,12 @@ int main(int argc, char *argv[]) {
     s = suite_create("srbchannel");
     tc = tcase_create("srbchannel");
     tcase_add_test(tc, srbchannel_test);
+    tcase_add_test(tc, srbchannel_lanes_test);
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+    tcase_add_test(tc, srbchannel_memfd_segment_test);
+#endif
+    /* The benchmarks take a while under valgrind */
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
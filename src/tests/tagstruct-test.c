@@ -0,0 +1,286 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/tagstruct.h>
+
+#include "runtime-test-util.h"
+
+#define N_OBJECTS 200
+#define N_PROPERTIES 30
+
+START_TEST (tagstruct_test) {
+    pa_tagstruct *t;
+    pa_packet *packet;
+    pa_sample_spec ss = { PA_SAMPLE_S16LE, 44100, 2 }, ss2;
+    pa_channel_map map, map2;
+    pa_cvolume vol, vol2;
+    pa_proplist *p, *p2;
+    const uint8_t *data;
+    const char *s, *s2;
+    const void *blob;
+    char big[1000];
+    size_t length, i;
+    uint32_t u32;
+    uint64_t u64;
+    int64_t s64;
+    uint8_t u8;
+    bool b;
+
+    pa_channel_map_init_stereo(&map);
+    pa_cvolume_set(&vol, 2, PA_VOLUME_NORM / 2);
+
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = 0;
+
+    p = pa_proplist_new();
+    pa_proplist_sets(p, PA_PROP_MEDIA_NAME, "Test");
+    pa_proplist_set(p, "x-test.binary", "\0\1\2\3", 4);
+
+    t = pa_tagstruct_new();
+    pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+    pa_tagstruct_putu8(t, 7);
+    pa_tagstruct_puts(t, "hello");
+    pa_tagstruct_puts(t, NULL);
+    pa_tagstruct_put_sample_spec(t, &ss);
+    pa_tagstruct_put_channel_map(t, &map);
+    pa_tagstruct_put_cvolume(t, &vol);
+    pa_tagstruct_put_boolean(t, true);
+    pa_tagstruct_putu64(t, UINT64_C(0x123456789abcdef0));
+    pa_tagstruct_puts64(t, -42);
+    pa_tagstruct_put_arbitrary(t, "blob", 4);
+    pa_tagstruct_puts(t, big);
+    pa_tagstruct_put_proplist(t, p);
+
+    packet = pa_tagstruct_free_to_packet(t);
+    data = pa_packet_data(packet, &length);
+
+    /* Cut short anywhere, parsing fails and does not read too far */
+    for (i = 1; i < length; i++) {
+        t = pa_tagstruct_new_fixed(data, i);
+        p2 = pa_proplist_new();
+
+        fail_unless(pa_tagstruct_get(t,
+                                     PA_TAG_U32, &u32,
+                                     PA_TAG_U8, &u8,
+                                     PA_TAG_STRING, &s,
+                                     PA_TAG_STRING, &s2,
+                                     PA_TAG_SAMPLE_SPEC, &ss2,
+                                     PA_TAG_CHANNEL_MAP, &map2,
+                                     PA_TAG_CVOLUME, &vol2,
+                                     PA_TAG_BOOLEAN, &b,
+                                     PA_TAG_U64, &u64,
+                                     PA_TAG_INVALID) < 0 ||
+                    pa_tagstruct_gets64(t, &s64) < 0 ||
+                    pa_tagstruct_get(t,
+                                     PA_TAG_ARBITRARY, &blob, (size_t) 4,
+                                     PA_TAG_STRING, &s,
+                                     PA_TAG_INVALID) < 0 ||
+                    pa_tagstruct_get_proplist(t, p2) < 0);
+
+        pa_proplist_free(p2);
+        pa_tagstruct_free(t);
+    }
+
+    t = pa_tagstruct_new_fixed(data, length);
+    fail_unless(pa_tagstruct_getu32(t, &u32) == 0 && u32 == PA_COMMAND_REPLY);
+    fail_unless(pa_tagstruct_getu8(t, &u8) == 0 && u8 == 7);
+
+    /* Strings and blobs are not copied out of the packet */
+    fail_unless(pa_tagstruct_gets(t, &s) == 0 && pa_streq(s, "hello"));
+    fail_unless((const uint8_t *) s > data && (const uint8_t *) s < data + length);
+    fail_unless(pa_tagstruct_gets(t, &s) == 0 && s == NULL);
+
+    fail_unless(pa_tagstruct_get_sample_spec(t, &ss2) == 0 && pa_sample_spec_equal(&ss, &ss2));
+    fail_unless(pa_tagstruct_get_channel_map(t, &map2) == 0 && pa_channel_map_equal(&map, &map2));
+    fail_unless(pa_tagstruct_get_cvolume(t, &vol2) == 0 && pa_cvolume_equal(&vol, &vol2));
+    fail_unless(pa_tagstruct_get_boolean(t, &b) == 0 && b);
+    fail_unless(pa_tagstruct_getu64(t, &u64) == 0 && u64 == UINT64_C(0x123456789abcdef0));
+    fail_unless(pa_tagstruct_gets64(t, &s64) == 0 && s64 == -42);
+    fail_unless(pa_tagstruct_get_arbitrary(t, &blob, 4) == 0 && memcmp(blob, "blob", 4) == 0);
+    fail_unless((const uint8_t *) blob > data && (const uint8_t *) blob < data + length);
+    fail_unless(pa_tagstruct_gets(t, &s) == 0 && pa_streq(s, big));
+
+    p2 = pa_proplist_new();
+    fail_unless(pa_tagstruct_get_proplist(t, p2) == 0);
+    fail_unless(pa_proplist_equal(p, p2));
+    fail_unless(pa_tagstruct_eof(t));
+    pa_proplist_free(p2);
+
+    pa_tagstruct_free(t);
+    pa_packet_unref(packet);
+    pa_proplist_free(p);
+}
+END_TEST
+
+/* Something like what the introspection replies for sinks look like */
+static void put_object(pa_tagstruct *t, unsigned i, pa_proplist *p) {
+    pa_sample_spec ss = { PA_SAMPLE_S16LE, 48000, 2 };
+    pa_channel_map map;
+    pa_cvolume vol;
+    char name[64];
+
+    pa_channel_map_init_stereo(&map);
+    pa_cvolume_set(&vol, 2, PA_VOLUME_NORM);
+    pa_snprintf(name, sizeof(name), "alsa_output.pci-0000_00_1f.3.analog-stereo.%u", i);
+
+    pa_tagstruct_putu32(t, i);
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_puts(t, "Built-in Audio Analog Stereo");
+    pa_tagstruct_put_sample_spec(t, &ss);
+    pa_tagstruct_put_channel_map(t, &map);
+    pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+    pa_tagstruct_put_cvolume(t, &vol);
+    pa_tagstruct_put_boolean(t, false);
+    pa_tagstruct_putu32(t, i);
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_put_usec(t, 20000);
+    pa_tagstruct_puts(t, "module-alsa-card.c");
+    pa_tagstruct_putu32(t, 0x3f);
+    pa_tagstruct_put_proplist(t, p);
+}
+
+static int get_object(pa_tagstruct *t, pa_proplist *p) {
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_cvolume vol;
+    const char *name, *description, *monitor_name, *driver;
+    uint32_t idx, owner_module, monitor_source, flags;
+    pa_usec_t latency;
+    bool mute;
+
+    if (pa_tagstruct_get(t,
+                         PA_TAG_U32, &idx,
+                         PA_TAG_STRING, &name,
+                         PA_TAG_STRING, &description,
+                         PA_TAG_SAMPLE_SPEC, &ss,
+                         PA_TAG_CHANNEL_MAP, &map,
+                         PA_TAG_U32, &owner_module,
+                         PA_TAG_CVOLUME, &vol,
+                         PA_TAG_BOOLEAN, &mute,
+                         PA_TAG_U32, &monitor_source,
+                         PA_TAG_STRING, &monitor_name,
+                         PA_TAG_USEC, &latency,
+                         PA_TAG_STRING, &driver,
+                         PA_TAG_U32, &flags,
+                         PA_TAG_INVALID) < 0)
+        return -1;
+
+    pa_proplist_clear(p);
+    return pa_tagstruct_get_proplist(t, p);
+}
+
+START_TEST (tagstruct_benchmark) {
+    pa_proplist *p, *p2;
+    pa_packet *packet = NULL;
+    unsigned i;
+
+    p = pa_proplist_new();
+    for (i = 0; i < N_PROPERTIES; i++) {
+        char k[32], v[64];
+
+        pa_snprintf(k, sizeof(k), "x-test.property%u", i);
+        pa_snprintf(v, sizeof(v), "some value that is not too short %u", i);
+        pa_proplist_sets(p, k, v);
+    }
+
+    p2 = pa_proplist_new();
+
+    PA_RUNTIME_TEST_RUN_START("acks, serialize", 10000, 5) {
+        pa_tagstruct *t = pa_tagstruct_new();
+
+        pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+        pa_tagstruct_putu32(t, _j);
+        pa_packet_unref(pa_tagstruct_free_to_packet(t));
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("list of 200 sinks, serialize", 10, 5) {
+        pa_tagstruct *t = pa_tagstruct_new();
+
+        pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+        pa_tagstruct_putu32(t, 1);
+
+        for (i = 0; i < N_OBJECTS; i++)
+            put_object(t, i, p);
+
+        if (packet)
+            pa_packet_unref(packet);
+        packet = pa_tagstruct_free_to_packet(t);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("list of 200 sinks, parse", 10, 5) {
+        const uint8_t *data;
+        size_t length;
+        uint32_t command, tag;
+        pa_tagstruct *t;
+
+        data = pa_packet_data(packet, &length);
+        t = pa_tagstruct_new_fixed(data, length);
+
+        fail_unless(pa_tagstruct_getu32(t, &command) == 0);
+        fail_unless(pa_tagstruct_getu32(t, &tag) == 0);
+
+        for (i = 0; i < N_OBJECTS; i++)
+            fail_unless(get_object(t, p2) == 0);
+
+        fail_unless(pa_tagstruct_eof(t));
+        pa_tagstruct_free(t);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    fail_unless(pa_proplist_equal(p, p2));
+
+    pa_packet_unref(packet);
+    pa_proplist_free(p);
+    pa_proplist_free(p2);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Tagstruct");
+    tc = tcase_create("tagstruct");
+    tcase_add_test(tc, tagstruct_test);
+    tcase_add_test(tc, tagstruct_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,167 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/write-ring.h>
+
+#define FRAME_SIZE 4
+#define N_WRITES 1000
+#define MAX_OUTSTANDING 8
+
+static void fill(uint8_t *d, size_t length, unsigned seq) {
+    size_t k;
+
+    for (k = 0; k < length; k++)
+        d[k] = (uint8_t) (seq + k);
+}
+
+static void verify(pa_memblock *b, unsigned seq) {
+    uint8_t *d;
+    size_t k;
+
+    fail_unless(pa_memblock_is_read_only(b));
+
+    d = pa_memblock_acquire(b);
+    for (k = 0; k < pa_memblock_get_length(b); k++)
+        fail_unless(d[k] == (uint8_t) (seq + k), "write %u, byte %u is %u", seq, (unsigned) k, d[k]);
+    pa_memblock_release(b);
+}
+
+START_TEST (write_ring_test) {
+    pa_mempool *pool;
+    pa_write_ring *server, *client;
+    pa_memblock *outstanding[MAX_OUTSTANDING];
+    unsigned n_outstanding = 0, i, n_direct = 0;
+    size_t capacity;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    fail_unless(pool != NULL);
+
+    server = pa_write_ring_new(pool, FRAME_SIZE);
+    fail_unless(server != NULL);
+    client = pa_write_ring_attach(pa_write_ring_get_memblock(server), FRAME_SIZE);
+    fail_unless(client != NULL);
+
+    capacity = pa_write_ring_get_capacity(client);
+    fail_unless(capacity == pa_write_ring_get_capacity(server));
+    fail_unless(capacity % FRAME_SIZE == 0);
+
+    for (i = 0; i < N_WRITES; i++) {
+        size_t want, length, index;
+        uint8_t *d;
+        pa_memblock *b;
+
+        /* Odd sizes, so that the ring has to start over now and then
+         * with some room left at its end */
+        want = ((i * 7919) % (capacity / 3 / FRAME_SIZE) + 1) * FRAME_SIZE;
+        length = want;
+
+        if (!(d = pa_write_ring_begin_write(client, &length))) {
+            unsigned j;
+
+            /* Full, free any of the blocks and try again later. Its
+             * space only comes back once the ones before it are gone. */
+            fail_unless(n_outstanding > 0);
+
+            j = i % n_outstanding;
+            pa_memblock_unref(outstanding[j]);
+            outstanding[j] = outstanding[--n_outstanding];
+            continue;
+        }
+
+        fail_unless(length >= want);
+        fill(d, want, i);
+        index = pa_write_ring_end_write(client, want);
+
+        /* Anything else than what was just written is refused */
+        fail_unless(pa_write_ring_take(server, index + FRAME_SIZE, want) == NULL);
+        fail_unless(pa_write_ring_take(server, index, want + 1) == NULL);
+
+        b = pa_write_ring_take(server, index, want);
+        fail_unless(b != NULL);
+        verify(b, i);
+        n_direct++;
+
+        if (n_outstanding == MAX_OUTSTANDING) {
+            pa_memblock_unref(outstanding[0]);
+            outstanding[0] = outstanding[--n_outstanding];
+        }
+        outstanding[n_outstanding++] = b;
+    }
+
+    /* Most writes must have gone into the ring */
+    fail_unless(n_direct > N_WRITES / 2);
+
+    while (n_outstanding > 0)
+        pa_memblock_unref(outstanding[--n_outstanding]);
+
+    /* With everything given back, half of the ring fits in one piece,
+     * either at its end or at its start */
+    {
+        size_t length = (capacity / 2 / FRAME_SIZE) * FRAME_SIZE;
+
+        fail_unless(pa_write_ring_begin_write(client, &length) != NULL);
+        pa_write_ring_end_write(client, 0);
+    }
+
+    /* A client that writes past what was given back is refused */
+    {
+        size_t length = FRAME_SIZE, index;
+        pa_memblock *b;
+
+        fail_unless(pa_write_ring_begin_write(client, &length) != NULL);
+        index = pa_write_ring_end_write(client, length);
+        b = pa_write_ring_take(server, index, length);
+        fail_unless(b != NULL);
+        fail_unless(pa_write_ring_take(server, (index + length) % capacity, capacity) == NULL);
+        pa_memblock_unref(b);
+    }
+
+    pa_write_ring_free(client);
+    pa_write_ring_free(server);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Write Ring");
+    tc = tcase_create("write-ring");
+    tcase_add_test(tc, write_ring_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}